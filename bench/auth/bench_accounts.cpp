@@ -0,0 +1,195 @@
+// bench accounts
+//
+// Username lookups on the login path, N accounts of ~70-byte values
+// ( an encoded password hash ):
+//
+//   unordered_map : std::unordered_map<std::string, std::string>, rebuilt
+//                   from storage at every start; readers share a
+//                   shared_mutex with the writer
+//   AccountTable  : the mapped open-addressing file, lock-free readers
+//
+// Reports insert, hit and miss latency on one thread, the time to have the
+// table ready after a restart, and lookups per second with R readers while
+// one writer keeps adding accounts.
+//
+// usage: bench_accounts [accounts] [readers] [dir]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "account_table.hpp"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+
+std::atomic<std::uint64_t> sink{0};
+
+double ns_per(clock_type::time_point start, std::size_t n)
+{
+    return std::chrono::duration<double, std::nano>(clock_type::now() -
+                                                    start)
+               .count() /
+           n;
+}
+
+double ms_since(clock_type::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(clock_type::now() -
+                                                     start)
+        .count();
+}
+
+/// Lookups per second of @p readers threads for @p seconds while @p write
+/// runs on its own thread.
+template <class Read, class Write>
+double concurrent(unsigned readers, double seconds, Read read, Write write)
+{
+    std::atomic<bool> done{false};
+    std::atomic<std::uint64_t> total{0};
+    std::vector<std::thread> threads;
+    for (unsigned r = 0; r < readers; ++r) {
+        threads.emplace_back([&, r] {
+            std::mt19937_64 rng(r);
+            std::uint64_t n = 0, found = 0;
+            while (!done.load(std::memory_order_relaxed)) {
+                for (int i = 0; i < 256; ++i)
+                    found += read(rng());
+                n += 256;
+            }
+            total += n;
+            sink += found;  // keeps the lookups
+        });
+    }
+    std::thread writer([&] {
+        for (std::uint64_t i = 0; !done.load(); ++i)
+            write(i);
+    });
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    done.store(true);
+    for (auto &t : threads)
+        t.join();
+    writer.join();
+    return total.load() / seconds;
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    const std::size_t accounts = argc > 1 ? std::atoll(argv[1]) : 1000000;
+    const unsigned readers = argc > 2 ? std::atoi(argv[2]) : 4;
+    const fs::path dir = argc > 3 ? fs::path(argv[3])
+                                  : fs::temp_directory_path() /
+                                        "bench_accounts";
+    const std::string value(68, 'h');
+
+    std::vector<std::string> names, absent;
+    names.reserve(accounts);
+    for (std::size_t i = 0; i < accounts; ++i) {
+        names.push_back("user" + std::to_string(i));
+        absent.push_back("nobody" + std::to_string(i));
+    }
+    std::vector<std::size_t> order(accounts);
+    for (std::size_t i = 0; i < accounts; ++i)
+        order[i] = i;
+    std::shuffle(order.begin(), order.end(), std::mt19937_64(1));
+
+    std::printf("%zu accounts, %u readers\n", accounts, readers);
+    std::printf("%-14s %10s %10s %10s %12s %14s\n", "", "insert ns",
+                "hit ns", "miss ns", "ready ms", "lookups/s");
+
+    // -- unordered_map -- //
+    {
+        std::unordered_map<std::string, std::string> map;
+        auto start = clock_type::now();
+        for (const auto &name : names)
+            map.emplace(name, value);
+        const double insert = ns_per(start, accounts);
+        const double ready = ms_since(start);  // rebuilt at every start
+
+        std::size_t found = 0;
+        start = clock_type::now();
+        for (std::size_t i : order)
+            found += map.count(names[i]);
+        const double hit = ns_per(start, accounts);
+        start = clock_type::now();
+        for (std::size_t i : order)
+            found += map.count(absent[i]);
+        const double miss = ns_per(start, accounts);
+
+        std::shared_mutex mtx;
+        const double rate = concurrent(
+            readers, 1.0,
+            [&](std::uint64_t r) {
+                std::shared_lock<std::shared_mutex> lk(mtx);
+                return map.count(names[r % accounts]) != 0;
+            },
+            [&](std::uint64_t i) {
+                std::unique_lock<std::shared_mutex> lk(mtx);
+                map.emplace("new" + std::to_string(i), value);
+            });
+        std::printf("%-14s %10.1f %10.1f %10.1f %12.1f %14.0f%s\n",
+                    "unordered_map", insert, hit, miss, ready, rate,
+                    found == accounts ? "" : " ( wrong count )");
+    }
+
+    // -- AccountTable -- //
+    fs::remove_all(dir);
+    {
+        double insert;
+        {
+            AccountTable table(dir.string(), accounts * 2);
+            const auto start = clock_type::now();
+            for (const auto &name : names)
+                table.put(name, value);
+            insert = ns_per(start, accounts);
+            table.sync();
+        }
+
+        auto start = clock_type::now();
+        AccountTable table(dir.string());
+        std::string_view v;
+        const double ready = ms_since(start);  // mapped, not loaded
+
+        std::size_t found = 0;
+        start = clock_type::now();
+        for (std::size_t i : order)
+            found += table.find(names[i], v);
+        const double hit = ns_per(start, accounts);
+        start = clock_type::now();
+        for (std::size_t i : order)
+            found += table.find(absent[i], v);
+        const double miss = ns_per(start, accounts);
+
+        const double rate = concurrent(
+            readers, 1.0,
+            [&](std::uint64_t r) {
+                std::string_view found_value;
+                return table.find(names[r % accounts], found_value);
+            },
+            [&](std::uint64_t i) {
+                table.put("new" + std::to_string(i), value);
+            });
+        std::printf("%-14s %10.1f %10.1f %10.1f %12.1f %14.0f%s\n",
+                    "AccountTable", insert, hit, miss, ready, rate,
+                    found == accounts ? "" : " ( wrong count )");
+    }
+    fs::remove_all(dir);
+    return 0;
+}
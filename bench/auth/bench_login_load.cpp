@@ -0,0 +1,148 @@
+// bench login load
+//
+// Login storm after a restart while chat traffic keeps flowing. Reports
+// login and chat latency ( enqueue -> done ) separately.
+//
+//   inline    : logins run the KDF on the chat workers ( old dispatch path )
+//   offloaded : logins go to a dedicated 2-thread pool with an admission
+//               limit, and reconnects within the TTL hit CredentialCache
+//
+// usage: bench_login_load [logins] [kdf_iterations]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "credential_cache.hpp"
+#include "crypto.hpp"
+#include "strand.hpp"
+#include "thread_pool.hpp"
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr int kUsers = 50;
+constexpr int kChats = 4000;
+constexpr int kConversations = 16;
+constexpr auto kChatInterval = std::chrono::microseconds(100);
+constexpr auto kChatWork = std::chrono::microseconds(10);
+
+double micros(clock_type::duration d)
+{
+    return std::chrono::duration<double, std::micro>(d).count();
+}
+
+double percentile(std::vector<double> v, double p)
+{
+    if (v.empty())
+        return 0;
+    std::sort(v.begin(), v.end());
+    const std::size_t i = static_cast<std::size_t>(p * (v.size() - 1));
+    return v[i];
+}
+
+struct Result {
+    std::vector<double> login_us;
+    std::vector<double> chat_us;
+    int shed{0};
+};
+
+Result run(bool offload,
+           int logins,
+           const std::vector<PasswordHash> &accounts)
+{
+    ThreadPool chat_pool(4);
+    StrandExecutor<int> strands(chat_pool);
+    ThreadPool login_pool(2, 64);
+    CredentialCache cache;
+
+    Result r;
+    r.login_us.assign(logins, -1);
+    r.chat_us.assign(kChats, -1);
+    std::atomic<int> left{logins + kChats};
+
+    auto login = [&](int i, clock_type::time_point t0) {
+        const int user = i % kUsers;
+        const std::string name = "user" + std::to_string(user);
+        const std::string password = "pw" + std::to_string(user);
+        if (!offload || !cache.check(name, password)) {
+            if (verify_password(password, accounts[user]) && offload)
+                cache.put(name, password);
+        }
+        r.login_us[i] = micros(clock_type::now() - t0);
+        left.fetch_sub(1);
+    };
+
+    // the storm: every client reconnects at once
+    std::thread storm([&] {
+        for (int i = 0; i < logins; ++i) {
+            const auto t0 = clock_type::now();
+            if (!offload) {
+                chat_pool.submit([&, i, t0] { login(i, t0); });
+            } else if (!login_pool.try_submit([&, i, t0] { login(i, t0); })) {
+                ++r.shed;
+                left.fetch_sub(1);
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    });
+
+    // steady chat traffic
+    for (int i = 0; i < kChats; ++i) {
+        const auto t0 = clock_type::now();
+        strands.post(i % kConversations, [&, i, t0] {
+            const auto until = clock_type::now() + kChatWork;
+            while (clock_type::now() < until) {
+            }
+            r.chat_us[i] = micros(clock_type::now() - t0);
+            left.fetch_sub(1);
+        });
+        std::this_thread::sleep_for(kChatInterval);
+    }
+
+    storm.join();
+    while (left.load() > 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    r.login_us.erase(std::remove(r.login_us.begin(), r.login_us.end(), -1),
+                     r.login_us.end());
+    return r;
+}
+
+void print(const char *mode, const Result &r)
+{
+    std::printf("%10s %10.0f %10.0f %10.0f %10.0f %8d\n", mode,
+                percentile(r.login_us, 0.50), percentile(r.login_us, 0.99),
+                percentile(r.chat_us, 0.50), percentile(r.chat_us, 0.99),
+                r.shed);
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    const int logins = argc > 1 ? std::atoi(argv[1]) : 300;
+    const std::uint32_t iterations = argc > 2 ? std::atoi(argv[2]) : 10000;
+
+    std::vector<PasswordHash> accounts;
+    for (int u = 0; u < kUsers; ++u)
+        accounts.push_back(
+            hash_password("pw" + std::to_string(u), iterations));
+
+    std::printf("logins=%d users=%d kdf_iterations=%u chats=%d\n", logins,
+                kUsers, iterations, kChats);
+    std::printf("%10s %10s %10s %10s %10s %8s\n", "mode", "login p50",
+                "login p99", "chat p50", "chat p99", "shed");
+    std::printf("%10s %10s %10s %10s %10s %8s\n", "", "(us)", "(us)", "(us)",
+                "(us)", "");
+    print("inline", run(false, logins, accounts));
+    print("offloaded", run(true, logins, accounts));
+    return 0;
+}
@@ -0,0 +1,92 @@
+// bench dedup
+//
+// Cost of the idempotency check on the chat path, and how often it
+// mistakes a new message for a retry.
+//
+//   new keys : a unique key per message, filled up to the rated capacity
+//              of one span
+//   retries  : keys seen before ( every one must be caught )
+//   threads  : new keys from several threads at once
+//
+// usage: bench_dedup [memory_kb] [threads]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dedup_filter.hpp"
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+
+std::vector<std::string> make_keys(std::size_t n, const std::string &from)
+{
+    std::vector<std::string> keys;
+    keys.reserve(n);
+    for (std::size_t i = 0; i < n; ++i)
+        keys.push_back(from + "\n" + std::to_string(i * 2654435761u));
+    return keys;
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    const std::size_t memory_kb = argc > 1 ? std::atoi(argv[1]) : 4096;
+    const unsigned threads = argc > 2 ? std::atoi(argv[2]) : 4;
+
+    DedupFilter filter(memory_kb * 1024);
+    const std::size_t n = filter.capacity();
+    const auto keys = make_keys(n, "alice");
+    const auto now = DedupFilter::clock_type::now();
+
+    auto t0 = clock_type::now();
+    std::size_t false_hits = 0;
+    for (const auto &k : keys)
+        false_hits += filter.seen(k, now) ? 1 : 0;
+    const double new_ns =
+        std::chrono::duration<double, std::nano>(clock_type::now() - t0)
+            .count() / n;
+
+    t0 = clock_type::now();
+    std::size_t caught = 0;
+    for (const auto &k : keys)
+        caught += filter.seen(k, now) ? 1 : 0;
+    const double retry_ns =
+        std::chrono::duration<double, std::nano>(clock_type::now() - t0)
+            .count() / n;
+
+    // concurrent senders on a fresh filter, capacity shared between them
+    DedupFilter shared(memory_kb * 1024);
+    std::vector<std::vector<std::string>> per_thread;
+    for (unsigned t = 0; t < threads; ++t) {
+        const std::string from = "user" + std::to_string(t);
+        per_thread.push_back(make_keys(n / threads, from));
+    }
+    std::vector<std::thread> workers;
+    t0 = clock_type::now();
+    for (unsigned t = 0; t < threads; ++t)
+        workers.emplace_back([&, t] {
+            for (const auto &k : per_thread[t])
+                shared.seen(k, now);
+        });
+    for (auto &w : workers)
+        w.join();
+    const double mt_s =
+        std::chrono::duration<double>(clock_type::now() - t0).count();
+
+    std::printf("memory=%zu KB keys=%zu ( capacity of one span )\n",
+                filter.memory() / 1024, n);
+    std::printf("%10s %8.1f ns/check   false positives %zu ( %.5f%% )\n",
+                "new keys", new_ns, false_hits, 100.0 * false_hits / n);
+    std::printf("%10s %8.1f ns/check   caught %zu / %zu\n", "retries",
+                retry_ns, caught, n);
+    std::printf("%10s %8.1f M checks/s with %u threads\n", "threads",
+                n / threads * threads / mt_s / 1e6, threads);
+    return 0;
+}
@@ -0,0 +1,95 @@
+// bench strand
+//
+// Throughput of StrandExecutor vs. number of active conversations.
+//
+// Every task simulates one chat handler that waits on I/O for a fixed time
+// ( sleep ) or burns CPU ( spin ). Tasks of the same conversation are
+// serialized, so throughput should grow linearly with the number of
+// conversations until the pool is saturated ( pool size for sleep, core
+// count for spin ).
+//
+// usage: bench_strand [sleep|spin] [work_us] [pool_threads]
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "strand.hpp"
+#include "thread_pool.hpp"
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+
+void simulate_work(bool spin, std::chrono::microseconds work)
+{
+    if (!spin) {
+        std::this_thread::sleep_for(work);
+        return;
+    }
+    const auto until = clock_type::now() + work;
+    while (clock_type::now() < until) {
+    }
+}
+
+double run(ThreadPool &pool,
+           int conversations,
+           int tasks,
+           bool spin,
+           std::chrono::microseconds work)
+{
+    StrandExecutor<int> strands(pool);
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::atomic<int> left{tasks};
+
+    const auto start = clock_type::now();
+    for (int i = 0; i < tasks; ++i) {
+        strands.post(i % conversations, [&] {
+            simulate_work(spin, work);
+            if (left.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> lk(mtx);
+                cv.notify_all();
+            }
+        });
+    }
+    {
+        std::unique_lock<std::mutex> lk(mtx);
+        cv.wait(lk, [&] { return left.load() == 0; });
+    }
+    const std::chrono::duration<double> elapsed = clock_type::now() - start;
+    return tasks / elapsed.count();
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    const bool spin = argc > 1 && std::string(argv[1]) == "spin";
+    const std::chrono::microseconds work(argc > 2 ? std::atoi(argv[2]) : 200);
+    const int threads = argc > 3 ? std::atoi(argv[3]) : 16;
+
+    ThreadPool pool(threads);
+    const int tasks_per_conversation = 200;
+
+    std::printf("mode=%s work=%lldus pool=%zu\n", spin ? "spin" : "sleep",
+                static_cast<long long>(work.count()), pool.size());
+    std::printf("%14s %14s %10s\n", "conversations", "msgs/s", "speedup");
+
+    double base = 0;
+    for (int conversations = 1; conversations <= 32; conversations *= 2) {
+        const double rate = run(pool, conversations,
+                                conversations * tasks_per_conversation, spin,
+                                work);
+        if (base == 0)
+            base = rate;
+        std::printf("%14d %14.0f %9.2fx\n", conversations, rate, rate / base);
+    }
+    return 0;
+}
@@ -0,0 +1,173 @@
+// bench frame
+//
+// Messages/sec of the receive -> dispatch -> reply path with a client that
+// pipelines 100 messages at a time.
+//
+//   per-frame : one recv() per frame, one queue push per frame, one send()
+//               per reply ( the old ServerSocket loop )
+//   batched   : one recv() drains every complete frame, one push_batch(),
+//               and the worker coalesces all ready replies into one send()
+//
+// Both ends run on a POSIX socketpair; on Windows the benchmark only prints
+// a notice.
+//
+// usage: bench_frame [rounds] [pipeline] [frame_len]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "frame_buffer.hpp"
+#include "thread_safe_queue.hpp"
+
+#ifndef _WIN32
+
+namespace
+{
+
+bool send_all(int fd, const char *p, std::size_t n)
+{
+    while (n > 0) {
+        const ssize_t r = ::send(fd, p, n, 0);
+        if (r <= 0)
+            return false;
+        p += r;
+        n -= static_cast<std::size_t>(r);
+    }
+    return true;
+}
+
+bool recv_all(int fd, char *p, std::size_t n)
+{
+    while (n > 0) {
+        const ssize_t r = ::recv(fd, p, n, 0);
+        if (r <= 0)
+            return false;
+        p += r;
+        n -= static_cast<std::size_t>(r);
+    }
+    return true;
+}
+
+void recv_loop(int fd,
+               bool batched,
+               std::size_t frame_len,
+               Queue<std::string> &q)
+{
+    if (batched) {
+        FrameBuffer frames(frame_len, 128);
+        std::vector<std::string> batch;
+        for (;;) {
+            const ssize_t n =
+                ::recv(fd, frames.write_ptr(), frames.writable(), 0);
+            if (n <= 0)
+                return;
+            frames.commit(static_cast<std::size_t>(n));
+            if (frames.drain(batch) > 0)
+                q.push_batch(batch);
+        }
+    }
+
+    std::vector<char> buffer(frame_len);
+    for (;;) {
+        if (!recv_all(fd, buffer.data(), frame_len))
+            return;
+        q.push(std::string(buffer.data()));
+    }
+}
+
+void reply_loop(int fd,
+                bool batched,
+                std::size_t frame_len,
+                Queue<std::string> &q)
+{
+    std::string message;
+    std::string wire;
+    while (q.pop(message)) {
+        wire.clear();
+        FrameBuffer::encode(wire, message, frame_len);  // * echo handler
+        if (batched) {
+            // coalesce every reply that is already available
+            while (q.try_pop(message))
+                FrameBuffer::encode(wire, message, frame_len);
+        }
+        if (!send_all(fd, wire.data(), wire.size()))
+            return;
+    }
+}
+
+double run(bool batched, int rounds, int pipeline, std::size_t frame_len)
+{
+    int sv[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+        std::perror("socketpair");
+        std::exit(1);
+    }
+
+    Queue<std::string> q;
+    std::thread receiver([&] { recv_loop(sv[1], batched, frame_len, q); });
+    std::thread worker([&] { reply_loop(sv[1], batched, frame_len, q); });
+
+    std::string request;
+    for (int i = 0; i < pipeline; ++i) {
+        FrameBuffer::encode(request,
+                            "{\"type\":\"chat\",\"from\":\"a\",\"to\":\"b\"}",
+                            frame_len);
+    }
+    std::vector<char> replies(pipeline * frame_len);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        if (!send_all(sv[0], request.data(), request.size()) ||
+            !recv_all(sv[0], replies.data(), replies.size())) {
+            std::fprintf(stderr, "connection lost\n");
+            std::exit(1);
+        }
+    }
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    ::shutdown(sv[0], SHUT_WR);  // receiver sees EOF
+    receiver.join();
+    q.shutdown();
+    worker.join();
+    ::close(sv[0]);
+    ::close(sv[1]);
+    return static_cast<double>(rounds) * pipeline / elapsed.count();
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    const int rounds = argc > 1 ? std::atoi(argv[1]) : 2000;
+    const int pipeline = argc > 2 ? std::atoi(argv[2]) : 100;
+    const std::size_t frame_len = argc > 3 ? std::atoi(argv[3]) : 256;
+
+    std::printf("rounds=%d pipeline=%d frame_len=%zu\n", rounds, pipeline,
+                frame_len);
+    const double single = run(false, rounds, pipeline, frame_len);
+    const double batched = run(true, rounds, pipeline, frame_len);
+    std::printf("%10s %14s\n", "mode", "msgs/s");
+    std::printf("%10s %14.0f\n", "per-frame", single);
+    std::printf("%10s %14.0f  (%.2fx)\n", "batched", batched, batched / single);
+    return 0;
+}
+
+#else  // _WIN32
+
+int main()
+{
+    std::printf("bench_frame needs a POSIX socketpair\n");
+    return 0;
+}
+
+#endif  // _WIN32
@@ -0,0 +1,142 @@
+// bench suggest
+//
+// "People you may know" on a clustered random graph: users belong to
+// communities and most friendships stay inside one, so friend-of-friend
+// lists are long and mutual counts vary.
+//
+//   indexed   : SuggestionIndex, maintained on every add / remove
+//   on demand : two-hop scan of the graph per request ( what the index
+//               replaces )
+//
+// usage: bench_suggest [users] [avg_degree] [top_k]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "friend_graph.hpp"
+#include "suggestion_index.hpp"
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+
+double micros(clock_type::duration d)
+{
+    return std::chrono::duration<double, std::micro>(d).count();
+}
+
+double percentile(std::vector<double> v, double p)
+{
+    std::sort(v.begin(), v.end());
+    return v[static_cast<std::size_t>(p * (v.size() - 1))];
+}
+
+/// Top-k by brute force, as a request handler without the index would do.
+void scan(const FriendGraph &g,
+          UserId u,
+          std::size_t k,
+          std::vector<Suggestion> &out)
+{
+    std::vector<UserId> mine_buf, theirs_buf, hops;
+    const FriendSpan mine = g.friends(u, mine_buf);
+    for (UserId f : mine) {
+        for (UserId w : g.friends(f, theirs_buf)) {
+            if (w != u && !std::binary_search(mine.begin(), mine.end(), w))
+                hops.push_back(w);
+        }
+    }
+    std::sort(hops.begin(), hops.end());
+    out.clear();
+    for (std::size_t i = 0; i < hops.size();) {
+        std::size_t j = i;
+        while (j < hops.size() && hops[j] == hops[i])
+            ++j;
+        out.push_back(Suggestion{hops[i], static_cast<std::uint32_t>(j - i)});
+        i = j;
+    }
+    auto by_rank = [](const Suggestion &x, const Suggestion &y) {
+        return x.mutual != y.mutual ? x.mutual > y.mutual : x.user < y.user;
+    };
+    const std::size_t n = std::min(k, out.size());
+    std::partial_sort(out.begin(), out.begin() + n, out.end(), by_rank);
+    out.resize(n);
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    const UserId users = argc > 1 ? std::atoi(argv[1]) : 100000;
+    const std::size_t degree = argc > 2 ? std::atoi(argv[2]) : 20;
+    const std::size_t k = argc > 3 ? std::atoi(argv[3]) : 20;
+    constexpr UserId kCommunity = 500;
+
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<UserId> any(0, users - 1);
+    std::uniform_int_distribution<UserId> near(0, kCommunity - 1);
+    auto random_edge = [&](UserId &a, UserId &b) {
+        a = any(rng);
+        b = rng() % 10 == 0 ? any(rng)
+                            : std::min(users - 1, a / kCommunity * kCommunity +
+                                                      near(rng));
+    };
+
+    FriendGraph g;
+    SuggestionIndex idx(k);
+
+    // build
+    const std::size_t target = static_cast<std::size_t>(users) * degree / 2;
+    auto t0 = clock_type::now();
+    while (g.edges() < target) {
+        UserId a, b;
+        random_edge(a, b);
+        if (g.add(a, b))
+            idx.on_added(g, a, b);
+    }
+    const double build_s =
+        std::chrono::duration<double>(clock_type::now() - t0).count();
+
+    // churn: mixed adds and removes on the live index
+    constexpr int kChurn = 20000;
+    std::vector<double> update_us;
+    update_us.reserve(kChurn);
+    for (int i = 0; i < kChurn; ++i) {
+        UserId a, b;
+        random_edge(a, b);
+        t0 = clock_type::now();
+        if (i % 2 == 0 ? (g.add(a, b) && (idx.on_added(g, a, b), true))
+                       : (g.remove(a, b) && (idx.on_removed(g, a, b), true)))
+            update_us.push_back(micros(clock_type::now() - t0));
+    }
+
+    // queries
+    constexpr int kQueries = 20000;
+    std::vector<double> indexed_us, scan_us;
+    std::vector<Suggestion> out;
+    for (int i = 0; i < kQueries; ++i) {
+        const UserId u = any(rng);
+        t0 = clock_type::now();
+        idx.suggest(g, u, out);
+        indexed_us.push_back(micros(clock_type::now() - t0));
+        t0 = clock_type::now();
+        scan(g, u, k, out);
+        scan_us.push_back(micros(clock_type::now() - t0));
+    }
+
+    std::printf("users=%u edges=%zu top_k=%zu build=%.2fs\n", users,
+                g.edges(), k, build_s);
+    std::printf("%12s %10s %10s\n", "", "p50 (us)", "p99 (us)");
+    std::printf("%12s %10.2f %10.2f\n", "indexed", percentile(indexed_us, 0.5),
+                percentile(indexed_us, 0.99));
+    std::printf("%12s %10.2f %10.2f\n", "on demand", percentile(scan_us, 0.5),
+                percentile(scan_us, 0.99));
+    std::printf("%12s %10.2f %10.2f   ( per friendship change )\n", "update",
+                percentile(update_us, 0.5), percentile(update_us, 0.99));
+    std::printf("recomputes=%zu\n", idx.recomputes());
+    return 0;
+}
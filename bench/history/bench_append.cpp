@@ -0,0 +1,118 @@
+// bench append
+//
+// Append throughput of the history store: chat-sized messages spread over
+// many conversations ( so every shard is busy ), written by one or more
+// threads, then random lookups by id through the sparse index:
+//
+//   view ( cold ) : zero-copy record in the mapped segment, first touch
+//   view ( warm ) : the same record again, pages resident
+//   read          : the same, copied into strings
+//
+// usage: bench_append [messages] [payload_bytes] [threads] [dir]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "history_store.hpp"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+
+double percentile(std::vector<double> v, double p)
+{
+    std::sort(v.begin(), v.end());
+    return v[static_cast<std::size_t>(p * (v.size() - 1))];
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    const std::size_t messages = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    const std::size_t payload = argc > 2 ? std::atoi(argv[2]) : 200;
+    const unsigned threads = argc > 3 ? std::atoi(argv[3]) : 1;
+    const fs::path dir = argc > 4 ? fs::path(argv[4])
+                                  : fs::temp_directory_path() / "bench_history";
+    constexpr int kConversations = 10000;
+
+    fs::remove_all(dir);
+    std::vector<MessageId> ids(messages);
+    double append_s = 0;
+    std::uint64_t bytes = 0;
+    {
+        HistoryStore store(dir.string());
+        std::vector<std::string> conversations;
+        for (int i = 0; i < kConversations; ++i)
+            conversations.push_back("user" + std::to_string(i) + "\nuser" +
+                                    std::to_string(i * 7919 % kConversations));
+        const std::string body(payload, 'm');
+
+        const auto t0 = clock_type::now();
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t] {
+                for (std::size_t i = t; i < messages; i += threads)
+                    ids[i] = store.append(conversations[i % kConversations],
+                                          body, i);
+            });
+        }
+        for (auto &w : workers)
+            w.join();
+        store.flush();
+        append_s = std::chrono::duration<double>(clock_type::now() - t0)
+                       .count();
+        bytes = store.bytes();
+
+        // random lookups: one binary search + a short scan each
+        std::mt19937 rng(1);
+        std::vector<double> cold_us, warm_us, read_us;
+        RecordView v;
+        HistoryRecord r;
+        auto micros_since = [](clock_type::time_point t) {
+            return std::chrono::duration<double, std::micro>(
+                       clock_type::now() - t)
+                .count();
+        };
+        for (int i = 0; i < 20000; ++i) {
+            const MessageId id = ids[rng() % messages];
+            auto t1 = clock_type::now();
+            bool found = store.view(id, v);
+            cold_us.push_back(micros_since(t1));
+            t1 = clock_type::now();
+            found = found && store.view(id, v);
+            warm_us.push_back(micros_since(t1));
+            t1 = clock_type::now();
+            if (!found || !store.read(id, r))
+                return std::printf("lookup of %llu failed\n",
+                                   static_cast<unsigned long long>(id)),
+                       1;
+            read_us.push_back(micros_since(t1));
+        }
+
+        std::printf("messages=%zu payload=%zuB threads=%u\n", messages,
+                    payload, threads);
+        std::printf("append        : %.0f msgs/s  %.1f MB/s  ( %.2f s, "
+                    "%.1f MB )\n",
+                    messages / append_s, bytes / append_s / 1e6, append_s,
+                    bytes / 1e6);
+        std::printf("view ( cold ) : p50 %.2f us  p99 %.2f us\n",
+                    percentile(cold_us, 0.5), percentile(cold_us, 0.99));
+        std::printf("view ( warm ) : p50 %.2f us  p99 %.2f us\n",
+                    percentile(warm_us, 0.5), percentile(warm_us, 0.99));
+        std::printf("read          : p50 %.2f us  p99 %.2f us\n",
+                    percentile(read_us, 0.5), percentile(read_us, 0.99));
+    }
+    fs::remove_all(dir);
+    return 0;
+}
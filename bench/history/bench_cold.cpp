@@ -0,0 +1,172 @@
+// bench cold
+//
+// Tiered history: N chat messages ( JSON payloads, a few hundred
+// conversations ) in one store, read before and after every sealed
+// segment was moved to the cold tier:
+//
+//   storage : bytes of records hot vs bytes of the cold files
+//   freeze  : MB/s of records recompressed
+//   view    : random record by id, latency percentiles ( hot: mapped
+//             pages, warm; cold: one block decompressed per miss )
+//   page    : 50 newest messages of a random conversation ( hot either way )
+//   page old: 50 messages before a random message of the oldest 3/4
+//
+// usage: bench_cold [messages] [block_kb] [dir]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "history_store.hpp"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr int kConversations = 500;
+constexpr int kSamples = 20000;
+
+double percentile(std::vector<double> v, double p)
+{
+    std::sort(v.begin(), v.end());
+    return v[static_cast<std::size_t>(p * (v.size() - 1))];
+}
+
+std::string conversation(int i)
+{
+    return "user" + std::to_string(i) + "\nuser" +
+           std::to_string(i * 7919 % kConversations);
+}
+
+std::string chat(std::mt19937_64 &rng, int c, std::uint64_t seq)
+{
+    static const char *words[] = {"ok",     "see you", "tomorrow", "lunch?",
+                                  "haha",   "sure",    "on my way", "meeting",
+                                  "thanks", "call me", "sounds good"};
+    std::string text;
+    for (int w = 0, n = 2 + rng() % 10; w < n; ++w)
+        text += std::string(words[rng() % 11]) + ' ';
+    return "{\"type\":\"chat\",\"from\":\"user" + std::to_string(c) +
+           "\",\"to\":\"user" + std::to_string(c * 7919 % kConversations) +
+           "\",\"seq\":" + std::to_string(seq) + ",\"text\":\"" + text + "\"}";
+}
+
+/// Latency of @p n calls of @p fn, us.
+template <class Fn>
+std::vector<double> sample(int n, Fn fn)
+{
+    std::vector<double> us;
+    us.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        const auto start = clock_type::now();
+        fn(i);
+        us.push_back(std::chrono::duration<double, std::micro>(
+                         clock_type::now() - start)
+                         .count());
+    }
+    return us;
+}
+
+void report(const char *what, const std::vector<double> &us)
+{
+    std::printf("%-14s p50 %7.2f us  p99 %7.2f us  p99.9 %7.2f us\n", what,
+                percentile(us, 0.5), percentile(us, 0.99),
+                percentile(us, 0.999));
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    const std::size_t messages = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    const std::uint32_t block_kb = argc > 2 ? std::atoi(argv[2]) : 64;
+    const fs::path dir = argc > 3 ? fs::path(argv[3])
+                                  : fs::temp_directory_path() / "bench_cold";
+
+    HistoryOptions options;
+    options.shards = 4;
+    options.segment_bytes = 16 << 20;
+    options.cold_block = block_kb << 10;
+    fs::remove_all(dir);
+    {
+        HistoryStore store(dir.string(), options);
+        std::mt19937_64 rng(1);
+        std::vector<MessageId> ids;
+        std::vector<int> convs;
+        ids.reserve(messages);
+        for (std::size_t i = 0; i < messages; ++i) {
+            const int c = static_cast<int>(rng() % kConversations);
+            ids.push_back(store.append(conversation(c), chat(rng, c, i), i));
+            convs.push_back(c);
+        }
+        store.flush();
+
+        RecordView v;
+        HistoryPage page;
+        auto view = [&](int) { store.view(ids[rng() % ids.size()], v); };
+        auto fetch = [&](int) {
+            const int c = static_cast<int>(rng() % kConversations);
+            store.fetch(conversation(c), 0, 50, page);
+        };
+        auto fetch_old = [&](int) {
+            const std::size_t k = rng() % (ids.size() * 3 / 4);
+            store.fetch(conversation(convs[k]), ids[k], 50, page);
+        };
+        for (int i = 0; i < kSamples; ++i)
+            view(i);  // pages resident, as for the cold runs' file
+        const auto hot_view = sample(kSamples, view);
+        const auto hot_page = sample(kSamples / 10, fetch);
+        const auto hot_old = sample(kSamples / 10, fetch_old);
+
+        // everything sealed goes cold
+        const TierStats before = store.tiers();
+        auto start = clock_type::now();
+        CompactionResult r;
+        std::uint64_t frozen = 0;
+        for (std::size_t shard = 0; shard < store.shards(); ++shard)
+            while (store.freeze(shard, ~std::uint64_t{0},
+                                [](std::uint64_t) { return true; }, r))
+                frozen += r.bytes_read;
+        const double freeze_s =
+            std::chrono::duration<double>(clock_type::now() - start).count();
+        const TierStats t = store.tiers();
+
+        const auto cold_view = sample(kSamples, view);
+        const TierStats mid = store.tiers();
+        const auto cold_page = sample(kSamples / 10, fetch);
+        const TierStats old = store.tiers();
+        const auto cold_old = sample(kSamples / 10, fetch_old);
+        const TierStats after = store.tiers();
+
+        std::printf("%zu messages, %.1f MB of records, %u KB blocks\n",
+                    messages, before.hot_records / 1e6, block_kb);
+        std::printf("storage     : %zu cold segments, %.1f MB -> %.1f MB "
+                    "( %.1f%% saved ), %zu hot segments left\n",
+                    t.cold_segments, t.cold_records / 1e6, t.cold_bytes / 1e6,
+                    100.0 * (t.cold_records - t.cold_bytes) / t.cold_records,
+                    t.hot_segments);
+        std::printf("freeze      : %.1f MB/s\n", frozen / freeze_s / 1e6);
+        report("view hot", hot_view);
+        report("view cold", cold_view);
+        std::printf("             %.2f blocks decompressed per view\n",
+                    1.0 * (mid.cold_blocks_read - t.cold_blocks_read) /
+                        kSamples);
+        report("page hot", hot_page);
+        report("page cold", cold_page);
+        report("page old hot", hot_old);
+        report("page old cold", cold_old);
+        std::printf("             %.1f blocks decompressed per page\n",
+                    1.0 * (after.cold_blocks_read - old.cold_blocks_read) /
+                        (kSamples / 10));
+    }
+    fs::remove_all(dir);
+    return 0;
+}
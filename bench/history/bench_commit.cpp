@@ -0,0 +1,136 @@
+// bench commit
+//
+// Durable chat appends: every message is on disk ( fdatasync ) before its
+// sender hears back. Closed loop: each client sends its next message only
+// once the previous one is durable, as a chat client waiting for its ack.
+//
+//   per message : append + sync for every message, one at a time
+//   window = W  : HistoryWriter group commit, batches held open up to W
+//                 ( one sync per shard a batch touches )
+//
+// usage: bench_commit [clients] [seconds_per_run] [shards] [payload_bytes]
+//                     [dir]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "history_store.hpp"
+#include "history_writer.hpp"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+
+double percentile(std::vector<double> v, double p)
+{
+    std::sort(v.begin(), v.end());
+    return v[static_cast<std::size_t>(p * (v.size() - 1))];
+}
+
+std::string conversation(unsigned client)
+{
+    return "user" + std::to_string(client) + "\nuser" +
+           std::to_string(client + 1);
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    const unsigned clients = argc > 1 ? std::atoi(argv[1]) : 64;
+    const double seconds = argc > 2 ? std::atof(argv[2]) : 2.0;
+    HistoryOptions layout;
+    layout.shards = argc > 3 ? std::atoi(argv[3]) : 16;
+    const std::size_t payload = argc > 4 ? std::atoi(argv[4]) : 200;
+    const fs::path dir = argc > 5 ? fs::path(argv[5])
+                                  : fs::temp_directory_path() / "bench_commit";
+    const std::string body(payload, 'm');
+    const auto run_for = std::chrono::duration<double>(seconds);
+
+    std::printf("clients=%u shards=%zu payload=%zuB %.1f s per run\n",
+                clients, layout.shards, payload, seconds);
+
+    // baseline: one sync per message
+    {
+        fs::remove_all(dir);
+        HistoryStore store(dir.string(), layout);
+        std::size_t n = 0;
+        std::vector<double> lat_us;
+        const auto t0 = clock_type::now();
+        while (clock_type::now() - t0 < run_for) {
+            const auto t1 = clock_type::now();
+            store.append(conversation(n % clients), body, n);
+            store.sync();
+            lat_us.push_back(std::chrono::duration<double, std::micro>(
+                                 clock_type::now() - t1)
+                                 .count());
+            ++n;
+        }
+        const double s =
+            std::chrono::duration<double>(clock_type::now() - t0).count();
+        std::printf("per message     : %8.0f msgs/s  p50 %7.0f us  p99 %7.0f "
+                    "us  msgs/batch 1.0\n",
+                    n / s, percentile(lat_us, 0.5), percentile(lat_us, 0.99));
+    }
+
+    for (int window_us : {0, 100, 500, 1000, 2000, 5000}) {
+        fs::remove_all(dir);
+        HistoryStore store(dir.string(), layout);
+        CommitOptions options;
+        options.window = std::chrono::microseconds(window_us);
+        HistoryWriter writer(store, options);
+
+        std::atomic<bool> stop{false};
+        std::vector<std::vector<double>> lat_us(clients);
+        std::vector<std::thread> threads;
+        const auto t0 = clock_type::now();
+        for (unsigned c = 0; c < clients; ++c) {
+            threads.emplace_back([&, c] {
+                const std::string conv = conversation(c);
+                while (!stop.load()) {
+                    std::promise<MessageId> durable;
+                    auto acked = durable.get_future();
+                    const auto t1 = clock_type::now();
+                    writer.append(conv, body, 0, [&](MessageId id) {
+                        durable.set_value(id);
+                    });
+                    if (acked.get() == 0)
+                        std::abort();
+                    lat_us[c].push_back(
+                        std::chrono::duration<double, std::micro>(
+                            clock_type::now() - t1)
+                            .count());
+                }
+            });
+        }
+        std::this_thread::sleep_for(run_for);
+        stop.store(true);
+        for (auto &t : threads)
+            t.join();
+        const double s =
+            std::chrono::duration<double>(clock_type::now() - t0).count();
+
+        std::vector<double> all;
+        for (const auto &l : lat_us)
+            all.insert(all.end(), l.begin(), l.end());
+        std::printf("window %5d us : %8.0f msgs/s  p50 %7.0f us  p99 %7.0f "
+                    "us  msgs/batch %.1f\n",
+                    window_us, all.size() / s, percentile(all, 0.5),
+                    percentile(all, 0.99),
+                    static_cast<double>(writer.appends()) /
+                        static_cast<double>(writer.batches()));
+    }
+    fs::remove_all(dir);
+    return 0;
+}
@@ -0,0 +1,100 @@
+// bench crc
+//
+// CRC-32C throughput, GB/s, on buffers from a chat record to a segment:
+//
+//   portable : slicing-by-8 tables
+//   crc32c   : what the store runs, the SSE4.2 crc32 instruction when the
+//              CPU has it
+//
+// Then the cost in the store: opening one ( every record is checked ) and
+// a scan ( every record is checked again ), N messages.
+//
+// usage: bench_crc [total_mb] [messages] [dir]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "crc32c.hpp"
+#include "history_store.hpp"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+
+double seconds_since(clock_type::time_point start)
+{
+    return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+/// GB/s of @p fn over @p total bytes, @p size at a time.
+template <class Fn>
+double throughput(Fn fn, const std::string &data, std::size_t size,
+                  std::uint64_t total, std::uint32_t &sink)
+{
+    const std::uint64_t rounds = total / size;
+    const auto start = clock_type::now();
+    std::size_t off = 0;
+    for (std::uint64_t i = 0; i < rounds; ++i) {
+        sink ^= fn(data.data() + off, size, sink);
+        off = off + size * 2 <= data.size() ? off + size : 0;
+    }
+    return rounds * size / seconds_since(start) / 1e9;
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    const std::uint64_t total =
+        (argc > 1 ? std::atoll(argv[1]) : 4096) * std::uint64_t{1 << 20};
+    const std::size_t messages = argc > 2 ? std::atoi(argv[2]) : 1000000;
+    const fs::path dir = argc > 3 ? fs::path(argv[3])
+                                  : fs::temp_directory_path() / "bench_crc";
+
+    std::string data(8 << 20, '\0');
+    for (std::size_t i = 0; i < data.size(); ++i)
+        data[i] = static_cast<char>(i * 2654435761u >> 13);
+
+    std::uint32_t sink = 0;
+    std::printf("crc32c %s\n", crc32c_accelerated()
+                                   ? "on the SSE4.2 crc32 instruction"
+                                   : "portable ( no SSE4.2 )");
+    std::printf("%10s %14s %14s\n", "bytes", "portable GB/s", "crc32c GB/s");
+    for (std::size_t size : {64, 256, 1024, 4096, 65536, 1 << 20}) {
+        const double portable =
+            throughput(crc32c_portable, data, size, total / 4, sink);
+        const double best = throughput(crc32c, data, size, total, sink);
+        std::printf("%10zu %14.2f %14.2f\n", size, portable, best);
+    }
+
+    fs::remove_all(dir);
+    {
+        HistoryStore store(dir.string());
+        const std::string body(200, 'm');
+        for (std::size_t i = 0; i < messages; ++i)
+            store.append("user" + std::to_string(i % 10000) + "\nuser0", body,
+                         i);
+    }
+    auto start = clock_type::now();
+    HistoryStore store(dir.string());
+    const double open_s = seconds_since(start);
+    std::uint64_t seen = 0;
+    start = clock_type::now();
+    const std::uint64_t corrupt =
+        store.scan([&](const RecordView &) { ++seen; });
+    const double scan_s = seconds_since(start);
+    std::printf("store: %zu messages, %.1f MB; open %.1f ms, scan %.1f ms "
+                "( %.2f GB/s checked, %llu corrupt )\n",
+                messages, store.bytes() / 1e6, open_s * 1e3, scan_s * 1e3,
+                store.bytes() / scan_s / 1e9,
+                static_cast<unsigned long long>(corrupt));
+    fs::remove_all(dir);
+    return sink == 42 && seen == 0;  // keeps the checksums
+}
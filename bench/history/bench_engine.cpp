@@ -0,0 +1,180 @@
+// bench engine
+//
+// One chat workload against every HistoryEngine backend, MemoryHistory
+// and HistoryStore, so their numbers compare directly:
+//
+//   append   : one message per call
+//   write    : batches of 256 messages, then sync() ( group commit )
+//   view     : random message by id ( point lookup )
+//   page     : 50 newest messages of a random conversation ( range read )
+//   page old : 50 messages before a random message
+//   jump     : 50 messages at a random date ( fetch_at() )
+//
+// Each line: calls per second ( messages for append and write ), then
+// latency percentiles of one call.
+//
+// usage: bench_engine [messages] [dir]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "history_store.hpp"
+#include "memory_history.hpp"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr int kConversations = 500;
+constexpr int kSamples = 20000;
+constexpr std::size_t kBatch = 256;
+
+double percentile(std::vector<double> v, double p)
+{
+    std::sort(v.begin(), v.end());
+    return v[static_cast<std::size_t>(p * (v.size() - 1))];
+}
+
+std::string conversation(int i)
+{
+    return "user" + std::to_string(i) + "\nuser" +
+           std::to_string(i * 7919 % kConversations);
+}
+
+std::string chat(std::mt19937_64 &rng, int c, std::uint64_t seq)
+{
+    static const char *words[] = {"ok",     "see you", "tomorrow", "lunch?",
+                                  "haha",   "sure",    "on my way", "meeting",
+                                  "thanks", "call me", "sounds good"};
+    std::string text;
+    for (int w = 0, n = 2 + rng() % 10; w < n; ++w)
+        text += std::string(words[rng() % 11]) + ' ';
+    return "{\"type\":\"chat\",\"from\":\"user" + std::to_string(c) +
+           "\",\"seq\":" + std::to_string(seq) + ",\"text\":\"" + text + "\"}";
+}
+
+/// Latency of @p n calls of @p fn, us.
+template <class Fn>
+std::vector<double> sample(std::size_t n, Fn fn)
+{
+    std::vector<double> us;
+    us.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        const auto start = clock_type::now();
+        fn(i);
+        us.push_back(std::chrono::duration<double, std::micro>(
+                         clock_type::now() - start)
+                         .count());
+    }
+    return us;
+}
+
+/// @p per messages per call, 0 to count calls.
+void report(const char *engine,
+            const char *what,
+            const std::vector<double> &us,
+            std::size_t per = 0)
+{
+    double total = 0;
+    for (double u : us)
+        total += u;
+    std::printf("%-7s %-9s %10.0f %s/s  p50 %8.2f us  p99 %8.2f us  "
+                "p99.9 %8.2f us\n",
+                engine, what, us.size() * (per ? per : 1) / total * 1e6,
+                per ? "msg" : " op",
+                percentile(us, 0.5), percentile(us, 0.99),
+                percentile(us, 0.999));
+}
+
+/// The workload, on @p h, fresh.
+void run(const char *engine, HistoryEngine &h, std::size_t messages)
+{
+    std::mt19937_64 rng(1);
+    std::vector<int> convs(messages);
+    std::vector<std::string> payloads(messages);
+    for (std::size_t i = 0; i < messages; ++i) {
+        convs[i] = static_cast<int>(rng() % kConversations);
+        payloads[i] = chat(rng, convs[i], i);
+    }
+    std::vector<MessageId> ids(messages);
+
+    // the first half one by one, the rest in batches
+    const std::size_t half = messages / 2 / kBatch * kBatch;
+    const auto appended = sample(half, [&](std::size_t i) {
+        ids[i] = h.append(conversation(convs[i]), payloads[i], i * 1000);
+    });
+    h.sync();
+    std::vector<HistoryAppend> batch;
+    std::vector<MessageId> got;
+    const auto written =
+        sample((messages - half) / kBatch, [&](std::size_t b) {
+            batch.clear();
+            const std::size_t from = half + b * kBatch;
+            for (std::size_t i = from; i < from + kBatch; ++i)
+                batch.push_back(HistoryAppend{conversation(convs[i]),
+                                              payloads[i], i * 1000});
+            h.write(batch, got);
+            h.sync();
+            std::copy(got.begin(), got.end(), ids.begin() + from);
+        });
+    const std::size_t stored = half + written.size() * kBatch;
+
+    RecordView v;
+    HistoryPage page;
+    const auto viewed = sample(kSamples, [&](std::size_t) {
+        h.view(ids[rng() % stored], v);
+    });
+    const auto paged = sample(kSamples / 10, [&](std::size_t) {
+        h.fetch(conversation(static_cast<int>(rng() % kConversations)), 0,
+                50, page);
+    });
+    const auto paged_old = sample(kSamples / 10, [&](std::size_t) {
+        const std::size_t k = rng() % stored;
+        h.fetch(conversation(convs[k]), ids[k], 50, page);
+    });
+    const auto jumped = sample(kSamples / 10, [&](std::size_t) {
+        h.fetch_at(conversation(static_cast<int>(rng() % kConversations)),
+                   rng() % stored * 1000, 50, page);
+    });
+
+    report(engine, "append", appended, 1);
+    report(engine, "write", written, kBatch);
+    report(engine, "view", viewed);
+    report(engine, "page", paged);
+    report(engine, "page old", paged_old);
+    report(engine, "jump", jumped);
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    const std::size_t messages = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    const fs::path dir = argc > 2 ? fs::path(argv[2])
+                                  : fs::temp_directory_path() / "bench_engine";
+
+    std::printf("%zu messages, %d conversations, batches of %zu\n", messages,
+                kConversations, kBatch);
+    {
+        MemoryHistory memory;
+        run("memory", memory, messages);
+    }
+    fs::remove_all(dir);
+    {
+        HistoryOptions options;
+        options.shards = 4;
+        HistoryStore disk(dir.string(), options);
+        run("disk", disk, messages);
+    }
+    fs::remove_all(dir);
+    return 0;
+}
@@ -0,0 +1,126 @@
+// bench time
+//
+// Jump to a date: N chat messages ( a few hundred conversations, a clock
+// stepping 1 s a message with senders up to a minute off ) in one store,
+// then the page of a random conversation at a random date:
+//
+//   jump : fetch_at(), through the time index
+//   walk : fetch() back from the newest page until a message is that old,
+//          what a client has to do without it
+//
+// usage: bench_time [messages] [dir]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "history_store.hpp"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr int kConversations = 500;
+constexpr int kSamples = 2000;
+
+double percentile(std::vector<double> v, double p)
+{
+    std::sort(v.begin(), v.end());
+    return v[static_cast<std::size_t>(p * (v.size() - 1))];
+}
+
+std::string conversation(int i)
+{
+    return "user" + std::to_string(i) + "\nuser" +
+           std::to_string(i * 7919 % kConversations);
+}
+
+/// Latency of @p n calls of @p fn, us.
+template <class Fn>
+std::vector<double> sample(int n, Fn fn)
+{
+    std::vector<double> us;
+    us.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        const auto start = clock_type::now();
+        fn(i);
+        us.push_back(std::chrono::duration<double, std::micro>(
+                         clock_type::now() - start)
+                         .count());
+    }
+    return us;
+}
+
+void report(const char *what, const std::vector<double> &us)
+{
+    std::printf("%-6s p50 %9.2f us  p99 %9.2f us  p99.9 %9.2f us\n", what,
+                percentile(us, 0.5), percentile(us, 0.99),
+                percentile(us, 0.999));
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    const std::size_t messages = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    const fs::path dir = argc > 2 ? fs::path(argv[2])
+                                  : fs::temp_directory_path() / "bench_time";
+
+    HistoryOptions options;
+    options.shards = 4;
+    options.segment_bytes = 16 << 20;
+    fs::remove_all(dir);
+    {
+        HistoryStore store(dir.string(), options);
+        std::mt19937_64 rng(1);
+        const std::string text(60, 'x');
+        for (std::size_t i = 0; i < messages; ++i) {
+            const int c = static_cast<int>(rng() % kConversations);
+            const std::uint64_t ts = 60000 + i * 1000 - rng() % 60000;
+            store.append(conversation(c), text, ts);
+        }
+        store.flush();
+
+        std::vector<int> convs(kSamples);
+        std::vector<std::uint64_t> dates(kSamples);
+        for (int i = 0; i < kSamples; ++i) {
+            convs[i] = static_cast<int>(rng() % kConversations);
+            dates[i] = 60000 + rng() % messages * 1000;
+        }
+        HistoryPage page;
+        std::size_t pages = 0;
+        auto jump = [&](int i) {
+            store.fetch_at(conversation(convs[i]), dates[i], 50, page);
+        };
+        auto walk = [&](int i) {
+            MessageId cursor = 0;
+            do {
+                store.fetch(conversation(convs[i]), cursor, 50, page);
+                ++pages;
+                cursor = page.next;
+            } while (cursor != 0 && page.records.back().timestamp > dates[i]);
+        };
+        for (int i = 0; i < kSamples; ++i)
+            walk(i);  // pages resident for both
+        pages = 0;
+        const auto walked = sample(kSamples, walk);
+        const auto jumped = sample(kSamples, jump);
+
+        std::printf("%zu messages, %d conversations\n", messages,
+                    kConversations);
+        report("jump", jumped);
+        report("walk", walked);
+        std::printf("       %.1f pages read per walk\n",
+                    1.0 * pages / kSamples);
+    }
+    fs::remove_all(dir);
+    return 0;
+}
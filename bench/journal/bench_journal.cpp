@@ -0,0 +1,141 @@
+// bench journal
+//
+// Startup with a friend graph of U users and U * D / 2 friendships:
+//
+//   replay   : every add_friend ever made is in the log, replayed one by one
+//   snapshot : the newest snapshot is loaded, then a log tail of T changes
+//
+// Also reports the snapshot itself: how long changes are held off while
+// the graph is copied, and how long the background write takes.
+//
+// usage: bench_journal [users] [degree] [tail] [dir]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <string_view>
+
+#include "friend_graph.hpp"
+#include "state_journal.hpp"
+#include "user_ids.hpp"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+
+double ms_since(clock_type::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(clock_type::now() -
+                                                     start)
+        .count();
+}
+
+/// The state being journaled: names and friendships.
+struct Graph {
+    UserIds ids;
+    FriendGraph graph;
+
+    void apply(std::string_view record)
+    {
+        const auto nl = record.find('\n');
+        graph.add(ids.intern(std::string(record.substr(0, nl))),
+                  ids.intern(std::string(record.substr(nl + 1))));
+    }
+
+    bool load(std::string_view image)
+    {
+        return ids.load(image) && graph.load(image) && image.empty();
+    }
+};
+
+std::string record(std::mt19937_64 &rng, std::uint64_t users)
+{
+    return "user" + std::to_string(rng() % users) + "\nuser" +
+           std::to_string(rng() % users);
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    const std::uint64_t users = argc > 1 ? std::atoll(argv[1]) : 1000000;
+    const std::uint64_t degree = argc > 2 ? std::atoll(argv[2]) : 10;
+    const std::uint64_t tail = argc > 3 ? std::atoll(argv[3]) : 10000;
+    const fs::path dir = argc > 4 ? fs::path(argv[4])
+                                  : fs::temp_directory_path() / "bench_journal";
+    const std::uint64_t edges = users * degree / 2;
+    JournalOptions options;
+    options.snapshot_bytes = ~std::uint64_t{0};  // taken by hand below
+
+    std::printf("users %llu, friendships %llu, tail %llu\n",
+                static_cast<unsigned long long>(users),
+                static_cast<unsigned long long>(edges),
+                static_cast<unsigned long long>(tail));
+
+    // the whole history in the log
+    fs::remove_all(dir);
+    std::mt19937_64 rng(1);
+    {
+        StateJournal journal(dir.string(), options);
+        journal.recover([&](std::string_view) { return false; },
+                        [&](std::string_view) {});
+        for (std::uint64_t i = 0; i < edges; ++i)
+            journal.append(record(rng, users));
+        journal.sync();
+    }
+    {
+        auto start = clock_type::now();
+        StateJournal journal(dir.string(), options);
+        Graph state;
+        const JournalRecovery r = journal.recover(
+            [&](std::string_view image) { return state.load(image); },
+            [&](std::string_view rec) { state.apply(rec); });
+        const double took = ms_since(start);
+        std::printf("replay   : %9.1f ms  ( %llu records, %.1f MB of log )\n",
+                    took, static_cast<unsigned long long>(r.replayed),
+                    r.replayed_bytes / 1e6);
+
+        // snapshot it, then let a tail of changes pile up
+        start = clock_type::now();
+        journal.snapshot([&] {
+            std::string names;
+            state.ids.save(names);
+            return StateJournal::Encoder(
+                [names = std::move(names),
+                 graph = state.graph](std::string &image) {
+                    image += names;
+                    graph.save(image);
+                });
+        });
+        const double held = ms_since(start);
+        journal.wait();
+        std::printf("snapshot : %9.1f ms held off, %.1f ms in total "
+                    "( %llu failed )\n",
+                    held, ms_since(start),
+                    static_cast<unsigned long long>(journal.stats().failures));
+        for (std::uint64_t i = 0; i < tail; ++i)
+            journal.append(record(rng, users));
+        journal.sync();
+    }
+    {
+        const auto start = clock_type::now();
+        StateJournal journal(dir.string(), options);
+        Graph state;
+        const JournalRecovery r = journal.recover(
+            [&](std::string_view image) { return state.load(image); },
+            [&](std::string_view rec) { state.apply(rec); });
+        std::printf("snapshot + tail : %9.1f ms  ( %.1f MB image, %llu "
+                    "records replayed, %zu friendships )\n",
+                    ms_since(start), r.snapshot_bytes / 1e6,
+                    static_cast<unsigned long long>(r.replayed),
+                    state.graph.edges());
+    }
+    fs::remove_all(dir);
+    return 0;
+}
@@ -0,0 +1,116 @@
+// bench fanout
+//
+// Who gets a message posted to a big room: members that are online. Ids
+// come from a 1M-user population; the room's members are random, a share
+// of them is online, and so are many users outside the room.
+//
+//   hash probe   : walk the member list, look each one up in a hash set of
+//                  online users ( what a naive server does )
+//   bitmap probe : walk the member list, test each one in the online set
+//                  ( a RoaringSet of bitmaps, one bit per user )
+//   intersect    : RoomRegistry::online_members(), chunk-wise intersection
+//                  of the room and the online set
+//
+// usage: bench_fanout [members] [online_pct] [others_online]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+#include "roaring_set.hpp"
+#include "room_registry.hpp"
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+
+double micros(clock_type::duration d)
+{
+    return std::chrono::duration<double, std::micro>(d).count();
+}
+
+double percentile(std::vector<double> v, double p)
+{
+    std::sort(v.begin(), v.end());
+    return v[static_cast<std::size_t>(p * (v.size() - 1))];
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    const std::size_t members = argc > 1 ? std::atoi(argv[1]) : 10000;
+    const double online_pct = argc > 2 ? std::atof(argv[2]) : 5.0;
+    const std::size_t others = argc > 3 ? std::atoi(argv[3]) : 50000;
+    constexpr UserId kPopulation = 1000000;
+    constexpr int kRounds = 2000;
+
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<UserId> any(0, kPopulation - 1);
+
+    RoomRegistry rooms;
+    std::vector<UserId> member_list;
+    while (member_list.size() < members) {
+        const UserId u = any(rng);
+        if (rooms.join("big", u))
+            member_list.push_back(u);
+    }
+    std::sort(member_list.begin(), member_list.end());
+
+    RoaringSet online(0);  // as the server keeps it: bitmaps only
+    std::unordered_set<UserId> online_hash;
+    const auto online_members =
+        static_cast<std::size_t>(members * online_pct / 100.0);
+    for (std::size_t i = 0; i < online_members; ++i)
+        online.add(member_list[rng() % members]);
+    while (online.size() < online_members + others)
+        online.add(any(rng));
+    online.for_each([&](UserId u) { online_hash.insert(u); });
+
+    std::vector<double> hash_us, probe_us, inter_us;
+    std::vector<UserId> out;
+    std::size_t sent = 0;
+    for (int i = 0; i < kRounds; ++i) {
+        auto t0 = clock_type::now();
+        out.clear();
+        for (UserId u : member_list)
+            if (online_hash.count(u))
+                out.push_back(u);
+        hash_us.push_back(micros(clock_type::now() - t0));
+        sent = out.size();
+
+        t0 = clock_type::now();
+        out.clear();
+        for (UserId u : member_list)
+            if (online.contains(u))
+                out.push_back(u);
+        probe_us.push_back(micros(clock_type::now() - t0));
+
+        t0 = clock_type::now();
+        rooms.online_members("big", online, out);
+        inter_us.push_back(micros(clock_type::now() - t0));
+        if (out.size() != sent)
+            return std::printf("mismatch: %zu != %zu\n", out.size(), sent), 1;
+    }
+
+    std::printf("members=%zu online=%zu recipients=%zu\n", members,
+                online.size(), sent);
+    std::printf("%14s %10s %10s\n", "", "p50 (us)", "p99 (us)");
+    std::printf("%14s %10.2f %10.2f\n", "hash probe",
+                percentile(hash_us, 0.5), percentile(hash_us, 0.99));
+    std::printf("%14s %10.2f %10.2f\n", "bitmap probe",
+                percentile(probe_us, 0.5), percentile(probe_us, 0.99));
+    std::printf("%14s %10.2f %10.2f\n", "intersect",
+                percentile(inter_us, 0.5), percentile(inter_us, 0.99));
+    std::printf("speedup vs hash probe: %.1fx ( p50 )\n",
+                percentile(hash_us, 0.5) / percentile(inter_us, 0.5));
+    std::printf("memory: member list %zu KB, online set %zu KB\n",
+                member_list.capacity() * sizeof(UserId) / 1024,
+                online.memory() / 1024);
+    return 0;
+}
@@ -0,0 +1,202 @@
+// bench search
+//
+// Full-text search over a chat corpus: English-like words and Chinese
+// text, Zipf-distributed like real vocabularies, spread over many direct
+// conversations. Measures indexing, the size of the compressed posting
+// lists, and query latency:
+//
+//   word         : one common word, in one conversation
+//   two words    : a rarer word AND a common one, in one conversation
+//   cjk          : 2 to 4 characters cut from one of its messages
+//   user-wide    : a word, in every conversation of one user
+//   grep         : the same word by scanning every message ( baseline )
+//
+// usage: bench_search [messages] [conversations] [cjk_percent]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "search_index.hpp"
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+
+double percentile(std::vector<double> v, double p)
+{
+    std::sort(v.begin(), v.end());
+    return v[static_cast<std::size_t>(p * (v.size() - 1))];
+}
+
+double micros_since(clock_type::time_point t)
+{
+    return std::chrono::duration<double, std::micro>(clock_type::now() - t)
+        .count();
+}
+
+/// Rank r drawn with weight 1 / (r + 1).
+class Zipf
+{
+public:
+    explicit Zipf(std::size_t n)
+    {
+        double sum = 0;
+        for (std::size_t r = 0; r < n; ++r)
+            cdf_.push_back(sum += 1.0 / (r + 1));
+        for (auto &c : cdf_)
+            c /= sum;
+    }
+    std::size_t operator()(std::mt19937 &rng) const
+    {
+        const double u = std::uniform_real_distribution<double>()(rng);
+        return std::lower_bound(cdf_.begin(), cdf_.end(), u) - cdf_.begin();
+    }
+
+private:
+    std::vector<double> cdf_;
+};
+
+std::string utf8(std::uint32_t cp)  // BMP only
+{
+    std::string s;
+    s.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+    s.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+    s.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    return s;
+}
+
+void report(const char *name, const std::vector<double> &us)
+{
+    std::printf("%-12s : p50 %8.2f us  p99 %8.2f us\n", name,
+                percentile(us, 0.5), percentile(us, 0.99));
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    const std::size_t messages = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    const std::size_t n_conv = argc > 2 ? std::atoi(argv[2]) : 20000;
+    const int cjk_percent = argc > 3 ? std::atoi(argv[3]) : 50;
+    const std::size_t n_users = std::max<std::size_t>(n_conv / 10, 2);
+
+    std::mt19937 rng(42);
+    const char *syllables[] = {"ka", "lo", "mi", "ne", "su", "ta", "ri",
+                               "po", "an", "el", "or", "th", "sh", "ve"};
+    std::vector<std::string> words(20000);
+    for (std::size_t i = 0; i < words.size(); ++i)
+        for (std::size_t n = i + 1; n > 0; n /= 14)
+            words[i] += syllables[n % 14];
+    std::vector<std::string> hanzi(4000);
+    for (std::size_t i = 0; i < hanzi.size(); ++i)
+        hanzi[i] = utf8(0x4E00 + static_cast<std::uint32_t>(i * 5));
+    const Zipf word_rank(words.size()), hanzi_rank(hanzi.size());
+
+    // ~10 conversations per user
+    std::vector<std::string> conversations;
+    for (std::size_t i = 0; i < n_conv; ++i) {
+        std::string a = "user" + std::to_string(rng() % n_users);
+        std::string b = "user" + std::to_string(rng() % n_users);
+        if (a == b)
+            b += "x";
+        conversations.push_back(a < b ? a + '\n' + b : b + '\n' + a);
+    }
+
+    std::vector<std::string> texts(messages);
+    std::vector<std::size_t> conv_of(messages);
+    std::size_t text_bytes = 0;
+    for (std::size_t i = 0; i < messages; ++i) {
+        std::string &t = texts[i];
+        const int len = 4 + static_cast<int>(rng() % 12);
+        if (static_cast<int>(rng() % 100) < cjk_percent) {
+            for (int k = 0; k < len; ++k)
+                t += hanzi[hanzi_rank(rng)];
+            t += "，";
+            for (int k = 0; k < len / 2; ++k)
+                t += hanzi[hanzi_rank(rng)];
+        } else {
+            for (int k = 0; k < len; ++k)
+                t += (k ? " " : "") + words[word_rank(rng)];
+        }
+        conv_of[i] = rng() % n_conv;
+        text_bytes += t.size();
+    }
+
+    SearchIndex index;
+    auto t0 = clock_type::now();
+    for (std::size_t i = 0; i < messages; ++i)
+        index.add(conversations[conv_of[i]], i + 1, texts[i]);
+    const double index_s =
+        std::chrono::duration<double>(clock_type::now() - t0).count();
+
+    std::printf("messages=%zu conversations=%zu cjk=%d%%\n", messages, n_conv,
+                cjk_percent);
+    std::printf("index        : %.0f msgs/s  ( %.2f s )\n", messages / index_s,
+                index_s);
+    std::printf("postings     : %llu in %zu terms, %.1f MB ( %.2f B each; "
+                "text %.1f MB )\n",
+                static_cast<unsigned long long>(index.postings()),
+                index.terms(), index.bytes() / 1e6,
+                1.0 * index.bytes() / index.postings(), text_bytes / 1e6);
+
+    std::vector<SearchHit> hits;
+    std::vector<double> word_us, two_us, cjk_us, user_us, grep_us;
+    std::size_t found = 0;
+    for (int q = 0; q < 2000; ++q) {
+        const std::size_t m = rng() % messages;
+        const std::string &conv = conversations[conv_of[m]];
+
+        auto t1 = clock_type::now();
+        index.search(conv, words[rng() % 20], 0, 20, hits);
+        word_us.push_back(micros_since(t1));
+        found += hits.size();
+
+        const std::string two =
+            words[20 + rng() % 500] + " " + words[rng() % 20];
+        t1 = clock_type::now();
+        index.search(conv, two, 0, 20, hits);
+        two_us.push_back(micros_since(t1));
+
+        // a piece of a Chinese message of that conversation
+        const std::string &text = texts[m];
+        if (text.size() >= 12 && static_cast<unsigned char>(text[0]) >= 0xE0) {
+            const std::size_t chars = 2 + rng() % 3;
+            const std::size_t at = 3 * (rng() % (text.size() / 3 - chars));
+            t1 = clock_type::now();
+            index.search(conv, text.substr(at, 3 * chars), 0, 20, hits);
+            cjk_us.push_back(micros_since(t1));
+            if (hits.empty())
+                return std::printf("missed a substring of message %zu\n", m),
+                       1;
+        }
+
+        const auto user = conv.substr(0, conv.find('\n'));
+        const auto scope = index.conversations_of(user);
+        t1 = clock_type::now();
+        index.search(scope, words[rng() % 50], 0, 20, hits);
+        user_us.push_back(micros_since(t1));
+    }
+    for (int q = 0; q < 10; ++q) {
+        const std::string &word = words[rng() % 50];
+        const auto t1 = clock_type::now();
+        std::size_t n = 0;
+        for (const auto &t : texts)
+            n += t.find(word) != std::string::npos;
+        grep_us.push_back(micros_since(t1));
+        found += n > 0;
+    }
+
+    report("word", word_us);
+    report("two words", two_us);
+    report("cjk", cjk_us);
+    report("user-wide", user_us);
+    report("grep", grep_us);
+    std::printf("( %zu hits )\n", found);
+    return 0;
+}
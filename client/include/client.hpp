@@ -17,6 +17,7 @@
 #include <vector>
 
 #include <atomic>
+#include <mutex>
 #include <thread>
 
 #include <functional>
@@ -77,6 +78,25 @@ public:
      */
     void stop();
 
+    /**
+     * @brief Drop the current link and connect again.
+     *
+     * If a session token was received at login, it is sent as the first
+     * frame ( { "type": "resume", "token": ... } ) so the server re-attaches
+     * the previous session without a new login: the answer is a "resume"
+     * reply with "ok" and "subscriptions" ( conversation -> last seq acked
+     * in it ). If it says ok=false the token is dropped and the caller has
+     * to log in again.
+     *
+     * @return false if the server cannot be reached.
+     */
+    bool reconnect();
+
+    /**
+     * @brief Resume token from the last successful login ( empty if none ).
+     */
+    std::string session_token() const;
+
     // -- send and get message -- //
 
     /**
@@ -142,6 +162,10 @@ private:
     WSADATA wsaData_;
     SOCKET ConnectSocket_{INVALID_SOCKET};
 
+    // resume token, written by the receive thread
+    mutable std::mutex token_mtx_;
+    std::string session_token_;
+
     // callback function
     std::vector<std::function<void()>> after_send_callbacks_;
     std::vector<std::function<void(const std::string &)>>
@@ -159,6 +183,17 @@ private:
      */
     bool _init();
 
+    /**
+     * @brief Resolve the server address and connect ConnectSocket_.
+     * @return true on success.
+     */
+    bool _connect();
+
+    /**
+     * @brief Keep the token of a login reply, drop it on a failed resume.
+     */
+    void _track_session(const std::string &message);
+
     /**
      * @brief Background thread function: receives data and pushes into queue.
      */
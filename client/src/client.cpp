@@ -7,6 +7,10 @@
 #include <iostream>
 #include <sstream>
 
+#include <nlohmann/json.hpp>
+
+#include "frame_buffer.hpp"
+
 // Implementation of CilentSocket methods
 
 CilentSocket::CilentSocket(const std::string &server_ip,
@@ -94,22 +98,79 @@ void CilentSocket::stop()
     WSACleanup();
 }
 
+bool CilentSocket::reconnect()
+{
+    // stop the old receive thread, keep the queue open
+    stop_.store(true);
+    if (ConnectSocket_ != INVALID_SOCKET) {
+        closesocket(ConnectSocket_);
+        ConnectSocket_ = INVALID_SOCKET;
+    }
+    if (recv_thread_.joinable())
+        recv_thread_.join();
+    stop_.store(false);
+
+    if (!_connect())
+        return false;
+
+    const std::string token = session_token();
+    if (!token.empty()) {
+        nlohmann::json resume;
+        resume["type"] = "resume";
+        resume["token"] = token;
+        send_message(resume.dump());
+    }
+    run();
+    return true;
+}
+
+std::string CilentSocket::session_token() const
+{
+    std::lock_guard<std::mutex> lk(token_mtx_);
+    return session_token_;
+}
+
+void CilentSocket::_track_session(const std::string &message)
+{
+    // most frames are chat: skip the parse unless it can be a session reply
+    if (message.find("\"ok\"") == std::string::npos)
+        return;
+    auto reply = nlohmann::json::parse(message, nullptr, false);
+    if (reply.is_discarded() || !reply.contains("type") ||
+        !reply["type"].is_string())
+        return;
+    const auto &type = reply["type"].get_ref<const std::string &>();
+    auto token = reply.find("token");
+    std::lock_guard<std::mutex> lk(token_mtx_);
+    if (type == "login" && token != reply.end() && token->is_string())
+        session_token_ = token->get<std::string>();
+    else if (type == "resume" && !reply.value("ok", false))
+        session_token_.clear();  // expired or unknown: log in again
+}
+
 void CilentSocket::_recv_func_async()
 {
     try {
+        FrameBuffer frames(message_buffer_len_);
+        std::vector<std::string> batch;
         while (!stop_.load()) {
-            // vector auto-manages char buffer
-            std::vector<char> buffer(message_buffer_len_);
-            int iResult =
-                recv(ConnectSocket_, buffer.data(), message_buffer_len_, 0);
+            int iResult = recv(ConnectSocket_, frames.write_ptr(),
+                               static_cast<int>(frames.writable()), 0);
 
             if (iResult > 0) {
-                // push received data into queue
-                q_.push(std::string(buffer.data(), iResult));
-                std::string message = buffer.data();
-                for (size_t i = 0; i < after_receive_callbacks_.size(); ++i) {
-                    after_receive_callbacks_[i](message);
+                // one recv may carry several frames ( or part of one )
+                frames.commit(iResult);
+                if (frames.drain(batch) == 0)
+                    continue;
+                for (const auto &message : batch) {
+                    _track_session(message);
+                    for (size_t i = 0; i < after_receive_callbacks_.size();
+                         ++i) {
+                        after_receive_callbacks_[i](message);
+                    }
                 }
+                // push received data into queue: one lock, one wake-up
+                q_.push_batch(batch);
             } else if (iResult == 0) {
                 // connection closed gracefully
                 q_.push("[Info] Connection closed by server");
@@ -145,6 +206,16 @@ bool CilentSocket::_init()
         return false;
     }
 
+    if (!_connect()) {
+        WSACleanup();
+        return false;
+    }
+    return true;
+}
+
+bool CilentSocket::_connect()
+{
+    int iResult;
     // setup address hints
     struct addrinfo hints{};
     hints.ai_family = AF_UNSPEC;      // IPv4 or IPv6
@@ -157,7 +228,6 @@ bool CilentSocket::_init()
         getaddrinfo(server_ip_.c_str(), server_port_.c_str(), &hints, &result);
     if (iResult != 0) {
         std::cerr << "getaddrinfo failed with error: " << iResult << std::endl;
-        WSACleanup();
         return false;
     }
 
@@ -168,7 +238,6 @@ bool CilentSocket::_init()
         std::cerr << "socket creation failed: " << WSAGetLastError()
                   << std::endl;
         freeaddrinfo(result);
-        WSACleanup();
         return false;
     }
 
@@ -179,8 +248,8 @@ bool CilentSocket::_init()
         std::cerr << "connect failed with error: " << WSAGetLastError()
                   << std::endl;
         closesocket(ConnectSocket_);
+        ConnectSocket_ = INVALID_SOCKET;
         freeaddrinfo(result);
-        WSACleanup();
         return false;
     }
 
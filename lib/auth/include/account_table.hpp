@@ -0,0 +1,105 @@
+// account_table.hpp : memory-mapped open-addressing table of accounts
+#pragma once
+
+#include <atomic>       // current table
+#include <cstddef>      // std::size_t
+#include <cstdint>      // hashes, offsets
+#include <memory>       // tables
+#include <mutex>        // writer lock
+#include <string>       // directory
+#include <string_view>  // names, values
+#include <vector>       // retired tables
+
+/**
+ * @brief Persistent username -> value table, used in place from a
+ * memory-mapped file.
+ *
+ * The file is the table: opening it maps it, with nothing to parse or
+ * rebuild, so a lookup right after start costs the same as ever ( plus
+ * the page faults ).
+ *
+ * File layout ( <dir>/<generation>.tbl, native little-endian ):
+ *
+ *     header  u64 magic | u64 capacity | u64 count | u64 heap bytes
+ *             | u64 heap used, padded to 64 bytes
+ *     slots   capacity x ( u64 hash | u64 heap offset ), 0 = empty
+ *     heap    records u32 name length | u32 value length | name | value,
+ *             8-byte aligned, append-only
+ *
+ * Slots are probed linearly from the name's hash. A slot is published by
+ * storing its offset last ( release ), and a record is never changed once
+ * in the heap: put() on a known name appends a new record and swaps the
+ * slot's offset. Readers therefore take no lock and never see a half
+ * written entry.
+ *
+ * When the table passes 3/4 full, or its heap is full, the writer copies
+ * the live entries into a file of the next generation, twice the size,
+ * and switches readers over with one pointer store. Older mappings stay
+ * mapped until the table is closed ( readers may still be in them ), so a
+ * view returned by find() lives as long as the table.
+ *
+ * A put() is in the OS page cache as soon as it returns, so it survives
+ * the process crashing; sync() makes it survive a power cut.
+ *
+ * NOTE: Thread-safe. find() is lock-free and never blocks; put() calls are
+ * serialized ( one writer at a time ).
+ */
+class AccountTable
+{
+public:
+    /**
+     * @param dir Directory of the table files ( created if missing ).
+     * @param capacity Slots of a new table ( rounded up to a power of two ).
+     * @throws std::runtime_error if the table cannot be created or mapped.
+     */
+    explicit AccountTable(std::string dir, std::size_t capacity = 1024);
+
+    ~AccountTable();
+
+    // -- copy and move trait -- //
+
+    AccountTable(const AccountTable &) = delete;
+    AccountTable &operator=(const AccountTable &) = delete;
+    AccountTable(AccountTable &&) = delete;
+    AccountTable &operator=(AccountTable &&) = delete;
+
+    /**
+     * @brief Value stored for @p name, in place ( valid until the table is
+     * destroyed ).
+     * @return false if @p name is unknown.
+     */
+    bool find(std::string_view name, std::string_view &value) const;
+
+    /**
+     * @brief Store @p value for @p name, replacing any previous one.
+     * @throws std::runtime_error if the table cannot grow.
+     */
+    void put(std::string_view name, std::string_view value);
+
+    /// @brief Number of names stored.
+    std::size_t size() const;
+
+    /// @brief Slots of the current table file.
+    std::size_t capacity() const;
+
+    /**
+     * @brief Put every put() so far on stable storage.
+     * @throws std::runtime_error if the OS reports a failure.
+     */
+    void sync();
+
+private:
+    struct Table;
+
+    Table *_create(std::uint32_t generation,
+                   std::uint64_t capacity,
+                   std::uint64_t heap_bytes);
+    void _grow(std::uint64_t need);
+    static bool _insert(Table &t, std::uint64_t hash, std::string_view name,
+                        std::string_view value);
+
+    std::string dir_;
+    std::atomic<Table *> current_{nullptr};  ///< Where readers look
+    std::vector<std::unique_ptr<Table>> tables_;  ///< Current one last
+    std::mutex write_mtx_;                   ///< One writer at a time
+};
@@ -0,0 +1,72 @@
+// credential_cache.hpp : short-lived cache of recently verified logins
+#pragma once
+
+#include <chrono>         // TTL
+#include <cstddef>        // std::size_t
+#include <mutex>          // table lock
+#include <string>         // user names
+#include <unordered_map>  // user -> entry
+
+#include "crypto.hpp"  // Digest, HmacSha256
+
+/**
+ * @brief Remembers that a (user, password) pair passed the slow KDF check,
+ * so a client that reconnects within the TTL skips the KDF.
+ *
+ * Passwords are never stored: an entry keeps HMAC(process secret, password),
+ * which is cheap to recompute on lookup and useless outside this process.
+ * The table is capped; when it is full, expired entries are swept and new
+ * entries are dropped if that does not free a slot.
+ *
+ * NOTE: Thread-safe ( one mutex, O(1) per call ).
+ */
+class CredentialCache
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @param ttl How long a verified credential stays valid.
+     * @param capacity Maximum number of cached users.
+     */
+    explicit CredentialCache(clock::duration ttl = std::chrono::seconds(30),
+                             std::size_t capacity = 10000);
+
+    // -- copy and move trait -- //
+
+    CredentialCache(const CredentialCache &) = delete;
+    CredentialCache &operator=(const CredentialCache &) = delete;
+    CredentialCache(CredentialCache &&) = delete;
+    CredentialCache &operator=(CredentialCache &&) = delete;
+
+    /**
+     * @brief Whether @p password was verified for @p user within the TTL.
+     */
+    bool check(const std::string &user, const std::string &password);
+
+    /**
+     * @brief Record a successful slow verification.
+     */
+    void put(const std::string &user, const std::string &password);
+
+    /**
+     * @brief Forget @p user ( password change, logout everywhere ).
+     */
+    void invalidate(const std::string &user);
+
+    /// @brief Number of cached users ( including expired, not yet swept ).
+    std::size_t size() const;
+
+private:
+    struct Entry {
+        Digest tag;                 ///< HMAC(secret, password)
+        clock::time_point expires;  ///< End of validity
+    };
+
+    clock::duration ttl_;   ///< Validity of one entry
+    std::size_t capacity_;  ///< Entry cap
+    HmacSha256 keyed_;      ///< Keyed with a random per-process secret
+
+    mutable std::mutex mtx_;                        ///< Protects table_
+    std::unordered_map<std::string, Entry> table_;  ///< user -> entry
+};
@@ -0,0 +1,115 @@
+// crypto.hpp : hashing primitives used for credentials and tokens
+#pragma once
+
+#include <array>    // Digest
+#include <cstddef>  // std::size_t
+#include <cstdint>  // fixed-width integers
+#include <string>   // passwords, salts
+
+/// SHA-256 output.
+using Digest = std::array<std::uint8_t, 32>;
+
+/**
+ * @brief Incremental SHA-256 ( FIPS 180-4 ).
+ *
+ * NOTE: finish() may be called once; create a new object for the next hash.
+ */
+class Sha256
+{
+public:
+    Sha256();
+
+    /// @brief Feed @p len bytes.
+    void update(const void *data, std::size_t len);
+
+    /// @brief Pad, process the last block and return the digest.
+    Digest finish();
+
+private:
+    void _compress(const std::uint8_t *block);
+
+    std::uint32_t state_[8];      ///< Working hash value
+    std::uint8_t buf_[64];        ///< Partial block
+    std::size_t buf_len_{0};      ///< Bytes in buf_
+    std::uint64_t total_len_{0};  ///< Bytes hashed so far
+};
+
+/**
+ * @brief HMAC-SHA256 with the key schedule done once.
+ *
+ * The inner and outer hash states after absorbing the padded key are kept,
+ * so every mac() costs two compressions less than a naive HMAC. PBKDF2 calls
+ * mac() once per iteration, which makes this the hot loop of a login.
+ */
+class HmacSha256
+{
+public:
+    HmacSha256(const void *key, std::size_t key_len);
+    explicit HmacSha256(const std::string &key)
+        : HmacSha256(key.data(), key.size())
+    {
+    }
+
+    /// @brief MAC of @p len bytes.
+    Digest mac(const void *data, std::size_t len) const;
+    Digest mac(const std::string &data) const
+    {
+        return mac(data.data(), data.size());
+    }
+
+private:
+    Sha256 inner_;  ///< State after ( key ^ ipad )
+    Sha256 outer_;  ///< State after ( key ^ opad )
+};
+
+/// @brief One-shot SHA-256.
+Digest sha256(const void *data, std::size_t len);
+inline Digest sha256(const std::string &data)
+{
+    return sha256(data.data(), data.size());
+}
+
+/**
+ * @brief PBKDF2-HMAC-SHA256 ( RFC 8018 ).
+ *
+ * @param out Receives @p out_len bytes of derived key.
+ */
+void pbkdf2_sha256(const std::string &password,
+                   const std::string &salt,
+                   std::uint32_t iterations,
+                   std::uint8_t *out,
+                   std::size_t out_len);
+
+/**
+ * @brief Compare two buffers in time independent of where they differ.
+ */
+bool constant_time_equal(const void *a, const void *b, std::size_t len);
+
+/**
+ * @brief @p len bytes from the OS random source.
+ */
+std::string random_bytes(std::size_t len);
+
+/**
+ * @brief Salted, slow password hash as stored for an account.
+ */
+struct PasswordHash {
+    std::string salt;          ///< Random per account
+    std::uint32_t iterations;  ///< PBKDF2 work factor
+    Digest digest;             ///< Derived key
+};
+
+/// Default PBKDF2 work factor for new passwords.
+constexpr std::uint32_t kDefaultPasswordIterations = 100000;
+
+/**
+ * @brief Hash a new password with a fresh salt.
+ */
+PasswordHash hash_password(
+    const std::string &password,
+    std::uint32_t iterations = kDefaultPasswordIterations);
+
+/**
+ * @brief Check @p password against @p stored ( slow: runs the KDF ).
+ */
+bool verify_password(const std::string &password, const PasswordHash &stored);
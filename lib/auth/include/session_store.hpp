@@ -0,0 +1,141 @@
+// session_store.hpp : per-session state that outlives a connection
+#pragma once
+
+#include <chrono>         // grace period
+#include <cstddef>        // std::size_t
+#include <cstdint>        // session id, sequence
+#include <map>            // subscriptions
+#include <mutex>          // table lock
+#include <string>         // user, conversation
+#include <string_view>    // snapshot images
+#include <unordered_map>  // id -> entry
+
+/**
+ * @brief What a client gets back when it resumes a session.
+ */
+struct SessionState {
+    std::string user;  ///< Owner of the session
+    /// Conversations followed -> last sequence number acked in each ( 0
+    /// before the first ); numbers are counted per conversation
+    std::map<std::string, std::uint64_t> subscriptions;
+};
+
+/**
+ * @brief In-memory table of sessions, keyed by session id.
+ *
+ * A session is opened at login and attached to a connection. When the
+ * connection drops it is detached and kept for a grace period, so a client
+ * presenting a resume token ( see SessionTokenIssuer ) picks up its state
+ * without logging in again. Detached sessions past the grace period are
+ * swept lazily, like CredentialCache.
+ *
+ * NOTE: Thread-safe ( one mutex, O(1) per call except the sweep ).
+ */
+class SessionStore
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @param grace How long a detached session may still be resumed.
+     * @param capacity Maximum number of sessions kept.
+     */
+    explicit SessionStore(clock::duration grace = std::chrono::minutes(5),
+                          std::size_t capacity = 100000);
+
+    // -- copy and move trait -- //
+
+    SessionStore(const SessionStore &) = delete;
+    SessionStore &operator=(const SessionStore &) = delete;
+    SessionStore(SessionStore &&) = delete;
+    SessionStore &operator=(SessionStore &&) = delete;
+
+    // -- lifetime -- //
+
+    /**
+     * @brief Open an attached session for @p user.
+     * @return Session id, or 0 if the table is full of live sessions.
+     */
+    std::uint64_t open(const std::string &user);
+
+    /**
+     * @brief Recreate session @p id of @p user, detached ( replaying a
+     * journal ); no-op if it exists.
+     */
+    void adopt(std::uint64_t id, const std::string &user);
+
+    /**
+     * @brief Re-attach session @p id ( after its token was verified ).
+     * @param user User named by the token; must own the session.
+     * @param[out] out Copy of the session state.
+     * @return false if the session is unknown, expired or not @p user's.
+     */
+    bool attach(std::uint64_t id, const std::string &user, SessionState &out);
+
+    /**
+     * @brief The connection went away; start the grace period.
+     */
+    void detach(std::uint64_t id);
+
+    /**
+     * @brief Drop the session now ( logout ).
+     */
+    void close(std::uint64_t id);
+
+    // -- state -- //
+
+    /**
+     * @brief Follow @p conversation ( no-op if already followed ).
+     * @return true if the subscriptions changed.
+     */
+    bool subscribe(std::uint64_t id, const std::string &conversation);
+
+    /**
+     * @brief Stop following @p conversation.
+     * @return true if the subscriptions changed.
+     */
+    bool unsubscribe(std::uint64_t id, const std::string &conversation);
+
+    /**
+     * @brief Record that messages of @p conversation up to @p seq were
+     * delivered ( a stale @p seq changes nothing ).
+     * @return false if the session does not follow @p conversation.
+     */
+    bool set_delivered(std::uint64_t id,
+                       const std::string &conversation,
+                       std::uint64_t seq);
+
+    /// @brief Number of sessions ( including expired, not yet swept ).
+    std::size_t size() const;
+
+    // -- persistence -- //
+
+    /// @brief Append an image of every session's state to @p out.
+    void save(std::string &out) const;
+
+    /**
+     * @brief Replace the sessions with an image made by save(), consumed
+     * from the front of @p in. They come back detached, with a full grace
+     * period to be resumed in.
+     * @return false, leaving the table unchanged, if the image is
+     * malformed.
+     */
+    bool load(std::string_view &in);
+
+private:
+    struct Entry {
+        SessionState state;
+        bool attached{true};
+        clock::time_point expires;  ///< Meaningful when detached
+    };
+
+    void _sweep(clock::time_point now);
+
+    clock::duration grace_;  ///< Resume window after detach
+    std::size_t capacity_;   ///< Entry cap
+
+    mutable std::mutex mtx_;  ///< Protects everything below
+    std::uint64_t next_id_;   ///< Id of the next session
+    std::unordered_map<std::uint64_t, Entry>
+        table_;  ///< id -> entry
+};
@@ -0,0 +1,64 @@
+// session_token.hpp : signed, self-contained tokens for resuming a session
+#pragma once
+
+#include <chrono>   // expiry
+#include <cstdint>  // session id
+#include <string>   // token, user
+
+#include "crypto.hpp"  // HmacSha256, random_bytes
+
+/**
+ * @brief What a valid token proves.
+ */
+struct SessionClaims {
+    std::string user;             ///< Authenticated user
+    std::uint64_t session_id{0};  ///< Session to re-attach to
+    std::int64_t expires{0};      ///< Unix time ( seconds )
+};
+
+/**
+ * @brief Issues and verifies opaque resume tokens.
+ *
+ * A token is base64url( version | session id | expiry | user | tag ) where
+ * tag = HMAC-SHA256(key, everything before it). Verifying needs only the key:
+ * no table lookup, one HMAC and a constant-time compare of the tag. A token
+ * cannot be forged or altered without the key, but it is not encrypted, so
+ * the user name is readable by whoever holds it.
+ *
+ * With the default random key every token dies with the process; pass a
+ * fixed key to keep tokens valid across restarts.
+ *
+ * NOTE: Immutable after construction, so MT-safe.
+ */
+class SessionTokenIssuer
+{
+public:
+    using clock = std::chrono::system_clock;
+
+    /**
+     * @param key HMAC key ( keep it secret ).
+     * @param ttl Lifetime of an issued token.
+     */
+    explicit SessionTokenIssuer(const std::string &key = random_bytes(32),
+                                clock::duration ttl = std::chrono::hours(24));
+
+    /**
+     * @brief Sign a token for @p user's session @p session_id.
+     */
+    std::string issue(const std::string &user,
+                      std::uint64_t session_id,
+                      clock::time_point now = clock::now()) const;
+
+    /**
+     * @brief Check signature and expiry.
+     * @param[out] out Claims of the token; valid only if true is returned.
+     * @return false if the token is malformed, forged or expired.
+     */
+    bool verify(const std::string &token,
+                SessionClaims &out,
+                clock::time_point now = clock::now()) const;
+
+private:
+    HmacSha256 keyed_;     ///< Key schedule done once
+    clock::duration ttl_;  ///< Token lifetime
+};
@@ -0,0 +1,445 @@
+// impl for account_table.hpp
+
+#include "account_table.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+constexpr std::uint64_t kMagic = 0x3142544e43434154;  ///< "TACCNTB1"
+constexpr std::size_t kHeader = 64;
+constexpr std::size_t kSlot = 16;  ///< hash, offset
+
+// header words
+constexpr std::size_t kCapacityAt = 8;
+constexpr std::size_t kCountAt = 16;
+constexpr std::size_t kHeapBytesAt = 24;
+constexpr std::size_t kHeapUsedAt = 32;
+
+/// Slots and header words are used in place through atomics.
+using Word = std::atomic<std::uint64_t>;
+static_assert(sizeof(Word) == 8 && Word::is_always_lock_free,
+              "mapped words need lock-free 64-bit atomics");
+
+/**
+ * @brief Hash of a name, the same on every run and platform ( it is
+ * stored ): FNV-1a, then the MurmurHash3 finalizer, so the low bits that
+ * pick the slot depend on every byte.
+ */
+std::uint64_t hash_name(std::string_view name)
+{
+    std::uint64_t h = 0xcbf29ce484222325;
+    for (unsigned char c : name)
+        h = (h ^ c) * 0x100000001b3;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccd;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53;
+    h ^= h >> 33;
+    return h;
+}
+
+std::uint64_t record_bytes(std::size_t name, std::size_t value)
+{
+    return (8 + name + value + 7) & ~std::uint64_t{7};
+}
+
+std::string table_name(std::uint32_t generation)
+{
+    char name[24];
+    std::snprintf(name, sizeof(name), "%08u.tbl", generation);
+    return name;
+}
+
+/// @return false if @p path is not a table_name().
+bool parse_name(const fs::path &path, std::uint32_t &generation)
+{
+    const std::string stem = path.stem().string();
+    if (path.extension() != ".tbl" || stem.size() != 8 ||
+        stem.find_first_not_of("0123456789") != std::string::npos)
+        return false;
+    generation = static_cast<std::uint32_t>(std::strtoul(stem.c_str(),
+                                                         nullptr, 10));
+    return true;
+}
+
+}  // namespace
+
+/**
+ * @brief One table file, mapped read-write.
+ */
+struct AccountTable::Table {
+    std::string path;
+    std::uint32_t generation{0};
+    char *data{nullptr};
+    std::size_t size{0};
+    std::uint64_t capacity{0};  ///< Slots, a power of two
+    char *slots{nullptr};
+    char *heap{nullptr};
+#ifdef _WIN32
+    void *file{nullptr};     ///< HANDLE of the file
+    void *mapping{nullptr};  ///< HANDLE of the mapping object
+#endif
+
+    /// Map @p path; @p create: make it @p bytes long and zeroed first.
+    Table(std::string p, std::uint32_t gen, bool create, std::uint64_t bytes);
+    ~Table();
+
+    Word &word(std::size_t offset) const
+    {
+        return *reinterpret_cast<Word *>(data + offset);
+    }
+    Word &hash_at(std::uint64_t i) const { return word(kHeader + i * kSlot); }
+    Word &offset_at(std::uint64_t i) const
+    {
+        return word(kHeader + i * kSlot + 8);
+    }
+
+    /// Whether the header is complete and matches the file size.
+    bool valid() const
+    {
+        if (size < kHeader || word(0).load() != kMagic)
+            return false;
+        const std::uint64_t cap = word(kCapacityAt).load();
+        const std::uint64_t heap_bytes = word(kHeapBytesAt).load();
+        return cap != 0 && (cap & (cap - 1)) == 0 &&
+               cap <= (size - kHeader) / kSlot &&
+               kHeader + cap * kSlot + heap_bytes == size &&
+               word(kHeapUsedAt).load() <= heap_bytes;
+    }
+
+    void layout()
+    {
+        capacity = word(kCapacityAt).load();
+        slots = data + kHeader;
+        heap = slots + capacity * kSlot;
+    }
+
+    void flush();
+};
+
+#ifdef _WIN32
+
+AccountTable::Table::Table(std::string p,
+                           std::uint32_t gen,
+                           bool create,
+                           std::uint64_t bytes)
+    : path(std::move(p)), generation(gen)
+{
+    HANDLE f = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE |
+                               FILE_SHARE_DELETE,
+                           nullptr, create ? CREATE_ALWAYS : OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (f == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("cannot open " + path);
+    LARGE_INTEGER len;
+    len.QuadPart = static_cast<LONGLONG>(bytes);
+    if (create && (!SetFilePointerEx(f, len, nullptr, FILE_BEGIN) ||
+                   !SetEndOfFile(f))) {
+        CloseHandle(f);
+        throw std::runtime_error("cannot size " + path);
+    }
+    if (!GetFileSizeEx(f, &len) || len.QuadPart == 0) {
+        CloseHandle(f);
+        throw std::runtime_error("empty table " + path);
+    }
+    size = static_cast<std::size_t>(len.QuadPart);
+    HANDLE m = CreateFileMappingA(f, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+    void *view = m ? MapViewOfFile(m, FILE_MAP_WRITE, 0, 0, 0) : nullptr;
+    if (!view) {
+        if (m)
+            CloseHandle(m);
+        CloseHandle(f);
+        throw std::runtime_error("cannot map " + path);
+    }
+    file = f;
+    mapping = m;
+    data = static_cast<char *>(view);
+}
+
+AccountTable::Table::~Table()
+{
+    if (data)
+        UnmapViewOfFile(data);
+    if (mapping)
+        CloseHandle(mapping);
+    if (file)
+        CloseHandle(file);
+}
+
+void AccountTable::Table::flush()
+{
+    if (!FlushViewOfFile(data, 0) || !FlushFileBuffers(file))
+        throw std::runtime_error("cannot sync " + path);
+}
+
+#else  // POSIX
+
+AccountTable::Table::Table(std::string p,
+                           std::uint32_t gen,
+                           bool create,
+                           std::uint64_t bytes)
+    : path(std::move(p)), generation(gen)
+{
+    const int fd = ::open(path.c_str(),
+                          create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR, 0644);
+    if (fd < 0)
+        throw std::runtime_error("cannot open " + path);
+    struct stat st;
+    if ((create && ::ftruncate(fd, static_cast<off_t>(bytes)) != 0) ||
+        ::fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        throw std::runtime_error("cannot size " + path);
+    }
+    size = static_cast<std::size_t>(st.st_size);
+    void *view =
+        ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);  // the mapping keeps the file
+    if (view == MAP_FAILED)
+        throw std::runtime_error("cannot map " + path);
+    data = static_cast<char *>(view);
+}
+
+AccountTable::Table::~Table()
+{
+    if (data)
+        ::munmap(data, size);
+}
+
+void AccountTable::Table::flush()
+{
+    if (::msync(data, size, MS_SYNC) != 0)
+        throw std::runtime_error("cannot sync " + path);
+}
+
+#endif
+
+AccountTable::AccountTable(std::string dir, std::size_t capacity)
+    : dir_(std::move(dir))
+{
+    std::error_code ec;
+    fs::create_directories(dir_, ec);
+    if (ec || !fs::is_directory(dir_))
+        throw std::runtime_error("cannot create account directory " + dir_);
+
+    // the newest complete generation wins; a growth cut short by a crash
+    // left a newer file without its magic
+    std::vector<std::uint32_t> generations;
+    for (const auto &entry : fs::directory_iterator(dir_)) {
+        std::uint32_t generation;
+        if (parse_name(entry.path(), generation))
+            generations.push_back(generation);
+    }
+    std::sort(generations.rbegin(), generations.rend());
+    for (std::uint32_t generation : generations) {
+        const std::string path =
+            (fs::path(dir_) / table_name(generation)).string();
+        if (!current_.load()) {
+            std::unique_ptr<Table> t;
+            try {
+                t = std::make_unique<Table>(path, generation, false, 0);
+            } catch (const std::runtime_error &) {
+                // empty or unreadable: not a complete generation
+            }
+            if (t && t->valid()) {
+                t->layout();
+                current_.store(t.get());
+                tables_.push_back(std::move(t));
+                continue;
+            }
+        }
+        fs::remove(path, ec);
+    }
+
+    if (!current_.load()) {
+        std::uint64_t slots = 8;
+        while (slots < capacity)
+            slots *= 2;
+        Table *t = _create(1, slots, slots * 64);
+        t->flush();
+        t->word(0).store(kMagic);
+        current_.store(t);
+    }
+}
+
+AccountTable::~AccountTable() = default;
+
+bool AccountTable::find(std::string_view name, std::string_view &value) const
+{
+    const Table *t = current_.load(std::memory_order_acquire);
+    const std::uint64_t hash = hash_name(name);
+    const std::uint64_t mask = t->capacity - 1;
+    for (std::uint64_t i = hash & mask, n = 0; n < t->capacity;
+         i = (i + 1) & mask, ++n) {
+        const std::uint64_t at =
+            t->offset_at(i).load(std::memory_order_acquire);
+        if (at == 0)
+            return false;  // an empty slot ends the probe
+        if (t->hash_at(i).load(std::memory_order_relaxed) != hash)
+            continue;
+        const char *rec = t->heap + at;
+        std::uint32_t name_len, value_len;
+        std::memcpy(&name_len, rec, 4);
+        std::memcpy(&value_len, rec + 4, 4);
+        if (std::string_view(rec + 8, name_len) == name) {
+            value = std::string_view(rec + 8 + name_len, value_len);
+            return true;
+        }
+    }
+    return false;
+}
+
+void AccountTable::put(std::string_view name, std::string_view value)
+{
+    if (name.size() > 0xFFFFFFFF || value.size() > 0xFFFFFFFF)
+        throw std::invalid_argument("account entry too large");
+    const std::uint64_t hash = hash_name(name);
+    std::lock_guard<std::mutex> lk(write_mtx_);
+    if (_insert(*current_.load(), hash, name, value))
+        return;
+    _grow(record_bytes(name.size(), value.size()));
+    if (!_insert(*current_.load(), hash, name, value))
+        throw std::runtime_error("account table cannot grow");
+}
+
+std::size_t AccountTable::size() const
+{
+    return static_cast<std::size_t>(
+        current_.load(std::memory_order_acquire)->word(kCountAt).load());
+}
+
+std::size_t AccountTable::capacity() const
+{
+    return static_cast<std::size_t>(
+        current_.load(std::memory_order_acquire)->capacity);
+}
+
+void AccountTable::sync()
+{
+    std::lock_guard<std::mutex> lk(write_mtx_);
+    current_.load()->flush();
+}
+
+AccountTable::Table *AccountTable::_create(std::uint32_t generation,
+                                           std::uint64_t capacity,
+                                           std::uint64_t heap_bytes)
+{
+    const std::string path =
+        (fs::path(dir_) / table_name(generation)).string();
+    auto t = std::make_unique<Table>(path, generation, true,
+                                     kHeader + capacity * kSlot + heap_bytes);
+    t->word(kCapacityAt).store(capacity);
+    t->word(kHeapBytesAt).store(heap_bytes);
+    t->word(kHeapUsedAt).store(8);  // offset 0 marks an empty slot
+    t->layout();
+    tables_.push_back(std::move(t));
+    return tables_.back().get();
+}
+
+void AccountTable::_grow(std::uint64_t need)
+{
+    const Table &old = *current_.load();
+    const std::uint64_t count = old.word(kCountAt).load();
+    std::uint64_t capacity = old.capacity;
+    if ((count + 1) * 4 > capacity * 3)
+        capacity *= 2;
+    std::uint64_t live = 8 + need;
+    for (std::uint64_t i = 0; i < old.capacity; ++i) {
+        const std::uint64_t at = old.offset_at(i).load();
+        if (at == 0)
+            continue;
+        std::uint32_t name_len, value_len;
+        std::memcpy(&name_len, old.heap + at, 4);
+        std::memcpy(&value_len, old.heap + at + 4, 4);
+        live += record_bytes(name_len, value_len);
+    }
+    std::uint64_t heap_bytes = old.word(kHeapBytesAt).load();
+    while (heap_bytes < live * 2)
+        heap_bytes *= 2;
+
+    // live entries only: replaced values stay behind
+    Table *t = _create(old.generation + 1, capacity, heap_bytes);
+    for (std::uint64_t i = 0; i < old.capacity; ++i) {
+        const std::uint64_t at = old.offset_at(i).load();
+        if (at == 0)
+            continue;
+        const char *rec = old.heap + at;
+        std::uint32_t name_len, value_len;
+        std::memcpy(&name_len, rec, 4);
+        std::memcpy(&value_len, rec + 4, 4);
+        _insert(*t, old.hash_at(i).load(), std::string_view(rec + 8, name_len),
+                std::string_view(rec + 8 + name_len, value_len));
+    }
+    t->flush();
+    t->word(0).store(kMagic);  // from here on, a restart opens it
+    t->flush();
+    current_.store(t, std::memory_order_release);
+
+    // readers may still be in the old mapping: only its file goes
+    std::error_code ec;
+    fs::remove(old.path, ec);
+}
+
+bool AccountTable::_insert(Table &t,
+                           std::uint64_t hash,
+                           std::string_view name,
+                           std::string_view value)
+{
+    const std::uint64_t bytes = record_bytes(name.size(), value.size());
+    const std::uint64_t used = t.word(kHeapUsedAt).load();
+    if (used + bytes > t.word(kHeapBytesAt).load())
+        return false;
+
+    const std::uint64_t mask = t.capacity - 1;
+    std::uint64_t i = hash & mask;
+    bool known = false;
+    for (;; i = (i + 1) & mask) {
+        const std::uint64_t at = t.offset_at(i).load();
+        if (at == 0)
+            break;
+        std::uint32_t name_len;
+        std::memcpy(&name_len, t.heap + at, 4);
+        if (t.hash_at(i).load() == hash &&
+            std::string_view(t.heap + at + 8, name_len) == name) {
+            known = true;
+            break;
+        }
+    }
+    const std::uint64_t count = t.word(kCountAt).load();
+    if (!known && (count + 1) * 4 > t.capacity * 3)
+        return false;
+
+    // the record first, then the slot that points readers at it
+    char *rec = t.heap + used;
+    const auto name_len = static_cast<std::uint32_t>(name.size());
+    const auto value_len = static_cast<std::uint32_t>(value.size());
+    std::memcpy(rec, &name_len, 4);
+    std::memcpy(rec + 4, &value_len, 4);
+    std::memcpy(rec + 8, name.data(), name.size());
+    std::memcpy(rec + 8 + name.size(), value.data(), value.size());
+    t.word(kHeapUsedAt).store(used + bytes);
+    if (!known) {
+        t.hash_at(i).store(hash, std::memory_order_relaxed);
+        t.word(kCountAt).store(count + 1);
+    }
+    t.offset_at(i).store(used, std::memory_order_release);
+    return true;
+}
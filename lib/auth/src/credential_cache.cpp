@@ -0,0 +1,56 @@
+// impl for credential_cache.hpp
+
+#include "credential_cache.hpp"
+
+CredentialCache::CredentialCache(clock::duration ttl, std::size_t capacity)
+    : ttl_(ttl), capacity_(capacity), keyed_(random_bytes(32))
+{
+}
+
+bool CredentialCache::check(const std::string &user,
+                            const std::string &password)
+{
+    const Digest tag = keyed_.mac(password);  // outside the lock
+    const auto now = clock::now();
+
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto it = table_.find(user);
+    if (it == table_.end())
+        return false;
+    if (now >= it->second.expires) {
+        table_.erase(it);
+        return false;
+    }
+    return constant_time_equal(tag.data(), it->second.tag.data(), tag.size());
+}
+
+void CredentialCache::put(const std::string &user, const std::string &password)
+{
+    const Digest tag = keyed_.mac(password);
+    const auto now = clock::now();
+
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (table_.size() >= capacity_ && table_.find(user) == table_.end()) {
+        for (auto it = table_.begin(); it != table_.end();) {
+            if (now >= it->second.expires)
+                it = table_.erase(it);
+            else
+                ++it;
+        }
+        if (table_.size() >= capacity_)
+            return;  // full of live entries: the next login pays the KDF
+    }
+    table_[user] = Entry{tag, now + ttl_};
+}
+
+void CredentialCache::invalidate(const std::string &user)
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    table_.erase(user);
+}
+
+std::size_t CredentialCache::size() const
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    return table_.size();
+}
@@ -0,0 +1,244 @@
+// impl for crypto.hpp
+
+#include "crypto.hpp"
+
+#include <algorithm>  // std::min
+#include <cstring>    // std::memcpy
+#include <random>     // std::random_device
+
+// -- helper function -- //
+
+namespace
+{
+
+constexpr std::uint32_t kRound[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+inline std::uint32_t _rotr(std::uint32_t x, int n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+inline std::uint32_t _load_be32(const std::uint8_t *p)
+{
+    return (std::uint32_t(p[0]) << 24) | (std::uint32_t(p[1]) << 16) |
+           (std::uint32_t(p[2]) << 8) | std::uint32_t(p[3]);
+}
+
+inline void _store_be32(std::uint8_t *p, std::uint32_t v)
+{
+    p[0] = static_cast<std::uint8_t>(v >> 24);
+    p[1] = static_cast<std::uint8_t>(v >> 16);
+    p[2] = static_cast<std::uint8_t>(v >> 8);
+    p[3] = static_cast<std::uint8_t>(v);
+}
+
+}  // namespace
+
+// Sha256
+
+Sha256::Sha256()
+    : state_{0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f,
+             0x9b05688c, 0x1f83d9ab, 0x5be0cd19}
+{
+}
+
+void Sha256::update(const void *data, std::size_t len)
+{
+    const auto *p = static_cast<const std::uint8_t *>(data);
+    total_len_ += len;
+
+    if (buf_len_ > 0) {
+        const std::size_t take = std::min(len, sizeof(buf_) - buf_len_);
+        std::memcpy(buf_ + buf_len_, p, take);
+        buf_len_ += take;
+        p += take;
+        len -= take;
+        if (buf_len_ < sizeof(buf_))
+            return;
+        _compress(buf_);
+        buf_len_ = 0;
+    }
+    for (; len >= 64; p += 64, len -= 64)
+        _compress(p);
+    if (len > 0) {
+        std::memcpy(buf_, p, len);
+        buf_len_ = len;
+    }
+}
+
+Digest Sha256::finish()
+{
+    const std::uint64_t bits = total_len_ * 8;
+    const std::uint8_t pad = 0x80;
+    const std::uint8_t zero[64] = {};
+    update(&pad, 1);
+    update(zero, (buf_len_ <= 56 ? 56 : 120) - buf_len_);
+
+    std::uint8_t len_be[8];
+    for (int i = 0; i < 8; ++i)
+        len_be[i] = static_cast<std::uint8_t>(bits >> (56 - 8 * i));
+    update(len_be, 8);
+
+    Digest out;
+    for (int i = 0; i < 8; ++i)
+        _store_be32(out.data() + 4 * i, state_[i]);
+    return out;
+}
+
+void Sha256::_compress(const std::uint8_t *block)
+{
+    std::uint32_t w[64];
+    for (int i = 0; i < 16; ++i)
+        w[i] = _load_be32(block + 4 * i);
+    for (int i = 16; i < 64; ++i) {
+        const std::uint32_t s0 =
+            _rotr(w[i - 15], 7) ^ _rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        const std::uint32_t s1 =
+            _rotr(w[i - 2], 17) ^ _rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    std::uint32_t a = state_[0], b = state_[1], c = state_[2], d = state_[3];
+    std::uint32_t e = state_[4], f = state_[5], g = state_[6], h = state_[7];
+    for (int i = 0; i < 64; ++i) {
+        const std::uint32_t s1 = _rotr(e, 6) ^ _rotr(e, 11) ^ _rotr(e, 25);
+        const std::uint32_t ch = (e & f) ^ (~e & g);
+        const std::uint32_t t1 = h + s1 + ch + kRound[i] + w[i];
+        const std::uint32_t s0 = _rotr(a, 2) ^ _rotr(a, 13) ^ _rotr(a, 22);
+        const std::uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+        const std::uint32_t t2 = s0 + maj;
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    state_[0] += a;
+    state_[1] += b;
+    state_[2] += c;
+    state_[3] += d;
+    state_[4] += e;
+    state_[5] += f;
+    state_[6] += g;
+    state_[7] += h;
+}
+
+// HmacSha256
+
+HmacSha256::HmacSha256(const void *key, std::size_t key_len)
+{
+    std::uint8_t block[64] = {};
+    if (key_len > sizeof(block)) {
+        const Digest d = sha256(key, key_len);
+        std::memcpy(block, d.data(), d.size());
+    } else if (key_len > 0) {
+        std::memcpy(block, key, key_len);
+    }
+
+    std::uint8_t pad[64];
+    for (int i = 0; i < 64; ++i)
+        pad[i] = block[i] ^ 0x36;
+    inner_.update(pad, sizeof(pad));
+    for (int i = 0; i < 64; ++i)
+        pad[i] = block[i] ^ 0x5c;
+    outer_.update(pad, sizeof(pad));
+}
+
+Digest HmacSha256::mac(const void *data, std::size_t len) const
+{
+    Sha256 inner = inner_;
+    inner.update(data, len);
+    const Digest ih = inner.finish();
+
+    Sha256 outer = outer_;
+    outer.update(ih.data(), ih.size());
+    return outer.finish();
+}
+
+// free functions
+
+Digest sha256(const void *data, std::size_t len)
+{
+    Sha256 h;
+    h.update(data, len);
+    return h.finish();
+}
+
+void pbkdf2_sha256(const std::string &password,
+                   const std::string &salt,
+                   std::uint32_t iterations,
+                   std::uint8_t *out,
+                   std::size_t out_len)
+{
+    const HmacSha256 prf(password);
+    std::string block_input = salt + std::string(4, '\0');
+
+    for (std::uint32_t block = 1; out_len > 0; ++block) {
+        _store_be32(reinterpret_cast<std::uint8_t *>(&block_input[salt.size()]),
+                    block);
+        Digest u = prf.mac(block_input);
+        Digest t = u;
+        for (std::uint32_t i = 1; i < iterations; ++i) {
+            u = prf.mac(u.data(), u.size());
+            for (std::size_t j = 0; j < t.size(); ++j)
+                t[j] ^= u[j];
+        }
+        const std::size_t take = std::min(out_len, t.size());
+        std::memcpy(out, t.data(), take);
+        out += take;
+        out_len -= take;
+    }
+}
+
+bool constant_time_equal(const void *a, const void *b, std::size_t len)
+{
+    const auto *x = static_cast<const volatile std::uint8_t *>(a);
+    const auto *y = static_cast<const volatile std::uint8_t *>(b);
+    std::uint8_t diff = 0;
+    for (std::size_t i = 0; i < len; ++i)
+        diff |= x[i] ^ y[i];
+    return diff == 0;
+}
+
+std::string random_bytes(std::size_t len)
+{
+    std::random_device rd;
+    std::string out(len, '\0');
+    for (std::size_t i = 0; i < len; i += 4) {
+        const std::uint32_t r = rd();
+        for (std::size_t j = 0; j < 4 && i + j < len; ++j)
+            out[i + j] = static_cast<char>(r >> (8 * j));
+    }
+    return out;
+}
+
+PasswordHash hash_password(const std::string &password,
+                           std::uint32_t iterations)
+{
+    PasswordHash h{random_bytes(16), iterations, {}};
+    pbkdf2_sha256(password, h.salt, iterations, h.digest.data(),
+                  h.digest.size());
+    return h;
+}
+
+bool verify_password(const std::string &password, const PasswordHash &stored)
+{
+    Digest d;
+    pbkdf2_sha256(password, stored.salt, stored.iterations, d.data(),
+                  d.size());
+    return constant_time_equal(d.data(), stored.digest.data(), d.size());
+}
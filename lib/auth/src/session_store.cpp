@@ -0,0 +1,232 @@
+// impl for session_store.hpp
+
+#include "session_store.hpp"
+
+#include <algorithm>
+
+#include "crypto.hpp"  // random_bytes
+
+namespace
+{
+
+/// Random start so ids of a restarted server do not repeat the old ones.
+std::uint64_t first_id()
+{
+    const std::string r = random_bytes(8);
+    std::uint64_t v = 0;
+    for (char c : r)
+        v = (v << 8) | static_cast<std::uint8_t>(c);
+    return (v >> 1) + 1;  // never 0, far from wrapping
+}
+
+void put(std::string &buf, std::uint64_t v, int bytes)
+{
+    for (int i = 0; i < bytes; ++i)
+        buf.push_back(static_cast<char>(v >> (8 * i)));
+}
+
+void put_string(std::string &buf, const std::string &s)
+{
+    put(buf, s.size(), 4);
+    buf += s;
+}
+
+/// Read a little-endian integer off the front of @p in.
+bool take(std::string_view &in, int bytes, std::uint64_t &v)
+{
+    if (in.size() < static_cast<std::size_t>(bytes))
+        return false;
+    v = 0;
+    for (int i = 0; i < bytes; ++i)
+        v |= std::uint64_t{static_cast<unsigned char>(in[i])} << (8 * i);
+    in.remove_prefix(bytes);
+    return true;
+}
+
+bool take_string(std::string_view &in, std::string &s)
+{
+    std::uint64_t len;
+    if (!take(in, 4, len) || len > in.size())
+        return false;
+    s.assign(in.substr(0, len));
+    in.remove_prefix(len);
+    return true;
+}
+
+}  // namespace
+
+SessionStore::SessionStore(clock::duration grace, std::size_t capacity)
+    : grace_(grace), capacity_(capacity), next_id_(first_id())
+{
+}
+
+std::uint64_t SessionStore::open(const std::string &user)
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (table_.size() >= capacity_) {
+        _sweep(clock::now());
+        if (table_.size() >= capacity_)
+            return 0;
+    }
+    while (table_.count(next_id_) != 0)  // adopted from a journal
+        ++next_id_;
+    const std::uint64_t id = next_id_++;
+    table_[id].state.user = user;
+    return id;
+}
+
+void SessionStore::adopt(std::uint64_t id, const std::string &user)
+{
+    const auto now = clock::now();
+
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto ins = table_.emplace(id, Entry());
+    if (!ins.second)
+        return;
+    Entry &e = ins.first->second;
+    e.state.user = user;
+    e.attached = false;
+    e.expires = now + grace_;
+}
+
+bool SessionStore::attach(std::uint64_t id,
+                          const std::string &user,
+                          SessionState &out)
+{
+    const auto now = clock::now();
+
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto it = table_.find(id);
+    if (it == table_.end())
+        return false;
+    Entry &e = it->second;
+    if (!e.attached && now >= e.expires) {
+        table_.erase(it);
+        return false;
+    }
+    if (e.state.user != user)
+        return false;
+    // an attached session may be taken over: the old link is probably dead
+    // and its drop has not been noticed yet
+    e.attached = true;
+    out = e.state;
+    return true;
+}
+
+void SessionStore::detach(std::uint64_t id)
+{
+    const auto now = clock::now();
+
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto it = table_.find(id);
+    if (it == table_.end())
+        return;
+    it->second.attached = false;
+    it->second.expires = now + grace_;
+}
+
+void SessionStore::close(std::uint64_t id)
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    table_.erase(id);
+}
+
+bool SessionStore::subscribe(std::uint64_t id, const std::string &conversation)
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto it = table_.find(id);
+    if (it == table_.end())
+        return false;
+    return it->second.state.subscriptions.emplace(conversation, 0).second;
+}
+
+bool SessionStore::unsubscribe(std::uint64_t id,
+                               const std::string &conversation)
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto it = table_.find(id);
+    if (it == table_.end())
+        return false;
+    return it->second.state.subscriptions.erase(conversation) != 0;
+}
+
+bool SessionStore::set_delivered(std::uint64_t id,
+                                 const std::string &conversation,
+                                 std::uint64_t seq)
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto it = table_.find(id);
+    if (it == table_.end())
+        return false;
+    auto &subs = it->second.state.subscriptions;
+    auto sub = subs.find(conversation);
+    if (sub == subs.end())
+        return false;
+    sub->second = std::max(sub->second, seq);
+    return true;
+}
+
+std::size_t SessionStore::size() const
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    return table_.size();
+}
+
+void SessionStore::save(std::string &out) const
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    put(out, table_.size(), 8);
+    for (const auto &entry : table_) {
+        const SessionState &state = entry.second.state;
+        put(out, entry.first, 8);
+        put_string(out, state.user);
+        put(out, state.subscriptions.size(), 4);
+        for (const auto &sub : state.subscriptions) {
+            put_string(out, sub.first);
+            put(out, sub.second, 8);
+        }
+    }
+}
+
+bool SessionStore::load(std::string_view &in)
+{
+    const auto now = clock::now();
+    std::string_view rest = in;
+    std::uint64_t count, id, subs, seq;
+    std::string conversation;
+    // every session takes at least its id, user length and count
+    if (!take(rest, 8, count) || count > rest.size() / 16)
+        return false;
+    std::unordered_map<std::uint64_t, Entry> table;
+    for (std::uint64_t i = 0; i < count; ++i) {
+        Entry e;
+        // every subscription takes at least its name length and seq
+        if (!take(rest, 8, id) || id == 0 ||
+            !take_string(rest, e.state.user) || !take(rest, 4, subs) ||
+            subs > rest.size() / 12)
+            return false;
+        for (std::uint64_t j = 0; j < subs; ++j) {
+            if (!take_string(rest, conversation) || !take(rest, 8, seq) ||
+                !e.state.subscriptions.emplace(conversation, seq).second)
+                return false;
+        }
+        e.attached = false;
+        e.expires = now + grace_;
+        if (!table.emplace(id, std::move(e)).second)
+            return false;  // an id twice
+    }
+    std::lock_guard<std::mutex> lk(mtx_);
+    table_.swap(table);
+    in = rest;
+    return true;
+}
+
+void SessionStore::_sweep(clock::time_point now)
+{
+    for (auto it = table_.begin(); it != table_.end();) {
+        if (!it->second.attached && now >= it->second.expires)
+            it = table_.erase(it);
+        else
+            ++it;
+    }
+}
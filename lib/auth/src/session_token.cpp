@@ -0,0 +1,141 @@
+// impl for session_token.hpp
+
+#include "session_token.hpp"
+
+namespace
+{
+
+constexpr std::uint8_t kVersion = 1;
+constexpr std::size_t kHeaderLen = 1 + 8 + 8;  // version, id, expiry
+constexpr std::size_t kTagLen = std::tuple_size<Digest>::value;
+
+const char kAlphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+void put_u64(std::string &out, std::uint64_t v)
+{
+    for (int i = 7; i >= 0; --i)
+        out.push_back(static_cast<char>(v >> (8 * i)));
+}
+
+std::uint64_t get_u64(const std::string &in, std::size_t pos)
+{
+    std::uint64_t v = 0;
+    for (std::size_t i = 0; i < 8; ++i)
+        v = (v << 8) | static_cast<std::uint8_t>(in[pos + i]);
+    return v;
+}
+
+/// base64url without padding
+std::string encode(const std::string &in)
+{
+    std::string out;
+    out.reserve((in.size() * 4 + 2) / 3);
+    std::uint32_t acc = 0;
+    int bits = 0;
+    for (unsigned char c : in) {
+        acc = (acc << 8) | c;
+        bits += 8;
+        while (bits >= 6) {
+            bits -= 6;
+            out.push_back(kAlphabet[(acc >> bits) & 0x3F]);
+        }
+    }
+    if (bits > 0)
+        out.push_back(kAlphabet[(acc << (6 - bits)) & 0x3F]);
+    return out;
+}
+
+int decode_char(char c)
+{
+    if (c >= 'A' && c <= 'Z')
+        return c - 'A';
+    if (c >= 'a' && c <= 'z')
+        return c - 'a' + 26;
+    if (c >= '0' && c <= '9')
+        return c - '0' + 52;
+    if (c == '-')
+        return 62;
+    if (c == '_')
+        return 63;
+    return -1;
+}
+
+bool decode(const std::string &in, std::string &out)
+{
+    out.clear();
+    out.reserve(in.size() * 3 / 4);
+    std::uint32_t acc = 0;
+    int bits = 0;
+    for (char c : in) {
+        const int v = decode_char(c);
+        if (v < 0)
+            return false;
+        acc = (acc << 6) | static_cast<std::uint32_t>(v);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out.push_back(static_cast<char>(acc >> bits));
+        }
+    }
+    // one encoding per token: no dangling char, no stray low bits
+    return bits < 6 && (acc & ((1u << bits) - 1)) == 0;
+}
+
+}  // namespace
+
+SessionTokenIssuer::SessionTokenIssuer(const std::string &key,
+                                       clock::duration ttl)
+    : keyed_(key), ttl_(ttl)
+{
+}
+
+std::string SessionTokenIssuer::issue(const std::string &user,
+                                      std::uint64_t session_id,
+                                      clock::time_point now) const
+{
+    const auto expires =
+        std::chrono::duration_cast<std::chrono::seconds>(
+            (now + ttl_).time_since_epoch())
+            .count();
+
+    std::string raw;
+    raw.reserve(kHeaderLen + user.size() + kTagLen);
+    raw.push_back(static_cast<char>(kVersion));
+    put_u64(raw, session_id);
+    put_u64(raw, static_cast<std::uint64_t>(expires));
+    raw += user;
+
+    const Digest tag = keyed_.mac(raw);
+    raw.append(reinterpret_cast<const char *>(tag.data()), tag.size());
+    return encode(raw);
+}
+
+bool SessionTokenIssuer::verify(const std::string &token,
+                                SessionClaims &out,
+                                clock::time_point now) const
+{
+    std::string raw;
+    if (!decode(token, raw) || raw.size() < kHeaderLen + kTagLen)
+        return false;
+
+    const std::size_t body_len = raw.size() - kTagLen;
+    const Digest tag = keyed_.mac(raw.data(), body_len);
+    if (!constant_time_equal(tag.data(), raw.data() + body_len, kTagLen))
+        return false;
+
+    // signed by us from here on: the fields can be trusted
+    if (static_cast<std::uint8_t>(raw[0]) != kVersion)
+        return false;
+    const auto expires = static_cast<std::int64_t>(get_u64(raw, 9));
+    const auto now_s = std::chrono::duration_cast<std::chrono::seconds>(
+                           now.time_since_epoch())
+                           .count();
+    if (now_s >= expires)
+        return false;
+
+    out.session_id = get_u64(raw, 1);
+    out.expires = expires;
+    out.user.assign(raw, kHeaderLen, body_len - kHeaderLen);
+    return true;
+}
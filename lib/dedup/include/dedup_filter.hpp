@@ -0,0 +1,108 @@
+// dedup_filter.hpp : fixed-memory filter of recently seen message keys
+#pragma once
+
+#include <atomic>       // lock-free bits
+#include <chrono>       // window
+#include <cstddef>      // std::size_t
+#include <cstdint>      // words, epochs
+#include <memory>       // slice storage
+#include <mutex>        // slice rotation
+#include <string_view>  // keys
+
+/**
+ * @brief Remembers idempotency keys for a time window, in fixed memory.
+ *
+ * A sliced Bloom filter: the window is cut into `slices - 1` time spans and
+ * every span gets its own split-block Bloom filter ( one 64-byte block per
+ * key, one bit in each of its 8 words ). Keys go into the slice of the
+ * current span; a lookup tests the live slices. When a span starts, the
+ * oldest slice is cleared and reused, so a key is remembered for at least
+ * `window` and at most `window * slices / (slices - 1)`.
+ *
+ * A lookup touches one cache line per slice and takes no lock; the memory
+ * budget is split evenly across slices and never grows.
+ *
+ * Like every Bloom filter it can report a key it never saw. At the rated
+ * capacity() ( keys per span ) that happens for fewer than 1 key in 10^4;
+ * past it, the rate climbs. Size the budget for the peak message rate.
+ *
+ * NOTE: Thread-safe, best effort under races: two copies of a key tested at
+ * the same instant on different threads may both be reported as new.
+ */
+class DedupFilter
+{
+public:
+    using clock_type = std::chrono::steady_clock;
+
+    /**
+     * @param memory_bytes Total budget for the bit arrays.
+     * @param window Minimum time a key is remembered.
+     * @param slices Filters in rotation ( >= 2 ); more slices waste less
+     * memory on expired keys but cost one more cache line per lookup.
+     * @throws std::invalid_argument if @p slices < 2 or @p window is not
+     * positive.
+     */
+    explicit DedupFilter(std::size_t memory_bytes = 4 << 20,
+                         clock_type::duration window = std::chrono::minutes(10),
+                         std::size_t slices = 4);
+
+    // -- copy and move trait -- //
+
+    DedupFilter(const DedupFilter &) = delete;
+    DedupFilter &operator=(const DedupFilter &) = delete;
+    DedupFilter(DedupFilter &&) = delete;
+    DedupFilter &operator=(DedupFilter &&) = delete;
+
+    /**
+     * @brief Test @p key and remember it.
+     * @return true if @p key was ( probably ) seen within the window.
+     */
+    bool seen(std::string_view key,
+              clock_type::time_point now = clock_type::now());
+
+    /**
+     * @brief Test @p key without remembering it, for callers that record
+     * a key only once its message is safe ( see insert() ).
+     * @return true if @p key was ( probably ) inserted within the window.
+     */
+    bool contains(std::string_view key,
+                  clock_type::time_point now = clock_type::now()) const;
+
+    /// @brief Remember @p key for the window.
+    void insert(std::string_view key,
+                clock_type::time_point now = clock_type::now());
+
+    /// @brief Bytes held by the bit arrays.
+    std::size_t memory() const;
+
+    /// @brief Keys per span the filter is rated for ( see class note ).
+    std::size_t capacity() const;
+
+private:
+    struct alignas(64) Block {
+        std::atomic<std::uint64_t> words[8];
+    };
+
+    struct Slice {
+        std::unique_ptr<Block[]> blocks;
+        std::atomic<std::int64_t> epoch{-1};  ///< Span it holds
+    };
+
+    struct Probe {
+        std::uint64_t hash;
+        std::size_t block;
+        std::int64_t epoch;
+    };
+
+    Probe _probe(std::string_view key, clock_type::time_point now) const;
+    bool _any(const Probe &p) const;
+    static bool _test(const Block &b, std::uint64_t h);
+    static void _set(Block &b, std::uint64_t h);
+    Slice &_current(std::int64_t epoch);
+
+    clock_type::duration span_;        ///< window / (slices - 1)
+    std::size_t n_slices_;             ///< Filters in rotation
+    std::size_t n_blocks_;             ///< Blocks per slice
+    std::unique_ptr<Slice[]> slices_;  ///< Indexed by epoch % n_slices_
+    std::mutex rotate_mtx_;            ///< Serializes slice reuse
+};
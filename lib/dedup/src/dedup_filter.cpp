@@ -0,0 +1,150 @@
+// impl for dedup_filter.hpp
+
+#include "dedup_filter.hpp"
+
+#include <functional>
+#include <stdexcept>
+
+namespace
+{
+
+/// One odd constant per word picks that word's bit ( as in Parquet's
+/// split-block Bloom filter ).
+constexpr std::uint32_t kSalt[8] = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU,
+                                    0xa2b7289dU, 0x705495c7U, 0x2df1424bU,
+                                    0x9efc4947U, 0x5c6bfb31U};
+
+/// std::hash is not required to mix well ( MSVC uses FNV ); finish it.
+std::uint64_t mix(std::uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+std::uint64_t word_bit(std::uint64_t h, int i)
+{
+    const std::uint32_t lo = static_cast<std::uint32_t>(h);
+    return std::uint64_t{1} << ((lo * kSalt[i]) >> 26);
+}
+
+}  // namespace
+
+DedupFilter::DedupFilter(std::size_t memory_bytes,
+                         clock_type::duration window,
+                         std::size_t slices)
+    : n_slices_(slices)
+{
+    if (slices < 2)
+        throw std::invalid_argument("DedupFilter needs at least 2 slices");
+    if (window <= clock_type::duration::zero())
+        throw std::invalid_argument("DedupFilter window must be positive");
+    span_ = window / static_cast<int>(slices - 1);
+    if (span_ <= clock_type::duration::zero())
+        span_ = clock_type::duration(1);
+
+    n_blocks_ = memory_bytes / slices / sizeof(Block);
+    if (n_blocks_ == 0)
+        n_blocks_ = 1;
+    slices_.reset(new Slice[slices]);
+    for (std::size_t i = 0; i < slices; ++i) {
+        slices_[i].blocks.reset(new Block[n_blocks_]);
+        for (std::size_t b = 0; b < n_blocks_; ++b)
+            for (auto &w : slices_[i].blocks[b].words)
+                w.store(0, std::memory_order_relaxed);
+    }
+}
+
+bool DedupFilter::seen(std::string_view key, clock_type::time_point now)
+{
+    const Probe p = _probe(key, now);
+    if (_any(p))
+        return true;
+    _set(_current(p.epoch).blocks[p.block], p.hash);
+    return false;
+}
+
+bool DedupFilter::contains(std::string_view key,
+                           clock_type::time_point now) const
+{
+    return _any(_probe(key, now));
+}
+
+void DedupFilter::insert(std::string_view key, clock_type::time_point now)
+{
+    const Probe p = _probe(key, now);
+    _set(_current(p.epoch).blocks[p.block], p.hash);
+}
+
+std::size_t DedupFilter::memory() const
+{
+    return n_slices_ * n_blocks_ * sizeof(Block);
+}
+
+std::size_t DedupFilter::capacity() const
+{
+    // 24 bits per key keeps a split-block filter near 1e-4 false positives
+    return n_blocks_ * sizeof(Block) * 8 / 24;
+}
+
+DedupFilter::Probe DedupFilter::_probe(std::string_view key,
+                                      clock_type::time_point now) const
+{
+    const std::uint64_t h = mix(std::hash<std::string_view>{}(key));
+    const std::size_t block = static_cast<std::size_t>(
+        ((h >> 32) * static_cast<std::uint64_t>(n_blocks_)) >> 32);
+    return Probe{h, block, now.time_since_epoch() / span_};
+}
+
+bool DedupFilter::_any(const Probe &p) const
+{
+    const auto oldest = p.epoch - static_cast<std::int64_t>(n_slices_);
+    for (std::size_t i = 0; i < n_slices_; ++i) {
+        const Slice &s = slices_[i];
+        const std::int64_t e = s.epoch.load(std::memory_order_acquire);
+        if (e > oldest && e <= p.epoch && _test(s.blocks[p.block], p.hash))
+            return true;
+    }
+    return false;
+}
+
+bool DedupFilter::_test(const Block &b, std::uint64_t h)
+{
+    for (int i = 0; i < 8; ++i) {
+        if (!(b.words[i].load(std::memory_order_relaxed) & word_bit(h, i)))
+            return false;
+    }
+    return true;
+}
+
+void DedupFilter::_set(Block &b, std::uint64_t h)
+{
+    // plain load + store, not fetch_or: 8 locked instructions would cost
+    // more than the rest of the check. Two inserts racing on one block can
+    // lose a bit, which only lets a duplicate through.
+    for (int i = 0; i < 8; ++i) {
+        auto &w = b.words[i];
+        w.store(w.load(std::memory_order_relaxed) | word_bit(h, i),
+                std::memory_order_relaxed);
+    }
+}
+
+DedupFilter::Slice &DedupFilter::_current(std::int64_t epoch)
+{
+    Slice &s = slices_[static_cast<std::size_t>(epoch) % n_slices_];
+    if (s.epoch.load(std::memory_order_acquire) >= epoch)
+        return s;
+
+    // a new span starts: wipe the slice that held the oldest one
+    std::lock_guard<std::mutex> lk(rotate_mtx_);
+    if (s.epoch.load(std::memory_order_relaxed) < epoch) {
+        s.epoch.store(-1, std::memory_order_release);  // hidden while wiped
+        for (std::size_t b = 0; b < n_blocks_; ++b)
+            for (auto &w : s.blocks[b].words)
+                w.store(0, std::memory_order_relaxed);
+        s.epoch.store(epoch, std::memory_order_release);
+    }
+    return s;
+}
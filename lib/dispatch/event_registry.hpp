@@ -0,0 +1,165 @@
+// event_registry.hpp
+#pragma once
+
+// -- headers for dispatch -- //
+#include <cstddef>
+#include <functional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// -- headers for the plugin slow path -- //
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * @brief Bind a handler type to one value of an event enum.
+ *
+ * @tparam Key     Enum value the handler is responsible for.
+ * @tparam Handler Default-constructible type with a non-virtual
+ *                 `bool handle(const std::string &)` member.
+ */
+template <auto Key, typename Handler>
+struct EventEntry {
+    static constexpr auto key = Key;
+    using handler_type = Handler;
+};
+
+/**
+ * @brief Event registry whose handlers are fixed at compile time.
+ *
+ * Every entry owns one handler instance, stored by value in a tuple. The
+ * fast path dispatch(Enum, ...) is a fold over the entry list, so the
+ * compiler sees a dense `if (idx == 0) ... else if (idx == 1) ...` chain
+ * with direct calls and lowers it to a switch / jump table; there is no
+ * virtual call and no type-erased functor on the way to the handler.
+ *
+ * Events that are not part of the enum can still be served by runtime
+ * plugins (std::function keyed by event name). That path takes a shared lock
+ * and a hash lookup, so it is meant for rarely used extensions only.
+ *
+ * NOTE: Entries must be listed in enum order, starting at 0 without gaps.
+ * NOTE: Handlers are shared between all callers; they must be MT-safe if
+ * dispatch() is called from several threads.
+ */
+template <typename Enum, typename... Entries>
+class EventRegistry
+{
+    static_assert(std::is_enum<Enum>::value, "Enum must be an enum type");
+
+public:
+    using plugin_type = std::function<bool(const std::string &)>;
+
+    /// Number of statically registered events.
+    static constexpr std::size_t size = sizeof...(Entries);
+
+    // -- constructor and destructor -- //
+
+    EventRegistry() = default;
+    ~EventRegistry() = default;
+
+    // -- disable copy and move trait -- //
+
+    EventRegistry(const EventRegistry &) = delete;
+    EventRegistry &operator=(const EventRegistry &) = delete;
+    EventRegistry(EventRegistry &&) = delete;
+    EventRegistry &operator=(EventRegistry &&) = delete;
+
+    // -- fast path -- //
+
+    /**
+     * @brief Dispatch an event to its compile-time registered handler.
+     *
+     * @param type Event type.
+     * @param json Raw event payload.
+     * @return The handler's result, or false if @p type is out of range.
+     */
+    bool dispatch(Enum type, const std::string &json)
+    {
+        return _dispatch(static_cast<std::size_t>(type), json,
+                         std::index_sequence_for<Entries...>{});
+    }
+
+    /**
+     * @brief Access the handler instance registered for @p Key.
+     */
+    template <Enum Key>
+    auto &get()
+    {
+        static_assert(static_cast<std::size_t>(Key) < size,
+                      "no handler registered for this key");
+        return std::get<static_cast<std::size_t>(Key)>(handlers_);
+    }
+
+    // -- slow path ( runtime plugins ) -- //
+
+    /**
+     * @brief Register or replace a runtime plugin for an event name.
+     *
+     * @param name Event name as it appears on the wire.
+     * @param fn   Callback receiving the raw payload.
+     */
+    void register_plugin(const std::string &name, plugin_type fn)
+    {
+        std::unique_lock<std::shared_mutex> lk(plugin_mtx_);
+        plugins_[name] = std::move(fn);
+    }
+
+    /**
+     * @brief Remove a runtime plugin.
+     * @return true if a plugin was registered under @p name.
+     */
+    bool unregister_plugin(const std::string &name)
+    {
+        std::unique_lock<std::shared_mutex> lk(plugin_mtx_);
+        return plugins_.erase(name) > 0;
+    }
+
+    /**
+     * @brief Dispatch an event by name to a runtime plugin.
+     *
+     * @return The plugin's result, or false if no plugin matches.
+     */
+    bool dispatch(const std::string &name, const std::string &json)
+    {
+        plugin_type fn;
+        {
+            std::shared_lock<std::shared_mutex> lk(plugin_mtx_);
+            auto it = plugins_.find(name);
+            if (it == plugins_.end())
+                return false;
+            fn = it->second;  // copy so the plugin may run without the lock
+        }
+        return fn(json);
+    }
+
+private:
+    template <std::size_t... Is>
+    static constexpr bool _keys_in_order(std::index_sequence<Is...>)
+    {
+        return ((static_cast<std::size_t>(Entries::key) == Is) && ...);
+    }
+    static_assert(_keys_in_order(std::index_sequence_for<Entries...>{}),
+                  "entries must be listed in enum order starting at 0");
+
+    template <std::size_t... Is>
+    bool _dispatch(std::size_t idx,
+                   const std::string &json,
+                   std::index_sequence<Is...>)
+    {
+        bool handled = false;
+        ((idx == Is ? (handled = std::get<Is>(handlers_).handle(json), true)
+                    : false) ||
+         ...);
+        return handled;
+    }
+
+    std::tuple<typename Entries::handler_type...>
+        handlers_;  ///< One instance per entry
+
+    std::shared_mutex plugin_mtx_;  ///< Guards plugins_ ( readers share )
+    std::unordered_map<std::string, plugin_type>
+        plugins_;  ///< Runtime registered handlers
+};
@@ -0,0 +1,169 @@
+// strand.hpp : per-key serial execution over a shared ThreadPool
+#pragma once
+
+#include <condition_variable>  // idle wait
+#include <cstddef>             // std::size_t
+#include <deque>               // per-strand backlog
+#include <functional>          // std::function, std::hash
+#include <memory>              // std::unique_ptr
+#include <mutex>               // shard lock
+#include <unordered_map>       // key -> strand
+#include <utility>             // std::move
+#include <vector>              // shard list
+
+#include "thread_pool.hpp"  // ThreadPool
+
+/**
+ * @brief Runs tasks posted under the same key one after another, and tasks
+ * under different keys in parallel, on a shared ThreadPool.
+ *
+ * A strand exists only while it has work: the first post() for an idle key
+ * creates it and submits one drain job to the pool; later posts append to
+ * its backlog; the drain job erases it when the backlog is empty. Keys are
+ * spread over a fixed number of shards, each with one mutex, so there is
+ * neither a thread nor a mutex per key.
+ *
+ * A drain job runs at most @p batch tasks before handing its strand back to
+ * the pool, so one busy key cannot starve the others.
+ *
+ * @tparam Key  Strand key ( e.g. conversation id ).
+ * @tparam Hash Hash for Key.
+ *
+ * NOTE: Shut the pool down before destroying the executor; wait_idle()
+ * first if the queued tasks must run.
+ */
+template <typename Key, typename Hash = std::hash<Key>>
+class StrandExecutor
+{
+public:
+    using task_type = std::function<void()>;
+
+    // -- constructor and destructor -- //
+
+    /**
+     * @param pool Shared worker pool; must outlive this object.
+     * @param shards Number of lock shards.
+     * @param batch Tasks a strand may run per turn on a worker.
+     */
+    explicit StrandExecutor(ThreadPool &pool,
+                            std::size_t shards = 64,
+                            std::size_t batch = 32)
+        : pool_(pool), batch_(batch ? batch : 1)
+    {
+        shards_.reserve(shards ? shards : 1);
+        for (std::size_t i = 0; i < (shards ? shards : 1); ++i)
+            shards_.push_back(std::make_unique<Shard>());
+    }
+
+    ~StrandExecutor() = default;
+
+    // -- copy and move trait -- //
+
+    StrandExecutor(const StrandExecutor &) = delete;
+    StrandExecutor &operator=(const StrandExecutor &) = delete;
+    StrandExecutor(StrandExecutor &&) = delete;
+    StrandExecutor &operator=(StrandExecutor &&) = delete;
+
+    // -- task -- //
+
+    /**
+     * @brief Run @p task after every task previously posted under @p key.
+     *
+     * NOTE: Never blocks on other tasks; one shard lock only.
+     */
+    void post(const Key &key, task_type task)
+    {
+        Shard &shard = _shard(key);
+        {
+            std::lock_guard<std::mutex> lk(shard.mtx);
+            auto it = shard.strands.find(key);
+            if (it != shard.strands.end()) {
+                it->second.push_back(std::move(task));  // strand is busy
+                return;
+            }
+            shard.strands[key].push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lk(idle_mtx_);
+            ++busy_;
+        }
+        _schedule(key);
+    }
+
+    /**
+     * @brief Block until no strand has queued or running work, including
+     * work posted meanwhile by the tasks themselves.
+     *
+     * NOTE: Must not be called from a task of this executor.
+     */
+    void wait_idle()
+    {
+        std::unique_lock<std::mutex> lk(idle_mtx_);
+        idle_cv_.wait(lk, [this] { return busy_ == 0; });
+    }
+
+    /// @brief Number of keys that currently have queued or running work.
+    std::size_t active_strands() const
+    {
+        std::size_t n = 0;
+        for (const auto &shard : shards_) {
+            std::lock_guard<std::mutex> lk(shard->mtx);
+            n += shard->strands.size();
+        }
+        return n;
+    }
+
+private:
+    struct Shard {
+        mutable std::mutex mtx;
+        // front() is the task currently running / next to run
+        std::unordered_map<Key, std::deque<task_type>, Hash> strands;
+    };
+
+    Shard &_shard(const Key &key)
+    {
+        return *shards_[hash_(key) % shards_.size()];
+    }
+
+    void _schedule(const Key &key)
+    {
+        pool_.submit([this, key] { _drain(key); });
+    }
+
+    void _drain(const Key &key)
+    {
+        Shard &shard = _shard(key);
+        for (std::size_t done = 0;; ++done) {
+            task_type task;
+            {
+                std::lock_guard<std::mutex> lk(shard.mtx);
+                auto &backlog = shard.strands.at(key);
+                if (done > 0)
+                    backlog.pop_front();  // previous task finished
+                if (backlog.empty()) {
+                    shard.strands.erase(key);  // strand goes idle
+                    break;
+                }
+                if (done == batch_)
+                    return _schedule(key);  // yield to other strands
+                task = std::move(backlog.front());
+            }
+            try {
+                task();
+            } catch (...) {
+                // keep the strand alive for the tasks behind this one
+            }
+        }
+        std::lock_guard<std::mutex> lk(idle_mtx_);
+        if (--busy_ == 0)
+            idle_cv_.notify_all();
+    }
+
+    ThreadPool &pool_;                            ///< Shared workers
+    std::size_t batch_;                           ///< Tasks per turn
+    Hash hash_;                                   ///< Key -> shard
+    std::vector<std::unique_ptr<Shard>> shards_;  ///< Lock shards
+    std::mutex idle_mtx_;                         ///< Guards busy_
+    std::condition_variable idle_cv_;             ///< Signals busy_ == 0
+    std::size_t busy_{0};                         ///< Strands with work
+};
@@ -0,0 +1,86 @@
+// thread_pool.hpp : fixed-size worker pool
+#pragma once
+
+#include <atomic>      // pending counter
+#include <cstddef>     // std::size_t
+#include <functional>  // std::function
+#include <thread>      // std::thread
+#include <vector>      // worker list
+
+#include "thread_safe_queue.hpp"  // Queue<T>
+
+/**
+ * @brief Fixed number of worker threads sharing one task queue.
+ *
+ * Tasks are run in FIFO order by whichever worker is free. Exceptions thrown
+ * by a task are swallowed so a bad task cannot kill a worker.
+ *
+ * A pool may be given an admission limit: try_submit() refuses work once
+ * that many tasks are waiting, so a burst is shed at the door instead of
+ * growing the queue ( and every caller's latency ) without bound.
+ *
+ * NOTE: Tasks still queued when shutdown() is called are discarded.
+ * NOTE: This class is not copyable or movable ( owns threads ).
+ */
+class ThreadPool
+{
+public:
+    using task_type = std::function<void()>;
+
+    // -- constructor and destructor -- //
+
+    /**
+     * @brief Start the workers.
+     * @param threads Number of workers; 0 means hardware concurrency.
+     * @param max_pending Admission limit for try_submit(); 0 means none.
+     */
+    explicit ThreadPool(std::size_t threads = 0, std::size_t max_pending = 0);
+
+    /**
+     * @brief Calls shutdown().
+     */
+    ~ThreadPool();
+
+    // -- copy and move trait -- //
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ThreadPool(ThreadPool &&) = delete;
+    ThreadPool &operator=(ThreadPool &&) = delete;
+
+    // -- task -- //
+
+    /**
+     * @brief Queue a task for execution.
+     * @param task Callable to run on a worker.
+     */
+    void submit(task_type task);
+
+    /**
+     * @brief Queue a task unless max_pending tasks are already waiting.
+     * @param task Callable to run on a worker.
+     * @return false if the task was rejected.
+     */
+    bool try_submit(task_type task);
+
+    /**
+     * @brief Stop accepting work, wake and join all workers.
+     *
+     * NOTE: Safe to call more than once.
+     */
+    void shutdown();
+
+    /// @brief Number of worker threads.
+    std::size_t size() const { return workers_.size(); }
+
+    /// @brief Number of queued tasks that no worker has started yet.
+    std::size_t pending() const { return pending_.load(); }
+
+private:
+    void _worker();
+
+    Queue<task_type> tasks_;               ///< Pending tasks ( MT-safe )
+    std::vector<std::thread> workers_;     ///< Worker threads
+    std::size_t max_pending_;              ///< Admission limit, 0 = none
+    std::atomic<std::size_t> pending_{0};  ///< Queued, not started
+};
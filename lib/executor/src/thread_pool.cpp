@@ -0,0 +1,62 @@
+// impl for thread_pool.hpp
+
+#include "thread_pool.hpp"
+
+ThreadPool::ThreadPool(std::size_t threads, std::size_t max_pending)
+    : max_pending_(max_pending)
+{
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    if (threads == 0)
+        threads = 1;  // hardware_concurrency() may be unknown
+
+    workers_.reserve(threads);
+    for (std::size_t i = 0; i < threads; ++i)
+        workers_.emplace_back([this] { _worker(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    shutdown();
+}
+
+void ThreadPool::submit(task_type task)
+{
+    pending_.fetch_add(1);
+    tasks_.push(std::move(task));
+}
+
+bool ThreadPool::try_submit(task_type task)
+{
+    if (max_pending_ > 0 && pending_.fetch_add(1) >= max_pending_) {
+        pending_.fetch_sub(1);
+        return false;
+    }
+    if (max_pending_ == 0)
+        pending_.fetch_add(1);
+    tasks_.push(std::move(task));
+    return true;
+}
+
+void ThreadPool::shutdown()
+{
+    tasks_.shutdown();
+    for (auto &t : workers_) {
+        if (t.joinable())
+            t.join();
+    }
+}
+
+void ThreadPool::_worker()
+{
+    task_type task;
+    while (tasks_.pop(task)) {
+        pending_.fetch_sub(1);
+        try {
+            task();
+        } catch (...) {
+            // a failing task must not take the worker down
+        }
+        task = nullptr;  // release captures before blocking again
+    }
+}
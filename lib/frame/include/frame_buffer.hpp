@@ -0,0 +1,83 @@
+// frame_buffer.hpp : decoder / encoder for fixed-size socket frames
+#pragma once
+
+#include <cstddef>  // std::size_t
+#include <string>   // payloads
+#include <vector>   // byte buffer, frame batches
+
+/**
+ * @brief Reassembles the fixed-size, zero-padded frames used between client
+ * and server from an arbitrary TCP byte stream.
+ *
+ * One recv() may return several frames, or end in the middle of one. The
+ * receive loop writes straight into the buffer ( write_ptr() / commit() ),
+ * then drain() extracts every complete frame at once so they can be handled
+ * as one batch; an incomplete tail is kept for the next recv().
+ *
+ * A payload ends at the first '\0' of its frame.
+ *
+ * NOTE: Not thread-safe; owned by one receive loop.
+ */
+class FrameBuffer
+{
+public:
+    /**
+     * @param frame_len Size of one frame on the wire.
+     * @param max_frames How many frames one recv() may deliver.
+     * @throws std::invalid_argument if a size is 0.
+     */
+    explicit FrameBuffer(std::size_t frame_len, std::size_t max_frames = 64);
+
+    // -- receive side -- //
+
+    /// @brief Where the next recv() should write.
+    char *write_ptr() { return buf_.data() + size_; }
+
+    /// @brief How many bytes the next recv() may write.
+    std::size_t writable() const { return buf_.size() - size_; }
+
+    /**
+     * @brief Mark @p n bytes after write_ptr() as received.
+     * @throws std::out_of_range if @p n > writable().
+     */
+    void commit(std::size_t n);
+
+    /**
+     * @brief Copy received bytes in ( for callers that do not recv()
+     * directly into the buffer ).
+     * @throws std::out_of_range if there is not enough room.
+     */
+    void append(const char *data, std::size_t n);
+
+    /**
+     * @brief Move every complete frame's payload to @p out.
+     *
+     * @param[out] out Payloads are appended in arrival order.
+     * @return Number of frames extracted.
+     */
+    std::size_t drain(std::vector<std::string> &out);
+
+    /// @brief Bytes of an incomplete frame still waiting for data.
+    std::size_t pending() const { return size_; }
+
+    std::size_t frame_len() const { return frame_len_; }
+
+    // -- send side -- //
+
+    /**
+     * @brief Append @p message as one zero-padded frame to @p out.
+     *
+     * Encoding several messages into the same buffer lets the caller flush
+     * them with a single send().
+     *
+     * @throws std::runtime_error if the message does not fit in a frame.
+     */
+    static void encode(std::string &out,
+                       const std::string &message,
+                       std::size_t frame_len);
+
+private:
+    std::size_t frame_len_;  ///< Bytes per frame
+    std::vector<char> buf_;  ///< Receive buffer
+    std::size_t size_{0};    ///< Valid bytes at the front of buf_
+};
@@ -0,0 +1,62 @@
+// impl for frame_buffer.hpp
+
+#include "frame_buffer.hpp"
+
+#include <cstring>    // std::memcpy, std::memmove, std::memchr
+#include <stdexcept>  // std::invalid_argument, std::out_of_range
+
+FrameBuffer::FrameBuffer(std::size_t frame_len, std::size_t max_frames)
+    : frame_len_(frame_len)
+{
+    if (frame_len == 0 || max_frames == 0)
+        throw std::invalid_argument("frame size and count must be > 0");
+    buf_.resize(frame_len * max_frames);
+}
+
+void FrameBuffer::commit(std::size_t n)
+{
+    if (n > writable())
+        throw std::out_of_range("commit past end of frame buffer");
+    size_ += n;
+}
+
+void FrameBuffer::append(const char *data, std::size_t n)
+{
+    if (n > writable())
+        throw std::out_of_range("frame buffer overflow");
+    std::memcpy(write_ptr(), data, n);
+    size_ += n;
+}
+
+std::size_t FrameBuffer::drain(std::vector<std::string> &out)
+{
+    const std::size_t frames = size_ / frame_len_;
+    if (frames == 0)
+        return 0;
+
+    out.reserve(out.size() + frames);
+    const char *p = buf_.data();
+    for (std::size_t i = 0; i < frames; ++i, p += frame_len_) {
+        const void *nul = std::memchr(p, '\0', frame_len_);
+        const std::size_t len =
+            nul ? static_cast<const char *>(nul) - p : frame_len_;
+        out.emplace_back(p, len);
+    }
+
+    // keep the incomplete tail ( < frame_len_ bytes ) at the front
+    const std::size_t used = frames * frame_len_;
+    size_ -= used;
+    if (size_ > 0)
+        std::memmove(buf_.data(), buf_.data() + used, size_);
+    return frames;
+}
+
+void FrameBuffer::encode(std::string &out,
+                         const std::string &message,
+                         std::size_t frame_len)
+{
+    if (message.size() > frame_len)
+        throw std::runtime_error("message too large!");
+    out.append(message);
+    out.append(frame_len - message.size(), '\0');
+}
@@ -0,0 +1,137 @@
+// friend_graph.hpp : compact undirected friend graph ( CSR + delta layer )
+#pragma once
+
+#include <cstddef>        // std::size_t
+#include <string>         // images
+#include <string_view>    // images
+#include <unordered_map>  // delta layer
+#include <vector>         // CSR arrays
+
+#include "user_ids.hpp"  // UserId
+
+/**
+ * @brief Contiguous, read-only view of one user's friends ( sorted ).
+ */
+struct FriendSpan {
+    const UserId *data{nullptr};
+    std::size_t size{0};
+
+    const UserId *begin() const { return data; }
+    const UserId *end() const { return data + size; }
+    bool empty() const { return size == 0; }
+};
+
+/**
+ * @brief Undirected friend graph over interned user ids.
+ *
+ * The bulk of the edges lives in CSR form: one array with every adjacency
+ * list back to back, each sorted, and an offset array indexed by user id.
+ * Recent mutations go to a small per-user delta ( sorted additions and
+ * removals ) instead of shifting the big array; once the delta holds more
+ * than the merge threshold, merge() folds it into a fresh CSR in one
+ * linear pass.
+ *
+ * Lookups binary-search the CSR row with a branch-free loop ( the compare
+ * becomes a conditional move ), then consult the delta only if the user has
+ * one. friends() returns the CSR row itself when the user has no pending
+ * delta; otherwise the merged row is built in the caller's scratch vector,
+ * so iteration is always over contiguous memory.
+ *
+ * Memory is about 4 bytes per directed edge plus 8 bytes per user, against
+ * two string copies and two tree nodes per edge for map<string, set<string>>.
+ *
+ * NOTE: Not thread-safe; readers may share it under a shared lock, writers
+ * need an exclusive one.
+ */
+class FriendGraph
+{
+public:
+    /**
+     * @param merge_threshold Delta entries that trigger merge(); 0 picks
+     * max(1024, edges / 8) each time, so merging stays amortized O(1).
+     */
+    explicit FriendGraph(std::size_t merge_threshold = 0);
+
+    // -- mutation -- //
+
+    /**
+     * @brief Make @p a and @p b friends.
+     * @return false if they already were, or a == b.
+     */
+    bool add(UserId a, UserId b);
+
+    /**
+     * @brief End the friendship of @p a and @p b.
+     * @return false if they were not friends.
+     */
+    bool remove(UserId a, UserId b);
+
+    /**
+     * @brief Fold the delta layer into the CSR arrays.
+     */
+    void merge();
+
+    // -- query -- //
+
+    /// @brief Whether @p a and @p b are friends.
+    bool are_friends(UserId a, UserId b) const;
+
+    /**
+     * @brief Friends of @p a in ascending id order.
+     * @param scratch Backing store used when @p a has pending changes; the
+     * span is valid until the next mutation or until @p scratch changes.
+     */
+    FriendSpan friends(UserId a, std::vector<UserId> &scratch) const;
+
+    /// @brief Number of friends of @p a.
+    std::size_t degree(UserId a) const;
+
+    /// @brief Number of friends @p a and @p b have in common.
+    std::size_t mutual_friends(UserId a, UserId b) const;
+
+    /// @brief Number of friendships ( undirected edges ).
+    std::size_t edges() const { return edges_; }
+
+    /// @brief Delta entries not yet merged.
+    std::size_t pending() const { return pending_; }
+
+    /// @brief Ids with a CSR row: all friends are below it once merged.
+    std::size_t rows() const { return offsets_.size() - 1; }
+
+    // -- image -- //
+
+    /**
+     * @brief Append the graph to @p out as a flat image: user count, edge
+     * count, every degree, then every row ( little-endian u32s, pending
+     * changes included ). About 4 bytes per user and per directed edge.
+     */
+    void save(std::string &out) const;
+
+    /**
+     * @brief Replace the graph with an image made by save(), consumed from
+     * the front of @p in. Rows are copied into place, not re-added.
+     * @return false, leaving the graph unchanged, if the image is
+     * malformed.
+     */
+    bool load(std::string_view &in);
+
+private:
+    struct Delta {
+        std::vector<UserId> add;  ///< Sorted, not in the CSR row
+        std::vector<UserId> del;  ///< Sorted, subset of the CSR row
+    };
+
+    FriendSpan _row(UserId a) const;
+    void _link(UserId a, UserId b);
+    void _unlink(UserId a, UserId b);
+    void _maybe_merge();
+
+    std::size_t merge_threshold_;  ///< 0 = adaptive
+
+    std::vector<std::size_t> offsets_;         ///< Row u starts at offsets_[u]
+    std::vector<UserId> adj_;                  ///< All rows, back to back
+    std::unordered_map<UserId, Delta> delta_;  ///< Unmerged changes
+
+    std::size_t edges_{0};    ///< Undirected edge count
+    std::size_t pending_{0};  ///< Entries across delta_
+};
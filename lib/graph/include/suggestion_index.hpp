@@ -0,0 +1,93 @@
+// suggestion_index.hpp : "people you may know", ranked by mutual friends
+#pragma once
+
+#include <cstddef>  // std::size_t
+#include <cstdint>  // counts
+#include <vector>   // per-user lists
+
+#include "friend_graph.hpp"  // FriendGraph
+#include "user_ids.hpp"      // UserId
+
+/**
+ * @brief One suggested user and the number of friends in common.
+ */
+struct Suggestion {
+    UserId user;
+    std::uint32_t mutual;
+};
+
+/**
+ * @brief Incrementally maintained top-K friend-of-friend index.
+ *
+ * For every user it keeps the 2K non-friends with the most mutual friends
+ * and their exact mutual-friend counts, and serves the best K. Each
+ * friendship change adjusts the counts along the new or removed two-hop
+ * paths, so a query only sorts 2K entries.
+ *
+ * Users outside the list are not stored. Instead, each user keeps an upper
+ * bound ( floor ) on their counts. When a change could break the served
+ * top-K ( the K-th best listed count drops below the floor ), the user is
+ * marked dirty. The next query for that user recomputes the list from the
+ * graph in one two-hop scan. The extra K entries absorb most removals
+ * before that happens.
+ *
+ * Memory is O(users * K) no matter how dense the two-hop neighbourhood is.
+ *
+ * NOTE: Not thread-safe. Call on_added() / on_removed() right after the
+ * matching FriendGraph mutation, with the same graph.
+ */
+class SuggestionIndex
+{
+public:
+    /**
+     * @param k Suggestions served per user.
+     */
+    explicit SuggestionIndex(std::size_t k = 20);
+
+    /// @brief @p a and @p b just became friends in @p g.
+    void on_added(const FriendGraph &g, UserId a, UserId b);
+
+    /// @brief @p a and @p b just stopped being friends in @p g.
+    void on_removed(const FriendGraph &g, UserId a, UserId b);
+
+    /**
+     * @brief Forget every list, e.g. after the graph was loaded whole: each
+     * of the first @p users is recomputed on its next query.
+     */
+    void reset(std::size_t users);
+
+    /**
+     * @brief Top suggestions for @p u, most mutual friends first ( ties by
+     * ascending id ).
+     * @param[out] out Replaced with at most K suggestions.
+     */
+    void suggest(const FriendGraph &g, UserId u, std::vector<Suggestion> &out);
+
+    /// @brief Number of full recomputations so far.
+    std::size_t recomputes() const { return recomputes_; }
+
+private:
+    struct Entry {
+        std::vector<Suggestion> top;  ///< Unordered, at most cap_
+        std::uint32_t floor{0};       ///< Bound on unlisted counts
+        bool dirty{false};            ///< top needs a recompute
+    };
+
+    Entry &_entry(UserId u);
+    void _increment(const FriendGraph &g, UserId u, UserId w);
+    void _decrement(UserId u, UserId w);
+    void _offer(Entry &e, UserId w, std::uint32_t mutual);
+    void _drop(UserId u, UserId w);
+    void _check(Entry &e);
+    void _recompute(const FriendGraph &g, UserId u, Entry &e);
+
+    std::size_t k_;              ///< Suggestions served
+    std::size_t cap_;            ///< Suggestions kept ( 2 * k_ )
+    std::vector<Entry> users_;   ///< Indexed by UserId
+    std::size_t recomputes_{0};  ///< Statistics
+
+    std::vector<UserId> scratch_a_;   ///< Reused by friends()
+    std::vector<UserId> scratch_b_;   ///< Reused by friends()
+    std::vector<UserId> hops_;        ///< Reused by _recompute()
+    std::vector<std::uint32_t> kth_;  ///< Reused by _check()
+};
@@ -0,0 +1,58 @@
+// user_ids.hpp : interning of user names into dense integer ids
+#pragma once
+
+#include <cstdint>        // UserId
+#include <string>         // names
+#include <string_view>    // images
+#include <unordered_map>  // name -> id
+#include <vector>         // id -> name
+
+/// Dense user id: 0, 1, 2, ... in order of first appearance.
+using UserId = std::uint32_t;
+
+/**
+ * @brief Maps user names to dense ids and back.
+ *
+ * Graph structures index arrays by UserId instead of hashing strings, so a
+ * name is hashed once at the edge of the system and never again.
+ *
+ * NOTE: Not thread-safe; the owner provides locking.
+ */
+class UserIds
+{
+public:
+    /**
+     * @brief Id of @p name, assigning the next free one if it is new.
+     */
+    UserId intern(const std::string &name);
+
+    /**
+     * @brief Id of an already known @p name.
+     * @return false if @p name was never interned.
+     */
+    bool find(const std::string &name, UserId &out) const;
+
+    /// @brief Name of @p id ( must be a valid id ).
+    const std::string &name(UserId id) const { return names_[id]; }
+
+    /// @brief Number of interned names; valid ids are [0, size()).
+    std::size_t size() const { return names_.size(); }
+
+    /**
+     * @brief Append every name, in id order, to @p out ( count, then
+     * length-prefixed names, little-endian ).
+     */
+    void save(std::string &out) const;
+
+    /**
+     * @brief Replace the names with an image made by save(), consumed from
+     * the front of @p in; ids are kept.
+     * @return false, leaving the names unchanged, if the image is
+     * malformed.
+     */
+    bool load(std::string_view &in);
+
+private:
+    std::unordered_map<std::string, UserId> ids_;  ///< name -> id
+    std::vector<std::string> names_;               ///< id -> name
+};
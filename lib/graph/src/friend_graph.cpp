@@ -0,0 +1,274 @@
+// impl for friend_graph.hpp
+
+#include "friend_graph.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+namespace
+{
+
+/**
+ * @brief Whether sorted @p p[0, n) contains @p key.
+ *
+ * Branch-free lower bound: the loop trip count depends only on n, and the
+ * compare selects the next base with a conditional move, so a miss costs
+ * no branch mispredictions.
+ */
+bool contains(const UserId *p, std::size_t n, UserId key)
+{
+    if (n == 0)
+        return false;
+    while (n > 1) {
+        const std::size_t half = n / 2;
+        p = (p[half] <= key) ? p + half : p;
+        n -= half;
+    }
+    return *p == key;
+}
+
+bool contains(const std::vector<UserId> &v, UserId key)
+{
+    return contains(v.data(), v.size(), key);
+}
+
+void insert_sorted(std::vector<UserId> &v, UserId key)
+{
+    v.insert(std::lower_bound(v.begin(), v.end(), key), key);
+}
+
+void erase_sorted(std::vector<UserId> &v, UserId key)
+{
+    v.erase(std::lower_bound(v.begin(), v.end(), key));
+}
+
+void put(std::string &buf, std::uint64_t v, int bytes)
+{
+    for (int i = 0; i < bytes; ++i)
+        buf.push_back(static_cast<char>(v >> (8 * i)));
+}
+
+std::uint64_t get(const char *p, int bytes)
+{
+    std::uint64_t v = 0;
+    for (int i = 0; i < bytes; ++i)
+        v |= std::uint64_t{static_cast<unsigned char>(p[i])} << (8 * i);
+    return v;
+}
+
+}  // namespace
+
+FriendGraph::FriendGraph(std::size_t merge_threshold)
+    : merge_threshold_(merge_threshold), offsets_(1, 0)
+{
+}
+
+bool FriendGraph::add(UserId a, UserId b)
+{
+    if (a == b || are_friends(a, b))
+        return false;
+    _link(a, b);
+    _link(b, a);
+    ++edges_;
+    _maybe_merge();
+    return true;
+}
+
+bool FriendGraph::remove(UserId a, UserId b)
+{
+    if (!are_friends(a, b))
+        return false;
+    _unlink(a, b);
+    _unlink(b, a);
+    --edges_;
+    _maybe_merge();
+    return true;
+}
+
+bool FriendGraph::are_friends(UserId a, UserId b) const
+{
+    const FriendSpan row = _row(a);
+    const bool in_row = contains(row.data, row.size, b);
+    if (delta_.empty())
+        return in_row;
+    auto it = delta_.find(a);
+    if (it == delta_.end())
+        return in_row;
+    return in_row ? !contains(it->second.del, b) : contains(it->second.add, b);
+}
+
+FriendSpan FriendGraph::friends(UserId a, std::vector<UserId> &scratch) const
+{
+    const FriendSpan row = _row(a);
+    auto it = delta_.find(a);
+    if (it == delta_.end())
+        return row;
+
+    const Delta &d = it->second;
+    scratch.clear();
+    scratch.reserve(row.size + d.add.size() - d.del.size());
+    std::set_difference(row.begin(), row.end(), d.del.begin(), d.del.end(),
+                        std::back_inserter(scratch));
+    const auto mid = scratch.size();
+    scratch.insert(scratch.end(), d.add.begin(), d.add.end());
+    std::inplace_merge(scratch.begin(), scratch.begin() + mid, scratch.end());
+    return FriendSpan{scratch.data(), scratch.size()};
+}
+
+std::size_t FriendGraph::degree(UserId a) const
+{
+    std::size_t n = _row(a).size;
+    auto it = delta_.find(a);
+    if (it != delta_.end())
+        n = n + it->second.add.size() - it->second.del.size();
+    return n;
+}
+
+std::size_t FriendGraph::mutual_friends(UserId a, UserId b) const
+{
+    std::vector<UserId> sa, sb;
+    const FriendSpan x = friends(a, sa);
+    const FriendSpan y = friends(b, sb);
+    std::size_t n = 0;
+    const UserId *p = x.begin(), *q = y.begin();
+    while (p != x.end() && q != y.end()) {
+        n += *p == *q;
+        const UserId vp = *p, vq = *q;
+        p += vp <= vq;
+        q += vq <= vp;
+    }
+    return n;
+}
+
+void FriendGraph::merge()
+{
+    if (delta_.empty())
+        return;
+
+    std::size_t users = offsets_.size() - 1;
+    for (const auto &d : delta_)
+        users = std::max<std::size_t>(users, d.first + 1);
+
+    std::vector<std::size_t> offsets;
+    offsets.reserve(users + 1);
+    offsets.push_back(0);
+    std::vector<UserId> adj;
+    adj.reserve(edges_ * 2);
+
+    std::vector<UserId> scratch;
+    for (std::size_t u = 0; u < users; ++u) {
+        const FriendSpan row = friends(static_cast<UserId>(u), scratch);
+        adj.insert(adj.end(), row.begin(), row.end());
+        offsets.push_back(adj.size());
+    }
+
+    offsets_.swap(offsets);
+    adj_.swap(adj);
+    delta_.clear();
+    pending_ = 0;
+}
+
+void FriendGraph::save(std::string &out) const
+{
+    std::size_t users = offsets_.size() - 1;
+    for (const auto &d : delta_)
+        users = std::max<std::size_t>(users, d.first + 1);
+
+    put(out, users, 8);
+    put(out, edges_, 8);
+    out.reserve(out.size() + 4 * (users + edges_ * 2));
+    for (std::size_t u = 0; u < users; ++u)
+        put(out, degree(static_cast<UserId>(u)), 4);
+    std::vector<UserId> scratch;
+    for (std::size_t u = 0; u < users; ++u) {
+        for (UserId f : friends(static_cast<UserId>(u), scratch))
+            put(out, f, 4);
+    }
+}
+
+bool FriendGraph::load(std::string_view &in)
+{
+    if (in.size() < 16)
+        return false;
+    const std::uint64_t users = get(in.data(), 8);
+    const std::uint64_t edges = get(in.data() + 8, 8);
+    if (users > (in.size() - 16) / 4 ||
+        edges > (in.size() - 16 - 4 * users) / 8)
+        return false;
+
+    std::vector<std::size_t> offsets;
+    offsets.reserve(users + 1);
+    offsets.push_back(0);
+    const char *p = in.data() + 16;
+    for (std::uint64_t u = 0; u < users; ++u, p += 4)
+        offsets.push_back(offsets.back() + get(p, 4));
+    if (offsets.back() != edges * 2)
+        return false;
+
+    std::vector<UserId> adj(edges * 2);
+    for (auto &f : adj) {
+        f = static_cast<UserId>(get(p, 4));
+        p += 4;
+    }
+    // rows must be sorted, unique and in range, as add() keeps them
+    for (std::uint64_t u = 0; u < users; ++u) {
+        for (std::size_t i = offsets[u]; i < offsets[u + 1]; ++i) {
+            if (adj[i] >= users || adj[i] == u ||
+                (i > offsets[u] && adj[i] <= adj[i - 1]))
+                return false;
+        }
+    }
+
+    offsets_.swap(offsets);
+    adj_.swap(adj);
+    delta_.clear();
+    edges_ = edges;
+    pending_ = 0;
+    in.remove_prefix(static_cast<std::size_t>(p - in.data()));
+    return true;
+}
+
+FriendSpan FriendGraph::_row(UserId a) const
+{
+    if (a + std::size_t{1} >= offsets_.size())
+        return FriendSpan{};
+    return FriendSpan{adj_.data() + offsets_[a],
+                      offsets_[a + 1] - offsets_[a]};
+}
+
+void FriendGraph::_maybe_merge()
+{
+    const std::size_t limit =
+        merge_threshold_ ? merge_threshold_
+                         : std::max<std::size_t>(1024, adj_.size() / 8);
+    if (pending_ > limit)
+        merge();
+}
+
+void FriendGraph::_link(UserId a, UserId b)
+{
+    Delta &d = delta_[a];
+    if (contains(d.del, b)) {  // re-added before a merge
+        erase_sorted(d.del, b);
+        --pending_;
+    } else {
+        insert_sorted(d.add, b);
+        ++pending_;
+    }
+    if (d.add.empty() && d.del.empty())
+        delta_.erase(a);
+}
+
+void FriendGraph::_unlink(UserId a, UserId b)
+{
+    Delta &d = delta_[a];
+    if (contains(d.add, b)) {  // removed before a merge
+        erase_sorted(d.add, b);
+        --pending_;
+    } else {
+        insert_sorted(d.del, b);
+        ++pending_;
+    }
+    if (d.add.empty() && d.del.empty())
+        delta_.erase(a);
+}
@@ -0,0 +1,235 @@
+// impl for suggestion_index.hpp
+
+#include "suggestion_index.hpp"
+
+#include <algorithm>
+#include <functional>
+
+namespace
+{
+
+bool ranks_before(const Suggestion &x, const Suggestion &y)
+{
+    return x.mutual != y.mutual ? x.mutual > y.mutual : x.user < y.user;
+}
+
+std::vector<Suggestion>::iterator find_user(std::vector<Suggestion> &top,
+                                            UserId w)
+{
+    return std::find_if(top.begin(), top.end(),
+                        [w](const Suggestion &s) { return s.user == w; });
+}
+
+std::vector<Suggestion>::iterator weakest(std::vector<Suggestion> &top)
+{
+    return std::min_element(top.begin(), top.end(),
+                            [](const Suggestion &x, const Suggestion &y) {
+                                return x.mutual < y.mutual;
+                            });
+}
+
+}  // namespace
+
+SuggestionIndex::SuggestionIndex(std::size_t k)
+    : k_(k == 0 ? 1 : k), cap_(2 * k_)
+{
+}
+
+void SuggestionIndex::on_added(const FriendGraph &g, UserId a, UserId b)
+{
+    _drop(a, b);
+    _drop(b, a);
+
+    // new two-hop paths a - b - x and y - a - b
+    const FriendSpan nb = g.friends(b, scratch_b_);
+    for (UserId x : nb) {
+        if (x == a || g.are_friends(a, x))
+            continue;
+        _increment(g, a, x);
+        _increment(g, x, a);
+    }
+    const FriendSpan na = g.friends(a, scratch_a_);
+    for (UserId y : na) {
+        if (y == b || g.are_friends(b, y))
+            continue;
+        _increment(g, b, y);
+        _increment(g, y, b);
+    }
+}
+
+void SuggestionIndex::on_removed(const FriendGraph &g, UserId a, UserId b)
+{
+    const FriendSpan nb = g.friends(b, scratch_b_);
+    for (UserId x : nb) {
+        if (x == a || g.are_friends(a, x))
+            continue;
+        _decrement(a, x);
+        _decrement(x, a);
+    }
+    const FriendSpan na = g.friends(a, scratch_a_);
+    for (UserId y : na) {
+        if (y == b || g.are_friends(b, y))
+            continue;
+        _decrement(b, y);
+        _decrement(y, b);
+    }
+
+    // no longer friends: they may suggest each other now
+    const auto mutual = static_cast<std::uint32_t>(g.mutual_friends(a, b));
+    Entry &ea = _entry(a);
+    if (!ea.dirty)
+        _offer(ea, b, mutual);
+    Entry &eb = _entry(b);
+    if (!eb.dirty)
+        _offer(eb, a, mutual);
+}
+
+void SuggestionIndex::reset(std::size_t users)
+{
+    Entry dirty;
+    dirty.dirty = true;
+    users_.assign(users, dirty);
+}
+
+void SuggestionIndex::suggest(const FriendGraph &g,
+                              UserId u,
+                              std::vector<Suggestion> &out)
+{
+    Entry &e = _entry(u);
+    if (e.dirty)
+        _recompute(g, u, e);
+    out = e.top;
+    const std::size_t n = std::min(k_, out.size());
+    std::partial_sort(out.begin(), out.begin() + n, out.end(), ranks_before);
+    out.resize(n);
+}
+
+SuggestionIndex::Entry &SuggestionIndex::_entry(UserId u)
+{
+    if (u >= users_.size())
+        users_.resize(u + std::size_t{1});
+    return users_[u];
+}
+
+void SuggestionIndex::_increment(const FriendGraph &g, UserId u, UserId w)
+{
+    Entry &e = _entry(u);
+    if (e.dirty)
+        return;  // rebuilt from the graph on the next query
+    auto it = find_user(e.top, w);
+    if (it != e.top.end()) {
+        ++it->mutual;
+        return;
+    }
+    if (e.top.size() < cap_) {
+        // with a zero floor no unlisted candidate has a mutual friend yet
+        const auto mutual =
+            e.floor == 0 ? 1u
+                         : static_cast<std::uint32_t>(g.mutual_friends(u, w));
+        e.top.push_back(Suggestion{w, mutual});
+        return;
+    }
+    const std::uint32_t least = weakest(e.top)->mutual;
+    if (e.floor < least) {
+        ++e.floor;  // w's count <= old floor + 1, still below the list
+        return;
+    }
+    _offer(e, w, static_cast<std::uint32_t>(g.mutual_friends(u, w)));
+}
+
+void SuggestionIndex::_decrement(UserId u, UserId w)
+{
+    Entry &e = _entry(u);
+    if (e.dirty)
+        return;
+    auto it = find_user(e.top, w);
+    if (it == e.top.end())
+        return;  // unlisted: the floor stays a valid bound
+    if (--it->mutual == 0)
+        e.top.erase(it);
+    _check(e);
+}
+
+void SuggestionIndex::_offer(Entry &e, UserId w, std::uint32_t mutual)
+{
+    if (mutual == 0)
+        return;
+    if (e.top.size() < cap_) {
+        e.top.push_back(Suggestion{w, mutual});
+        return;
+    }
+    auto least = weakest(e.top);
+    if (mutual > least->mutual) {
+        e.floor = std::max(e.floor, least->mutual);
+        *least = Suggestion{w, mutual};
+    } else {
+        e.floor = std::max(e.floor, mutual);
+    }
+}
+
+void SuggestionIndex::_drop(UserId u, UserId w)
+{
+    Entry &e = _entry(u);
+    if (e.dirty)
+        return;
+    auto it = find_user(e.top, w);
+    if (it == e.top.end())
+        return;
+    e.top.erase(it);
+    _check(e);
+}
+
+void SuggestionIndex::_check(Entry &e)
+{
+    if (e.floor == 0)
+        return;  // nothing unlisted can compete
+    // the k-th best listed entry must still rank at or above every
+    // unlisted candidate, whose counts are at most floor
+    if (e.top.size() < k_) {
+        e.dirty = true;
+        return;
+    }
+    kth_.clear();
+    for (const auto &s : e.top)
+        kth_.push_back(s.mutual);
+    std::nth_element(kth_.begin(), kth_.begin() + (k_ - 1), kth_.end(),
+                     std::greater<std::uint32_t>());
+    if (kth_[k_ - 1] < e.floor)
+        e.dirty = true;
+}
+
+void SuggestionIndex::_recompute(const FriendGraph &g, UserId u, Entry &e)
+{
+    ++recomputes_;
+
+    // every friend-of-friend, once per mutual friend
+    hops_.clear();
+    const FriendSpan mine = g.friends(u, scratch_a_);
+    for (UserId f : mine) {
+        for (UserId w : g.friends(f, scratch_b_)) {
+            if (w != u && !std::binary_search(mine.begin(), mine.end(), w))
+                hops_.push_back(w);
+        }
+    }
+    std::sort(hops_.begin(), hops_.end());
+
+    std::vector<Suggestion> all;
+    for (std::size_t i = 0; i < hops_.size();) {
+        std::size_t j = i;
+        while (j < hops_.size() && hops_[j] == hops_[i])
+            ++j;
+        all.push_back(
+            Suggestion{hops_[i], static_cast<std::uint32_t>(j - i)});
+        i = j;
+    }
+
+    e.floor = 0;
+    if (all.size() > cap_) {
+        std::nth_element(all.begin(), all.begin() + cap_, all.end(),
+                         ranks_before);
+        e.floor = all[cap_].mutual;  // best of the rest
+        all.resize(cap_);
+    }
+    e.top.assign(all.begin(), all.end());
+    e.dirty = false;
+}
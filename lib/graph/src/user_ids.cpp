@@ -0,0 +1,80 @@
+// impl for user_ids.hpp
+
+#include "user_ids.hpp"
+
+namespace
+{
+
+void put(std::string &buf, std::uint64_t v, int bytes)
+{
+    for (int i = 0; i < bytes; ++i)
+        buf.push_back(static_cast<char>(v >> (8 * i)));
+}
+
+/// Read a little-endian integer off the front of @p in.
+bool take(std::string_view &in, int bytes, std::uint64_t &v)
+{
+    if (in.size() < static_cast<std::size_t>(bytes))
+        return false;
+    v = 0;
+    for (int i = 0; i < bytes; ++i)
+        v |= std::uint64_t{static_cast<unsigned char>(in[i])} << (8 * i);
+    in.remove_prefix(bytes);
+    return true;
+}
+
+}  // namespace
+
+UserId UserIds::intern(const std::string &name)
+{
+    auto it = ids_.find(name);
+    if (it != ids_.end())
+        return it->second;
+    const auto id = static_cast<UserId>(names_.size());
+    ids_.emplace(name, id);
+    names_.push_back(name);
+    return id;
+}
+
+bool UserIds::find(const std::string &name, UserId &out) const
+{
+    auto it = ids_.find(name);
+    if (it == ids_.end())
+        return false;
+    out = it->second;
+    return true;
+}
+
+void UserIds::save(std::string &out) const
+{
+    put(out, names_.size(), 8);
+    for (const auto &name : names_) {
+        put(out, name.size(), 4);
+        out += name;
+    }
+}
+
+bool UserIds::load(std::string_view &in)
+{
+    std::string_view rest = in;
+    std::uint64_t count, len;
+    // every name takes at least its length
+    if (!take(rest, 8, count) || count > rest.size() / 4)
+        return false;
+    std::vector<std::string> names;
+    std::unordered_map<std::string, UserId> ids;
+    names.reserve(count);
+    ids.reserve(count);
+    for (std::uint64_t i = 0; i < count; ++i) {
+        if (!take(rest, 4, len) || len > rest.size())
+            return false;
+        names.emplace_back(rest.substr(0, len));
+        rest.remove_prefix(len);
+        if (!ids.emplace(names.back(), static_cast<UserId>(i)).second)
+            return false;  // a name twice
+    }
+    names_.swap(names);
+    ids_.swap(ids);
+    in = rest;
+    return true;
+}
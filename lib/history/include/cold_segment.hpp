@@ -0,0 +1,121 @@
+// cold_segment.hpp : block-compressed, read-only history segment
+#pragma once
+
+#include <cstddef>     // std::size_t
+#include <cstdint>     // offsets, checksums
+#include <functional>  // pacing
+#include <memory>      // blocks
+#include <mutex>       // block cache
+#include <string>      // path, blocks
+#include <vector>      // block index, block ends
+
+#include "mapped_file.hpp"  // MappedFile
+
+/**
+ * @brief A sealed segment's records, compressed a block at a time.
+ *
+ * File layout ( little-endian ):
+ *
+ *     blocks  lz_compress()ed runs of whole records, back to back
+ *     index   per block: u64 record offset | u64 file offset
+ *             | u32 record bytes | u32 compressed bytes | u32 CRC-32C of
+ *             the compressed bytes
+ *     footer  u64 record bytes | u64 index offset | u32 blocks
+ *             | u32 records' crc chain | u32 CRC-32C of the index
+ *             | u32 magic
+ *
+ * Offsets are those of the segment the records came from, so the store's
+ * index keeps pointing at them. Reading a record decompresses the one
+ * block that holds it; the last few blocks are kept.
+ *
+ * NOTE: Thread-safe.
+ */
+class ColdSegment
+{
+public:
+    /**
+     * @brief Write @p records as a cold segment at @p path ( created ).
+     *
+     * @p ends are the record offsets where blocks end, ascending, the last
+     * one the size of @p records. @p pace is called with the bytes about to
+     * be read and written before each block; returning false stops.
+     *
+     * @return false if @p pace stopped the write ( @p path is left
+     * partial ); @p bytes is the file size otherwise.
+     * @throws std::runtime_error if the file cannot be written.
+     */
+    static bool write(const std::string &path,
+                      const char *records,
+                      const std::vector<std::uint64_t> &ends,
+                      std::uint32_t chained,
+                      const std::function<bool(std::uint64_t)> &pace,
+                      std::uint64_t &bytes);
+
+    /**
+     * @throws std::runtime_error if @p path is not a whole cold segment.
+     */
+    explicit ColdSegment(const std::string &path);
+
+    // -- copy and move trait -- //
+
+    ColdSegment(const ColdSegment &) = delete;
+    ColdSegment &operator=(const ColdSegment &) = delete;
+    ColdSegment(ColdSegment &&) = delete;
+    ColdSegment &operator=(ColdSegment &&) = delete;
+
+    /// @brief Bytes of records, uncompressed.
+    std::uint64_t records() const { return records_; }
+
+    /// @brief Bytes of the file.
+    std::uint64_t file_bytes() const { return map_.size(); }
+
+    /// @brief Crc chain of the records, as in the hot segment's footer.
+    std::uint32_t chained() const { return chained_; }
+
+    std::size_t blocks() const { return index_.size(); }
+
+    /// @brief Record offset block @p i starts at.
+    std::uint64_t block_start(std::size_t i) const
+    {
+        return index_[i].offset;
+    }
+
+    /**
+     * @brief Records of block @p i, decompressed ( or from the cache ).
+     * @throws std::runtime_error if the block is corrupt.
+     */
+    std::shared_ptr<const std::string> block(std::size_t i) const;
+
+    /**
+     * @brief Record bytes at @p offset, which @p keep holds in memory.
+     * @throws std::runtime_error if the block is corrupt.
+     */
+    const char *at(std::uint64_t offset,
+                   std::shared_ptr<const void> &keep) const;
+
+    /// @brief Blocks decompressed so far ( cache misses ).
+    std::uint64_t decompressed() const;
+
+private:
+    struct Block {
+        std::uint64_t offset;  ///< Of its first record
+        std::uint64_t at;      ///< In the file
+        std::uint32_t size;    ///< Uncompressed
+        std::uint32_t packed;
+        std::uint32_t crc;
+    };
+
+    /// Blocks kept decompressed, most recently loaded replaced last.
+    static constexpr std::size_t kCached = 4;
+
+    MappedFile map_;
+    std::uint64_t records_{0};
+    std::uint32_t chained_{0};
+    std::vector<Block> index_;
+
+    mutable std::mutex mtx_;  ///< Protects the cache
+    mutable std::size_t cached_[kCached];
+    mutable std::shared_ptr<const std::string> cache_[kCached];
+    mutable std::size_t victim_{0};
+    mutable std::uint64_t decompressed_{0};
+};
@@ -0,0 +1,26 @@
+// crc32c.hpp : CRC-32C ( Castagnoli ) checksums
+#pragma once
+
+#include <cstddef>  // std::size_t
+#include <cstdint>  // checksums
+
+/**
+ * @brief CRC-32C of @p size bytes at @p data, continuing from @p crc ( the
+ * checksum of the bytes before them, 0 to start ).
+ *
+ * Chains like zlib's crc32(): crc32c(b, crc32c(a)) is the checksum of a
+ * then b. Uses the SSE4.2 crc32 instruction when the CPU has it ( checked
+ * once, at the first call ), slicing-by-8 tables otherwise; both give the
+ * same result.
+ *
+ * NOTE: Thread-safe.
+ */
+std::uint32_t crc32c(const void *data, std::size_t size, std::uint32_t crc = 0);
+
+/// @brief crc32c() without the hardware path ( tests, benchmarks ).
+std::uint32_t crc32c_portable(const void *data,
+                              std::size_t size,
+                              std::uint32_t crc = 0);
+
+/// @brief Whether crc32c() runs on the CPU's crc32 instruction.
+bool crc32c_accelerated();
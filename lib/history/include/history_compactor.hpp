@@ -0,0 +1,106 @@
+// history_compactor.hpp : background compaction of a HistoryStore
+#pragma once
+
+#include <chrono>              // interval, pacing
+#include <condition_variable>  // sleeps stop() can cut short
+#include <cstddef>             // std::size_t
+#include <cstdint>             // byte counts
+#include <mutex>               // progress, stop flag
+#include <thread>              // compactor thread
+
+#include "history_store.hpp"  // HistoryStore, CompactionResult
+
+/**
+ * @brief Knobs of a HistoryCompactor.
+ */
+struct CompactionOptions {
+    std::uint64_t io_bytes_per_sec{8 << 20};  ///< Read + write budget, 0 = none
+    double min_garbage{0.25};  ///< Erased share that makes a segment worth it
+    std::chrono::milliseconds interval{10000};  ///< Between passes
+    /// Age that sends a sealed segment to the cold tier, 0 = never;
+    /// against record timestamps in ms since the Unix epoch
+    std::chrono::milliseconds cold_after{0};
+};
+
+/**
+ * @brief Where a HistoryCompactor is, and what it did so far.
+ */
+struct CompactionProgress {
+    std::uint64_t passes{0};    ///< Passes over every shard finished
+    std::uint64_t runs{0};      ///< Runs of segments compacted
+    std::uint64_t frozen{0};    ///< Segments moved to the cold tier
+    std::size_t shard{0};       ///< Shard the current pass is at
+    std::size_t shards{0};      ///< Shards of the store
+    std::uint64_t bytes_read{0};
+    std::uint64_t bytes_written{0};
+    std::uint64_t bytes_reclaimed{0};  ///< Disk space given back
+};
+
+/**
+ * @brief Compacts a HistoryStore in the background.
+ *
+ * Every interval, one pass walks the shards and calls
+ * HistoryStore::compact() on each until it finds nothing more to do, then
+ * HistoryStore::freeze() for segments older than cold_after. The
+ * copying is paced by a token bucket of io_bytes_per_sec, so the
+ * compactor never takes more than that share of the disk from foreground
+ * appends, whatever the backlog; the store only holds the shard lock to
+ * plan a run and to swap it in.
+ *
+ * NOTE: Thread-safe. stop() interrupts a paced run; the half-written merge
+ * is dropped and the store is left as it was.
+ */
+class HistoryCompactor
+{
+public:
+    /**
+     * @param start Start the background thread; without it, passes only
+     * run through run_pass().
+     */
+    explicit HistoryCompactor(HistoryStore &store,
+                              CompactionOptions options = CompactionOptions(),
+                              bool start = true);
+
+    /**
+     * @brief Calls stop().
+     */
+    ~HistoryCompactor();
+
+    // -- copy and move trait -- //
+
+    HistoryCompactor(const HistoryCompactor &) = delete;
+    HistoryCompactor &operator=(const HistoryCompactor &) = delete;
+    HistoryCompactor(HistoryCompactor &&) = delete;
+    HistoryCompactor &operator=(HistoryCompactor &&) = delete;
+
+    /**
+     * @brief One pass over every shard, on the caller's thread.
+     * @return Runs compacted and segments frozen.
+     * @throws std::runtime_error if a merged segment cannot be written.
+     */
+    std::size_t run_pass();
+
+    /**
+     * @brief Stop the background thread, abandoning the current run.
+     *
+     * NOTE: Safe to call more than once.
+     */
+    void stop();
+
+    CompactionProgress progress() const;
+
+private:
+    void _count(const CompactionResult &r);  ///< Under mtx_
+    bool _pace(std::uint64_t bytes);
+    void _run();
+
+    HistoryStore &store_;
+    CompactionOptions options_;
+
+    mutable std::mutex mtx_;      ///< Protects progress_, stop_, next_
+    std::condition_variable cv_;  ///< Wakes sleepers on stop()
+    CompactionProgress progress_;
+    bool stop_{false};
+    std::chrono::steady_clock::time_point next_;  ///< Budget free again
+    std::thread thread_;
+};
@@ -0,0 +1,167 @@
+// history_engine.hpp : storage interface of the chat history
+#pragma once
+
+#include <cstdint>      // ids, timestamps
+#include <functional>   // scan
+#include <memory>       // record views
+#include <string>       // conversation, payload
+#include <string_view>  // record views
+#include <vector>       // pages, batches
+
+/**
+ * @brief Id of a stored message: shard in the high 16 bits, position in
+ * the shard's log ( 1, 2, 3, ... ) in the low 48. 0 is never used.
+ */
+using MessageId = std::uint64_t;
+
+/**
+ * @brief One stored message.
+ */
+struct HistoryRecord {
+    MessageId id{0};
+    std::uint64_t timestamp{0};  ///< Caller's clock, e.g. ms since epoch
+    std::string conversation;
+    std::string payload;
+};
+
+/**
+ * @brief A stored message in place: the views point into the engine's
+ * own memory ( a mapped segment, the decompressed block of a cold one, a
+ * chunk of a MemoryHistory ), which the view keeps alive ( even once
+ * compaction replaced it ).
+ */
+struct RecordView {
+    MessageId id{0};
+    std::uint64_t timestamp{0};
+    std::string_view conversation;
+    std::string_view payload;
+    std::shared_ptr<const void> segment;  ///< Keeps the bytes alive
+};
+
+/**
+ * @brief A page of one conversation, as returned by HistoryEngine::fetch().
+ */
+struct HistoryPage {
+    std::vector<RecordView> records;  ///< Newest first
+    MessageId next{0};  ///< Cursor for the older page, 0 once at the start
+};
+
+/**
+ * @brief One message of a HistoryEngine::write() batch.
+ */
+struct HistoryAppend {
+    std::string conversation;
+    std::string payload;
+    std::uint64_t timestamp{0};
+};
+
+/**
+ * @brief Where chat history is kept, as the server sees it.
+ *
+ * Conversations are logs of messages, newest appended last. Every message
+ * gets an id that stays valid for good; each conversation can be paged
+ * back from its newest message or any of its ids, or from a date.
+ *
+ * Backends:
+ *
+ *     HistoryStore   log-structured segment files, for production
+ *     MemoryHistory  chunks in memory, for tests and load generation
+ *
+ * Both give the same answers to the same calls ( the history tests run
+ * them side by side, bench_engine times them on one workload ). What is
+ * particular to a backend ( compaction, tiers, prefetch ) stays on it.
+ *
+ * NOTE: Implementations are thread-safe.
+ */
+class HistoryEngine
+{
+public:
+    virtual ~HistoryEngine() = default;
+
+    /**
+     * @brief Append a message to @p conversation.
+     * @return Id of the new record.
+     * @throws std::invalid_argument if the record is too large to store.
+     * @throws std::runtime_error if it cannot be written.
+     */
+    virtual MessageId append(const std::string &conversation,
+                             const std::string &payload,
+                             std::uint64_t timestamp) = 0;
+
+    /**
+     * @brief Append every message of @p batch, in order ( batch write ).
+     *
+     * @p ids gets one id per message, 0 for one that could not be stored;
+     * one failing does not stop the others. Cheaper than append() one at
+     * a time: locks are taken once per batch, not per message.
+     */
+    virtual void write(const std::vector<HistoryAppend> &batch,
+                       std::vector<MessageId> &ids) = 0;
+
+    /**
+     * @brief Delete message @p id.
+     * @return false if there is no such message, or it is already erased.
+     */
+    virtual bool erase(MessageId id) = 0;
+
+    /**
+     * @brief Record @p id in place, zero-copy ( point lookup ).
+     * @return false if no such message exists, or it was erased.
+     */
+    virtual bool view(MessageId id, RecordView &out) = 0;
+
+    /**
+     * @brief Copy of record @p id.
+     * @return false if no such message exists, or it was erased.
+     */
+    virtual bool read(MessageId id, HistoryRecord &out) = 0;
+
+    /**
+     * @brief Up to @p limit messages of @p conversation older than
+     * @p before, newest first ( range read ).
+     *
+     * Start with @p before = 0 for the latest messages, then pass
+     * out.next to get the page before; out.next is 0 once the page reaches
+     * the first message.
+     *
+     * @return false if @p before is not a message of @p conversation.
+     */
+    virtual bool fetch(const std::string &conversation,
+                       MessageId before,
+                       std::size_t limit,
+                       HistoryPage &out) = 0;
+
+    /**
+     * @brief Up to @p limit messages of @p conversation from the last one
+     * appended before any message stamped later than @p timestamp, newest
+     * first ( jump to a date ). Pass out.next to fetch() to go on back.
+     */
+    virtual void fetch_at(const std::string &conversation,
+                          std::uint64_t timestamp,
+                          std::size_t limit,
+                          HistoryPage &out) = 0;
+
+    /**
+     * @brief Call @p fn for every message not erased, oldest first within
+     * a conversation. @p fn must not call back into the engine.
+     * @return Records skipped as corrupt.
+     */
+    virtual std::uint64_t scan(
+        const std::function<void(const RecordView &)> &fn) = 0;
+
+    /**
+     * @brief scan() of the messages stamped at @p since or later; a
+     * backend may skip older stretches unread ( catching up a derived
+     * index saved at @p since ).
+     */
+    virtual std::uint64_t scan_since(
+        std::uint64_t since,
+        const std::function<void(const RecordView &)> &fn) = 0;
+
+    /**
+     * @brief Wait until every append made so far is durable ( as durable
+     * as the backend gets ).
+     * @throws std::runtime_error if that fails.
+     */
+    virtual void sync() = 0;
+};
@@ -0,0 +1,396 @@
+// history_store.hpp : append-only chat history in segment files
+#pragma once
+
+#include <cstddef>        // std::size_t
+#include <cstdint>        // ids, offsets
+#include <functional>     // compaction pacing
+#include <memory>         // shards, mappings
+#include <mutex>          // per-shard lock
+#include <string>         // conversation, payload
+#include <unordered_map>  // conversation heads
+#include <unordered_set>  // erased ids
+#include <vector>         // segments, index
+
+#include "cold_segment.hpp"    // ColdSegment
+#include "history_engine.hpp"  // HistoryEngine, MessageId, records
+#include "mapped_file.hpp"     // MappedFile
+#include "segment_file.hpp"    // SegmentFile
+
+/**
+ * @brief What one HistoryStore::compact() call did.
+ */
+struct CompactionResult {
+    std::size_t segments{0};           ///< Segments merged into one
+    std::uint64_t bytes_read{0};       ///< Records read from them
+    std::uint64_t bytes_written{0};    ///< Records written to the merge
+    std::uint64_t bytes_reclaimed{0};  ///< Disk space given back
+};
+
+/**
+ * @brief Where a HistoryStore's records are, as counted by tiers().
+ */
+struct TierStats {
+    std::size_t hot_segments{0};
+    std::uint64_t hot_records{0};  ///< Bytes of records in hot segments
+    std::size_t cold_segments{0};
+    std::uint64_t cold_records{0};      ///< Bytes of records, uncompressed
+    std::uint64_t cold_bytes{0};        ///< Bytes of the cold files
+    std::uint64_t cold_blocks_read{0};  ///< Blocks decompressed by reads
+};
+
+/**
+ * @brief Layout knobs of a HistoryStore.
+ */
+struct HistoryOptions {
+    std::size_t shards{16};                 ///< Conversation shards
+    std::uint64_t segment_bytes{64 << 20};  ///< Size of every segment file
+    std::uint32_t index_every{64};          ///< Sparse index stride
+    std::uint32_t cold_block{64 << 10};     ///< Cold block size, about
+};
+
+/**
+ * @brief Log-structured message store, the on-disk HistoryEngine.
+ *
+ * Conversations are hashed onto shards. Each shard is one append-only log
+ * cut into segment files of a fixed size ( <dir>/<shard>/<first id>.seg,
+ * preallocated ), so a message is written once, sequentially, and never
+ * moved.
+ *
+ * Record layout ( little-endian ):
+ *
+ *     u32 size | u32 crc | u64 id | u64 timestamp | u64 prev | u16 flags
+ *     | u16 conversation length | conversation | payload
+ *
+ * crc is the CRC-32C ( see crc32c() ) of everything after it. A segment
+ * is sealed when the next one starts, or when a merge writes it, by a
+ * footer in its last 16 bytes:
+ *
+ *     u64 record bytes | u32 CRC-32C of the records' crcs | u32 magic
+ *
+ * prev is the id of the conversation's previous message in the shard, so
+ * every conversation is a backward linked list threaded through the log.
+ * The shard keeps the head of each list in memory ( one entry per
+ * conversation, rebuilt on open ).
+ *
+ * erase() appends a tombstone ( flags, payload = the erased id ); the
+ * message disappears from reads at once and from disk at the next
+ * compaction. compact() rewrites a run of sealed segments into one file:
+ * erased messages, and tombstones nobody needs any more, shrink to a bare
+ * header ( a stub that keeps ids contiguous and conversation chains
+ * linked ), and small segments are merged, with their index entries
+ * rebuilt. The merged file is named <first id>-<generation>.seg and
+ * replaces its inputs atomically: after a crash, whichever complete set
+ * of files covers the log is kept. Only the planning and the swap take
+ * the shard lock, so appends and reads go on while a run is copied.
+ *
+ * Each shard keeps a sparse in-memory index: the position of every
+ * index_every-th record and of the first record of every segment. A lookup
+ * finds the closest indexed record with one binary search and scans
+ * forward at most index_every records from there. The index costs 16
+ * bytes per index_every records.
+ *
+ * Sealed segments whose records are all older than a cut can be moved to
+ * a cold tier by freeze(): the records are compressed a block of whole
+ * records at a time into a ColdSegment ( <first id>-<generation>.cold ),
+ * at the same offsets, so the index still applies. Blocks end at indexed
+ * records, so a read into cold history decompresses the one block holding
+ * the record and the indexed record before it; a fetch() or
+ * scan() walking it reuses the last few blocks ( a block failing its crc
+ * makes the read throw std::runtime_error ). Compaction reads cold
+ * segments like hot ones, and writes what it merges back hot.
+ *
+ * Reads go through a read-only memory mapping of each segment, made on
+ * first use ( segments have a fixed size, so one mapping serves a segment
+ * for good, the open one included ). view() returns the record in place:
+ * once the pages are resident, a lookup is a binary search and a pointer
+ * walk, with no system call and no copy. prefetch_before() asks the OS to
+ * page in the records before an id, for clients scrolling back.
+ *
+ * fetch() pages through a conversation backwards from a cursor: one index
+ * lookup per record, following prev. A page costs O(limit log n) whatever
+ * the age of the cursor, and only the records of the page are touched.
+ *
+ * fetch_at() jumps to a date. Each index stride also keeps the earliest
+ * timestamp of its records and the shard's clock at its end ( the latest
+ * timestamp appended so far, so ascending however skewed the senders'
+ * clocks ): 16 bytes more per index_every records. Two binary searches
+ * find the stride where the clock passes the date, one scan of at most
+ * index_every records the seq. The conversation's last record up to it
+ * is found by walking its chain back from the head and the log back a
+ * stride at a time, in step; whichever arrives first answers.
+ *
+ * Opening a store rebuilds the index by scanning the segments, checking
+ * every record's crc and every footer. An append torn by a crash ( a
+ * header that does not continue the log, or a record whose crc does not
+ * match, in the unsealed segment ) ends it: the rest of the segment is
+ * zeroed and overwritten by the next append. A bad record or footer in a
+ * sealed segment is damage, not a crash, and fails the open. Compaction
+ * and scan() check the records they read again.
+ *
+ * NOTE: Thread-safe. Shards have their own lock, so appends to different
+ * shards run in parallel. Appends are buffered; flush() hands them to the
+ * OS and sync() puts them on disk ( see HistoryWriter for doing that in
+ * groups ).
+ */
+class HistoryStore : public HistoryEngine
+{
+public:
+    /**
+     * @param dir Root directory ( created if missing ).
+     * @throws std::runtime_error if @p dir cannot be created or read, or a
+     * sealed segment is corrupt.
+     * @throws std::invalid_argument on a zero shard count, stride or cold
+     * block size, or a segment size of 4 GB or more.
+     */
+    explicit HistoryStore(std::string dir,
+                          HistoryOptions options = HistoryOptions());
+
+    ~HistoryStore() override;
+
+    // -- copy and move trait -- //
+
+    HistoryStore(const HistoryStore &) = delete;
+    HistoryStore &operator=(const HistoryStore &) = delete;
+    HistoryStore(HistoryStore &&) = delete;
+    HistoryStore &operator=(HistoryStore &&) = delete;
+
+    /**
+     * @brief Append a message to @p conversation's shard.
+     * @return Id of the new record.
+     * @throws std::invalid_argument if the record would not fit in a
+     * segment.
+     * @throws std::runtime_error if the segment cannot be written.
+     */
+    MessageId append(const std::string &conversation,
+                     const std::string &payload,
+                     std::uint64_t timestamp) override;
+
+    /**
+     * @brief Append @p batch, taking each shard's lock once for all of
+     * its messages ( see HistoryEngine::write() ).
+     */
+    void write(const std::vector<HistoryAppend> &batch,
+               std::vector<MessageId> &ids) override;
+
+    /**
+     * @brief Delete message @p id ( appends a tombstone ).
+     * @return false if there is no such message, or it is already erased.
+     * @throws std::runtime_error if the tombstone cannot be written.
+     */
+    bool erase(MessageId id) override;
+
+    /**
+     * @brief Record @p id in place ( zero-copy ).
+     * @return false if no such message exists, or it was erased.
+     */
+    bool view(MessageId id, RecordView &out) override;
+
+    /**
+     * @brief Copy of record @p id.
+     * @return false if no such message exists, or it was erased.
+     */
+    bool read(MessageId id, HistoryRecord &out) override;
+
+    /**
+     * @brief Up to @p limit messages of @p conversation older than
+     * @p before, newest first ( zero-copy, see view() ).
+     *
+     * Start with @p before = 0 for the latest messages, then pass
+     * out.next to get the page before; out.next is 0 once the page reaches
+     * the first message. The log before the page is prefetched.
+     *
+     * @return false if @p before is not a message of @p conversation.
+     */
+    bool fetch(const std::string &conversation,
+               MessageId before,
+               std::size_t limit,
+               HistoryPage &out) override;
+
+    /**
+     * @brief Up to @p limit messages of @p conversation sent at or before
+     * @p timestamp, newest first, paged as fetch() does.
+     *
+     * "At or before" as far as the shard's order goes: the page starts
+     * at the conversation's last message appended before any message of
+     * the shard stamped later than @p timestamp. Pass out.next to fetch()
+     * to go on back. Empty if nothing of @p conversation is that old.
+     */
+    void fetch_at(const std::string &conversation,
+                  std::uint64_t timestamp,
+                  std::size_t limit,
+                  HistoryPage &out) override;
+
+    /**
+     * @brief Call @p fn for every message not erased, shard by shard, in id
+     * order within a shard ( zero-copy, see view() ). Records whose crc no
+     * longer matches are skipped.
+     *
+     * NOTE: Holds each shard's lock while walking it, so @p fn must not call
+     * back into the store. Meant for rebuilding derived indexes on start.
+     *
+     * @return Records skipped as corrupt.
+     */
+    std::uint64_t scan(
+        const std::function<void(const RecordView &)> &fn) override;
+
+    /// @brief scan() that skips segments whose newest record is older
+    /// than @p since without reading them.
+    std::uint64_t scan_since(
+        std::uint64_t since,
+        const std::function<void(const RecordView &)> &fn) override;
+
+    /**
+     * @brief Start paging in about @p bytes of the shard log before record
+     * @p id ( madvise(WILLNEED) ), so reading older messages next does not
+     * fault. Returns at once.
+     */
+    void prefetch_before(MessageId id, std::size_t bytes = 256 * 1024);
+
+    /// @brief Push buffered appends of every shard to the OS.
+    void flush();
+
+    /**
+     * @brief flush(), then wait until every append made so far is on
+     * stable storage. Costs one fdatasync per shard written since the last
+     * sync.
+     * @throws std::runtime_error if a write or sync fails.
+     */
+    void sync() override;
+
+    /**
+     * @brief Compact the first run of sealed segments in @p shard worth it:
+     * one with at least @p min_garbage of its bytes erased, or several
+     * small segments that fit in one.
+     *
+     * @p pace is called with the bytes about to be read or written before
+     * each chunk ( an I/O budget sleeps in it ); returning false abandons
+     * the run. Runs one compaction at a time per store.
+     *
+     * @return false if nothing was worth compacting or the run was
+     * abandoned; @p out is filled otherwise.
+     * @throws std::runtime_error if the merged file cannot be written, or
+     * a record of the run is corrupt ( nothing is replaced ).
+     */
+    bool compact(std::size_t shard,
+                 double min_garbage,
+                 const std::function<bool(std::uint64_t)> &pace,
+                 CompactionResult &out);
+
+    /**
+     * @brief Move the oldest sealed hot segment of @p shard whose records
+     * are all older than @p older_than ( same clock as their timestamps )
+     * to the cold tier. @p pace works as in compact(), and the one
+     * compaction at a time includes freezes.
+     *
+     * A segment whose cold copy would be no smaller than its hot file is
+     * left hot, and skipped by later calls until the store is reopened.
+     *
+     * @return false if no segment qualifies or @p pace stopped it; @p out
+     * is filled otherwise ( bytes_read: records, bytes_written: the cold
+     * file; segments is 0 if the segment was left hot ).
+     * @throws std::runtime_error if the cold file cannot be written, or
+     * a record of the segment is corrupt ( nothing is replaced ).
+     */
+    bool freeze(std::size_t shard,
+                std::uint64_t older_than,
+                const std::function<bool(std::uint64_t)> &pace,
+                CompactionResult &out);
+
+    /// @brief Segments and bytes per tier, all shards.
+    TierStats tiers() const;
+
+    /// @brief Shard that stores @p conversation.
+    std::size_t shard_of(const std::string &conversation) const;
+
+    /// @brief Shards of the store.
+    std::size_t shards() const { return shards_.size(); }
+
+    /// @brief Records stored, tombstones included, all shards.
+    std::uint64_t count() const;
+
+    /// @brief Record bytes stored, all shards ( not the preallocation ).
+    std::uint64_t bytes() const;
+
+    /// @brief Bytes of erased messages not compacted yet, all shards.
+    std::uint64_t garbage() const;
+
+private:
+    /// Timestamps of one index stride ( from an index entry to the next ).
+    struct TimeBlock {
+        std::uint64_t low;    ///< Earliest timestamp in the stride
+        std::uint64_t clock;  ///< Shard clock at its end ( ascending )
+    };
+
+    struct Segment {
+        std::uint64_t first;    ///< Sequence number of its first record
+        std::string path;
+        std::uint64_t used{0};  ///< Bytes of records
+        std::shared_ptr<const MappedFile> map;  ///< Made by the first read
+        std::uint64_t dead{0};  ///< Bytes a compaction would drop
+        std::uint32_t chained{0};  ///< CRC-32C of its records' crcs
+        std::shared_ptr<const ColdSegment> cold{};  ///< Set once frozen
+        std::uint64_t newest{0};  ///< Latest timestamp of its records
+        std::vector<TimeBlock> times{};  ///< One per index entry in it
+        bool raw{false};  ///< Stays hot: its cold copy was no smaller
+    };
+
+    struct IndexEntry {
+        std::uint64_t seq;      ///< Sequence number in the shard
+        std::uint32_t segment;  ///< Index into Shard::segments
+        std::uint32_t offset;   ///< Byte offset in that segment
+    };
+
+    struct Shard {
+        mutable std::mutex mtx;
+        std::string dir;
+        std::vector<Segment> segments;
+        std::vector<IndexEntry> index;  ///< Sorted by seq
+        std::uint64_t next_seq{1};
+        SegmentFile out;        ///< Writes the last segment
+        std::string pending;    ///< Records not handed to the OS yet
+        bool unsynced{false};   ///< out was written since the last sync
+        std::unordered_map<std::string, std::uint64_t>
+            heads;  ///< conversation -> seq of its last message
+        std::unordered_set<std::uint64_t>
+            erased;  ///< Tombstoned, not yet stubs on disk
+        std::uint32_t generation{0};  ///< Of the newest merged file
+        std::uint64_t clock{0};       ///< Latest timestamp appended
+    };
+
+    void _recover(Shard &s);
+    void _roll(Shard &s);
+    void _write(Shard &s);
+    MessageId _append(Shard &s,
+                      std::size_t shard,
+                      const std::string &conversation,
+                      const std::string &payload,
+                      std::uint64_t timestamp,
+                      std::uint16_t flags);
+    static void _stamp(std::uint64_t &clock,
+                       std::vector<TimeBlock> &times,
+                       bool indexed,
+                       std::uint64_t timestamp);
+    std::uint64_t _clock_floor(Shard &s, std::uint64_t timestamp);
+    std::uint64_t _last_of(Shard &s,
+                           const std::string &conversation,
+                           std::uint64_t head,
+                           std::uint64_t last);
+    void _page(Shard &s,
+               std::size_t shard,
+               std::uint64_t seq,
+               MessageId before,
+               std::size_t limit,
+               HistoryPage &out);
+    const IndexEntry *_floor(Shard &s, std::uint64_t seq);
+    const char *_at(Segment &seg, std::uint64_t offset,
+                    std::shared_ptr<const void> &keep);
+    bool _locate(Shard &s, std::uint64_t seq, std::uint64_t &pos);
+    std::uint16_t _view_at(Shard &s, std::size_t shard, std::uint64_t pos,
+                           RecordView &out, std::uint64_t &prev);
+    const std::shared_ptr<const MappedFile> &_map(Segment &seg);
+
+    std::string dir_;
+    HistoryOptions options_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::mutex compact_mtx_;  ///< One compaction at a time
+};
@@ -0,0 +1,104 @@
+// history_writer.hpp : group commit of history appends
+#pragma once
+
+#include <atomic>              // counters
+#include <chrono>              // batch window
+#include <condition_variable>  // writer wake-up
+#include <cstddef>             // std::size_t
+#include <cstdint>             // counters
+#include <functional>          // completions
+#include <mutex>               // queue lock
+#include <string>              // conversation, payload
+#include <thread>              // writer thread
+#include <vector>              // queue, batch
+
+#include "history_engine.hpp"  // HistoryEngine, MessageId
+
+/**
+ * @brief Batching knobs of a HistoryWriter.
+ */
+struct CommitOptions {
+    std::chrono::microseconds window{500};  ///< Longest a batch stays open
+    std::size_t max_batch{4096};            ///< Appends that close it early
+};
+
+/**
+ * @brief Makes history appends durable in groups ( group commit ).
+ *
+ * Any thread queues appends; one writer thread takes everything queued,
+ * hands it to the engine as one write() and syncs once for the whole
+ * batch ( on a HistoryStore, one lock, one write and one fdatasync per
+ * shard the batch touched ). Only then do the
+ * callers' completions run, so a completion means the message is on disk.
+ * One sync costs about as much for a thousand messages as for one, which
+ * is where the throughput comes from.
+ *
+ * A batch opens with its first append and closes after window, or as soon
+ * as max_batch appends wait. Appends that arrive while a batch is synced
+ * queue for the next one, so under load batches grow with the disk's
+ * latency even with window = 0; the window trades latency for fewer syncs
+ * at low load.
+ *
+ * NOTE: Thread-safe. Completions run on the writer thread, in append
+ * order; hand real work elsewhere.
+ */
+class HistoryWriter
+{
+public:
+    /// @brief Called with the id once durable, or with 0 if it failed.
+    using done_type = std::function<void(MessageId)>;
+
+    explicit HistoryWriter(HistoryEngine &store,
+                           CommitOptions options = CommitOptions());
+
+    /**
+     * @brief Calls shutdown().
+     */
+    ~HistoryWriter();
+
+    // -- copy and move trait -- //
+
+    HistoryWriter(const HistoryWriter &) = delete;
+    HistoryWriter &operator=(const HistoryWriter &) = delete;
+    HistoryWriter(HistoryWriter &&) = delete;
+    HistoryWriter &operator=(HistoryWriter &&) = delete;
+
+    /**
+     * @brief Queue an append; @p done runs once it is durable.
+     *
+     * After shutdown() @p done runs at once, on the caller, with 0.
+     */
+    void append(std::string conversation,
+                std::string payload,
+                std::uint64_t timestamp,
+                done_type done);
+
+    /**
+     * @brief Commit what is queued, then stop the writer thread.
+     *
+     * NOTE: Safe to call more than once.
+     */
+    void shutdown();
+
+    /// @brief Batches committed ( one sync each ).
+    std::uint64_t batches() const { return batches_.load(); }
+
+    /// @brief Appends committed, failed ones included.
+    std::uint64_t appends() const { return appends_.load(); }
+
+private:
+    void _run();
+
+    HistoryEngine &store_;
+    CommitOptions options_;
+
+    std::mutex mtx_;              ///< Protects queue_, done_ and stop_
+    std::condition_variable cv_;  ///< Wakes the writer
+    std::vector<HistoryAppend> queue_;  ///< Next batch, arrival order
+    std::vector<done_type> done_;       ///< Their completions
+    bool stop_{false};
+
+    std::atomic<std::uint64_t> batches_{0};
+    std::atomic<std::uint64_t> appends_{0};
+    std::thread writer_;
+};
@@ -0,0 +1,33 @@
+// lz_block.hpp : LZ77 compression of one block of bytes
+#pragma once
+
+#include <cstddef>  // std::size_t
+#include <string>   // output
+
+/**
+ * @brief Append @p size bytes at @p data, compressed, to @p out.
+ *
+ * Format ( LZ4-like, byte oriented ): a run of sequences, each a token
+ * ( literal count high nibble, match length - 4 low nibble; 15 means more
+ * bytes follow, 255 each while they go on ), the literals, then a u16
+ * little-endian match distance and any extra length bytes. The last
+ * sequence has literals only. Matches are found through a hash of the
+ * next 4 bytes, within 64 KB back.
+ *
+ * Fast on both ends and no dictionary: chat payloads, JSON with repeated
+ * keys and names, typically shrink 2 - 4x.
+ *
+ * NOTE: Thread-safe.
+ */
+void lz_compress(const char *data, std::size_t size, std::string &out);
+
+/**
+ * @brief Decompress @p size bytes at @p data into exactly @p raw_size
+ * bytes at @p out.
+ * @return false if the input is malformed or does not decompress to
+ * @p raw_size bytes ( never reads or writes out of bounds ).
+ */
+bool lz_decompress(const char *data,
+                   std::size_t size,
+                   char *out,
+                   std::size_t raw_size);
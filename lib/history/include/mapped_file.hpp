@@ -0,0 +1,50 @@
+// mapped_file.hpp : read-only memory mapping of a whole file
+#pragma once
+
+#include <cstddef>  // std::size_t
+#include <string>   // path
+
+/**
+ * @brief Maps a file read-only for its whole lifetime ( mmap on POSIX,
+ * a file mapping view on Windows ).
+ *
+ * Writes made to the file through ordinary I/O after the mapping was
+ * created are visible through it: both go through the OS page cache.
+ *
+ * NOTE: Thread-safe for reads; the mapping never changes.
+ */
+class MappedFile
+{
+public:
+    /**
+     * @throws std::runtime_error if @p path cannot be opened or mapped.
+     */
+    explicit MappedFile(const std::string &path);
+
+    ~MappedFile();
+
+    // -- copy and move trait -- //
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&) = delete;
+    MappedFile &operator=(MappedFile &&) = delete;
+
+    const char *data() const { return data_; }
+    std::size_t size() const { return size_; }
+
+    /**
+     * @brief Ask the OS to read [@p offset, @p offset + @p len) in ahead of
+     * use ( madvise(MADV_WILLNEED) / PrefetchVirtualMemory ). Returns at
+     * once; out-of-range parts are ignored.
+     */
+    void will_need(std::size_t offset, std::size_t len) const;
+
+private:
+    const char *data_{nullptr};
+    std::size_t size_{0};
+#ifdef _WIN32
+    void *file_{nullptr};     ///< HANDLE of the file
+    void *mapping_{nullptr};  ///< HANDLE of the mapping object
+#endif
+};
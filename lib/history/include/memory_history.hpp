@@ -0,0 +1,119 @@
+// memory_history.hpp : chat history kept in memory
+#pragma once
+
+#include <cstddef>        // std::size_t
+#include <cstdint>        // ids, timestamps
+#include <functional>     // scan
+#include <memory>         // chunks
+#include <mutex>          // engine lock
+#include <string>         // conversation, payload, chunks
+#include <unordered_map>  // conversation heads
+#include <vector>         // chunks, entries
+
+#include "history_engine.hpp"  // HistoryEngine
+
+/**
+ * @brief The in-memory HistoryEngine, for tests and load generation.
+ *
+ * One log, as one shard of a HistoryStore: ids are 1, 2, 3, ... and the
+ * clock is the latest timestamp so far. Conversation and payload are
+ * packed back to back into chunks of chunk_bytes that never move once
+ * allocated, so views point into a chunk and keep it alive; a record
+ * larger than a chunk gets one of its own. Per record a 40-byte entry
+ * holds where it is and the clock, and its conversation's list its id:
+ * 48 bytes. Paging walks that list, so fetch() and fetch_at() are a
+ * binary search each, then the page.
+ *
+ * erase() only hides a message: its bytes stay until the engine goes.
+ * Nothing outlives the engine, so sync() has nothing to do.
+ *
+ * NOTE: Thread-safe. One lock for everything.
+ */
+class MemoryHistory : public HistoryEngine
+{
+public:
+    explicit MemoryHistory(std::size_t chunk_bytes = 1 << 20);
+
+    // -- copy and move trait -- //
+
+    MemoryHistory(const MemoryHistory &) = delete;
+    MemoryHistory &operator=(const MemoryHistory &) = delete;
+    MemoryHistory(MemoryHistory &&) = delete;
+    MemoryHistory &operator=(MemoryHistory &&) = delete;
+
+    /**
+     * @throws std::invalid_argument if @p conversation is over 64 KB or
+     * @p payload over 4 GB.
+     */
+    MessageId append(const std::string &conversation,
+                     const std::string &payload,
+                     std::uint64_t timestamp) override;
+
+    void write(const std::vector<HistoryAppend> &batch,
+               std::vector<MessageId> &ids) override;
+
+    bool erase(MessageId id) override;
+
+    bool view(MessageId id, RecordView &out) override;
+
+    bool read(MessageId id, HistoryRecord &out) override;
+
+    bool fetch(const std::string &conversation,
+               MessageId before,
+               std::size_t limit,
+               HistoryPage &out) override;
+
+    void fetch_at(const std::string &conversation,
+                  std::uint64_t timestamp,
+                  std::size_t limit,
+                  HistoryPage &out) override;
+
+    /// @brief Every message not erased, in id order; never any corrupt.
+    std::uint64_t scan(
+        const std::function<void(const RecordView &)> &fn) override;
+
+    std::uint64_t scan_since(
+        std::uint64_t since,
+        const std::function<void(const RecordView &)> &fn) override;
+
+    void sync() override {}
+
+    /// @brief Messages appended, erased ones included.
+    std::uint64_t count() const;
+
+    /// @brief Bytes of chunks allocated.
+    std::uint64_t bytes() const;
+
+private:
+    struct Entry {
+        std::uint32_t chunk;     ///< Index into chunks_
+        std::uint32_t offset;    ///< Of the conversation in the chunk
+        std::uint32_t conv_len;
+        std::uint32_t size;      ///< Of the payload, right after
+        std::uint64_t timestamp;
+        std::uint64_t clock;     ///< Latest timestamp up to it ( ascending )
+        bool erased;
+    };
+
+    static bool _fits(const std::string &conversation,
+                      const std::string &payload);
+    MessageId _append(const std::string &conversation,
+                      const std::string &payload,
+                      std::uint64_t timestamp);
+    void _view(std::uint64_t seq, RecordView &out) const;
+    void _page(const std::vector<std::uint64_t> &ids,
+               std::size_t end,
+               MessageId before,
+               std::size_t limit,
+               HistoryPage &out) const;
+
+    std::size_t chunk_bytes_;
+
+    mutable std::mutex mtx_;  ///< Protects everything below
+    std::vector<std::shared_ptr<std::string>> chunks_;  ///< Last one filling
+    std::vector<Entry> entries_;  ///< Entry of id i at i - 1
+    std::unordered_map<std::string, std::vector<std::uint64_t>>
+        convs_;  ///< conversation -> ids of its messages, ascending
+    std::uint64_t clock_{0};  ///< Latest timestamp appended
+    std::uint64_t bytes_{0};
+};
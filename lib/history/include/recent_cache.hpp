@@ -0,0 +1,169 @@
+// recent_cache.hpp : newest messages of active conversations, in memory
+#pragma once
+
+#include <atomic>         // counters
+#include <cstddef>        // std::size_t
+#include <cstdint>        // ids, counters
+#include <memory>         // shards
+#include <mutex>          // per-shard lock
+#include <string>         // conversations, packed payloads
+#include <string_view>    // payloads
+#include <unordered_map>  // conversation -> entry
+#include <vector>         // slots, clock ring
+
+#include "history_store.hpp"  // MessageId, HistoryRecord, RecordView
+
+/**
+ * @brief Counters of a RecentCache.
+ */
+struct RecentCacheStats {
+    std::uint64_t hits{0};
+    std::uint64_t misses{0};
+    std::uint64_t evictions{0};    ///< Conversations dropped for room
+    std::size_t conversations{0};  ///< Cached now
+    std::size_t bytes{0};          ///< Held now, bookkeeping included
+    std::size_t budget{0};
+};
+
+/**
+ * @brief Cache of the newest messages of each active conversation, so
+ * opening a chat is served from memory instead of the history segments.
+ *
+ * A conversation's entry holds its newest messages, up to
+ * per_conversation, packed in one string ( payloads back to back ) with a
+ * small slot per message. New messages are appended at the end; the
+ * oldest fall off the front, and the block is compacted once half of it
+ * is dead. An entry is always the exact tail of the conversation, so it
+ * answers any page that lies inside it.
+ *
+ * Entries are admitted on a miss ( begin_fill(), read the store, fill() )
+ * and kept current by the write path ( on_append() ). A fill that raced
+ * an append to the same conversation is dropped, so the cache never
+ * misses a message the store has.
+ *
+ * Conversations are hashed onto shards, each with its own lock and an
+ * equal part of the memory budget. A shard over budget evicts with CLOCK:
+ * the hand sweeps the shard's entries, sparing ( once ) those read since
+ * its last pass.
+ *
+ * NOTE: Thread-safe.
+ */
+class RecentCache
+{
+public:
+    /**
+     * @param budget_bytes Memory for all entries, bookkeeping included.
+     * @param per_conversation Messages kept per conversation.
+     * @param shards Lock shards ( >= 1 ).
+     * @throws std::invalid_argument on zero @p per_conversation or
+     * @p shards.
+     */
+    explicit RecentCache(std::size_t budget_bytes = 64 << 20,
+                         std::size_t per_conversation = 50,
+                         std::size_t shards = 16);
+
+    // -- copy and move trait -- //
+
+    RecentCache(const RecentCache &) = delete;
+    RecentCache &operator=(const RecentCache &) = delete;
+    RecentCache(RecentCache &&) = delete;
+    RecentCache &operator=(RecentCache &&) = delete;
+
+    /**
+     * @brief Up to @p limit messages of @p conversation older than
+     * @p before ( 0: the newest ), newest first, as HistoryStore::fetch().
+     *
+     * @param[out] out Replaced by copies of the messages.
+     * @param[out] next Cursor for the page before, 0 at the first message.
+     * @return false on a miss: the conversation is not cached, or the page
+     * reaches past what is.
+     */
+    bool get(const std::string &conversation,
+             MessageId before,
+             std::size_t limit,
+             std::vector<HistoryRecord> &out,
+             MessageId &next);
+
+    /**
+     * @brief Start admitting @p conversation after a miss; read its newest
+     * per_conversation() messages from the store, then call fill().
+     * @return Ticket for fill().
+     */
+    std::uint64_t begin_fill(const std::string &conversation);
+
+    /**
+     * @brief Admit @p conversation with @p records, its newest messages,
+     * newest first ( a HistoryStore::fetch() page ). @p complete: nothing
+     * older exists.
+     *
+     * Ignored if a message was appended to the conversation since
+     * begin_fill(), or it is cached already.
+     */
+    void fill(const std::string &conversation,
+              std::uint64_t ticket,
+              const std::vector<RecordView> &records,
+              bool complete);
+
+    /**
+     * @brief Write path: message @p id was stored in @p conversation.
+     * Appended if the conversation is cached.
+     */
+    void on_append(const std::string &conversation,
+                   MessageId id,
+                   std::uint64_t timestamp,
+                   std::string_view payload);
+
+    /// @brief Drop @p conversation ( e.g. a message of it was erased ).
+    void invalidate(const std::string &conversation);
+
+    std::size_t per_conversation() const { return per_conversation_; }
+
+    RecentCacheStats stats() const;
+
+private:
+    struct Slot {
+        MessageId id;
+        std::uint64_t timestamp;
+        std::uint32_t offset;  ///< In Entry::data
+        std::uint32_t size;
+    };
+
+    struct Entry {
+        std::string data;         ///< Payloads, oldest first
+        std::vector<Slot> slots;  ///< From slots[first], oldest first
+        std::size_t first{0};     ///< Slots before it fell off
+        bool complete{false};     ///< Holds the conversation's first message
+        bool referenced{false};   ///< Read since the hand last passed
+        std::size_t clock;        ///< Index in Shard::clock
+    };
+
+    struct Fill {
+        std::uint64_t ticket;
+        bool dirty;  ///< Appended to since begin_fill()
+    };
+
+    struct Shard {
+        std::mutex mtx;
+        std::unordered_map<std::string, Entry> entries;
+        std::vector<const std::string *> clock;  ///< Keys of entries
+        std::size_t hand{0};
+        std::size_t bytes{0};
+        std::unordered_map<std::string, Fill> filling;
+    };
+
+    Shard &_shard(const std::string &conversation);
+    std::size_t _cost(const std::string &key, const Entry &e) const;
+    void _push(Entry &e, MessageId id, std::uint64_t timestamp,
+               std::string_view payload);
+    void _evict(Shard &s);
+    void _erase(Shard &s, std::unordered_map<std::string, Entry>::iterator it);
+
+    std::size_t per_conversation_;
+    std::size_t shard_budget_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::atomic<std::uint64_t> next_ticket_{1};
+
+    std::atomic<std::uint64_t> hits_{0};
+    std::atomic<std::uint64_t> misses_{0};
+    std::atomic<std::uint64_t> evictions_{0};
+};
@@ -0,0 +1,66 @@
+// segment_file.hpp : positioned writes and data sync on one file
+#pragma once
+
+#include <cstddef>  // std::size_t
+#include <cstdint>  // offsets
+#include <string>   // path
+
+/**
+ * @brief Read-write handle on an existing file, written at explicit
+ * offsets ( pwrite on POSIX, WriteFile with an offset on Windows ).
+ *
+ * sync() forces what was written to stable storage ( fdatasync /
+ * FlushFileBuffers ), the only way to make an append survive a power cut:
+ * written data alone sits in the OS page cache.
+ *
+ * NOTE: Not thread-safe.
+ */
+class SegmentFile
+{
+public:
+    SegmentFile() = default;
+    ~SegmentFile();
+
+    // -- copy and move trait -- //
+
+    SegmentFile(const SegmentFile &) = delete;
+    SegmentFile &operator=(const SegmentFile &) = delete;
+    SegmentFile(SegmentFile &&) = delete;
+    SegmentFile &operator=(SegmentFile &&) = delete;
+
+    /**
+     * @brief Open @p path ( must exist ), closing the current file first.
+     * @throws std::runtime_error if it cannot be opened.
+     */
+    void open(const std::string &path);
+
+    void close();
+
+    bool is_open() const;
+
+    /**
+     * @brief Write all of @p data at @p offset.
+     * @throws std::runtime_error on a failed or short write.
+     */
+    void write_at(std::uint64_t offset, const char *data, std::size_t len);
+
+    /**
+     * @brief Block until everything written is on stable storage.
+     * @throws std::runtime_error if the OS reports a failure.
+     */
+    void sync();
+
+private:
+    std::string path_;
+#ifdef _WIN32
+    void *handle_{nullptr};  ///< HANDLE of the file
+#else
+    int fd_{-1};
+#endif
+};
+
+/**
+ * @brief Make the entries of directory @p path ( e.g. a new file )
+ * durable. No-op on Windows, where NTFS journals them.
+ */
+void sync_directory(const std::string &path);
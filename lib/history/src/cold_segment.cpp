@@ -0,0 +1,156 @@
+// impl for cold_segment.hpp
+
+#include "cold_segment.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+#include "crc32c.hpp"
+#include "lz_block.hpp"
+#include "segment_file.hpp"
+
+namespace
+{
+
+constexpr std::size_t kEntry = 8 + 8 + 4 + 4 + 4;
+constexpr std::size_t kFooter = 8 + 8 + 4 + 4 + 4 + 4;
+constexpr std::uint32_t kCold = 0x444C4F43;  ///< "COLD"
+
+void put(std::string &buf, std::uint64_t v, int bytes)
+{
+    for (int i = 0; i < bytes; ++i)
+        buf.push_back(static_cast<char>(v >> (8 * i)));
+}
+
+std::uint64_t get(const char *p, int bytes)
+{
+    std::uint64_t v = 0;
+    for (int i = 0; i < bytes; ++i)
+        v |= std::uint64_t{static_cast<unsigned char>(p[i])} << (8 * i);
+    return v;
+}
+
+}  // namespace
+
+bool ColdSegment::write(const std::string &path,
+                        const char *records,
+                        const std::vector<std::uint64_t> &ends,
+                        std::uint32_t chained,
+                        const std::function<bool(std::uint64_t)> &pace,
+                        std::uint64_t &bytes)
+{
+    {
+        std::ofstream create(path, std::ios::binary | std::ios::trunc);
+    }
+    SegmentFile file;
+    file.open(path);
+    std::string index, packed;
+    std::uint64_t written = 0, from = 0;
+    for (std::uint64_t end : ends) {
+        packed.clear();
+        lz_compress(records + from, static_cast<std::size_t>(end - from),
+                    packed);
+        if (!pace(end - from + packed.size()))
+            return false;
+        file.write_at(written, packed.data(), packed.size());
+        put(index, from, 8);
+        put(index, written, 8);
+        put(index, end - from, 4);
+        put(index, packed.size(), 4);
+        put(index, crc32c(packed.data(), packed.size()), 4);
+        written += packed.size();
+        from = end;
+    }
+    std::string footer;
+    put(footer, from, 8);
+    put(footer, written, 8);
+    put(footer, ends.size(), 4);
+    put(footer, chained, 4);
+    put(footer, crc32c(index.data(), index.size()), 4);
+    put(footer, kCold, 4);
+    index += footer;
+    file.write_at(written, index.data(), index.size());
+    file.sync();
+    bytes = written + index.size();
+    return true;
+}
+
+ColdSegment::ColdSegment(const std::string &path) : map_(path)
+{
+    const char *base = map_.data();
+    const std::size_t size = map_.size();
+    if (size < kFooter || get(base + size - 4, 4) != kCold)
+        throw std::runtime_error("not a cold segment " + path);
+    const char *foot = base + size - kFooter;
+    records_ = get(foot, 8);
+    const std::uint64_t at = get(foot + 8, 8);
+    const std::uint64_t blocks = get(foot + 16, 4);
+    chained_ = static_cast<std::uint32_t>(get(foot + 20, 4));
+    if (at > size - kFooter || blocks * kEntry != size - kFooter - at ||
+        crc32c(base + at, blocks * kEntry) != get(foot + 24, 4))
+        throw std::runtime_error("damaged cold segment " + path);
+
+    // blocks tile the records and the file, in order
+    std::uint64_t offset = 0, packed = 0;
+    for (std::uint64_t i = 0; i < blocks; ++i) {
+        const char *e = base + at + i * kEntry;
+        const Block b{get(e, 8), get(e + 8, 8),
+                      static_cast<std::uint32_t>(get(e + 16, 4)),
+                      static_cast<std::uint32_t>(get(e + 20, 4)),
+                      static_cast<std::uint32_t>(get(e + 24, 4))};
+        if (b.offset != offset || b.at != packed || b.size == 0)
+            throw std::runtime_error("damaged cold segment " + path);
+        offset += b.size;
+        packed += b.packed;
+        index_.push_back(b);
+    }
+    if (offset != records_ || packed != at)
+        throw std::runtime_error("damaged cold segment " + path);
+    std::fill(cached_, cached_ + kCached, index_.size());
+}
+
+std::shared_ptr<const std::string> ColdSegment::block(std::size_t i) const
+{
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        for (std::size_t k = 0; k < kCached; ++k)
+            if (cached_[k] == i)
+                return cache_[k];
+    }
+
+    // decompressed outside the lock; two readers may both do it
+    const Block &b = index_[i];
+    const char *packed = map_.data() + b.at;
+    auto raw = std::make_shared<std::string>(b.size, '\0');
+    if (crc32c(packed, b.packed) != b.crc ||
+        !lz_decompress(packed, b.packed, &(*raw)[0], b.size))
+        throw std::runtime_error("corrupt cold block");
+
+    std::lock_guard<std::mutex> lk(mtx_);
+    ++decompressed_;
+    cached_[victim_] = i;
+    cache_[victim_] = raw;
+    victim_ = (victim_ + 1) % kCached;
+    return raw;
+}
+
+const char *ColdSegment::at(std::uint64_t offset,
+                            std::shared_ptr<const void> &keep) const
+{
+    // last block starting at or before offset
+    auto it = std::upper_bound(
+        index_.begin(), index_.end(), offset,
+        [](std::uint64_t v, const Block &b) { return v < b.offset; });
+    const std::size_t i = static_cast<std::size_t>(it - index_.begin()) - 1;
+    auto raw = block(i);
+    const char *p = raw->data() + (offset - index_[i].offset);
+    keep = std::move(raw);
+    return p;
+}
+
+std::uint64_t ColdSegment::decompressed() const
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    return decompressed_;
+}
@@ -0,0 +1,198 @@
+// impl for crc32c.hpp
+
+#include "crc32c.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || \
+    defined(_M_IX86)
+#define CRC32C_X86 1
+#if defined(__x86_64__) || defined(_M_X64)
+#define CRC32C_X64 1
+#endif
+#include <nmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// the crc32 intrinsics need SSE4.2 enabled for their function only: the
+// rest of the build keeps running on CPUs without it
+#if defined(CRC32C_X86) && defined(__GNUC__)
+#define CRC32C_TARGET __attribute__((target("sse4.2")))
+#else
+#define CRC32C_TARGET
+#endif
+
+namespace
+{
+
+constexpr std::uint32_t kPoly = 0x82F63B78;  ///< Castagnoli, reflected
+
+using Update = std::uint32_t (*)(const unsigned char *,
+                                 std::size_t,
+                                 std::uint32_t);
+
+/// table[k][b]: CRC of byte b followed by k zero bytes.
+struct Tables {
+    std::uint32_t table[8][256];
+
+    Tables()
+    {
+        for (std::uint32_t b = 0; b < 256; ++b) {
+            std::uint32_t c = b;
+            for (int i = 0; i < 8; ++i)
+                c = (c >> 1) ^ (kPoly & (0u - (c & 1)));
+            table[0][b] = c;
+        }
+        for (std::uint32_t b = 0; b < 256; ++b)
+            for (int k = 1; k < 8; ++k)
+                table[k][b] = (table[k - 1][b] >> 8) ^
+                              table[0][table[k - 1][b] & 0xFF];
+    }
+};
+
+const Tables &tables()
+{
+    static const Tables t;
+    return t;
+}
+
+/// Slicing-by-8 on the inverted crc: 8 table lookups per 8 bytes.
+std::uint32_t portable(const unsigned char *p,
+                       std::size_t n,
+                       std::uint32_t crc)
+{
+    const auto &t = tables().table;
+    for (; n >= 8; p += 8, n -= 8) {
+        const std::uint32_t lo = crc ^ (std::uint32_t{p[0]} |
+                                        std::uint32_t{p[1]} << 8 |
+                                        std::uint32_t{p[2]} << 16 |
+                                        std::uint32_t{p[3]} << 24);
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^
+              t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^ t[3][p[4]] ^
+              t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+    }
+    for (; n > 0; ++p, --n)
+        crc = (crc >> 8) ^ t[0][(crc ^ *p) & 0xFF];
+    return crc;
+}
+
+#ifdef CRC32C_X64
+
+/// Bytes of each of the three streams crc32 runs side by side.
+constexpr std::size_t kStripe = 4096;
+
+/// Moves a crc past kStripe zero bytes, a byte of the crc at a time: what
+/// joins the crcs of consecutive stripes ( the crc is linear ).
+struct Shift {
+    std::uint32_t table[4][256];
+
+    Shift()
+    {
+        static const unsigned char zeros[kStripe] = {};
+        std::uint32_t column[32];
+        for (int bit = 0; bit < 32; ++bit)
+            column[bit] = portable(zeros, kStripe, std::uint32_t{1} << bit);
+        for (int k = 0; k < 4; ++k) {
+            for (std::uint32_t v = 0; v < 256; ++v) {
+                std::uint32_t c = 0;
+                for (int bit = 0; bit < 8; ++bit)
+                    if (v & (1u << bit))
+                        c ^= column[8 * k + bit];
+                table[k][v] = c;
+            }
+        }
+    }
+
+    std::uint32_t operator()(std::uint64_t crc) const
+    {
+        return table[0][crc & 0xFF] ^ table[1][(crc >> 8) & 0xFF] ^
+               table[2][(crc >> 16) & 0xFF] ^ table[3][(crc >> 24) & 0xFF];
+    }
+};
+
+std::uint64_t load(const unsigned char *p)
+{
+    std::uint64_t v;
+    std::memcpy(&v, p, 8);  // unaligned, and little-endian already
+    return v;
+}
+
+#endif
+
+#ifdef CRC32C_X86
+
+CRC32C_TARGET std::uint32_t hardware(const unsigned char *p,
+                                     std::size_t n,
+                                     std::uint32_t crc)
+{
+#ifdef CRC32C_X64
+    // crc32 takes 3 cycles but starts one a cycle: three independent
+    // streams keep it busy, then their crcs are joined
+    static const Shift shift;
+    std::uint64_t c = crc;
+    for (; n >= 3 * kStripe; p += 3 * kStripe, n -= 3 * kStripe) {
+        std::uint64_t c1 = 0, c2 = 0;
+        for (std::size_t i = 0; i < kStripe; i += 8) {
+            c = _mm_crc32_u64(c, load(p + i));
+            c1 = _mm_crc32_u64(c1, load(p + kStripe + i));
+            c2 = _mm_crc32_u64(c2, load(p + 2 * kStripe + i));
+        }
+        c = shift(shift(c) ^ c1) ^ c2;
+    }
+    for (; n >= 8; p += 8, n -= 8)
+        c = _mm_crc32_u64(c, load(p));
+    crc = static_cast<std::uint32_t>(c);
+#endif
+    for (; n > 0; ++p, --n)
+        crc = _mm_crc32_u8(crc, *p);
+    return crc;
+}
+
+bool has_sse42()
+{
+#ifdef _MSC_VER
+    int regs[4];
+    __cpuid(regs, 1);
+    return (regs[2] & (1 << 20)) != 0;  // ecx bit 20
+#else
+    return __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+#endif
+
+Update pick()
+{
+#ifdef CRC32C_X86
+    if (has_sse42())
+        return hardware;
+#endif
+    return portable;
+}
+
+Update update()
+{
+    static const Update fn = pick();
+    return fn;
+}
+
+}  // namespace
+
+std::uint32_t crc32c(const void *data, std::size_t size, std::uint32_t crc)
+{
+    return ~update()(static_cast<const unsigned char *>(data), size, ~crc);
+}
+
+std::uint32_t crc32c_portable(const void *data,
+                              std::size_t size,
+                              std::uint32_t crc)
+{
+    return ~portable(static_cast<const unsigned char *>(data), size, ~crc);
+}
+
+bool crc32c_accelerated()
+{
+    return update() != portable;
+}
@@ -0,0 +1,114 @@
+// impl for history_compactor.hpp
+
+#include "history_compactor.hpp"
+
+#include <exception>
+
+HistoryCompactor::HistoryCompactor(HistoryStore &store,
+                                   CompactionOptions options,
+                                   bool start)
+    : store_(store), options_(options)
+{
+    progress_.shards = store_.shards();
+    if (start)
+        thread_ = std::thread([this] { _run(); });
+}
+
+HistoryCompactor::~HistoryCompactor()
+{
+    stop();
+}
+
+std::size_t HistoryCompactor::run_pass()
+{
+    std::size_t runs = 0;
+    const auto pace = [this](std::uint64_t bytes) { return _pace(bytes); };
+    for (std::size_t shard = 0; shard < store_.shards(); ++shard) {
+        {
+            std::lock_guard<std::mutex> lk(mtx_);
+            if (stop_)
+                return runs;
+            progress_.shard = shard;
+        }
+        CompactionResult r;
+        while (store_.compact(shard, options_.min_garbage, pace, r)) {
+            ++runs;
+            std::lock_guard<std::mutex> lk(mtx_);
+            ++progress_.runs;
+            _count(r);
+        }
+        if (options_.cold_after.count() <= 0)
+            continue;
+        using namespace std::chrono;
+        const auto now = system_clock::now().time_since_epoch();
+        const auto age = duration_cast<milliseconds>(now) - options_.cold_after;
+        const std::uint64_t cut =
+            age.count() > 0 ? static_cast<std::uint64_t>(age.count()) : 0;
+        while (store_.freeze(shard, cut, pace, r)) {
+            ++runs;
+            std::lock_guard<std::mutex> lk(mtx_);
+            progress_.frozen += r.segments;
+            _count(r);
+        }
+    }
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (!stop_)
+        ++progress_.passes;
+    return runs;
+}
+
+void HistoryCompactor::stop()
+{
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable())
+        thread_.join();
+}
+
+CompactionProgress HistoryCompactor::progress() const
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    return progress_;
+}
+
+void HistoryCompactor::_count(const CompactionResult &r)
+{
+    progress_.bytes_read += r.bytes_read;
+    progress_.bytes_written += r.bytes_written;
+    progress_.bytes_reclaimed += r.bytes_reclaimed;
+}
+
+bool HistoryCompactor::_pace(std::uint64_t bytes)
+{
+    std::unique_lock<std::mutex> lk(mtx_);
+    if (options_.io_bytes_per_sec == 0)
+        return !stop_;
+    // token bucket: each byte pushes the point the budget is free again
+    // by 1 / rate; no burst beyond what was left unused since now
+    const auto now = std::chrono::steady_clock::now();
+    if (next_ < now)
+        next_ = now;
+    const auto wait = next_;
+    next_ += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(static_cast<double>(bytes) /
+                                      options_.io_bytes_per_sec));
+    cv_.wait_until(lk, wait, [this] { return stop_; });
+    return !stop_;
+}
+
+void HistoryCompactor::_run()
+{
+    for (;;) {
+        try {
+            run_pass();
+        } catch (const std::exception &) {
+            // disk full or the like: try again next interval
+        }
+        std::unique_lock<std::mutex> lk(mtx_);
+        if (cv_.wait_for(lk, options_.interval, [this] { return stop_; }))
+            return;
+    }
+}
@@ -0,0 +1,1254 @@
+// impl for history_store.hpp
+
+#include "history_store.hpp"
+
+#include "cold_segment.hpp"
+#include "crc32c.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <filesystem>
+#include <functional>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+/// size, crc, id, time, prev, flags, conversation length
+constexpr std::size_t kHeader = 4 + 4 + 8 + 8 + 8 + 2 + 2;
+/// records length, crc chain, magic; the last bytes of a sealed segment
+constexpr std::size_t kFooter = 8 + 4 + 4;
+constexpr std::uint32_t kSealed = 0x4C414553;  ///< "SEAL"
+constexpr int kShardBits = 48;
+constexpr std::uint64_t kSeqMask = (std::uint64_t{1} << kShardBits) - 1;
+constexpr std::size_t kFetchAhead = 256 * 1024;    ///< Prefetch per page
+constexpr std::size_t kWriteBuffer = 64 * 1024;    ///< Pending per shard
+constexpr std::size_t kCompactChunk = 256 * 1024;  ///< Merge write unit
+
+// record flags; a plain message has none
+constexpr std::uint16_t kTombstone = 1;  ///< Payload: u64 erased seq
+constexpr std::uint16_t kStub = 2;       ///< Payload dropped by compaction
+
+/// Record position in a shard: segment index high, byte offset low.
+std::uint64_t position(std::size_t segment, std::uint64_t offset)
+{
+    return (std::uint64_t{segment} << 32) | offset;
+}
+
+void put(std::string &buf, std::uint64_t v, int bytes)
+{
+    for (int i = 0; i < bytes; ++i)
+        buf.push_back(static_cast<char>(v >> (8 * i)));
+}
+
+std::uint64_t get(const char *p, int bytes)
+{
+    std::uint64_t v = 0;
+    for (int i = 0; i < bytes; ++i)
+        v |= std::uint64_t{static_cast<unsigned char>(p[i])} << (8 * i);
+    return v;
+}
+
+struct Header {
+    std::uint32_t size;
+    std::uint32_t crc;  ///< CRC-32C of the record after this field
+    std::uint64_t seq;
+    std::uint64_t timestamp;
+    std::uint64_t prev;
+    std::uint16_t flags;
+    std::uint16_t conv_len;
+};
+
+Header decode(const char *p)
+{
+    return Header{static_cast<std::uint32_t>(get(p, 4)),
+                  static_cast<std::uint32_t>(get(p + 4, 4)), get(p + 8, 8),
+                  get(p + 16, 8), get(p + 24, 8),
+                  static_cast<std::uint16_t>(get(p + 32, 2)),
+                  static_cast<std::uint16_t>(get(p + 34, 2))};
+}
+
+/// Header with its crc left to seal().
+void encode(std::string &buf, const Header &h)
+{
+    put(buf, h.size, 4);
+    put(buf, 0, 4);
+    put(buf, h.seq, 8);
+    put(buf, h.timestamp, 8);
+    put(buf, h.prev, 8);
+    put(buf, h.flags, 2);
+    put(buf, h.conv_len, 2);
+}
+
+/// CRC-32C a record of @p size bytes at @p rec should carry.
+std::uint32_t record_crc(const char *rec, std::uint64_t size)
+{
+    return crc32c(rec + 8, static_cast<std::size_t>(size - 8));
+}
+
+/// Fill in the crc of the record from @p at to the end of @p buf.
+std::uint32_t seal(std::string &buf, std::size_t at)
+{
+    const std::uint32_t crc = record_crc(&buf[at], buf.size() - at);
+    for (int i = 0; i < 4; ++i)
+        buf[at + 4 + i] = static_cast<char>(crc >> (8 * i));
+    return crc;
+}
+
+/// A segment's footer checksums the crcs of its records, in order.
+std::uint32_t chain(std::uint32_t chained, std::uint32_t crc)
+{
+    const unsigned char le[4] = {
+        static_cast<unsigned char>(crc), static_cast<unsigned char>(crc >> 8),
+        static_cast<unsigned char>(crc >> 16),
+        static_cast<unsigned char>(crc >> 24)};
+    return crc32c(le, 4, chained);
+}
+
+std::string footer(std::uint64_t used, std::uint32_t chained)
+{
+    std::string buf;
+    put(buf, used, 8);
+    put(buf, chained, 4);
+    put(buf, kSealed, 4);
+    return buf;
+}
+
+/// <first>.seg, or <first>-<generation>.seg for a merged segment
+/// ( .cold for a cold one ).
+std::string segment_name(std::uint64_t first,
+                         std::uint32_t generation,
+                         const char *ext = ".seg")
+{
+    char name[48];
+    if (generation == 0)
+        std::snprintf(name, sizeof(name), "%020llu%s",
+                      static_cast<unsigned long long>(first), ext);
+    else
+        std::snprintf(name, sizeof(name), "%020llu-%06u%s",
+                      static_cast<unsigned long long>(first), generation,
+                      ext);
+    return name;
+}
+
+/// @return false if @p path is not a segment_name().
+bool parse_name(const fs::path &path,
+                std::uint64_t &first,
+                std::uint32_t &generation,
+                bool &cold)
+{
+    const std::string stem = path.stem().string();
+    cold = path.extension() == ".cold";
+    if ((!cold && path.extension() != ".seg") || stem.size() < 20 ||
+        (stem.size() > 20 && stem[20] != '-'))
+        return false;
+    first = std::strtoull(stem.substr(0, 20).c_str(), nullptr, 10);
+    generation = stem.size() > 21 ? static_cast<std::uint32_t>(std::strtoul(
+                                        stem.c_str() + 21, nullptr, 10))
+                                  : 0;
+    return true;
+}
+
+/// Overwrite [from, end of file) with zeros.
+void zero_tail(const std::string &path, std::uint64_t from)
+{
+    std::error_code ec;
+    const std::uint64_t end = fs::file_size(path, ec);
+    if (ec || from >= end)
+        return;
+    std::fstream f(path, std::ios::binary | std::ios::in | std::ios::out);
+    f.seekp(static_cast<std::streamoff>(from));
+    const std::string zeros(64 * 1024, '\0');
+    for (std::uint64_t left = end - from; left > 0 && f;) {
+        const auto n = std::min<std::uint64_t>(left, zeros.size());
+        f.write(zeros.data(), static_cast<std::streamsize>(n));
+        left -= n;
+    }
+}
+
+}  // namespace
+
+HistoryStore::HistoryStore(std::string dir, HistoryOptions options)
+    : dir_(std::move(dir)), options_(options)
+{
+    if (options_.shards == 0 || options_.shards > 0xFFFF ||
+        options_.index_every == 0 ||
+        options_.segment_bytes < kHeader + kFooter ||
+        options_.segment_bytes > 0xFFFFFFFF || options_.cold_block == 0)
+        throw std::invalid_argument("bad HistoryStore options");
+
+    for (std::size_t i = 0; i < options_.shards; ++i) {
+        auto s = std::make_unique<Shard>();
+        char name[24];
+        std::snprintf(name, sizeof(name), "%04zx", i);
+        s->dir = (fs::path(dir_) / name).string();
+        std::error_code ec;
+        fs::create_directories(s->dir, ec);
+        if (ec || !fs::is_directory(s->dir))
+            throw std::runtime_error("cannot create history directory " +
+                                     s->dir);
+        _recover(*s);
+        shards_.push_back(std::move(s));
+    }
+}
+
+HistoryStore::~HistoryStore()
+{
+    try {
+        flush();
+    } catch (const std::exception &) {
+        // nothing left to report to
+    }
+}
+
+MessageId HistoryStore::append(const std::string &conversation,
+                               const std::string &payload,
+                               std::uint64_t timestamp)
+{
+    const std::uint64_t size =
+        kHeader + conversation.size() + payload.size();
+    if (conversation.size() > 0xFFFF ||
+        size > options_.segment_bytes - kFooter)
+        throw std::invalid_argument("history record too large");
+
+    const std::size_t shard = shard_of(conversation);
+    Shard &s = *shards_[shard];
+    std::lock_guard<std::mutex> lk(s.mtx);
+    return _append(s, shard, conversation, payload, timestamp, 0);
+}
+
+void HistoryStore::write(const std::vector<HistoryAppend> &batch,
+                         std::vector<MessageId> &ids)
+{
+    // messages by shard, in batch order within each
+    std::vector<std::vector<std::size_t>> by_shard(shards_.size());
+    for (std::size_t i = 0; i < batch.size(); ++i)
+        by_shard[shard_of(batch[i].conversation)].push_back(i);
+
+    ids.assign(batch.size(), 0);
+    for (std::size_t shard = 0; shard < shards_.size(); ++shard) {
+        if (by_shard[shard].empty())
+            continue;
+        Shard &s = *shards_[shard];
+        std::lock_guard<std::mutex> lk(s.mtx);
+        for (std::size_t i : by_shard[shard]) {
+            const HistoryAppend &m = batch[i];
+            if (m.conversation.size() > 0xFFFF ||
+                kHeader + m.conversation.size() + m.payload.size() >
+                    options_.segment_bytes - kFooter)
+                continue;  // too large: this one fails alone
+            try {
+                ids[i] = _append(s, shard, m.conversation, m.payload,
+                                 m.timestamp, 0);
+            } catch (const std::exception &) {
+                // disk full: so does this one
+            }
+        }
+    }
+}
+
+bool HistoryStore::erase(MessageId id)
+{
+    const std::size_t shard = static_cast<std::size_t>(id >> kShardBits);
+    if (shard >= shards_.size())
+        return false;
+    Shard &s = *shards_[shard];
+    const std::uint64_t seq = id & kSeqMask;
+    std::lock_guard<std::mutex> lk(s.mtx);
+    std::uint64_t pos, prev;
+    RecordView v;
+    if (s.erased.count(seq) != 0 || !_locate(s, seq, pos) ||
+        _view_at(s, shard, pos, v, prev) != 0)
+        return false;
+
+    std::string target;
+    put(target, seq, 8);
+    _append(s, shard, std::string(), target, v.timestamp, kTombstone);
+    s.segments[static_cast<std::size_t>(pos >> 32)].dead += v.payload.size();
+    s.erased.insert(seq);
+    return true;
+}
+
+bool HistoryStore::view(MessageId id, RecordView &out)
+{
+    const std::size_t shard = static_cast<std::size_t>(id >> kShardBits);
+    if (shard >= shards_.size())
+        return false;
+    Shard &s = *shards_[shard];
+    const std::uint64_t seq = id & kSeqMask;
+    std::lock_guard<std::mutex> lk(s.mtx);
+    std::uint64_t pos, prev;
+    return _locate(s, seq, pos) && _view_at(s, shard, pos, out, prev) == 0 &&
+           s.erased.count(seq) == 0;
+}
+
+bool HistoryStore::fetch(const std::string &conversation,
+                         MessageId before,
+                         std::size_t limit,
+                         HistoryPage &out)
+{
+    out.records.clear();
+    out.next = 0;
+    const std::size_t shard = shard_of(conversation);
+    Shard &s = *shards_[shard];
+    std::lock_guard<std::mutex> lk(s.mtx);
+
+    std::uint64_t seq, pos;  // seq: next record to visit, 0 at the start
+    RecordView v;
+    if (before == 0) {
+        auto head = s.heads.find(conversation);
+        if (head == s.heads.end())
+            return true;  // nothing said yet
+        seq = head->second;
+    } else {
+        // an erased message is still a cursor: its stub keeps the link
+        if ((before >> kShardBits) != shard ||
+            !_locate(s, before & kSeqMask, pos) ||
+            (_view_at(s, shard, pos, v, seq) & kTombstone) != 0 ||
+            v.conversation != conversation)
+            return false;
+    }
+
+    _page(s, shard, seq, before, limit, out);
+    return true;
+}
+
+void HistoryStore::fetch_at(const std::string &conversation,
+                            std::uint64_t timestamp,
+                            std::size_t limit,
+                            HistoryPage &out)
+{
+    out.records.clear();
+    out.next = 0;
+    const std::size_t shard = shard_of(conversation);
+    Shard &s = *shards_[shard];
+    std::lock_guard<std::mutex> lk(s.mtx);
+    auto head = s.heads.find(conversation);
+    if (head == s.heads.end())
+        return;  // nothing said yet
+    _write(s);
+
+    // where the shard's clock passed timestamp, then the conversation's
+    // last record up to there
+    const std::uint64_t seq = _last_of(s, conversation, head->second,
+                                       _clock_floor(s, timestamp));
+    if (seq != 0)
+        _page(s, shard, seq, (std::uint64_t{shard} << kShardBits) | seq,
+              limit, out);
+}
+
+void HistoryStore::_page(Shard &s,
+                         std::size_t shard,
+                         std::uint64_t seq,
+                         MessageId before,
+                         std::size_t limit,
+                         HistoryPage &out)
+{
+    // one lookup per record, back through the conversation's own records
+    std::uint64_t pos;
+    RecordView v;
+    while (seq != 0 && out.records.size() < limit && _locate(s, seq, pos)) {
+        if (_view_at(s, shard, pos, v, seq) == 0 &&
+            s.erased.count(v.id & kSeqMask) == 0)
+            out.records.push_back(v);
+    }
+    if (seq == 0 || !_locate(s, seq, pos))
+        return;
+    out.next = out.records.empty() ? before : out.records.back().id;
+
+    // the next page starts at pos and most likely lies just before it
+    Segment &seg = s.segments[static_cast<std::size_t>(pos >> 32)];
+    const std::uint64_t off = pos & 0xFFFFFFFF;
+    const std::uint64_t from = off > kFetchAhead ? off - kFetchAhead : 0;
+    if (!seg.cold)  // a cold block is read whole anyway
+        _map(seg)->will_need(from, off - from + kHeader);
+}
+
+bool HistoryStore::read(MessageId id, HistoryRecord &out)
+{
+    RecordView v;
+    if (!view(id, v))
+        return false;
+    out.id = v.id;
+    out.timestamp = v.timestamp;
+    out.conversation.assign(v.conversation.data(), v.conversation.size());
+    out.payload.assign(v.payload.data(), v.payload.size());
+    return true;
+}
+
+std::uint64_t HistoryStore::scan(
+    const std::function<void(const RecordView &)> &fn)
+{
+    return scan_since(0, fn);
+}
+
+std::uint64_t HistoryStore::scan_since(
+    std::uint64_t since,
+    const std::function<void(const RecordView &)> &fn)
+{
+    std::uint64_t corrupt = 0;
+    for (std::size_t shard = 0; shard < shards_.size(); ++shard) {
+        Shard &s = *shards_[shard];
+        std::lock_guard<std::mutex> lk(s.mtx);
+        _write(s);
+        RecordView v;
+        std::uint64_t prev;
+        for (std::size_t i = 0; i < s.segments.size(); ++i) {
+            Segment &seg = s.segments[i];
+            if (seg.newest < since)
+                continue;  // not even mapped, or a cold block read
+            std::shared_ptr<const void> keep;
+            for (std::uint64_t off = 0; off < seg.used;) {
+                const std::uint64_t pos = position(i, off);
+                const char *rec = _at(seg, off, keep);
+                const Header h = decode(rec);
+                off += h.size;
+                if (record_crc(rec, h.size) != h.crc)
+                    ++corrupt;
+                else if (h.timestamp >= since &&
+                         _view_at(s, shard, pos, v, prev) == 0 &&
+                         s.erased.count(v.id & kSeqMask) == 0)
+                    fn(v);
+            }
+        }
+    }
+    return corrupt;
+}
+
+void HistoryStore::prefetch_before(MessageId id, std::size_t bytes)
+{
+    const std::size_t shard = static_cast<std::size_t>(id >> kShardBits);
+    if (shard >= shards_.size())
+        return;
+    Shard &s = *shards_[shard];
+    std::lock_guard<std::mutex> lk(s.mtx);
+    const IndexEntry *e = _floor(s, id & kSeqMask);
+    if (!e)
+        return;
+    // the stretch before the record, spilling into the previous segment;
+    // cold segments are read a block at a time, on demand
+    const std::uint64_t off = e->offset;
+    if (!s.segments[e->segment].cold)
+        _map(s.segments[e->segment])
+            ->will_need(off > bytes ? off - bytes : 0, bytes);
+    if (off < bytes && e->segment > 0 && !s.segments[e->segment - 1].cold) {
+        Segment &prev = s.segments[e->segment - 1];
+        const std::uint64_t rest = bytes - off;
+        _map(prev)->will_need(prev.used > rest ? prev.used - rest : 0, rest);
+    }
+}
+
+void HistoryStore::flush()
+{
+    for (auto &s : shards_) {
+        std::lock_guard<std::mutex> lk(s->mtx);
+        _write(*s);
+    }
+}
+
+void HistoryStore::sync()
+{
+    for (auto &s : shards_) {
+        std::lock_guard<std::mutex> lk(s->mtx);
+        _write(*s);
+        if (s->unsynced) {
+            s->out.sync();
+            s->unsynced = false;
+        }
+    }
+}
+
+bool HistoryStore::compact(std::size_t shard,
+                           double min_garbage,
+                           const std::function<bool(std::uint64_t)> &pace,
+                           CompactionResult &out)
+{
+    out = CompactionResult();
+    if (shard >= shards_.size())
+        return false;
+    std::lock_guard<std::mutex> one(compact_mtx_);
+    Shard &s = *shards_[shard];
+
+    // plan under the lock: the run is [a, a + k), sealed segments only
+    std::size_t a = 0, k = 0;
+    std::vector<Segment> inputs;
+    std::unordered_set<std::uint64_t> erased;
+    std::uint32_t generation;
+    std::uint64_t clock = 0;  ///< Shard clock before the run
+    {
+        std::lock_guard<std::mutex> lk(s.mtx);
+        const std::size_t sealed =
+            s.segments.empty() ? 0 : s.segments.size() - 1;
+        for (; a < sealed; ++a) {
+            std::uint64_t live = 0;
+            std::size_t n = 0;
+            bool garbage = false;
+            for (; a + n < sealed; ++n) {
+                const Segment &seg = s.segments[a + n];
+                const std::uint64_t seg_live = seg.used - seg.dead;
+                if (n > 0 &&
+                    live + seg_live > options_.segment_bytes - kFooter)
+                    break;
+                live += seg_live;
+                garbage = garbage || (seg.dead > 0 &&
+                                      seg.dead >= min_garbage * seg.used);
+            }
+            if (garbage || n >= 2) {
+                k = n;
+                break;
+            }
+        }
+        if (k == 0)
+            return false;
+        for (std::size_t i = a; i < a + k; ++i) {
+            if (!s.segments[i].cold)
+                _map(s.segments[i]);  // keeps the bytes once the file is gone
+            inputs.push_back(s.segments[i]);
+        }
+        erased = s.erased;
+        generation = ++s.generation;
+        if (a > 0)
+            clock = s.segments[a - 1].times.back().clock;
+    }
+
+    // copy without the lock: sealed segments never change
+    const std::uint64_t first = inputs.front().first;
+    const std::string path =
+        (fs::path(s.dir) / segment_name(first, generation)).string();
+    const std::string tmp = path + ".compact";
+    std::uint64_t on_disk = 0, newest = 0;
+    for (const auto &seg : inputs) {
+        std::error_code ec;
+        on_disk += fs::file_size(seg.path, ec);
+        newest = std::max(newest, seg.newest);
+    }
+
+    std::vector<IndexEntry> index;
+    std::vector<TimeBlock> times;        ///< Rebuilt on the new strides
+    std::vector<std::uint64_t> stubbed;  ///< Erased messages dropped
+    std::uint64_t dropped = 0;           ///< Their payload bytes
+    std::uint64_t written = 0;
+    std::uint32_t chained = 0;  ///< Of the merged records
+    bool paced = true;
+    SegmentFile file;
+    try {
+        {
+            std::ofstream create(tmp, std::ios::binary | std::ios::trunc);
+        }
+        file.open(tmp);
+        std::string buf;
+        std::uint64_t read = 0;
+        auto put_chunk = [&] {
+            if (!pace(read + buf.size()))
+                return false;
+            file.write_at(written, buf.data(), buf.size());
+            out.bytes_read += read;
+            out.bytes_written += buf.size();
+            written += buf.size();
+            buf.clear();
+            read = 0;
+            return true;
+        };
+        for (std::size_t i = 0; i < inputs.size() && paced; ++i) {
+            const Segment &seg = inputs[i];
+            std::string thawed;  // a cold segment's records, decompressed
+            if (seg.cold) {
+                thawed.reserve(static_cast<std::size_t>(seg.used));
+                for (std::size_t b = 0; b < seg.cold->blocks(); ++b)
+                    thawed += *seg.cold->block(b);
+            }
+            const char *base = seg.cold ? thawed.data() : seg.map->data();
+            for (std::uint64_t off = 0; off < seg.used && paced;) {
+                const Header h = decode(base + off);
+                const char *body = base + off + kHeader;
+                // a damaged record must not end up under a fresh footer
+                if (record_crc(base + off, h.size) != h.crc)
+                    throw std::runtime_error("corrupt history record in " +
+                                             seg.path);
+                const std::uint64_t at = written + buf.size();
+                const bool indexed =
+                    at == 0 || (h.seq - 1) % options_.index_every == 0;
+                if (indexed)
+                    index.push_back(IndexEntry{
+                        h.seq, static_cast<std::uint32_t>(a),
+                        static_cast<std::uint32_t>(at)});
+                _stamp(clock, times, indexed, h.timestamp);
+
+                bool stub = false;
+                if (h.flags == 0 && erased.count(h.seq) != 0) {
+                    stub = true;
+                    stubbed.push_back(h.seq);
+                    dropped += h.size - kHeader - h.conv_len;
+                } else if (h.flags == kTombstone) {
+                    // needed until its message is a stub: now, or earlier
+                    const std::uint64_t target = get(body + h.conv_len, 8);
+                    stub = target >= first || erased.count(target) == 0;
+                }
+                if (stub) {
+                    Header kept = h;
+                    kept.size =
+                        static_cast<std::uint32_t>(kHeader + h.conv_len);
+                    kept.flags |= kStub;
+                    const std::size_t at = buf.size();
+                    encode(buf, kept);
+                    buf.append(body, h.conv_len);
+                    chained = chain(chained, seal(buf, at));
+                } else {
+                    buf.append(base + off, h.size);
+                    chained = chain(chained, h.crc);
+                }
+                read += h.size;
+                off += h.size;
+                if (buf.size() >= kCompactChunk)
+                    paced = put_chunk();
+            }
+        }
+        if (paced && !buf.empty())
+            paced = put_chunk();
+        if (paced) {
+            const std::string foot = footer(written, chained);
+            file.write_at(written, foot.data(), foot.size());
+            file.sync();
+        }
+        file.close();
+    } catch (const std::exception &) {
+        file.close();
+        std::error_code ec;
+        fs::remove(tmp, ec);
+        throw;
+    }
+    std::error_code ec;
+    if (!paced) {
+        fs::remove(tmp, ec);
+        return false;
+    }
+    fs::rename(tmp, path, ec);
+    if (ec) {
+        fs::remove(tmp, ec);
+        throw std::runtime_error("cannot install segment " + path);
+    }
+    sync_directory(s.dir);  // from here on, a restart keeps the merge
+
+    {
+        std::lock_guard<std::mutex> lk(s.mtx);
+        std::uint64_t dead = 0;  // includes messages erased meanwhile
+        for (std::size_t i = a; i < a + k; ++i)
+            dead += s.segments[i].dead;
+        s.segments[a] = Segment{first, path, written, nullptr, dead - dropped,
+                                chained, nullptr, newest, std::move(times)};
+        s.segments.erase(s.segments.begin() + a + 1,
+                         s.segments.begin() + a + k);
+
+        // the run's index entries out, the merge's in, later ones shifted
+        auto by_seq = [](const IndexEntry &e, std::uint64_t seq) {
+            return e.seq < seq;
+        };
+        auto lo =
+            std::lower_bound(s.index.begin(), s.index.end(), first, by_seq);
+        auto hi = std::lower_bound(lo, s.index.end(),
+                                   s.segments[a + 1].first, by_seq);
+        for (auto it = hi; it != s.index.end(); ++it)
+            it->segment -= static_cast<std::uint32_t>(k - 1);
+        hi = s.index.erase(lo, hi);
+        s.index.insert(hi, index.begin(), index.end());
+
+        for (std::uint64_t seq : stubbed)
+            s.erased.erase(seq);
+    }
+
+    // views may still map the inputs; where a mapped file cannot be
+    // removed ( Windows ), the next open drops it as covered by the merge
+    for (const auto &seg : inputs)
+        fs::remove(seg.path, ec);
+    out.segments = k;
+    out.bytes_reclaimed =
+        on_disk > written + kFooter ? on_disk - written - kFooter : 0;
+    return true;
+}
+
+bool HistoryStore::freeze(std::size_t shard,
+                          std::uint64_t older_than,
+                          const std::function<bool(std::uint64_t)> &pace,
+                          CompactionResult &out)
+{
+    out = CompactionResult();
+    if (shard >= shards_.size())
+        return false;
+    std::lock_guard<std::mutex> one(compact_mtx_);
+    Shard &s = *shards_[shard];
+
+    // the oldest sealed segment still hot, every record before the cut
+    std::size_t i = 0;
+    Segment seg{};
+    std::uint32_t generation;
+    {
+        std::lock_guard<std::mutex> lk(s.mtx);
+        const std::size_t sealed =
+            s.segments.empty() ? 0 : s.segments.size() - 1;
+        while (i < sealed && (s.segments[i].cold || s.segments[i].raw ||
+                              s.segments[i].newest >= older_than))
+            ++i;
+        if (i == sealed)
+            return false;
+        _map(s.segments[i]);  // keeps the bytes once the file is gone
+        seg = s.segments[i];
+        generation = ++s.generation;
+    }
+
+    // blocks end at indexed records: a lookup scans on from one, so it
+    // stays in one block and decompresses just that. A damaged record must
+    // not be sealed into a block with a fresh crc
+    const char *base = seg.map->data();
+    std::vector<std::uint64_t> ends;
+    std::uint64_t from = 0, mark = 0;  // block start, last indexed record
+    for (std::uint64_t off = 0; off < seg.used;) {
+        const Header h = decode(base + off);
+        if (record_crc(base + off, h.size) != h.crc)
+            throw std::runtime_error("corrupt history record in " + seg.path);
+        if ((h.seq - 1) % options_.index_every == 0) {
+            // cut if one more stride like the last would overflow
+            if (off > from && 2 * off - from - mark > options_.cold_block) {
+                ends.push_back(off);
+                from = off;
+            }
+            mark = off;
+        }
+        off += h.size;
+    }
+    ends.push_back(seg.used);
+
+    const std::string path =
+        (fs::path(s.dir) / segment_name(seg.first, generation, ".cold"))
+            .string();
+    const std::string tmp = path + ".compact";
+    std::uint64_t written = 0;
+    bool paced;
+    try {
+        paced = ColdSegment::write(tmp, base, ends, seg.chained, pace,
+                                   written);
+    } catch (const std::exception &) {
+        std::error_code ec;
+        fs::remove(tmp, ec);
+        throw;
+    }
+    std::error_code ec;
+    if (!paced) {
+        fs::remove(tmp, ec);
+        return false;
+    }
+    const std::uint64_t on_disk = fs::file_size(seg.path, ec);
+    if (!ec && written >= on_disk) {
+        // compression did not pay: the hot file stays, and is not retried
+        fs::remove(tmp, ec);
+        std::lock_guard<std::mutex> lk(s.mtx);
+        s.segments[i].raw = true;
+        out.bytes_read = seg.used;
+        return true;
+    }
+    fs::rename(tmp, path, ec);
+    if (ec) {
+        fs::remove(tmp, ec);
+        throw std::runtime_error("cannot install segment " + path);
+    }
+    sync_directory(s.dir);  // from here on, a restart reads the cold copy
+    auto cold = std::make_shared<const ColdSegment>(path);
+
+    // offsets are unchanged: the index stays as it is
+    {
+        std::lock_guard<std::mutex> lk(s.mtx);
+        Segment &now = s.segments[i];
+        now.path = path;
+        now.map = nullptr;
+        now.cold = std::move(cold);
+    }
+    fs::remove(seg.path, ec);  // as after a merge, see compact()
+    out.segments = 1;
+    out.bytes_read = seg.used;
+    out.bytes_written = written;
+    out.bytes_reclaimed = on_disk > written ? on_disk - written : 0;
+    return true;
+}
+
+TierStats HistoryStore::tiers() const
+{
+    TierStats t;
+    for (const auto &s : shards_) {
+        std::lock_guard<std::mutex> lk(s->mtx);
+        for (const auto &seg : s->segments) {
+            if (seg.cold) {
+                ++t.cold_segments;
+                t.cold_records += seg.used;
+                t.cold_bytes += seg.cold->file_bytes();
+                t.cold_blocks_read += seg.cold->decompressed();
+            } else {
+                ++t.hot_segments;
+                t.hot_records += seg.used;
+            }
+        }
+    }
+    return t;
+}
+
+std::size_t HistoryStore::shard_of(const std::string &conversation) const
+{
+    return std::hash<std::string>{}(conversation) % shards_.size();
+}
+
+std::uint64_t HistoryStore::count() const
+{
+    std::uint64_t n = 0;
+    for (const auto &s : shards_) {
+        std::lock_guard<std::mutex> lk(s->mtx);
+        n += s->next_seq - 1;
+    }
+    return n;
+}
+
+std::uint64_t HistoryStore::bytes() const
+{
+    std::uint64_t n = 0;
+    for (const auto &s : shards_) {
+        std::lock_guard<std::mutex> lk(s->mtx);
+        for (const auto &seg : s->segments)
+            n += seg.used;
+    }
+    return n;
+}
+
+std::uint64_t HistoryStore::garbage() const
+{
+    std::uint64_t n = 0;
+    for (const auto &s : shards_) {
+        std::lock_guard<std::mutex> lk(s->mtx);
+        for (const auto &seg : s->segments)
+            n += seg.dead;
+    }
+    return n;
+}
+
+MessageId HistoryStore::_append(Shard &s,
+                                std::size_t shard,
+                                const std::string &conversation,
+                                const std::string &payload,
+                                std::uint64_t timestamp,
+                                std::uint16_t flags)
+{
+    const std::uint64_t size =
+        kHeader + conversation.size() + payload.size();
+    if (!s.out.is_open() ||
+        s.segments.back().used + size > options_.segment_bytes - kFooter)
+        _roll(s);
+    Segment &seg = s.segments.back();
+    const std::uint64_t seq = s.next_seq;
+
+    std::uint64_t prev = 0;
+    if (flags == 0) {  // a tombstone is in no conversation
+        auto head = s.heads.find(conversation);
+        if (head == s.heads.end()) {
+            s.heads.emplace(conversation, seq);
+        } else {
+            prev = head->second;
+            head->second = seq;
+        }
+    }
+    const std::size_t at = s.pending.size();
+    encode(s.pending,
+           Header{static_cast<std::uint32_t>(size), 0, seq, timestamp, prev,
+                  flags, static_cast<std::uint16_t>(conversation.size())});
+    s.pending += conversation;
+    s.pending += payload;
+    seg.chained = chain(seg.chained, seal(s.pending, at));
+
+    // the first record of a segment is always indexed, so a scan never
+    // crosses a segment boundary
+    const bool indexed =
+        seg.used == 0 || (seq - 1) % options_.index_every == 0;
+    if (indexed)
+        s.index.push_back(
+            IndexEntry{seq, static_cast<std::uint32_t>(s.segments.size() - 1),
+                       static_cast<std::uint32_t>(seg.used)});
+    _stamp(s.clock, seg.times, indexed, timestamp);
+    seg.used += size;
+    seg.newest = std::max(seg.newest, timestamp);
+    ++s.next_seq;
+    if (s.pending.size() >= kWriteBuffer)
+        _write(s);
+    return (std::uint64_t{shard} << kShardBits) | seq;
+}
+
+void HistoryStore::_recover(Shard &s)
+{
+    struct File {
+        std::uint64_t first;
+        std::uint32_t generation;
+        std::string path;
+        bool cold;
+    };
+    std::vector<File> files;
+    for (const auto &f : fs::directory_iterator(s.dir)) {
+        File file{0, 0, f.path().string(), false};
+        std::error_code ec;
+        if (f.path().extension() == ".compact")  // rewrite cut short
+            fs::remove(f.path(), ec);
+        else if (parse_name(f.path(), file.first, file.generation, file.cold))
+            files.push_back(std::move(file));
+    }
+    // by first id; a merge ( or a cold copy ) ahead of what it replaced
+    std::sort(files.begin(), files.end(), [](const File &x, const File &y) {
+        return x.first != y.first ? x.first < y.first
+                                  : x.generation > y.generation;
+    });
+
+    char head[kHeader];
+    char foot[kFooter];
+    std::string body;
+    std::vector<std::uint64_t> tombstones;
+    bool ended = false;
+    bool last_sealed = false;  ///< The last segment kept has its footer
+    for (const auto &file : files) {
+        s.generation = std::max(s.generation, file.generation);
+        std::error_code ec;
+        // after a damaged segment: unreachable; before next_seq: replaced
+        // by a merge, but not removed yet
+        if (ended || file.first < s.next_seq) {
+            fs::remove(file.path, ec);
+            continue;
+        }
+        Segment seg{s.next_seq, file.path, 0, nullptr, 0};
+
+        // a record that continues the log
+        auto take = [&](const Header &h, const char *rest) {
+            if (h.flags == kTombstone && h.size >= kHeader + h.conv_len + 8u)
+                tombstones.push_back(get(rest + h.conv_len, 8));
+            else if ((h.flags & kTombstone) == 0)
+                s.heads[std::string(rest, h.conv_len)] = h.seq;
+            const bool indexed =
+                seg.used == 0 || (h.seq - 1) % options_.index_every == 0;
+            if (indexed)
+                s.index.push_back(IndexEntry{
+                    h.seq, static_cast<std::uint32_t>(s.segments.size()),
+                    static_cast<std::uint32_t>(seg.used)});
+            _stamp(s.clock, seg.times, indexed, h.timestamp);
+            seg.used += h.size;
+            seg.chained = chain(seg.chained, h.crc);
+            seg.newest = std::max(seg.newest, h.timestamp);
+            ++s.next_seq;
+        };
+
+        // a cold segment is sealed, whole, and decompressed block by block
+        if (file.cold) {
+            seg.cold = std::make_shared<const ColdSegment>(file.path);
+            for (std::size_t b = 0; b < seg.cold->blocks(); ++b) {
+                const auto raw = seg.cold->block(b);
+                for (std::size_t off = 0; off < raw->size();) {
+                    const char *rec = raw->data() + off;
+                    const Header h =
+                        off + kHeader <= raw->size() ? decode(rec) : Header{};
+                    if (h.size < kHeader + h.conv_len ||
+                        off + h.size > raw->size() || h.seq != s.next_seq ||
+                        record_crc(rec, h.size) != h.crc)
+                        throw std::runtime_error(
+                            "corrupt history record in " + file.path);
+                    take(h, rec + kHeader);
+                    off += h.size;
+                }
+            }
+            if (seg.chained != seg.cold->chained())
+                throw std::runtime_error("damaged history segment " +
+                                         file.path);
+            last_sealed = true;
+            s.segments.push_back(std::move(seg));
+            continue;
+        }
+
+        std::uint64_t file_size = fs::file_size(file.path, ec);
+        std::ifstream in(file.path, std::ios::binary);
+
+        // records stop short of the footer, written when the segment is
+        // sealed; a segment without one is the open one
+        bool sealed = false;
+        std::uint64_t sealed_used = 0;
+        std::uint32_t sealed_chain = 0;
+        if (!ec && file_size >= kFooter) {
+            file_size -= kFooter;
+            in.seekg(static_cast<std::streamoff>(file_size));
+            if (in.read(foot, kFooter) && get(foot + 12, 4) == kSealed) {
+                sealed = true;
+                sealed_used = get(foot, 8);
+                sealed_chain = static_cast<std::uint32_t>(get(foot + 8, 4));
+            }
+            in.seekg(0);
+        }
+
+        bool torn = false;
+        while (!ec && seg.used + kHeader <= file_size &&
+               in.read(head, kHeader)) {
+            const Header h = decode(head);
+            if (h.size < kHeader + h.conv_len ||
+                seg.used + h.size > file_size || h.seq != s.next_seq) {
+                // zeros are the unwritten rest; anything else a torn append
+                torn = h.size != 0;
+                break;
+            }
+            body.resize(h.size - kHeader);
+            if (!in.read(&body[0], static_cast<std::streamsize>(body.size())))
+                break;
+            // a partly written append in the open segment is torn; a bad
+            // record anywhere else is damage to stop at
+            const std::uint32_t crc =
+                crc32c(body.data(), body.size(), crc32c(head + 8, kHeader - 8));
+            if (crc != h.crc) {
+                if (sealed)
+                    throw std::runtime_error("corrupt history record in " +
+                                             file.path);
+                torn = true;
+                break;
+            }
+            take(h, body.data());
+        }
+        if (sealed &&
+            (seg.used != sealed_used || seg.chained != sealed_chain))
+            throw std::runtime_error("damaged history segment " + file.path);
+        if (torn) {
+            zero_tail(file.path, seg.used);
+            ended = true;
+        }
+        if (seg.used == 0 && !s.segments.empty()) {
+            fs::remove(file.path, ec);  // empty, and not the only one
+            continue;
+        }
+        last_sealed = sealed;
+        s.segments.push_back(std::move(seg));
+    }
+
+    // erased, not compacted yet
+    for (std::uint64_t seq : tombstones) {
+        std::uint64_t pos, prev;
+        RecordView v;
+        if (_locate(s, seq, pos) && _view_at(s, 0, pos, v, prev) == 0 &&
+            s.erased.insert(seq).second)
+            s.segments[static_cast<std::size_t>(pos >> 32)].dead +=
+                v.payload.size();
+    }
+
+    // appends go on in a preallocated segment; a merged one is exact size,
+    // and a sealed one was cut before its successor was made
+    std::error_code ec;
+    if (!s.segments.empty() && !last_sealed &&
+        fs::file_size(s.segments.back().path, ec) >= options_.segment_bytes)
+        s.out.open(s.segments.back().path);
+}
+
+void HistoryStore::_roll(Shard &s)
+{
+    if (s.out.is_open()) {
+        // sealed before the next segment exists, so every segment but the
+        // last has its footer; a sync after the roll only covers the new one
+        _write(s);
+        const Segment &last = s.segments.back();
+        const std::string foot = footer(last.used, last.chained);
+        s.out.write_at(options_.segment_bytes - kFooter, foot.data(),
+                       foot.size());
+        s.out.sync();
+        s.unsynced = false;
+        s.out.close();
+    }
+    const auto path = fs::path(s.dir) / segment_name(s.next_seq, 0);
+    Segment seg{s.next_seq, path.string(), 0, nullptr, 0};
+    {
+        std::ofstream create(seg.path, std::ios::binary | std::ios::trunc);
+    }
+    std::error_code ec;
+    fs::resize_file(seg.path, options_.segment_bytes, ec);  // fixed size
+    if (ec)
+        throw std::runtime_error("cannot create segment " + seg.path);
+    sync_directory(s.dir);  // the new name survives a crash
+    s.out.open(seg.path);
+    s.segments.push_back(std::move(seg));
+}
+
+void HistoryStore::_write(Shard &s)
+{
+    if (s.pending.empty())
+        return;
+    // pending holds the tail of the last segment
+    const Segment &seg = s.segments.back();
+    s.out.write_at(seg.used - s.pending.size(), s.pending.data(),
+                   s.pending.size());
+    s.pending.clear();
+    s.unsynced = true;
+}
+
+const HistoryStore::IndexEntry *HistoryStore::_floor(Shard &s,
+                                                     std::uint64_t seq)
+{
+    if (seq == 0 || seq >= s.next_seq)
+        return nullptr;
+    _write(s);  // the mapping sees what the OS has, not our buffer
+    // last indexed record at or before seq; index[0] is seq 1
+    auto it = std::upper_bound(
+        s.index.begin(), s.index.end(), seq,
+        [](std::uint64_t v, const IndexEntry &e) { return v < e.seq; });
+    return &*--it;
+}
+
+const std::shared_ptr<const MappedFile> &HistoryStore::_map(Segment &seg)
+{
+    if (!seg.map)
+        seg.map = std::make_shared<const MappedFile>(seg.path);
+    return seg.map;
+}
+
+void HistoryStore::_stamp(std::uint64_t &clock,
+                          std::vector<TimeBlock> &times,
+                          bool indexed,
+                          std::uint64_t timestamp)
+{
+    clock = std::max(clock, timestamp);
+    if (indexed) {
+        times.push_back(TimeBlock{timestamp, clock});
+    } else {
+        times.back().low = std::min(times.back().low, timestamp);
+        times.back().clock = clock;
+    }
+}
+
+std::uint64_t HistoryStore::_clock_floor(Shard &s, std::uint64_t timestamp)
+{
+    // first segment, then first stride in it, where the clock passes
+    auto last = s.segments.end();
+    if (last != s.segments.begin() && (last - 1)->times.empty())
+        --last;  // just rolled
+    auto seg = std::upper_bound(
+        s.segments.begin(), last, timestamp,
+        [](std::uint64_t t, const Segment &x) {
+            return t < x.times.back().clock;
+        });
+    if (seg == last)
+        return s.next_seq - 1;  // not yet: the whole log
+    auto block = std::upper_bound(
+        seg->times.begin(), seg->times.end(), timestamp,
+        [](std::uint64_t t, const TimeBlock &b) { return t < b.clock; });
+    std::uint64_t clock =
+        block != seg->times.begin()
+            ? (block - 1)->clock
+            : seg != s.segments.begin() ? (seg - 1)->times.back().clock : 0;
+
+    // the stride's index entry: the segment's first, plus the stride
+    auto e = std::lower_bound(
+        s.index.begin(), s.index.end(), seg->first,
+        [](const IndexEntry &x, std::uint64_t seq) { return x.seq < seq; });
+    e += block - seg->times.begin();
+    if (block->low > timestamp)
+        return e->seq - 1;  // passed at its first record
+    std::shared_ptr<const void> keep;
+    for (std::uint64_t off = e->offset; off < seg->used;) {
+        const Header h = decode(_at(*seg, off, keep));
+        clock = std::max(clock, h.timestamp);
+        if (clock > timestamp)
+            return h.seq - 1;
+        off += h.size;
+    }
+    return s.next_seq - 1;  // unreachable: the stride's clock passed it
+}
+
+std::uint64_t HistoryStore::_last_of(Shard &s,
+                                     const std::string &conversation,
+                                     std::uint64_t head,
+                                     std::uint64_t last)
+{
+    // two walks in step, the first to arrive wins: back along the chain
+    // from the head ( long if the conversation went on a lot since ), and
+    // back through the log a stride at a time from last ( long if it was
+    // quiet for a while before )
+    std::uint64_t chain = head, pos;
+    RecordView v;
+    const IndexEntry *e = _floor(s, last);
+    std::size_t stride = e ? static_cast<std::size_t>(e - s.index.data()) : 0;
+    std::uint64_t upto = last;  // of the stride to scan next
+    std::shared_ptr<const void> keep;
+    for (bool strides = e != nullptr;;) {
+        if (chain <= last)
+            return chain;
+        if (!_locate(s, chain, pos))
+            return 0;
+        _view_at(s, 0, pos, v, chain);
+        if (!strides)
+            continue;
+
+        const IndexEntry &x = s.index[stride];
+        Segment &seg = s.segments[x.segment];
+        std::uint64_t found = 0;
+        for (std::uint64_t off = x.offset; off < seg.used;) {
+            const char *rec = _at(seg, off, keep);
+            const Header h = decode(rec);
+            if (h.seq > upto)
+                break;
+            if ((h.flags & kTombstone) == 0 &&
+                std::string_view(rec + kHeader, h.conv_len) == conversation)
+                found = h.seq;
+            off += h.size;
+        }
+        if (found != 0)
+            return found;
+        upto = x.seq - 1;
+        strides = stride-- > 0;
+    }
+}
+
+const char *HistoryStore::_at(Segment &seg,
+                              std::uint64_t offset,
+                              std::shared_ptr<const void> &keep)
+{
+    if (seg.cold)
+        return seg.cold->at(offset, keep);
+    return _map(seg)->data() + offset;
+}
+
+bool HistoryStore::_locate(Shard &s, std::uint64_t seq, std::uint64_t &pos)
+{
+    const IndexEntry *e = _floor(s, seq);
+    if (!e)
+        return false;
+    Segment &seg = s.segments[e->segment];
+    std::shared_ptr<const void> keep;
+
+    // at most index_every records from the indexed one
+    for (std::uint64_t off = e->offset; off + kHeader <= seg.used;) {
+        const Header h = decode(_at(seg, off, keep));
+        if (h.seq == seq) {
+            pos = position(e->segment, off);
+            return true;
+        }
+        if (h.seq > seq || h.size < kHeader)
+            break;
+        off += h.size;
+    }
+    return false;
+}
+
+std::uint16_t HistoryStore::_view_at(Shard &s,
+                                     std::size_t shard,
+                                     std::uint64_t pos,
+                                     RecordView &out,
+                                     std::uint64_t &prev)
+{
+    Segment &seg = s.segments[static_cast<std::size_t>(pos >> 32)];
+    std::shared_ptr<const void> keep;
+    const char *rec = _at(seg, pos & 0xFFFFFFFF, keep);
+    const Header h = decode(rec);
+    const char *p = rec + kHeader;
+    out.id = (std::uint64_t{shard} << kShardBits) | h.seq;
+    out.timestamp = h.timestamp;
+    out.conversation = std::string_view(p, h.conv_len);
+    out.payload =
+        std::string_view(p + h.conv_len, h.size - kHeader - h.conv_len);
+    out.segment = seg.cold ? std::move(keep)
+                           : std::shared_ptr<const void>(seg.map);
+    prev = h.prev;
+    return h.flags;
+}
@@ -0,0 +1,93 @@
+// impl for history_writer.hpp
+
+#include "history_writer.hpp"
+
+#include <exception>
+
+HistoryWriter::HistoryWriter(HistoryEngine &store, CommitOptions options)
+    : store_(store), options_(options), writer_([this] { _run(); })
+{
+}
+
+HistoryWriter::~HistoryWriter()
+{
+    shutdown();
+}
+
+void HistoryWriter::append(std::string conversation,
+                           std::string payload,
+                           std::uint64_t timestamp,
+                           done_type done)
+{
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        if (!stop_) {
+            queue_.push_back(HistoryAppend{std::move(conversation),
+                                           std::move(payload), timestamp});
+            done_.push_back(std::move(done));
+            // the writer waits for a first append, or for a full batch
+            wake = queue_.size() == 1 || queue_.size() == options_.max_batch;
+            done = nullptr;
+        }
+    }
+    if (done) {  // shut down
+        done(0);
+        return;
+    }
+    if (wake)
+        cv_.notify_one();
+}
+
+void HistoryWriter::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    if (writer_.joinable())
+        writer_.join();
+}
+
+void HistoryWriter::_run()
+{
+    std::vector<HistoryAppend> batch;
+    std::vector<done_type> done;
+    std::vector<MessageId> ids;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lk(mtx_);
+            cv_.wait(lk, [this] { return stop_ || !queue_.empty(); });
+            if (queue_.empty())
+                return;  // stopped, nothing left
+            if (!stop_ && options_.window.count() > 0)
+                cv_.wait_for(lk, options_.window, [this] {
+                    return stop_ || queue_.size() >= options_.max_batch;
+                });
+            batch.swap(queue_);
+            done.swap(done_);
+        }
+
+        store_.write(batch, ids);  // too large or disk full: 0, alone
+        bool durable = true;
+        try {
+            store_.sync();  // the one sync the whole batch waits for
+        } catch (const std::exception &) {
+            durable = false;
+        }
+        batches_.fetch_add(1);
+        appends_.fetch_add(batch.size());
+
+        for (std::size_t i = 0; i < batch.size(); ++i) {
+            try {
+                if (done[i])
+                    done[i](durable ? ids[i] : 0);
+            } catch (...) {
+                // a bad completion must not stop the writer
+            }
+        }
+        batch.clear();
+        done.clear();
+    }
+}
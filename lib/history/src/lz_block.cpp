@@ -0,0 +1,150 @@
+// impl for lz_block.hpp
+
+#include "lz_block.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+
+constexpr std::size_t kMinMatch = 4;
+constexpr std::size_t kMaxDistance = 0xFFFF;
+constexpr int kHashBits = 14;
+
+std::uint32_t load32(const char *p)
+{
+    std::uint32_t v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+std::uint32_t hash(std::uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - kHashBits);
+}
+
+/// The part of a length over 15, as 255, 255, ..., rest.
+void put_length(std::string &out, std::size_t n)
+{
+    for (; n >= 255; n -= 255)
+        out.push_back(static_cast<char>(255));
+    out.push_back(static_cast<char>(n));
+}
+
+void put_sequence(std::string &out,
+                  const char *literals,
+                  std::size_t n,
+                  std::size_t distance,
+                  std::size_t match)
+{
+    const std::size_t m = match - kMinMatch;
+    out.push_back(static_cast<char>((n < 15 ? n : 15) << 4 |
+                                    (m < 15 ? m : 15)));
+    if (n >= 15)
+        put_length(out, n - 15);
+    out.append(literals, n);
+    out.push_back(static_cast<char>(distance));
+    out.push_back(static_cast<char>(distance >> 8));
+    if (m >= 15)
+        put_length(out, m - 15);
+}
+
+/// Reads a length started in a token nibble; false past @p end.
+bool get_length(const unsigned char *&p,
+                const unsigned char *end,
+                std::size_t &n)
+{
+    if (n != 15)
+        return true;
+    for (;;) {
+        if (p == end)
+            return false;
+        const unsigned char b = *p++;
+        n += b;
+        if (b != 255)
+            return true;
+    }
+}
+
+}  // namespace
+
+void lz_compress(const char *data, std::size_t size, std::string &out)
+{
+    std::vector<std::uint32_t> table(std::size_t{1} << kHashBits, 0);
+    std::size_t anchor = 0;  // first byte not emitted yet
+    std::size_t i = 0;
+    unsigned misses = 0;
+    while (i + kMinMatch <= size) {
+        const std::uint32_t v = load32(data + i);
+        std::uint32_t &slot = table[hash(v)];
+        const std::size_t candidate = slot;
+        slot = static_cast<std::uint32_t>(i);
+        if (candidate >= i || i - candidate > kMaxDistance ||
+            load32(data + candidate) != v) {
+            // incompressible stretches are skipped over faster and faster
+            i += 1 + (misses++ >> 5);
+            continue;
+        }
+        misses = 0;
+        std::size_t match = kMinMatch;
+        while (i + match < size && data[candidate + match] == data[i + match])
+            ++match;
+        put_sequence(out, data + anchor, i - anchor, i - candidate, match);
+        i += match;
+        anchor = i;
+        if (i >= 2 && i + kMinMatch <= size)  // the match's tail, for later
+            table[hash(load32(data + i - 2))] =
+                static_cast<std::uint32_t>(i - 2);
+    }
+
+    const std::size_t n = size - anchor;
+    out.push_back(static_cast<char>((n < 15 ? n : 15) << 4));
+    if (n >= 15)
+        put_length(out, n - 15);
+    out.append(data + anchor, n);
+}
+
+bool lz_decompress(const char *data,
+                   std::size_t size,
+                   char *out,
+                   std::size_t raw_size)
+{
+    auto p = reinterpret_cast<const unsigned char *>(data);
+    const unsigned char *end = p + size;
+    std::size_t at = 0;
+    for (;;) {
+        if (p == end)
+            return false;  // cut before its last sequence
+        const unsigned char token = *p++;
+        std::size_t n = token >> 4;
+        if (!get_length(p, end, n) ||
+            n > static_cast<std::size_t>(end - p) || n > raw_size - at)
+            return false;
+        std::memcpy(out + at, p, n);
+        p += n;
+        at += n;
+        if (p == end)
+            return at == raw_size;  // the last sequence: literals only
+
+        if (end - p < 2)
+            return false;
+        const std::size_t distance = p[0] | std::size_t{p[1]} << 8;
+        p += 2;
+        std::size_t match = token & 15;
+        if (!get_length(p, end, match) || distance == 0 || distance > at)
+            return false;
+        match += kMinMatch;
+        if (match > raw_size - at)
+            return false;
+        // byte by byte when a match overlaps what it produces
+        const char *from = out + at - distance;
+        if (distance >= match)
+            std::memcpy(out + at, from, match);
+        else
+            for (std::size_t k = 0; k < match; ++k)
+                out[at + k] = from[k];
+        at += match;
+    }
+}
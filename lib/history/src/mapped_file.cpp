@@ -0,0 +1,114 @@
+// impl for mapped_file.hpp
+
+#include "mapped_file.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string &path)
+{
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("cannot open " + path);
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        throw std::runtime_error("cannot stat " + path);
+    }
+    size_ = static_cast<std::size_t>(size.QuadPart);
+    if (size_ == 0) {  // an empty file cannot be mapped
+        file_ = file;
+        return;
+    }
+    HANDLE mapping =
+        CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void *view = mapping
+                           ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)
+                           : nullptr;
+    if (!view) {
+        if (mapping)
+            CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::runtime_error("cannot map " + path);
+    }
+    file_ = file;
+    mapping_ = mapping;
+    data_ = static_cast<const char *>(view);
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_)
+        UnmapViewOfFile(data_);
+    if (mapping_)
+        CloseHandle(mapping_);
+    if (file_)
+        CloseHandle(file_);
+}
+
+void MappedFile::will_need(std::size_t offset, std::size_t len) const
+{
+    if (offset >= size_ || len == 0)
+        return;
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = const_cast<char *>(data_ + offset);
+    range.NumberOfBytes = std::min(len, size_ - offset);
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+#else  // POSIX
+
+MappedFile::MappedFile(const std::string &path)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("cannot open " + path);
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("cannot stat " + path);
+    }
+    size_ = static_cast<std::size_t>(st.st_size);
+    if (size_ > 0) {
+        void *p = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("cannot map " + path);
+        }
+        data_ = static_cast<const char *>(p);
+    }
+    ::close(fd);  // the mapping keeps the file
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_)
+        ::munmap(const_cast<char *>(data_), size_);
+}
+
+void MappedFile::will_need(std::size_t offset, std::size_t len) const
+{
+    if (offset >= size_ || len == 0)
+        return;
+    // madvise wants a page-aligned start
+    static const std::size_t page =
+        static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    const std::size_t start = offset / page * page;
+    const std::size_t end = std::min(size_, offset + len);
+    ::madvise(const_cast<char *>(data_ + start), end - start, MADV_WILLNEED);
+}
+
+#endif
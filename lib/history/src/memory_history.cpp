@@ -0,0 +1,209 @@
+// impl for memory_history.hpp
+
+#include "memory_history.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string_view>
+
+MemoryHistory::MemoryHistory(std::size_t chunk_bytes)
+    : chunk_bytes_(chunk_bytes)
+{
+}
+
+MessageId MemoryHistory::append(const std::string &conversation,
+                                const std::string &payload,
+                                std::uint64_t timestamp)
+{
+    if (!_fits(conversation, payload))
+        throw std::invalid_argument("history record too large");
+    std::lock_guard<std::mutex> lk(mtx_);
+    return _append(conversation, payload, timestamp);
+}
+
+void MemoryHistory::write(const std::vector<HistoryAppend> &batch,
+                          std::vector<MessageId> &ids)
+{
+    ids.assign(batch.size(), 0);
+    std::lock_guard<std::mutex> lk(mtx_);
+    for (std::size_t i = 0; i < batch.size(); ++i)
+        if (_fits(batch[i].conversation, batch[i].payload))
+            ids[i] = _append(batch[i].conversation, batch[i].payload,
+                             batch[i].timestamp);
+}
+
+bool MemoryHistory::erase(MessageId id)
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (id == 0 || id > entries_.size() || entries_[id - 1].erased)
+        return false;
+    entries_[id - 1].erased = true;
+    return true;
+}
+
+bool MemoryHistory::view(MessageId id, RecordView &out)
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (id == 0 || id > entries_.size() || entries_[id - 1].erased)
+        return false;
+    _view(id, out);
+    return true;
+}
+
+bool MemoryHistory::read(MessageId id, HistoryRecord &out)
+{
+    RecordView v;
+    if (!view(id, v))
+        return false;
+    out.id = v.id;
+    out.timestamp = v.timestamp;
+    out.conversation.assign(v.conversation);
+    out.payload.assign(v.payload);
+    return true;
+}
+
+bool MemoryHistory::fetch(const std::string &conversation,
+                          MessageId before,
+                          std::size_t limit,
+                          HistoryPage &out)
+{
+    out.records.clear();
+    out.next = 0;
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto c = convs_.find(conversation);
+    if (c == convs_.end())
+        return before == 0;  // nothing said yet
+    const std::vector<std::uint64_t> &ids = c->second;
+    // an erased message is still a cursor, as on disk
+    auto end = before == 0
+                   ? ids.end()
+                   : std::lower_bound(ids.begin(), ids.end(), before);
+    if (before != 0 && (end == ids.end() || *end != before))
+        return false;
+    _page(ids, static_cast<std::size_t>(end - ids.begin()), before, limit,
+          out);
+    return true;
+}
+
+void MemoryHistory::fetch_at(const std::string &conversation,
+                             std::uint64_t timestamp,
+                             std::size_t limit,
+                             HistoryPage &out)
+{
+    out.records.clear();
+    out.next = 0;
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto c = convs_.find(conversation);
+    if (c == convs_.end())
+        return;  // nothing said yet
+
+    // ids up to the one before the clock passes timestamp
+    const std::uint64_t last = static_cast<std::uint64_t>(
+        std::upper_bound(entries_.begin(), entries_.end(), timestamp,
+                         [](std::uint64_t t, const Entry &e) {
+                             return t < e.clock;
+                         }) -
+        entries_.begin());
+    const std::vector<std::uint64_t> &ids = c->second;
+    const auto end = std::upper_bound(ids.begin(), ids.end(), last);
+    if (end != ids.begin())
+        _page(ids, static_cast<std::size_t>(end - ids.begin()), *(end - 1),
+              limit, out);
+}
+
+std::uint64_t MemoryHistory::scan(
+    const std::function<void(const RecordView &)> &fn)
+{
+    return scan_since(0, fn);
+}
+
+std::uint64_t MemoryHistory::scan_since(
+    std::uint64_t since,
+    const std::function<void(const RecordView &)> &fn)
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    RecordView v;
+    for (std::uint64_t seq = 1; seq <= entries_.size(); ++seq) {
+        const Entry &e = entries_[seq - 1];
+        if (e.erased || e.timestamp < since)
+            continue;
+        _view(seq, v);
+        fn(v);
+    }
+    return 0;
+}
+
+std::uint64_t MemoryHistory::count() const
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    return entries_.size();
+}
+
+std::uint64_t MemoryHistory::bytes() const
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    return bytes_;
+}
+
+bool MemoryHistory::_fits(const std::string &conversation,
+                          const std::string &payload)
+{
+    return conversation.size() <= 0xFFFF && payload.size() <= 0xFFFFFFFF;
+}
+
+MessageId MemoryHistory::_append(const std::string &conversation,
+                                 const std::string &payload,
+                                 std::uint64_t timestamp)
+{
+    // appending within the capacity never moves the bytes views point at
+    const std::size_t size = conversation.size() + payload.size();
+    if (chunks_.empty() ||
+        chunks_.back()->capacity() - chunks_.back()->size() < size) {
+        auto chunk = std::make_shared<std::string>();
+        chunk->reserve(std::max(size, chunk_bytes_));
+        bytes_ += chunk->capacity();
+        chunks_.push_back(std::move(chunk));
+    }
+    std::string &chunk = *chunks_.back();
+
+    clock_ = std::max(clock_, timestamp);
+    entries_.push_back(Entry{static_cast<std::uint32_t>(chunks_.size() - 1),
+                             static_cast<std::uint32_t>(chunk.size()),
+                             static_cast<std::uint32_t>(conversation.size()),
+                             static_cast<std::uint32_t>(payload.size()),
+                             timestamp, clock_, false});
+    chunk.append(conversation);
+    chunk.append(payload);
+    convs_[conversation].push_back(entries_.size());
+    return entries_.size();
+}
+
+void MemoryHistory::_view(std::uint64_t seq, RecordView &out) const
+{
+    const Entry &e = entries_[seq - 1];
+    const auto &chunk = chunks_[e.chunk];
+    const char *at = chunk->data() + e.offset;
+    out.id = seq;
+    out.timestamp = e.timestamp;
+    out.conversation = std::string_view(at, e.conv_len);
+    out.payload = std::string_view(at + e.conv_len, e.size);
+    out.segment = chunk;
+}
+
+void MemoryHistory::_page(const std::vector<std::uint64_t> &ids,
+                          std::size_t end,
+                          MessageId before,
+                          std::size_t limit,
+                          HistoryPage &out) const
+{
+    // ids[end - 1] first, back to the conversation's first message
+    RecordView v;
+    for (; end > 0 && out.records.size() < limit; --end) {
+        if (!entries_[ids[end - 1] - 1].erased) {
+            _view(ids[end - 1], v);
+            out.records.push_back(v);
+        }
+    }
+    if (end > 0)
+        out.next = out.records.empty() ? before : out.records.back().id;
+}
@@ -0,0 +1,232 @@
+// impl for recent_cache.hpp
+
+#include "recent_cache.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+namespace
+{
+
+/// Hash node, bucket and clock slot of an entry, roughly.
+constexpr std::size_t kEntryOverhead = 64;
+
+}  // namespace
+
+RecentCache::RecentCache(std::size_t budget_bytes,
+                         std::size_t per_conversation,
+                         std::size_t shards)
+    : per_conversation_(per_conversation),
+      shard_budget_(shards == 0 ? 0 : budget_bytes / shards)
+{
+    if (per_conversation == 0 || shards == 0)
+        throw std::invalid_argument("bad RecentCache options");
+    for (std::size_t i = 0; i < shards; ++i)
+        shards_.push_back(std::make_unique<Shard>());
+}
+
+bool RecentCache::get(const std::string &conversation,
+                      MessageId before,
+                      std::size_t limit,
+                      std::vector<HistoryRecord> &out,
+                      MessageId &next)
+{
+    out.clear();
+    Shard &s = _shard(conversation);
+    std::lock_guard<std::mutex> lk(s.mtx);
+    auto it = s.entries.find(conversation);
+    if (it == s.entries.end()) {
+        misses_.fetch_add(1);
+        return false;
+    }
+    Entry &e = it->second;
+
+    // the page is [.., end), newest first from end - 1
+    const auto live = e.slots.begin() + e.first;
+    auto end = e.slots.end();
+    if (before != 0) {
+        end = std::lower_bound(
+            live, e.slots.end(), before,
+            [](const Slot &slot, MessageId id) { return slot.id < id; });
+        if (end == e.slots.end() || end->id != before) {
+            misses_.fetch_add(1);  // a cursor we do not hold
+            return false;
+        }
+    }
+    const auto available = static_cast<std::size_t>(end - live);
+    if (available < limit && !e.complete) {
+        misses_.fetch_add(1);  // reaches past the cached tail
+        return false;
+    }
+
+    const std::size_t n = std::min(limit, available);
+    out.reserve(n);
+    for (auto slot = end; slot != end - n;) {
+        --slot;
+        out.push_back(HistoryRecord{slot->id, slot->timestamp, conversation,
+                                    e.data.substr(slot->offset, slot->size)});
+    }
+    if (n == available && e.complete)
+        next = 0;  // the first message is in the page
+    else
+        next = n == 0 ? before : out.back().id;
+    e.referenced = true;
+    hits_.fetch_add(1);
+    return true;
+}
+
+std::uint64_t RecentCache::begin_fill(const std::string &conversation)
+{
+    Shard &s = _shard(conversation);
+    const std::uint64_t ticket = next_ticket_.fetch_add(1);
+    std::lock_guard<std::mutex> lk(s.mtx);
+    s.filling[conversation] = Fill{ticket, false};
+    return ticket;
+}
+
+void RecentCache::fill(const std::string &conversation,
+                       std::uint64_t ticket,
+                       const std::vector<RecordView> &records,
+                       bool complete)
+{
+    Shard &s = _shard(conversation);
+    std::lock_guard<std::mutex> lk(s.mtx);
+    auto f = s.filling.find(conversation);
+    if (f == s.filling.end() || f->second.ticket != ticket)
+        return;  // a newer fill took over
+    const bool dirty = f->second.dirty;
+    s.filling.erase(f);
+    if (dirty || s.entries.count(conversation) != 0)
+        return;
+
+    auto it = s.entries.emplace(conversation, Entry()).first;
+    Entry &e = it->second;
+    const std::size_t n = std::min(records.size(), per_conversation_);
+    for (std::size_t i = n; i-- > 0;)
+        _push(e, records[i].id, records[i].timestamp, records[i].payload);
+    e.complete = complete && n == records.size();
+    // spared only once read again, so one-off reads do not push out the
+    // conversations people keep coming back to
+    e.referenced = false;
+    e.clock = s.clock.size();
+    s.clock.push_back(&it->first);
+    s.bytes += _cost(it->first, e);
+    _evict(s);
+}
+
+void RecentCache::on_append(const std::string &conversation,
+                            MessageId id,
+                            std::uint64_t timestamp,
+                            std::string_view payload)
+{
+    Shard &s = _shard(conversation);
+    std::lock_guard<std::mutex> lk(s.mtx);
+    auto f = s.filling.find(conversation);
+    if (f != s.filling.end())
+        f->second.dirty = true;
+    auto it = s.entries.find(conversation);
+    if (it == s.entries.end())
+        return;
+    Entry &e = it->second;
+    // a fill may have read it from the store already
+    if (e.slots.size() > e.first && e.slots.back().id >= id)
+        return;
+    s.bytes -= _cost(it->first, e);
+    _push(e, id, timestamp, payload);
+    s.bytes += _cost(it->first, e);
+    _evict(s);
+}
+
+void RecentCache::invalidate(const std::string &conversation)
+{
+    Shard &s = _shard(conversation);
+    std::lock_guard<std::mutex> lk(s.mtx);
+    auto f = s.filling.find(conversation);
+    if (f != s.filling.end())
+        f->second.dirty = true;
+    auto it = s.entries.find(conversation);
+    if (it != s.entries.end())
+        _erase(s, it);
+}
+
+RecentCacheStats RecentCache::stats() const
+{
+    RecentCacheStats out;
+    out.hits = hits_.load();
+    out.misses = misses_.load();
+    out.evictions = evictions_.load();
+    out.budget = shard_budget_ * shards_.size();
+    for (const auto &s : shards_) {
+        std::lock_guard<std::mutex> lk(s->mtx);
+        out.conversations += s->entries.size();
+        out.bytes += s->bytes;
+    }
+    return out;
+}
+
+RecentCache::Shard &RecentCache::_shard(const std::string &conversation)
+{
+    return *shards_[std::hash<std::string>{}(conversation) % shards_.size()];
+}
+
+std::size_t RecentCache::_cost(const std::string &key, const Entry &e) const
+{
+    return kEntryOverhead + sizeof(Entry) + key.size() + e.data.capacity() +
+           e.slots.capacity() * sizeof(Slot);
+}
+
+void RecentCache::_push(Entry &e,
+                        MessageId id,
+                        std::uint64_t timestamp,
+                        std::string_view payload)
+{
+    if (e.slots.size() - e.first == per_conversation_) {
+        ++e.first;  // the oldest falls off
+        e.complete = false;
+    }
+    // as many dead slots as live ones: slide the live tail to the front
+    if (e.first == per_conversation_) {
+        const std::size_t dead = e.first < e.slots.size()
+                                     ? e.slots[e.first].offset
+                                     : e.data.size();
+        e.data.erase(0, dead);
+        e.slots.erase(e.slots.begin(), e.slots.begin() + e.first);
+        for (auto &slot : e.slots)
+            slot.offset -= static_cast<std::uint32_t>(dead);
+        e.first = 0;
+    }
+    e.slots.push_back(Slot{id, timestamp,
+                           static_cast<std::uint32_t>(e.data.size()),
+                           static_cast<std::uint32_t>(payload.size())});
+    e.data.append(payload.data(), payload.size());
+}
+
+void RecentCache::_evict(Shard &s)
+{
+    while (s.bytes > shard_budget_ && !s.clock.empty()) {
+        if (s.hand >= s.clock.size())
+            s.hand = 0;
+        auto it = s.entries.find(*s.clock[s.hand]);
+        if (it->second.referenced) {
+            it->second.referenced = false;  // spared once
+            ++s.hand;
+        } else {
+            _erase(s, it);  // the last entry moves into the hand's slot
+            evictions_.fetch_add(1);
+        }
+    }
+}
+
+void RecentCache::_erase(Shard &s,
+                         std::unordered_map<std::string, Entry>::iterator it)
+{
+    const std::size_t slot = it->second.clock;
+    s.bytes -= _cost(it->first, it->second);
+    if (slot + 1 != s.clock.size()) {
+        s.clock[slot] = s.clock.back();
+        s.entries.find(*s.clock[slot])->second.clock = slot;
+    }
+    s.clock.pop_back();
+    s.entries.erase(it);
+}
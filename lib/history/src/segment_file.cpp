@@ -0,0 +1,138 @@
+// impl for segment_file.hpp
+
+#include "segment_file.hpp"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+SegmentFile::~SegmentFile()
+{
+    close();
+}
+
+#ifdef _WIN32
+
+void SegmentFile::open(const std::string &path)
+{
+    close();
+    HANDLE h = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("cannot open " + path);
+    handle_ = h;
+    path_ = path;
+}
+
+void SegmentFile::close()
+{
+    if (handle_) {
+        CloseHandle(handle_);
+        handle_ = nullptr;
+    }
+}
+
+bool SegmentFile::is_open() const
+{
+    return handle_ != nullptr;
+}
+
+void SegmentFile::write_at(std::uint64_t offset,
+                           const char *data,
+                           std::size_t len)
+{
+    while (len > 0) {
+        OVERLAPPED at{};
+        at.Offset = static_cast<DWORD>(offset);
+        at.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        const DWORD chunk =
+            static_cast<DWORD>(len < (1u << 30) ? len : (1u << 30));
+        DWORD n = 0;
+        if (!WriteFile(handle_, data, chunk, &n, &at) || n == 0)
+            throw std::runtime_error("cannot write " + path_);
+        data += n;
+        offset += n;
+        len -= n;
+    }
+}
+
+void SegmentFile::sync()
+{
+    if (handle_ && !FlushFileBuffers(handle_))
+        throw std::runtime_error("cannot sync " + path_);
+}
+
+void sync_directory(const std::string &)
+{
+}
+
+#else  // POSIX
+
+void SegmentFile::open(const std::string &path)
+{
+    close();
+    const int fd = ::open(path.c_str(), O_RDWR);
+    if (fd < 0)
+        throw std::runtime_error("cannot open " + path);
+    fd_ = fd;
+    path_ = path;
+}
+
+void SegmentFile::close()
+{
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+bool SegmentFile::is_open() const
+{
+    return fd_ >= 0;
+}
+
+void SegmentFile::write_at(std::uint64_t offset,
+                           const char *data,
+                           std::size_t len)
+{
+    while (len > 0) {
+        const ssize_t n =
+            ::pwrite(fd_, data, len, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            throw std::runtime_error("cannot write " + path_);
+        data += n;
+        offset += static_cast<std::uint64_t>(n);
+        len -= static_cast<std::size_t>(n);
+    }
+}
+
+void SegmentFile::sync()
+{
+#ifdef __APPLE__
+    const int rc = fd_ < 0 ? 0 : ::fsync(fd_);  // no fdatasync
+#else
+    const int rc = fd_ < 0 ? 0 : ::fdatasync(fd_);
+#endif
+    if (rc != 0)
+        throw std::runtime_error("cannot sync " + path_);
+}
+
+void sync_directory(const std::string &path)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+    ::fsync(fd);
+    ::close(fd);
+}
+
+#endif
@@ -0,0 +1,80 @@
+// ack_window.hpp : sent-but-unacknowledged messages of one connection
+#pragma once
+
+#include <cstddef>  // std::size_t
+#include <cstdint>  // sequence numbers
+#include <string>   // conversation, message
+#include <vector>   // ring storage
+
+/**
+ * @brief Fixed-size ring of messages a client has not acknowledged yet.
+ *
+ * Every message carries its conversation and that conversation's sequence
+ * number. The client acknowledges cumulatively per conversation ( "all of
+ * conversation C up to seq N" ). Entries leave from the head once acked,
+ * so the ring holds the oldest unacked message and what was sent after
+ * it, never more than capacity() entries.
+ *
+ * A full ring is the sender's cue to stop: push() refuses, and the caller
+ * holds further messages back until acks make room ( a sliding window ).
+ * When the connection ends, take_unacked() yields exactly the gap to
+ * resend.
+ *
+ * NOTE: Not thread-safe; the owner provides locking.
+ */
+class AckWindow
+{
+public:
+    struct Entry {
+        std::string conversation;
+        std::uint64_t seq{0};
+        std::string message;
+        bool acked{false};
+    };
+
+    /**
+     * @param capacity Entries kept ( at least 1 ).
+     */
+    explicit AckWindow(std::size_t capacity = 256);
+
+    /**
+     * @brief Track a message that is being sent.
+     * @return false if the ring is full ( nothing is stored ).
+     */
+    bool push(std::string conversation,
+              std::uint64_t seq,
+              std::string message);
+
+    /**
+     * @brief Cumulative ack: everything of @p conversation up to @p seq.
+     * @return Entries released from the ring.
+     */
+    std::size_t ack(const std::string &conversation, std::uint64_t seq);
+
+    /**
+     * @brief Stop tracking the message @p seq of @p conversation, whose
+     * send failed: it leaves the ring like an acked one.
+     * @return Entries released from the ring.
+     */
+    std::size_t drop(const std::string &conversation, std::uint64_t seq);
+
+    /// @brief Unacked entries, oldest first; the ring is left empty.
+    std::vector<Entry> take_unacked();
+
+    /// @brief Entries held ( acked ones behind an unacked head count ).
+    std::size_t size() const { return size_; }
+
+    std::size_t capacity() const { return ring_.size(); }
+
+    /// @brief Entries push() still accepts.
+    std::size_t room() const { return ring_.size() - size_; }
+
+private:
+    Entry &_at(std::size_t i) { return ring_[(head_ + i) % ring_.size()]; }
+    void _pop();
+    std::size_t _release();  ///< Pop acked entries off the head
+
+    std::vector<Entry> ring_;  ///< Fixed slots
+    std::size_t head_{0};      ///< Oldest entry
+    std::size_t size_{0};      ///< Entries in use
+};
@@ -0,0 +1,110 @@
+// offline_inbox.hpp : store-and-forward queues for offline users
+#pragma once
+
+#include <atomic>         // memory total
+#include <cstddef>        // std::size_t
+#include <cstdint>        // file offsets
+#include <deque>          // in-memory head
+#include <functional>     // replay sink
+#include <memory>         // per-user boxes
+#include <mutex>          // locks
+#include <string>         // users, messages
+#include <unordered_map>  // user -> box
+#include <vector>         // batches
+
+/**
+ * @brief Per-user inboxes for messages sent while the recipient is offline.
+ *
+ * The oldest messages of a user stay in memory, up to a message and a byte
+ * cap. Everything after that is appended to the user's spill file
+ * ( <dir>/<hex user name>.inbox, length-prefixed records ), so memory per
+ * offline user is bounded however long they stay away. Order is kept: once
+ * a user has spilled, new messages go to disk until the file is drained.
+ *
+ * replay() streams the backlog back in batches: each batch is handed to the
+ * sink in one call ( one flush on the socket ). A sink that returns false
+ * stops the replay; what was not accepted stays queued for the next one.
+ *
+ * Spill files survive a restart and are picked up on the next access;
+ * flush() moves the in-memory heads there too before a shutdown.
+ *
+ * NOTE: Thread-safe. Different users never contend; pushes to a user are
+ * not blocked while a batch is being sent.
+ */
+class OfflineInbox
+{
+public:
+    /// Receives one batch; return false to stop ( e.g. connection lost ).
+    using sink_type = std::function<bool(const std::vector<std::string> &)>;
+
+    /**
+     * @param spill_dir Directory for spill files ( created if missing ).
+     * @param mem_messages In-memory messages per user.
+     * @param mem_bytes In-memory payload bytes per user.
+     * @throws std::runtime_error if @p spill_dir cannot be created.
+     */
+    explicit OfflineInbox(std::string spill_dir,
+                          std::size_t mem_messages = 64,
+                          std::size_t mem_bytes = 64 * 1024);
+
+    // -- copy and move trait -- //
+
+    OfflineInbox(const OfflineInbox &) = delete;
+    OfflineInbox &operator=(const OfflineInbox &) = delete;
+    OfflineInbox(OfflineInbox &&) = delete;
+    OfflineInbox &operator=(OfflineInbox &&) = delete;
+
+    /**
+     * @brief Queue @p message for @p user.
+     * @throws std::runtime_error if the spill file cannot be written.
+     */
+    void push(const std::string &user, const std::string &message);
+
+    /**
+     * @brief Stream @p user's backlog to @p sink, oldest first.
+     * @param batch Messages per sink call.
+     * @return Number of messages delivered. 0 also if another replay for
+     * @p user is already running.
+     */
+    std::size_t replay(const std::string &user,
+                       std::size_t batch,
+                       const sink_type &sink);
+
+    /**
+     * @brief Write every user's in-memory messages to the front of their
+     * spill file, so all of the backlog survives a restart. A user being
+     * replayed to is skipped.
+     * @throws std::runtime_error if a spill file cannot be rewritten ( that
+     * user's messages stay in memory ).
+     */
+    void flush();
+
+    /// @brief Messages queued for @p user ( memory + disk ).
+    std::size_t pending(const std::string &user);
+
+    /// @brief Payload bytes held in memory, all users.
+    std::size_t memory_bytes() const;
+
+private:
+    struct Box {
+        std::mutex mtx;
+        std::deque<std::string> mem;  ///< Oldest messages
+        std::size_t mem_bytes{0};     ///< Payload bytes in mem
+        std::string path;             ///< Spill file
+        std::uint64_t read_off{0};    ///< First unread spill byte
+        std::size_t spilled{0};       ///< Unread spill records
+        bool replaying{false};        ///< One replay at a time
+    };
+
+    Box &_box(const std::string &user);
+    bool _read_spill(Box &b, std::size_t n, std::vector<std::string> &out,
+                     std::uint64_t &end_off);
+
+    std::string dir_;            ///< Spill directory
+    std::size_t mem_messages_;   ///< Per-user cap
+    std::size_t mem_bytes_cap_;  ///< Per-user cap
+
+    mutable std::mutex mtx_;  ///< Protects boxes_ ( not their content )
+    std::unordered_map<std::string, std::unique_ptr<Box>> boxes_;
+    std::atomic<std::size_t> total_mem_{0};  ///< Sum of mem_bytes
+};
@@ -0,0 +1,77 @@
+// impl for ack_window.hpp
+
+#include "ack_window.hpp"
+
+#include <utility>
+
+AckWindow::AckWindow(std::size_t capacity)
+    : ring_(capacity == 0 ? 1 : capacity)
+{
+}
+
+bool AckWindow::push(std::string conversation,
+                     std::uint64_t seq,
+                     std::string message)
+{
+    if (size_ == ring_.size())
+        return false;
+    Entry &e = _at(size_++);
+    e.conversation = std::move(conversation);
+    e.seq = seq;
+    e.message = std::move(message);
+    e.acked = false;
+    return true;
+}
+
+std::size_t AckWindow::ack(const std::string &conversation, std::uint64_t seq)
+{
+    for (std::size_t i = 0; i < size_; ++i) {
+        Entry &e = _at(i);
+        if (!e.acked && e.seq <= seq && e.conversation == conversation)
+            e.acked = true;
+    }
+    return _release();
+}
+
+std::size_t AckWindow::drop(const std::string &conversation, std::uint64_t seq)
+{
+    for (std::size_t i = 0; i < size_; ++i) {
+        Entry &e = _at(i);
+        if (!e.acked && e.seq == seq && e.conversation == conversation) {
+            e.acked = true;
+            break;
+        }
+    }
+    return _release();
+}
+
+std::vector<AckWindow::Entry> AckWindow::take_unacked()
+{
+    std::vector<Entry> out;
+    for (std::size_t i = 0; i < size_; ++i) {
+        Entry &e = _at(i);
+        if (!e.acked)
+            out.push_back(std::move(e));
+    }
+    head_ = 0;
+    size_ = 0;
+    return out;
+}
+
+std::size_t AckWindow::_release()
+{
+    std::size_t released = 0;
+    while (size_ > 0 && ring_[head_].acked) {
+        _pop();
+        ++released;
+    }
+    return released;
+}
+
+void AckWindow::_pop()
+{
+    Entry &e = ring_[head_];
+    e.message.clear();  // keeps the capacity for the next push
+    head_ = (head_ + 1) % ring_.size();
+    --size_;
+}
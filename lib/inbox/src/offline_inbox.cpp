@@ -0,0 +1,270 @@
+// impl for offline_inbox.hpp
+
+#include "offline_inbox.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+/// File name safe on every platform, whatever the user name contains.
+std::string hex_name(const std::string &user)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string out;
+    out.reserve(user.size() * 2);
+    for (unsigned char c : user) {
+        out.push_back(digits[c >> 4]);
+        out.push_back(digits[c & 0xF]);
+    }
+    return out;
+}
+
+void put_u32(std::ostream &os, std::uint32_t v)
+{
+    const char b[4] = {static_cast<char>(v), static_cast<char>(v >> 8),
+                       static_cast<char>(v >> 16), static_cast<char>(v >> 24)};
+    os.write(b, 4);
+}
+
+bool get_u32(std::istream &is, std::uint32_t &v)
+{
+    unsigned char b[4];
+    if (!is.read(reinterpret_cast<char *>(b), 4))
+        return false;
+    v = b[0] | (b[1] << 8) | (b[2] << 16) | (std::uint32_t{b[3]} << 24);
+    return true;
+}
+
+/// Count complete records; a torn tail ( crash mid-append ) is cut off so
+/// later appends stay aligned.
+std::size_t recover_records(const std::string &path)
+{
+    std::size_t n = 0;
+    std::uint64_t good = 0;
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::uint32_t len;
+        while (get_u32(in, len)) {
+            in.ignore(len);
+            if (static_cast<std::uint32_t>(in.gcount()) != len)
+                break;
+            ++n;
+            good += 4 + std::uint64_t{len};
+        }
+    }
+    std::error_code ec;
+    if (fs::file_size(path, ec) != good && !ec)
+        fs::resize_file(path, good, ec);
+    return n;
+}
+
+}  // namespace
+
+OfflineInbox::OfflineInbox(std::string spill_dir,
+                           std::size_t mem_messages,
+                           std::size_t mem_bytes)
+    : dir_(std::move(spill_dir)),
+      mem_messages_(mem_messages),
+      mem_bytes_cap_(mem_bytes)
+{
+    std::error_code ec;
+    fs::create_directories(dir_, ec);
+    if (ec || !fs::is_directory(dir_))
+        throw std::runtime_error("cannot create inbox directory " + dir_);
+}
+
+void OfflineInbox::push(const std::string &user, const std::string &message)
+{
+    Box &b = _box(user);
+    std::lock_guard<std::mutex> lk(b.mtx);
+
+    // memory only while nothing older sits on disk
+    if (b.spilled == 0 && b.mem.size() < mem_messages_ &&
+        b.mem_bytes + message.size() <= mem_bytes_cap_) {
+        b.mem.push_back(message);
+        b.mem_bytes += message.size();
+        total_mem_.fetch_add(message.size());
+        return;
+    }
+
+    std::ofstream out(b.path, std::ios::binary | std::ios::app);
+    put_u32(out, static_cast<std::uint32_t>(message.size()));
+    out.write(message.data(), static_cast<std::streamsize>(message.size()));
+    out.flush();
+    if (!out)
+        throw std::runtime_error("cannot append to " + b.path);
+    ++b.spilled;
+}
+
+std::size_t OfflineInbox::replay(const std::string &user,
+                                 std::size_t batch,
+                                 const sink_type &sink)
+{
+    if (batch == 0)
+        batch = 1;
+    Box &b = _box(user);
+    {
+        std::lock_guard<std::mutex> lk(b.mtx);
+        if (b.replaying)
+            return 0;
+        b.replaying = true;
+    }
+
+    std::size_t delivered = 0;
+    std::vector<std::string> out;
+    try {
+        for (;;) {
+            // take a batch under the lock, send it without
+            out.clear();
+            bool from_mem = false;
+            std::uint64_t end_off = 0;
+            {
+                std::lock_guard<std::mutex> lk(b.mtx);
+                if (!b.mem.empty()) {
+                    from_mem = true;
+                    const std::size_t n = std::min(batch, b.mem.size());
+                    out.assign(b.mem.begin(), b.mem.begin() + n);
+                } else if (b.spilled > 0 &&
+                           !_read_spill(b, batch, out, end_off)) {
+                    // unreadable spill: drop it rather than spin
+                    std::error_code ec;
+                    fs::remove(b.path, ec);
+                    b.spilled = 0;
+                    b.read_off = 0;
+                }
+            }
+            if (out.empty() || !sink(out))
+                break;
+
+            std::lock_guard<std::mutex> lk(b.mtx);
+            if (from_mem) {
+                for (std::size_t i = 0; i < out.size(); ++i) {
+                    b.mem_bytes -= b.mem.front().size();
+                    total_mem_.fetch_sub(b.mem.front().size());
+                    b.mem.pop_front();
+                }
+            } else {
+                b.read_off = end_off;
+                b.spilled -= out.size();
+                if (b.spilled == 0) {
+                    std::error_code ec;
+                    fs::remove(b.path, ec);
+                    b.read_off = 0;
+                }
+            }
+            delivered += out.size();
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> lk(b.mtx);
+        b.replaying = false;
+        throw;
+    }
+
+    std::lock_guard<std::mutex> lk(b.mtx);
+    b.replaying = false;
+    return delivered;
+}
+
+void OfflineInbox::flush()
+{
+    std::vector<Box *> boxes;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        for (auto &slot : boxes_)
+            boxes.push_back(slot.second.get());
+    }
+    for (Box *b : boxes) {
+        std::lock_guard<std::mutex> lk(b->mtx);
+        // a replay pops the head it sent: leave it to that one
+        if (b->mem.empty() || b->replaying)
+            continue;
+
+        // head, then the unread spill, into a new file that replaces it
+        const std::string tmp = b->path + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            for (const auto &message : b->mem) {
+                put_u32(out, static_cast<std::uint32_t>(message.size()));
+                out.write(message.data(),
+                          static_cast<std::streamsize>(message.size()));
+            }
+            if (b->spilled > 0) {
+                std::ifstream in(b->path, std::ios::binary);
+                in.seekg(static_cast<std::streamoff>(b->read_off));
+                std::copy(std::istreambuf_iterator<char>(in),
+                          std::istreambuf_iterator<char>(),
+                          std::ostreambuf_iterator<char>(out));
+            }
+            out.flush();
+            if (!out) {
+                std::error_code ec;
+                fs::remove(tmp, ec);
+                throw std::runtime_error("cannot write " + tmp);
+            }
+        }
+        std::error_code ec;
+        fs::rename(tmp, b->path, ec);
+        if (ec) {
+            fs::remove(tmp, ec);
+            throw std::runtime_error("cannot replace " + b->path);
+        }
+        b->spilled += b->mem.size();
+        b->read_off = 0;
+        total_mem_.fetch_sub(b->mem_bytes);
+        b->mem.clear();
+        b->mem_bytes = 0;
+    }
+}
+
+std::size_t OfflineInbox::pending(const std::string &user)
+{
+    Box &b = _box(user);
+    std::lock_guard<std::mutex> lk(b.mtx);
+    return b.mem.size() + b.spilled;
+}
+
+std::size_t OfflineInbox::memory_bytes() const
+{
+    return total_mem_.load();
+}
+
+OfflineInbox::Box &OfflineInbox::_box(const std::string &user)
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto &slot = boxes_[user];
+    if (!slot) {
+        slot = std::make_unique<Box>();
+        slot->path = (fs::path(dir_) / (hex_name(user) + ".inbox")).string();
+        std::error_code ec;
+        if (fs::exists(slot->path, ec))  // left by a previous run
+            slot->spilled = recover_records(slot->path);
+    }
+    return *slot;
+}
+
+bool OfflineInbox::_read_spill(Box &b,
+                               std::size_t n,
+                               std::vector<std::string> &out,
+                               std::uint64_t &end_off)
+{
+    std::ifstream in(b.path, std::ios::binary);
+    if (!in.seekg(static_cast<std::streamoff>(b.read_off)))
+        return false;
+    end_off = b.read_off;
+    std::uint32_t len;
+    while (out.size() < n && out.size() < b.spilled && get_u32(in, len)) {
+        std::string msg(len, '\0');
+        if (!in.read(&msg[0], len))
+            break;  // torn tail
+        out.push_back(std::move(msg));
+        end_off += 4 + std::uint64_t{len};
+    }
+    return !out.empty();
+}
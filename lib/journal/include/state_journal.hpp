@@ -0,0 +1,162 @@
+// state_journal.hpp : durable server state as a snapshot plus a log tail
+#pragma once
+
+#include <atomic>       // snapshot in flight
+#include <cstddef>      // std::size_t
+#include <cstdint>      // sequence numbers, sizes
+#include <functional>   // state callbacks
+#include <mutex>        // log lock
+#include <string>       // paths, images
+#include <string_view>  // records
+#include <thread>       // snapshot writer
+
+#include "segment_file.hpp"  // SegmentFile
+
+/**
+ * @brief Knobs of a StateJournal.
+ */
+struct JournalOptions {
+    /// Log bytes written since the last snapshot that make the next one due.
+    std::uint64_t snapshot_bytes{16 << 20};
+};
+
+/**
+ * @brief What StateJournal::recover() found.
+ */
+struct JournalRecovery {
+    std::uint64_t snapshot_lsn{0};    ///< Last record in the snapshot, 0: none
+    std::uint64_t snapshot_bytes{0};  ///< Size of its image
+    std::uint64_t replayed{0};        ///< Log records after it
+    std::uint64_t replayed_bytes{0};
+};
+
+/**
+ * @brief Counters of a StateJournal.
+ */
+struct JournalStats {
+    std::uint64_t lsn{0};           ///< Last record appended
+    std::uint64_t snapshot_lsn{0};  ///< Covered by the newest snapshot
+    std::uint64_t snapshots{0};     ///< Written since open
+    std::uint64_t failures{0};      ///< Snapshots that could not be written
+    std::uint64_t log_bytes{0};     ///< Written since the newest snapshot
+};
+
+/**
+ * @brief Write-ahead log of state changes, cut short by periodic snapshots.
+ *
+ * The owner appends one record per change ( an opaque byte string, given a
+ * log sequence number, lsn ) and, from time to time, hands over a snapshot
+ * of its whole state. Starting up then loads the newest snapshot and
+ * replays only the records after it, so boot time follows the size of the
+ * state and the recent churn, not the age of the server.
+ *
+ * Layout of <dir>:
+ *
+ *     <first lsn>.log  u32 size | u64 lsn | record, back to back
+ *     <lsn>.snap       u64 magic | u64 lsn | u64 size | image
+ *
+ * A snapshot named L holds the state after record L. snapshot() starts a
+ * new log file at L + 1 and writes the image on a background thread
+ * ( temporary file, sync, rename ); once it is durable, older snapshots
+ * and logs are deleted. The image is whatever the owner's encoder writes:
+ * the owner copies its state while changes are held off ( a memcpy of
+ * flat arrays ), and the slow part, encoding and writing, runs on the
+ * snapshot thread while changes go on.
+ *
+ * A record is handed to the OS by append(), so it survives the process
+ * crashing; sync() makes the records so far survive a power cut. A record
+ * torn by a crash ends the log: replay stops before it.
+ *
+ * NOTE: Thread-safe. Callers that need the log in the order their state
+ * changed append under the same lock as the change.
+ */
+class StateJournal
+{
+public:
+    /// Encodes a captured copy of the state into the snapshot image.
+    using Encoder = std::function<void(std::string &image)>;
+
+    /**
+     * @param dir Directory of the logs and snapshots ( created if missing ).
+     * @throws std::runtime_error if @p dir cannot be created.
+     */
+    explicit StateJournal(std::string dir,
+                          JournalOptions options = JournalOptions());
+
+    /// Waits for a snapshot in flight.
+    ~StateJournal();
+
+    // -- copy and move trait -- //
+
+    StateJournal(const StateJournal &) = delete;
+    StateJournal &operator=(const StateJournal &) = delete;
+    StateJournal(StateJournal &&) = delete;
+    StateJournal &operator=(StateJournal &&) = delete;
+
+    /**
+     * @brief Rebuild the state: call @p load with the image of the newest
+     * snapshot ( not at all if there is none ), then @p replay with every
+     * record after it, in order. Call once, before append().
+     *
+     * @throws std::runtime_error if @p load returns false ( a corrupt
+     * snapshot ), the log has a gap, or a new log file cannot be made.
+     */
+    JournalRecovery recover(
+        const std::function<bool(std::string_view image)> &load,
+        const std::function<void(std::string_view record)> &replay);
+
+    /**
+     * @brief Log one change.
+     * @return Its lsn.
+     * @throws std::runtime_error if the log cannot be written.
+     */
+    std::uint64_t append(std::string_view record);
+
+    /**
+     * @brief Put every record appended so far on stable storage.
+     * @throws std::runtime_error if the OS reports a failure.
+     */
+    void sync();
+
+    /// @brief Whether enough was logged that a snapshot should be taken.
+    bool snapshot_due() const;
+
+    /**
+     * @brief Take a snapshot of the state as of the last record appended.
+     *
+     * @p capture runs on the calling thread, which must hold off changes
+     * ( and appends ) until it returns; it copies the state and returns
+     * the encoder that runs on the snapshot thread.
+     *
+     * @return false if a snapshot is already being written ( @p capture
+     * is not called ).
+     * @throws std::runtime_error if a new log file cannot be made.
+     */
+    bool snapshot(const std::function<Encoder()> &capture);
+
+    /// @brief Block until no snapshot is being written.
+    void wait();
+
+    JournalStats stats() const;
+
+private:
+    void _roll();
+    void _write_snapshot(std::uint64_t lsn, const Encoder &encode);
+
+    std::string dir_;
+    JournalOptions options_;
+
+    mutable std::mutex mtx_;           ///< Protects the log state below
+    SegmentFile log_;                  ///< The newest log file
+    std::uint64_t log_first_{0};       ///< First lsn of log_
+    std::uint64_t log_offset_{0};      ///< End of log_
+    std::uint64_t lsn_{0};             ///< Last record appended
+    std::uint64_t since_snapshot_{0};  ///< Log bytes after the snapshot
+    std::uint64_t snapshot_lsn_{0};
+    std::uint64_t snapshots_{0};
+    std::uint64_t failures_{0};
+
+    std::mutex writer_mtx_;             ///< Protects writer_
+    std::atomic<bool> writing_{false};  ///< A snapshot is in flight
+    std::thread writer_;                ///< Writes it
+};
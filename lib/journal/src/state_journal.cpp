@@ -0,0 +1,291 @@
+// impl for state_journal.hpp
+
+#include "state_journal.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#include "mapped_file.hpp"  // MappedFile
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+constexpr std::size_t kRecordHeader = 4 + 8;  ///< size, lsn
+constexpr std::size_t kSnapHeader = 8 + 8 + 8;  ///< magic, lsn, size
+constexpr std::uint64_t kSnapMagic = 0x31504e5354415453;  ///< "STATSNP1"
+
+void put(std::string &buf, std::uint64_t v, int bytes)
+{
+    for (int i = 0; i < bytes; ++i)
+        buf.push_back(static_cast<char>(v >> (8 * i)));
+}
+
+std::uint64_t get(const char *p, int bytes)
+{
+    std::uint64_t v = 0;
+    for (int i = 0; i < bytes; ++i)
+        v |= std::uint64_t{static_cast<unsigned char>(p[i])} << (8 * i);
+    return v;
+}
+
+/// <lsn>.log or <lsn>.snap
+std::string file_name(std::uint64_t lsn, const char *ext)
+{
+    char name[40];
+    std::snprintf(name, sizeof(name), "%020llu%s",
+                  static_cast<unsigned long long>(lsn), ext);
+    return name;
+}
+
+/// @return false if @p path is not a file_name() with extension @p ext.
+bool parse_name(const fs::path &path, const char *ext, std::uint64_t &lsn)
+{
+    const std::string stem = path.stem().string();
+    if (path.extension() != ext || stem.size() != 20 ||
+        stem.find_first_not_of("0123456789") != std::string::npos)
+        return false;
+    lsn = std::strtoull(stem.c_str(), nullptr, 10);
+    return true;
+}
+
+std::string read_file(const fs::path &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        throw std::runtime_error("cannot read " + path.string());
+    return std::string(std::istreambuf_iterator<char>(in),
+                       std::istreambuf_iterator<char>());
+}
+
+}  // namespace
+
+StateJournal::StateJournal(std::string dir, JournalOptions options)
+    : dir_(std::move(dir)), options_(options)
+{
+    std::error_code ec;
+    fs::create_directories(dir_, ec);
+    if (ec || !fs::is_directory(dir_))
+        throw std::runtime_error("cannot create journal directory " + dir_);
+}
+
+StateJournal::~StateJournal()
+{
+    wait();
+}
+
+JournalRecovery StateJournal::recover(
+    const std::function<bool(std::string_view image)> &load,
+    const std::function<void(std::string_view record)> &replay)
+{
+    std::vector<std::uint64_t> logs, snaps;
+    for (const auto &entry : fs::directory_iterator(dir_)) {
+        std::uint64_t lsn;
+        if (parse_name(entry.path(), ".log", lsn))
+            logs.push_back(lsn);
+        else if (parse_name(entry.path(), ".snap", lsn))
+            snaps.push_back(lsn);
+        else if (entry.path().extension() == ".tmp")
+            fs::remove(entry.path());  // a snapshot cut short by a crash
+    }
+    std::sort(logs.begin(), logs.end());
+    std::sort(snaps.begin(), snaps.end());
+
+    // the newest snapshot is complete: it was renamed into place once
+    // synced, and older ones only go after that
+    JournalRecovery out;
+    if (!snaps.empty()) {
+        const auto path = (fs::path(dir_) / file_name(snaps.back(), ".snap"));
+        MappedFile map(path.string());
+        if (map.size() < kSnapHeader ||
+            get(map.data(), 8) != kSnapMagic ||
+            get(map.data() + 8, 8) != snaps.back() ||
+            get(map.data() + 16, 8) != map.size() - kSnapHeader)
+            throw std::runtime_error("corrupt snapshot " + path.string());
+        out.snapshot_lsn = snaps.back();
+        out.snapshot_bytes = map.size() - kSnapHeader;
+        if (!load(std::string_view(map.data() + kSnapHeader,
+                                   out.snapshot_bytes)))
+            throw std::runtime_error("cannot load snapshot " + path.string());
+    }
+
+    // the tail: records after the snapshot, in order. A torn append ends
+    // its file; the next file ( made by the restart ) picks up from it
+    std::uint64_t expected = out.snapshot_lsn + 1;
+    for (std::uint64_t first : logs) {
+        const std::string log =
+            read_file(fs::path(dir_) / file_name(first, ".log"));
+        std::size_t pos = 0;
+        while (log.size() - pos >= kRecordHeader) {
+            const std::uint64_t size = get(log.data() + pos, 4);
+            const std::uint64_t lsn = get(log.data() + pos + 4, 8);
+            if (size > log.size() - pos - kRecordHeader)
+                break;  // torn
+            if (lsn > expected)
+                throw std::runtime_error("state log has a gap before " +
+                                         std::to_string(lsn));
+            if (lsn == expected) {
+                replay(std::string_view(log.data() + pos + kRecordHeader,
+                                        static_cast<std::size_t>(size)));
+                ++expected;
+                ++out.replayed;
+                out.replayed_bytes += kRecordHeader + size;
+            }
+            pos += kRecordHeader + static_cast<std::size_t>(size);
+        }
+    }
+
+    std::lock_guard<std::mutex> lk(mtx_);
+    lsn_ = expected - 1;
+    snapshot_lsn_ = out.snapshot_lsn;
+    since_snapshot_ = out.replayed_bytes;
+    _roll();  // never append after a torn record
+    return out;
+}
+
+std::uint64_t StateJournal::append(std::string_view record)
+{
+    if (record.size() > 0xFFFFFFFF)
+        throw std::invalid_argument("journal record too large");
+    std::string buf;
+    buf.reserve(kRecordHeader + record.size());
+
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (!log_.is_open())
+        throw std::logic_error("StateJournal::append before recover");
+    put(buf, record.size(), 4);
+    put(buf, lsn_ + 1, 8);
+    buf.append(record.data(), record.size());
+    log_.write_at(log_offset_, buf.data(), buf.size());
+    log_offset_ += buf.size();
+    since_snapshot_ += buf.size();
+    return ++lsn_;
+}
+
+void StateJournal::sync()
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (log_.is_open())
+        log_.sync();
+}
+
+bool StateJournal::snapshot_due() const
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    return !writing_.load() && since_snapshot_ >= options_.snapshot_bytes;
+}
+
+bool StateJournal::snapshot(const std::function<Encoder()> &capture)
+{
+    std::lock_guard<std::mutex> wl(writer_mtx_);
+    if (writing_.exchange(true))
+        return false;
+    std::uint64_t lsn;
+    Encoder encode;
+    try {
+        {
+            std::lock_guard<std::mutex> lk(mtx_);
+            lsn = lsn_;
+            if (log_first_ != lsn_ + 1)
+                _roll();  // the old files end at lsn: deleted with it
+            since_snapshot_ = 0;
+        }
+        encode = capture();
+    } catch (...) {
+        writing_.store(false);
+        throw;
+    }
+    if (writer_.joinable())
+        writer_.join();  // finished: writing_ was clear
+    writer_ = std::thread([this, lsn, encode = std::move(encode)] {
+        _write_snapshot(lsn, encode);
+        writing_.store(false);
+    });
+    return true;
+}
+
+void StateJournal::wait()
+{
+    std::lock_guard<std::mutex> wl(writer_mtx_);
+    if (writer_.joinable())
+        writer_.join();
+}
+
+JournalStats StateJournal::stats() const
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    JournalStats out;
+    out.lsn = lsn_;
+    out.snapshot_lsn = snapshot_lsn_;
+    out.snapshots = snapshots_;
+    out.failures = failures_;
+    out.log_bytes = since_snapshot_;
+    return out;
+}
+
+void StateJournal::_roll()
+{
+    const std::uint64_t first = lsn_ + 1;
+    const std::string path = (fs::path(dir_) / file_name(first, ".log"))
+                                 .string();
+    {
+        std::ofstream create(path, std::ios::binary | std::ios::trunc);
+        if (!create)
+            throw std::runtime_error("cannot create state log " + path);
+    }
+    log_.open(path);
+    sync_directory(dir_);
+    log_first_ = first;
+    log_offset_ = 0;
+}
+
+void StateJournal::_write_snapshot(std::uint64_t lsn, const Encoder &encode)
+{
+    const fs::path path = fs::path(dir_) / file_name(lsn, ".snap");
+    const fs::path tmp = fs::path(dir_) / (file_name(lsn, ".snap") + ".tmp");
+    try {
+        std::string image;
+        put(image, kSnapMagic, 8);
+        put(image, lsn, 8);
+        put(image, 0, 8);  // size, once known
+        encode(image);
+        const std::uint64_t size = image.size() - kSnapHeader;
+        for (int i = 0; i < 8; ++i)
+            image[16 + i] = static_cast<char>(size >> (8 * i));
+
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            out.write(image.data(), static_cast<std::streamsize>(image.size()));
+            if (!out)
+                throw std::runtime_error("cannot write " + tmp.string());
+        }
+        SegmentFile file;
+        file.open(tmp.string());
+        file.sync();
+        file.close();
+        fs::rename(tmp, path);
+        sync_directory(dir_);  // from here on, a restart loads it
+
+        // everything it covers can go
+        for (const auto &entry : fs::directory_iterator(dir_)) {
+            std::uint64_t n;
+            if ((parse_name(entry.path(), ".snap", n) && n < lsn) ||
+                (parse_name(entry.path(), ".log", n) && n <= lsn))
+                fs::remove(entry.path());
+        }
+        std::lock_guard<std::mutex> lk(mtx_);
+        snapshot_lsn_ = lsn;
+        ++snapshots_;
+    } catch (const std::exception &) {
+        std::error_code ec;
+        fs::remove(tmp, ec);
+        std::lock_guard<std::mutex> lk(mtx_);
+        ++failures_;
+    }
+}
@@ -13,6 +13,9 @@
 // optional
 #include <optional>
 
+// batch push
+#include <vector>
+
 // queue for MT-safe
 /**
  * @brief Thread-safe queue version
@@ -89,6 +92,23 @@ public:
      */
     void push(const T &item_);
 
+    /**
+     * @brief Push a new value by move and notify one waiting thread.
+     *
+     * @param item_ The value to be moved into the queue.
+     */
+    void push(T &&item_);
+
+    /**
+     * @brief Push several values with one lock acquisition and one wake-up.
+     *
+     * @param items_ Values moved into the queue in order; left empty.
+     *
+     * NOTE: Wakes all waiting threads if more than one value is pushed, so
+     * several consumers can share the batch.
+     */
+    void push_batch(std::vector<T> &items_);
+
     // -- shutdown -- //
 
     /**
@@ -159,6 +179,32 @@ inline void Queue<T>::push(const T &item_)
     cv_.notify_one();
 }
 
+template <typename T>
+inline void Queue<T>::push(T &&item_)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    my_queue_.push(std::move(item_));
+    cv_.notify_one();
+}
+
+template <typename T>
+inline void Queue<T>::push_batch(std::vector<T> &items_)
+{
+    if (items_.empty())
+        return;
+    const bool many = items_.size() > 1;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        for (auto &item : items_)
+            my_queue_.push(std::move(item));
+    }
+    items_.clear();
+    if (many)
+        cv_.notify_all();
+    else
+        cv_.notify_one();
+}
+
 template <typename T>
 inline void Queue<T>::shutdown()
 {
@@ -0,0 +1,205 @@
+// roaring_set.hpp : compressed set of 32-bit ids ( roaring-style )
+#pragma once
+
+#include <algorithm>  // std::lower_bound
+#include <cstddef>    // std::size_t
+#include <cstdint>    // fixed-width integers
+#include <vector>     // chunks, containers
+
+#ifdef _MSC_VER
+#include <intrin.h>  // _BitScanForward64
+#endif
+
+/// @brief Index of the lowest set bit of @p x ( x != 0 ).
+inline unsigned lowest_bit(std::uint64_t x)
+{
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward64(&i, x);
+    return static_cast<unsigned>(i);
+#else
+    return static_cast<unsigned>(__builtin_ctzll(x));
+#endif
+}
+
+/**
+ * @brief Set of 32-bit ids split into 64K-id chunks by the high 16 bits.
+ *
+ * Each chunk picks its own container, as in Roaring bitmaps:
+ *   - array  : sorted 16-bit low halves, while it holds <= 4096 ids
+ *              ( 2 bytes per id )
+ *   - bitmap : 1024 x 64-bit words once it holds more ( 8 KB, which is
+ *              what 4096 array entries would cost )
+ *
+ * A set that is probed far more than it is iterated ( e.g. who is online )
+ * can be built with array_max = 0: every chunk is then a bitmap, one bit
+ * per possible id, and contains() is a single bit test.
+ *
+ * for_each_common() intersects two sets chunk by chunk with the cheapest
+ * kernel for the container pair: a word-wise AND for two bitmaps, a bit
+ * test per element when one side is an array, a merge for two arrays. The
+ * work is bounded by the smaller side of every chunk pair, not by the
+ * total size of either set.
+ *
+ * NOTE: Not thread-safe.
+ */
+class RoaringSet
+{
+public:
+    static constexpr std::size_t kArrayMax = 4096;  ///< Default array_max
+
+    /**
+     * @param array_max Ids a chunk holds as an array before it switches to
+     * a bitmap. 4096 is where both cost the same memory.
+     */
+    explicit RoaringSet(std::size_t array_max = kArrayMax)
+        : array_max_(array_max)
+    {
+    }
+
+    /// @return false if @p x was already present.
+    bool add(std::uint32_t x);
+
+    /// @return false if @p x was absent.
+    bool remove(std::uint32_t x);
+
+    bool contains(std::uint32_t x) const;
+
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    /// @brief Heap bytes held by the containers.
+    std::size_t memory() const;
+
+    /**
+     * @brief Call @p f(id) for every id, ascending.
+     */
+    template <typename F>
+    void for_each(F &&f) const
+    {
+        for (const auto &c : chunks_) {
+            const std::uint32_t base = std::uint32_t{c.key} << 16;
+            if (c.is_bitmap()) {
+                for (std::size_t w = 0; w < kWords; ++w)
+                    _each_bit(c.bits[w], base + w * 64, f);
+            } else {
+                for (std::uint16_t low : c.array)
+                    f(base | low);
+            }
+        }
+    }
+
+    /**
+     * @brief Call @p f(id) for every id in both this set and @p other,
+     * ascending.
+     */
+    template <typename F>
+    void for_each_common(const RoaringSet &other, F &&f) const
+    {
+        auto a = chunks_.begin(), ae = chunks_.end();
+        auto b = other.chunks_.begin(), be = other.chunks_.end();
+        while (a != ae && b != be) {
+            if (a->key < b->key) {
+                ++a;
+            } else if (b->key < a->key) {
+                ++b;
+            } else {
+                _intersect(*a, *b, f);
+                ++a;
+                ++b;
+            }
+        }
+    }
+
+private:
+    static constexpr std::size_t kWords = 65536 / 64;
+
+    struct Chunk {
+        std::uint16_t key;                 ///< High 16 bits
+        std::uint32_t card{0};             ///< Ids in this chunk
+        std::vector<std::uint16_t> array;  ///< Sorted, if not a bitmap
+        std::vector<std::uint64_t> bits;   ///< kWords words, or empty
+
+        bool is_bitmap() const { return !bits.empty(); }
+        bool test(std::uint16_t low) const;
+    };
+
+    template <typename F>
+    static void _each_bit(std::uint64_t word, std::uint32_t base, F &f)
+    {
+        while (word) {
+            f(base + lowest_bit(word));
+            word &= word - 1;
+        }
+    }
+
+    template <typename F>
+    static void _intersect(const Chunk &a, const Chunk &b, F &f)
+    {
+        const std::uint32_t base = std::uint32_t{a.key} << 16;
+        if (a.is_bitmap() && b.is_bitmap()) {
+            for (std::size_t w = 0; w < kWords; ++w)
+                _each_bit(a.bits[w] & b.bits[w], base + w * 64, f);
+        } else if (a.is_bitmap()) {
+            _probe(b.array, a, base, f);
+        } else if (b.is_bitmap()) {
+            _probe(a.array, b, base, f);
+        } else if (a.card <= b.card) {
+            _merge(a.array, b.array, base, f);
+        } else {
+            _merge(b.array, a.array, base, f);
+        }
+    }
+
+    /// Every element of @p small that is set in bitmap @p big.
+    template <typename F>
+    static void _probe(const std::vector<std::uint16_t> &small,
+                       const Chunk &big,
+                       std::uint32_t base,
+                       F &f)
+    {
+        for (std::uint16_t low : small)
+            if (big.test(low))
+                f(base | low);
+    }
+
+    /// Sorted intersection; @p x is the smaller side. When @p y is much
+    /// larger, elements of @p x are searched in it instead of walking it.
+    template <typename F>
+    static void _merge(const std::vector<std::uint16_t> &x,
+                       const std::vector<std::uint16_t> &y,
+                       std::uint32_t base,
+                       F &f)
+    {
+        auto j = y.begin();
+        if (x.size() * 16 < y.size()) {
+            for (std::uint16_t low : x) {
+                j = std::lower_bound(j, y.end(), low);
+                if (j == y.end())
+                    return;
+                if (*j == low)
+                    f(base | low);
+            }
+            return;
+        }
+        auto i = x.begin();
+        while (i != x.end() && j != y.end()) {
+            if (*i < *j) {
+                ++i;
+            } else if (*j < *i) {
+                ++j;
+            } else {
+                f(base | *i);
+                ++i;
+                ++j;
+            }
+        }
+    }
+
+    Chunk *_find(std::uint16_t key);
+    const Chunk *_find(std::uint16_t key) const;
+
+    std::size_t array_max_;      ///< array -> bitmap
+    std::vector<Chunk> chunks_;  ///< Sorted by key
+    std::size_t size_{0};        ///< Total ids
+};
@@ -0,0 +1,65 @@
+// room_registry.hpp : group chat rooms and their membership
+#pragma once
+
+#include <cstddef>        // std::size_t
+#include <string>         // room names
+#include <string_view>    // snapshot images
+#include <unordered_map>  // name -> room
+#include <vector>         // fan-out lists
+
+#include "roaring_set.hpp"  // RoaringSet
+#include "user_ids.hpp"     // UserId
+
+/**
+ * @brief Rooms by name, each holding its members as a RoaringSet.
+ *
+ * Fan-out never walks the whole member list: online_members() intersects
+ * the room with the set of online users, so the cost follows the smaller
+ * of the two per 64K-id chunk. A 10k-member room with 5% online costs
+ * about as much as a 500-member one.
+ *
+ * A room exists while it has members; the last leave() drops it.
+ *
+ * NOTE: Not thread-safe; the owner provides locking.
+ */
+class RoomRegistry
+{
+public:
+    /// @return false if @p user already was a member.
+    bool join(const std::string &room, UserId user);
+
+    /// @return false if @p user was not a member.
+    bool leave(const std::string &room, UserId user);
+
+    bool is_member(const std::string &room, UserId user) const;
+
+    /// @brief Member count of @p room ( 0 if it does not exist ).
+    std::size_t members(const std::string &room) const;
+
+    /// @brief Number of non-empty rooms.
+    std::size_t rooms() const { return rooms_.size(); }
+
+    /// @brief Append an image of every room and its member ids to @p out.
+    void save(std::string &out) const;
+
+    /**
+     * @brief Replace the rooms with an image made by save(), consumed from
+     * the front of @p in.
+     * @param users Member ids must be below it ( names known ).
+     * @return false, leaving the rooms unchanged, if the image is
+     * malformed.
+     */
+    bool load(std::string_view &in, std::size_t users);
+
+    /**
+     * @brief Members of @p room that are in @p online, ascending.
+     * @param[out] out Replaced with the recipients.
+     * @return false if the room does not exist.
+     */
+    bool online_members(const std::string &room,
+                        const RoaringSet &online,
+                        std::vector<UserId> &out) const;
+
+private:
+    std::unordered_map<std::string, RoaringSet> rooms_;  ///< name -> members
+};
@@ -0,0 +1,124 @@
+// impl for roaring_set.hpp
+
+#include "roaring_set.hpp"
+
+namespace
+{
+
+constexpr std::uint64_t bit(std::uint16_t low)
+{
+    return std::uint64_t{1} << (low & 63);
+}
+
+}  // namespace
+
+bool RoaringSet::Chunk::test(std::uint16_t low) const
+{
+    if (is_bitmap())
+        return (bits[low >> 6] & bit(low)) != 0;
+    return std::binary_search(array.begin(), array.end(), low);
+}
+
+bool RoaringSet::add(std::uint32_t x)
+{
+    const auto key = static_cast<std::uint16_t>(x >> 16);
+    const auto low = static_cast<std::uint16_t>(x);
+
+    auto it = std::lower_bound(
+        chunks_.begin(), chunks_.end(), key,
+        [](const Chunk &c, std::uint16_t k) { return c.key < k; });
+    if (it == chunks_.end() || it->key != key) {
+        it = chunks_.insert(it, Chunk{});
+        it->key = key;
+    }
+    Chunk &c = *it;
+
+    if (c.is_bitmap()) {
+        std::uint64_t &w = c.bits[low >> 6];
+        if (w & bit(low))
+            return false;
+        w |= bit(low);
+    } else {
+        auto pos = std::lower_bound(c.array.begin(), c.array.end(), low);
+        if (pos != c.array.end() && *pos == low)
+            return false;
+        if (c.array.size() < array_max_) {
+            c.array.insert(pos, low);
+        } else {
+            // array full: switch to the bitmap
+            c.bits.assign(kWords, 0);
+            for (std::uint16_t v : c.array)
+                c.bits[v >> 6] |= bit(v);
+            c.bits[low >> 6] |= bit(low);
+            std::vector<std::uint16_t>().swap(c.array);
+        }
+    }
+    ++c.card;
+    ++size_;
+    return true;
+}
+
+bool RoaringSet::remove(std::uint32_t x)
+{
+    const auto key = static_cast<std::uint16_t>(x >> 16);
+    const auto low = static_cast<std::uint16_t>(x);
+
+    Chunk *c = _find(key);
+    if (!c)
+        return false;
+
+    if (c->is_bitmap()) {
+        std::uint64_t &w = c->bits[low >> 6];
+        if (!(w & bit(low)))
+            return false;
+        w &= ~bit(low);
+        if (c->card - 1 <= array_max_ && c->card > 1) {
+            // back to an array
+            auto push = [c](std::uint32_t v) {
+                c->array.push_back(static_cast<std::uint16_t>(v));
+            };
+            c->array.reserve(c->card - 1);
+            for (std::size_t i = 0; i < kWords; ++i)
+                _each_bit(c->bits[i], static_cast<std::uint32_t>(i * 64), push);
+            std::vector<std::uint64_t>().swap(c->bits);
+        }
+    } else {
+        auto pos = std::lower_bound(c->array.begin(), c->array.end(), low);
+        if (pos == c->array.end() || *pos != low)
+            return false;
+        c->array.erase(pos);
+    }
+    --size_;
+    if (--c->card == 0)
+        chunks_.erase(chunks_.begin() + (c - chunks_.data()));
+    return true;
+}
+
+bool RoaringSet::contains(std::uint32_t x) const
+{
+    const Chunk *c = _find(static_cast<std::uint16_t>(x >> 16));
+    return c && c->test(static_cast<std::uint16_t>(x));
+}
+
+std::size_t RoaringSet::memory() const
+{
+    std::size_t bytes = chunks_.capacity() * sizeof(Chunk);
+    for (const auto &c : chunks_)
+        bytes += c.array.capacity() * sizeof(std::uint16_t) +
+                 c.bits.capacity() * sizeof(std::uint64_t);
+    return bytes;
+}
+
+RoaringSet::Chunk *RoaringSet::_find(std::uint16_t key)
+{
+    const auto *self = this;
+    return const_cast<Chunk *>(self->_find(key));
+}
+
+const RoaringSet::Chunk *RoaringSet::_find(std::uint16_t key) const
+{
+    auto it = std::lower_bound(
+        chunks_.begin(), chunks_.end(), key,
+        [](const Chunk &c, std::uint16_t k) { return c.key < k; });
+    return it != chunks_.end() && it->key == key ? &*it : nullptr;
+}
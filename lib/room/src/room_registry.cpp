@@ -0,0 +1,107 @@
+// impl for room_registry.hpp
+
+#include "room_registry.hpp"
+
+namespace
+{
+
+void put(std::string &buf, std::uint64_t v, int bytes)
+{
+    for (int i = 0; i < bytes; ++i)
+        buf.push_back(static_cast<char>(v >> (8 * i)));
+}
+
+/// Read a little-endian integer off the front of @p in.
+bool take(std::string_view &in, int bytes, std::uint64_t &v)
+{
+    if (in.size() < static_cast<std::size_t>(bytes))
+        return false;
+    v = 0;
+    for (int i = 0; i < bytes; ++i)
+        v |= std::uint64_t{static_cast<unsigned char>(in[i])} << (8 * i);
+    in.remove_prefix(bytes);
+    return true;
+}
+
+}  // namespace
+
+bool RoomRegistry::join(const std::string &room, UserId user)
+{
+    return rooms_[room].add(user);
+}
+
+bool RoomRegistry::leave(const std::string &room, UserId user)
+{
+    auto it = rooms_.find(room);
+    if (it == rooms_.end() || !it->second.remove(user))
+        return false;
+    if (it->second.empty())
+        rooms_.erase(it);
+    return true;
+}
+
+bool RoomRegistry::is_member(const std::string &room, UserId user) const
+{
+    auto it = rooms_.find(room);
+    return it != rooms_.end() && it->second.contains(user);
+}
+
+std::size_t RoomRegistry::members(const std::string &room) const
+{
+    auto it = rooms_.find(room);
+    return it == rooms_.end() ? 0 : it->second.size();
+}
+
+bool RoomRegistry::online_members(const std::string &room,
+                                  const RoaringSet &online,
+                                  std::vector<UserId> &out) const
+{
+    out.clear();
+    auto it = rooms_.find(room);
+    if (it == rooms_.end())
+        return false;
+    it->second.for_each_common(online,
+                               [&out](std::uint32_t id) { out.push_back(id); });
+    return true;
+}
+
+void RoomRegistry::save(std::string &out) const
+{
+    put(out, rooms_.size(), 8);
+    for (const auto &room : rooms_) {
+        put(out, room.first.size(), 4);
+        out += room.first;
+        put(out, room.second.size(), 8);
+        room.second.for_each([&out](std::uint32_t id) { put(out, id, 4); });
+    }
+}
+
+bool RoomRegistry::load(std::string_view &in, std::size_t users)
+{
+    std::string_view rest = in;
+    std::uint64_t count, len, members, id;
+    // every room takes at least its name length and member count
+    if (!take(rest, 8, count) || count > rest.size() / 12)
+        return false;
+    std::unordered_map<std::string, RoaringSet> rooms;
+    for (std::uint64_t i = 0; i < count; ++i) {
+        if (!take(rest, 4, len) || len > rest.size())
+            return false;
+        std::string name(rest.substr(0, len));
+        rest.remove_prefix(len);
+        if (!take(rest, 8, members) || members == 0 ||
+            members > rest.size() / 4)
+            return false;
+        RoaringSet &set = rooms[name];
+        if (!set.empty())
+            return false;  // a room twice
+        for (std::uint64_t m = 0; m < members; ++m) {
+            if (!take(rest, 4, id) || id >= users ||
+                !set.add(static_cast<std::uint32_t>(id)))
+                return false;
+        }
+    }
+    rooms_.swap(rooms);
+    in = rest;
+    return true;
+}
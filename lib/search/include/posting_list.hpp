@@ -0,0 +1,60 @@
+// posting_list.hpp : compressed ascending list of document numbers
+#pragma once
+
+#include <cstddef>  // std::size_t
+#include <cstdint>  // document numbers
+#include <string>   // encoded bytes
+#include <vector>   // skips, decoded blocks
+
+/**
+ * @brief Ascending document numbers, delta- and varint-encoded.
+ *
+ * Each number is stored as its gap from the previous one in LEB128 ( 7
+ * bits per byte ), so the dense lists of common terms cost about a byte
+ * per entry. Entries are cut into blocks of kBlock; a skip entry per block
+ * ( the number before it and its byte offset ) lets contains() binary
+ * search to the right block and decode at most kBlock gaps, and lets a
+ * reader walk the list backwards block by block.
+ *
+ * NOTE: Not thread-safe. Documents only ever get appended, in order.
+ */
+class PostingList
+{
+public:
+    static constexpr std::size_t kBlock = 128;  ///< Entries per skip
+
+    /**
+     * @brief Append @p doc.
+     * @return false, storing nothing, unless @p doc is above last().
+     */
+    bool append(std::uint64_t doc);
+
+    bool contains(std::uint64_t doc) const;
+
+    /// @brief Index of the block @p doc would be in ( blocks() if none ).
+    std::size_t block_of(std::uint64_t doc) const;
+
+    /// @brief Replace @p out with the entries of block @p b, ascending.
+    void block(std::size_t b, std::vector<std::uint64_t> &out) const;
+
+    std::size_t blocks() const { return skips_.size(); }
+    std::size_t size() const { return size_; }
+    std::uint64_t last() const { return last_; }
+
+    /// @brief Heap bytes: the encoded gaps and the skips.
+    std::size_t bytes() const
+    {
+        return data_.capacity() + skips_.capacity() * sizeof(Skip);
+    }
+
+private:
+    struct Skip {
+        std::uint64_t base;    ///< Entry before the block, 0 for the first
+        std::uint32_t offset;  ///< Byte offset of the block in data_
+    };
+
+    std::string data_;
+    std::vector<Skip> skips_;
+    std::uint64_t last_{0};
+    std::size_t size_{0};
+};
@@ -0,0 +1,135 @@
+// search_index.hpp : incremental full-text index of chat messages
+#pragma once
+
+#include <cstddef>        // std::size_t
+#include <cstdint>        // ids, document numbers
+#include <shared_mutex>   // readers share
+#include <string>         // conversations, terms
+#include <string_view>    // text
+#include <unordered_map>  // term dictionary
+#include <vector>         // hits
+
+#include "posting_list.hpp"  // PostingList
+
+/**
+ * @brief One message that matched a query.
+ */
+struct SearchHit {
+    std::uint64_t doc;  ///< Position in the index; cursor for older hits
+    std::uint64_t id;   ///< Message id given to add()
+};
+
+/**
+ * @brief Inverted index of chat messages, per conversation.
+ *
+ * add() numbers each message ( 1, 2, 3, ... in call order, so newer is
+ * higher ), splits its text with tokenize() and appends the number to the
+ * posting list of every term, and to the list of its conversation. Lists
+ * only grow at the end, so indexing a message costs one varint per
+ * distinct term ( see PostingList ).
+ *
+ * A query is split the same way and matches the messages that have all
+ * its terms. Scoping to a conversation is one more list in the
+ * intersection. The smallest list drives: it is walked backwards from the
+ * cursor, block by block, and each of its entries is probed in the other
+ * lists ( a binary search over skips and at most PostingList::kBlock
+ * gaps ). A page costs what it takes to find limit hits, however long the
+ * history or common the terms.
+ *
+ * Documents are never removed: callers drop hits whose message was erased
+ * when they read them. The index lives in memory; save() writes it to a
+ * file with a caller's mark ( e.g. the clock of the newest message it
+ * holds ), and load() reads it back, so a restart only adds the messages
+ * stored after the mark.
+ *
+ * NOTE: Thread-safe. Searches share a lock; add() takes it alone, after
+ * tokenizing.
+ */
+class SearchIndex
+{
+public:
+    /**
+     * @brief Index message @p id of @p conversation.
+     * @return Its document number.
+     */
+    std::uint64_t add(const std::string &conversation,
+                      std::uint64_t id,
+                      std::string_view text);
+
+    /**
+     * @brief Up to @p limit messages of @p conversation matching
+     * @p query, newest first, below document @p before ( 0: from the
+     * newest ).
+     *
+     * Pass the last hit's doc as @p before for the next page. A query
+     * without terms matches nothing.
+     */
+    void search(const std::string &conversation,
+                std::string_view query,
+                std::uint64_t before,
+                std::size_t limit,
+                std::vector<SearchHit> &out) const;
+
+    /**
+     * @brief search() over several conversations, merged newest first.
+     */
+    void search(const std::vector<std::string> &conversations,
+                std::string_view query,
+                std::uint64_t before,
+                std::size_t limit,
+                std::vector<SearchHit> &out) const;
+
+    /**
+     * @brief Direct conversations ( "a\nb" keys ) @p user has messages in.
+     */
+    std::vector<std::string> conversations_of(const std::string &user) const;
+
+    /// @brief Drop every message.
+    void clear();
+
+    /// @brief Messages indexed.
+    std::uint64_t documents() const;
+
+    /// @brief Message id of document @p doc, 0 if there is none.
+    std::uint64_t id_of(std::uint64_t doc) const;
+
+    /**
+     * @brief Write the index to @p path ( through a temporary file, so a
+     * crash leaves the old one ), with @p mark.
+     * @return false if the file could not be written.
+     */
+    bool save(const std::string &path, std::uint64_t mark) const;
+
+    /**
+     * @brief Replace the index with the one saved in @p path.
+     * @param[out] mark The mark it was saved with.
+     * @return false, changing nothing, if the file is missing or damaged.
+     */
+    bool load(const std::string &path, std::uint64_t &mark);
+
+    /// @brief Distinct terms.
+    std::size_t terms() const;
+
+    /// @brief Term postings stored ( one per distinct term per message ).
+    std::uint64_t postings() const;
+
+    /// @brief Heap bytes of the posting lists, conversation lists included.
+    std::uint64_t bytes() const;
+
+private:
+    /// Hits of one conversation; terms are unique, shared lock held.
+    void _search(const std::string &conversation,
+                 const std::vector<std::string> &terms,
+                 std::uint64_t before,
+                 std::size_t limit,
+                 std::vector<SearchHit> &out) const;
+
+    mutable std::shared_mutex mtx_;
+    std::vector<std::uint64_t> ids_;  ///< Message id of document i + 1
+    std::unordered_map<std::string, PostingList> terms_;
+    std::unordered_map<std::string, PostingList> conversations_;
+    std::unordered_map<std::string, std::vector<std::string>>
+        users_;  ///< user -> direct conversations
+    std::uint64_t postings_{0};
+    std::uint64_t bytes_{0};
+};
@@ -0,0 +1,35 @@
+// tokenizer.hpp : chat text to search terms, CJK-aware
+#pragma once
+
+#include <string>       // terms
+#include <string_view>  // text
+#include <vector>       // output
+
+/**
+ * @brief What the terms are for: indexing a message, or querying.
+ */
+enum class TokenMode {
+    Index,  ///< CJK runs give unigrams and bigrams
+    Query,  ///< CJK runs give bigrams, a lone character its unigram
+};
+
+/**
+ * @brief Split UTF-8 @p text into search terms, appended to @p out.
+ *
+ * Words are runs of letters and digits: ASCII is lowercased, fullwidth
+ * forms ( Ａ１ ) are folded to ASCII, other letters are kept as they are.
+ * Words longer than 64 bytes are dropped.
+ *
+ * Chinese, Japanese and Korean text has no spaces, so runs of CJK
+ * characters ( ideographs, kana, hangul ) are cut into overlapping
+ * bigrams: 你好嗎 gives 你好 and 好嗎. A query matches a message when the
+ * message has all its bigrams, which finds any CJK substring of two or
+ * more characters without a dictionary. Messages also index every
+ * character alone, so a one-character query works too.
+ *
+ * Whitespace, punctuation ( ASCII, CJK and fullwidth ), symbols, emoji and
+ * invalid UTF-8 separate terms. Terms may repeat.
+ */
+void tokenize(std::string_view text,
+              TokenMode mode,
+              std::vector<std::string> &out);
@@ -0,0 +1,78 @@
+// impl for posting_list.hpp
+
+#include "posting_list.hpp"
+
+#include <algorithm>
+
+namespace
+{
+
+void put_varint(std::string &out, std::uint64_t v)
+{
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+std::uint64_t get_varint(const char *&p)
+{
+    std::uint64_t v = 0;
+    for (int shift = 0;; shift += 7) {
+        const auto byte = static_cast<unsigned char>(*p++);
+        v |= std::uint64_t{byte & 0x7Fu} << shift;
+        if (byte < 0x80)
+            return v;
+    }
+}
+
+}  // namespace
+
+bool PostingList::append(std::uint64_t doc)
+{
+    if (doc <= last_)
+        return false;
+    if (size_ % kBlock == 0)
+        skips_.push_back(Skip{last_, static_cast<std::uint32_t>(data_.size())});
+    put_varint(data_, doc - last_);
+    last_ = doc;
+    ++size_;
+    return true;
+}
+
+bool PostingList::contains(std::uint64_t doc) const
+{
+    if (doc > last_ || doc == 0)
+        return false;
+    const Skip &s = skips_[block_of(doc)];
+    const char *p = data_.data() + s.offset;
+    std::uint64_t v = s.base;
+    // the block holds an entry >= doc: last_ is one, in it or after
+    while (v < doc)
+        v += get_varint(p);
+    return v == doc;
+}
+
+std::size_t PostingList::block_of(std::uint64_t doc) const
+{
+    // last block whose entries start above base < doc
+    auto it = std::lower_bound(
+        skips_.begin(), skips_.end(), doc,
+        [](const Skip &s, std::uint64_t d) { return s.base < d; });
+    if (it == skips_.begin())
+        return skips_.size();
+    return static_cast<std::size_t>(it - skips_.begin()) - 1;
+}
+
+void PostingList::block(std::size_t b, std::vector<std::uint64_t> &out) const
+{
+    out.clear();
+    const std::size_t n = std::min(kBlock, size_ - b * kBlock);
+    const char *p = data_.data() + skips_[b].offset;
+    std::uint64_t v = skips_[b].base;
+    for (std::size_t i = 0; i < n; ++i) {
+        v += get_varint(p);
+        out.push_back(v);
+    }
+}
@@ -0,0 +1,383 @@
+// impl for search_index.hpp
+
+#include "search_index.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+
+#include "tokenizer.hpp"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+constexpr char kMagic[4] = {'S', 'I', 'X', '1'};
+
+/// FNV-1a, to tell a damaged file from a short one.
+std::uint64_t fnv1a(const char *p, std::size_t n)
+{
+    std::uint64_t h = 0xcbf29ce484222325ULL;
+    for (std::size_t i = 0; i < n; ++i) {
+        h ^= static_cast<unsigned char>(p[i]);
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+void put_varint(std::string &out, std::uint64_t v)
+{
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+void put_string(std::string &out, const std::string &s)
+{
+    put_varint(out, s.size());
+    out += s;
+}
+
+/// Gap-encoded, like the list itself; load() appends them back.
+void put_list(std::string &out, const PostingList &list)
+{
+    put_varint(out, list.size());
+    std::vector<std::uint64_t> docs;
+    std::uint64_t last = 0;
+    for (std::size_t b = 0; b < list.blocks(); ++b) {
+        list.block(b, docs);
+        for (const auto doc : docs) {
+            put_varint(out, doc - last);
+            last = doc;
+        }
+    }
+}
+
+/// Bounds-checked reader of a saved index; ok turns false for good on
+/// the first read past the end.
+struct Reader {
+    const char *p;
+    const char *end;
+    bool ok{true};
+
+    std::uint64_t varint()
+    {
+        std::uint64_t v = 0;
+        for (int shift = 0; ok && shift < 64; shift += 7) {
+            if (p == end)
+                break;
+            const auto byte = static_cast<unsigned char>(*p++);
+            v |= std::uint64_t{byte & 0x7Fu} << shift;
+            if (byte < 0x80)
+                return v;
+        }
+        ok = false;
+        return 0;
+    }
+
+    std::string string()
+    {
+        const std::uint64_t n = varint();
+        if (!ok || n > static_cast<std::uint64_t>(end - p)) {
+            ok = false;
+            return std::string();
+        }
+        std::string s(p, static_cast<std::size_t>(n));
+        p += n;
+        return s;
+    }
+
+    /// Documents must rise and stay within the @p docs indexed.
+    bool list(PostingList &out, std::uint64_t docs)
+    {
+        const std::uint64_t n = varint();
+        std::uint64_t doc = 0;
+        for (std::uint64_t i = 0; ok && i < n; ++i) {
+            doc += varint();
+            if (doc > docs || !out.append(doc))
+                ok = false;
+        }
+        return ok;
+    }
+};
+
+/// Query terms, each once.
+std::vector<std::string> query_terms(std::string_view query)
+{
+    std::vector<std::string> terms;
+    tokenize(query, TokenMode::Query, terms);
+    std::sort(terms.begin(), terms.end());
+    terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+    return terms;
+}
+
+}  // namespace
+
+std::uint64_t SearchIndex::add(const std::string &conversation,
+                               std::uint64_t id,
+                               std::string_view text)
+{
+    std::vector<std::string> terms;
+    tokenize(text, TokenMode::Index, terms);
+
+    std::unique_lock<std::shared_mutex> lk(mtx_);
+    ids_.push_back(id);
+    const std::uint64_t doc = ids_.size();
+
+    auto conv = conversations_.find(conversation);
+    if (conv == conversations_.end()) {
+        conv = conversations_.emplace(conversation, PostingList()).first;
+        const auto nl = conversation.find('\n');
+        if (nl != std::string::npos) {
+            users_[conversation.substr(0, nl)].push_back(conversation);
+            users_[conversation.substr(nl + 1)].push_back(conversation);
+        }
+    }
+    auto append = [this, doc](PostingList &list) {
+        const std::size_t was = list.bytes();
+        if (!list.append(doc))
+            return false;  // a repeated term
+        bytes_ += list.bytes() - was;
+        return true;
+    };
+    append(conv->second);
+    for (const auto &term : terms)
+        if (append(terms_[term]))
+            ++postings_;
+    return doc;
+}
+
+void SearchIndex::search(const std::string &conversation,
+                         std::string_view query,
+                         std::uint64_t before,
+                         std::size_t limit,
+                         std::vector<SearchHit> &out) const
+{
+    out.clear();
+    const auto terms = query_terms(query);
+    std::shared_lock<std::shared_mutex> lk(mtx_);
+    _search(conversation, terms, before, limit, out);
+}
+
+void SearchIndex::search(const std::vector<std::string> &conversations,
+                         std::string_view query,
+                         std::uint64_t before,
+                         std::size_t limit,
+                         std::vector<SearchHit> &out) const
+{
+    out.clear();
+    const auto terms = query_terms(query);
+    std::vector<SearchHit> some;
+    std::shared_lock<std::shared_mutex> lk(mtx_);
+    for (const auto &conversation : conversations) {
+        _search(conversation, terms, before, limit, some);
+        out.insert(out.end(), some.begin(), some.end());
+    }
+    // each is newest first and at most limit: the best limit of all
+    std::sort(out.begin(), out.end(),
+              [](const SearchHit &a, const SearchHit &b) {
+                  return a.doc > b.doc;
+              });
+    if (out.size() > limit)
+        out.resize(limit);
+}
+
+std::vector<std::string> SearchIndex::conversations_of(
+    const std::string &user) const
+{
+    std::shared_lock<std::shared_mutex> lk(mtx_);
+    auto it = users_.find(user);
+    return it == users_.end() ? std::vector<std::string>() : it->second;
+}
+
+std::uint64_t SearchIndex::documents() const
+{
+    std::shared_lock<std::shared_mutex> lk(mtx_);
+    return ids_.size();
+}
+
+void SearchIndex::clear()
+{
+    std::unique_lock<std::shared_mutex> lk(mtx_);
+    ids_.clear();
+    terms_.clear();
+    conversations_.clear();
+    users_.clear();
+    postings_ = 0;
+    bytes_ = 0;
+}
+
+std::uint64_t SearchIndex::id_of(std::uint64_t doc) const
+{
+    std::shared_lock<std::shared_mutex> lk(mtx_);
+    return doc == 0 || doc > ids_.size() ? 0 : ids_[doc - 1];
+}
+
+bool SearchIndex::save(const std::string &path, std::uint64_t mark) const
+{
+    std::string out(kMagic, sizeof(kMagic));
+    put_varint(out, mark);
+    {
+        std::shared_lock<std::shared_mutex> lk(mtx_);
+        put_varint(out, ids_.size());
+        for (const auto id : ids_)
+            put_varint(out, id);
+        put_varint(out, conversations_.size());
+        for (const auto &c : conversations_) {
+            put_string(out, c.first);
+            put_list(out, c.second);
+        }
+        put_varint(out, terms_.size());
+        for (const auto &t : terms_) {
+            put_string(out, t.first);
+            put_list(out, t.second);
+        }
+    }
+    const std::uint64_t sum = fnv1a(out.data(), out.size());
+    for (int i = 0; i < 8; ++i)
+        out.push_back(static_cast<char>(sum >> (8 * i)));
+
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+        file.write(out.data(), static_cast<std::streamsize>(out.size()));
+        if (!file.flush())
+            return false;
+    }
+    std::error_code ec;
+    fs::rename(tmp, path, ec);
+    if (ec)
+        fs::remove(tmp, ec);
+    return !ec;
+}
+
+bool SearchIndex::load(const std::string &path, std::uint64_t &mark)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    const std::string in((std::istreambuf_iterator<char>(file)),
+                         std::istreambuf_iterator<char>());
+    if (in.size() < sizeof(kMagic) + 8 ||
+        in.compare(0, sizeof(kMagic), kMagic, sizeof(kMagic)) != 0)
+        return false;
+    const std::size_t body = in.size() - 8;
+    std::uint64_t sum = 0;
+    for (int i = 0; i < 8; ++i)
+        sum |= std::uint64_t{static_cast<unsigned char>(in[body + i])}
+               << (8 * i);
+    if (sum != fnv1a(in.data(), body))
+        return false;
+
+    // build aside, swap in only if the whole file reads back
+    Reader r{in.data() + sizeof(kMagic), in.data() + body};
+    const std::uint64_t saved_mark = r.varint();
+    std::vector<std::uint64_t> ids(
+        std::min<std::uint64_t>(r.varint(), body));
+    for (auto &id : ids)
+        id = r.varint();
+    std::unordered_map<std::string, PostingList> conversations, terms;
+    std::unordered_map<std::string, std::vector<std::string>> users;
+    std::uint64_t postings = 0, bytes = 0;
+    for (std::uint64_t n = r.varint(); r.ok && n > 0; --n) {
+        std::string name = r.string();
+        PostingList &list = conversations[name];
+        if (!r.list(list, ids.size()))
+            break;
+        bytes += list.bytes();
+        const auto nl = name.find('\n');
+        if (nl != std::string::npos) {
+            users[name.substr(0, nl)].push_back(name);
+            users[name.substr(nl + 1)].push_back(name);
+        }
+    }
+    for (std::uint64_t n = r.ok ? r.varint() : 0; r.ok && n > 0; --n) {
+        PostingList &list = terms[r.string()];
+        if (!r.list(list, ids.size()))
+            break;
+        bytes += list.bytes();
+        postings += list.size();
+    }
+    if (!r.ok || r.p != r.end)
+        return false;
+
+    std::unique_lock<std::shared_mutex> lk(mtx_);
+    ids_ = std::move(ids);
+    conversations_ = std::move(conversations);
+    terms_ = std::move(terms);
+    users_ = std::move(users);
+    postings_ = postings;
+    bytes_ = bytes;
+    mark = saved_mark;
+    return true;
+}
+
+std::size_t SearchIndex::terms() const
+{
+    std::shared_lock<std::shared_mutex> lk(mtx_);
+    return terms_.size();
+}
+
+std::uint64_t SearchIndex::postings() const
+{
+    std::shared_lock<std::shared_mutex> lk(mtx_);
+    return postings_;
+}
+
+std::uint64_t SearchIndex::bytes() const
+{
+    std::shared_lock<std::shared_mutex> lk(mtx_);
+    return bytes_;
+}
+
+void SearchIndex::_search(const std::string &conversation,
+                          const std::vector<std::string> &terms,
+                          std::uint64_t before,
+                          std::size_t limit,
+                          std::vector<SearchHit> &out) const
+{
+    out.clear();
+    auto conv = conversations_.find(conversation);
+    if (terms.empty() || limit == 0 || conv == conversations_.end())
+        return;
+    std::vector<const PostingList *> lists{&conv->second};
+    for (const auto &term : terms) {
+        auto it = terms_.find(term);
+        if (it == terms_.end())
+            return;  // a term nobody used
+        lists.push_back(&it->second);
+    }
+    // the smallest list drives, the others are probed
+    std::iter_swap(lists.begin(),
+                   std::min_element(lists.begin(), lists.end(),
+                                    [](const auto *a, const auto *b) {
+                                        return a->size() < b->size();
+                                    }));
+    const PostingList &driver = *lists.front();
+
+    // from the block holding the entries just below the cursor
+    std::size_t b = driver.blocks();
+    if (before != 0 && b != 0)
+        b = std::min(b, driver.block_of(before) + 1);
+    std::vector<std::uint64_t> docs;
+    while (b-- > 0 && out.size() < limit) {
+        driver.block(b, docs);
+        for (auto it = docs.rbegin(); it != docs.rend(); ++it) {
+            if (before != 0 && *it >= before)
+                continue;
+            const bool all = std::all_of(
+                lists.begin() + 1, lists.end(),
+                [&](const PostingList *l) { return l->contains(*it); });
+            if (!all)
+                continue;
+            out.push_back(SearchHit{*it, ids_[*it - 1]});
+            if (out.size() == limit)
+                break;
+        }
+    }
+}
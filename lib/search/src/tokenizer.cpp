@@ -0,0 +1,154 @@
+// impl for tokenizer.hpp
+
+#include "tokenizer.hpp"
+
+#include <cstdint>
+
+namespace
+{
+
+constexpr std::size_t kMaxWord = 64;  ///< Longer: a URL, a key, a paste
+
+enum class Kind { Separator, Word, Cjk };
+
+/// Next code point of @p s at @p i ( advanced ); invalid bytes give
+/// 0xFFFD, one byte at a time.
+std::uint32_t next_code_point(std::string_view s, std::size_t &i)
+{
+    const auto b = [&](std::size_t k) {
+        return static_cast<unsigned char>(s[k]);
+    };
+    const unsigned char c = b(i);
+    std::size_t len = 0;
+    if (c < 0x80)
+        len = 1;
+    else if ((c >> 5) == 0x6)
+        len = 2;
+    else if ((c >> 4) == 0xE)
+        len = 3;
+    else if ((c >> 3) == 0x1E)
+        len = 4;
+    if (len == 0 || i + len > s.size()) {
+        ++i;
+        return 0xFFFD;
+    }
+    std::uint32_t cp = len == 1 ? c : c & (0x7F >> len);
+    for (std::size_t k = 1; k < len; ++k) {
+        if ((b(i + k) & 0xC0) != 0x80) {
+            ++i;
+            return 0xFFFD;
+        }
+        cp = (cp << 6) | (b(i + k) & 0x3F);
+    }
+    i += len;
+    return cp;
+}
+
+/// Fullwidth ASCII letters and digits as ASCII; @p cp otherwise.
+std::uint32_t fold(std::uint32_t cp)
+{
+    if ((cp >= 0xFF10 && cp <= 0xFF19) || (cp >= 0xFF21 && cp <= 0xFF3A) ||
+        (cp >= 0xFF41 && cp <= 0xFF5A))
+        cp -= 0xFEE0;
+    if (cp >= 'A' && cp <= 'Z')
+        cp += 'a' - 'A';
+    return cp;
+}
+
+Kind kind(std::uint32_t cp)
+{
+    if (cp < 0x80)
+        return (cp >= 'a' && cp <= 'z') || (cp >= '0' && cp <= '9')
+                   ? Kind::Word
+                   : Kind::Separator;
+    if ((cp >= 0x4E00 && cp <= 0x9FFF) ||    // CJK unified ideographs
+        (cp >= 0x3400 && cp <= 0x4DBF) ||    // extension A
+        (cp >= 0x20000 && cp <= 0x2FA1F) ||  // extensions B.., compat
+        (cp >= 0xF900 && cp <= 0xFAFF) ||    // compatibility ideographs
+        (cp >= 0x3040 && cp <= 0x30FF) ||    // hiragana, katakana
+        (cp >= 0xAC00 && cp <= 0xD7AF))      // hangul syllables
+        return Kind::Cjk;
+    if (cp <= 0xBF || cp == 0xD7 || cp == 0xF7 ||  // Latin-1 symbols
+        (cp >= 0x2000 && cp <= 0x2BFF) ||  // punctuation, symbols, arrows
+        (cp >= 0x3000 && cp <= 0x303F) ||  // CJK punctuation
+        (cp >= 0xFE30 && cp <= 0xFE4F) ||  // CJK compatibility forms
+        (cp >= 0xFF00 && cp <= 0xFFEF) ||  // fullwidth punctuation
+        cp >= 0x1F000 || cp == 0xFFFD)     // emoji, invalid
+        return Kind::Separator;
+    return Kind::Word;  // other scripts: letters as far as we can tell
+}
+
+void put_utf8(std::string &out, std::uint32_t cp)
+{
+    if (cp < 0x80) {
+        out.push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+/// Terms of one run of CJK characters ( as UTF-8 pieces ).
+void cjk_terms(const std::vector<std::string_view> &run,
+               TokenMode mode,
+               std::vector<std::string> &out)
+{
+    if (mode == TokenMode::Index || run.size() == 1)
+        for (const auto c : run)
+            out.emplace_back(c);
+    for (std::size_t i = 0; i + 1 < run.size(); ++i) {
+        std::string bigram(run[i]);
+        bigram.append(run[i + 1].data(), run[i + 1].size());
+        out.push_back(std::move(bigram));
+    }
+}
+
+}  // namespace
+
+void tokenize(std::string_view text,
+              TokenMode mode,
+              std::vector<std::string> &out)
+{
+    std::string word;
+    std::vector<std::string_view> run;  // CJK characters, in text
+    const auto end_word = [&] {
+        if (!word.empty() && word.size() <= kMaxWord)
+            out.push_back(word);
+        word.clear();
+    };
+    const auto end_run = [&] {
+        if (!run.empty())
+            cjk_terms(run, mode, out);
+        run.clear();
+    };
+
+    for (std::size_t i = 0; i < text.size();) {
+        const std::size_t at = i;
+        const std::uint32_t cp = fold(next_code_point(text, i));
+        switch (kind(cp)) {
+        case Kind::Word:
+            end_run();
+            put_utf8(word, cp);
+            break;
+        case Kind::Cjk:
+            end_word();
+            run.push_back(text.substr(at, i - at));
+            break;
+        case Kind::Separator:
+            end_word();
+            end_run();
+            break;
+        }
+    }
+    end_word();
+    end_run();
+}
@@ -0,0 +1,171 @@
+// watchdog.hpp : deadline tracking for event handlers
+#pragma once
+
+// -- Standard Library -- //
+#include <chrono>         // steady_clock, durations
+#include <cstdint>        // std::uint64_t
+#include <functional>     // report callback
+#include <string>         // labels
+#include <unordered_map>  // armed tickets and throttled owners
+
+// -- Thread Support Headers -- //
+#include <condition_variable>  // wake the monitor thread on shutdown
+#include <mutex>               // protects the tables
+#include <thread>              // monitor thread
+
+/**
+ * @brief Watches running handlers and reports the ones that miss their
+ * deadline.
+ *
+ * A caller arms a Ticket before running a handler and drops it afterwards.
+ * A background thread scans the armed tickets every tick; a ticket that is
+ * still alive past its deadline is reported once while it is running and
+ * once more when it finally finishes ( with the total duration ).
+ *
+ * The owner of an overrunning ticket ( usually a connection ) is throttled
+ * until its last overrunning ticket is released plus a cool-down period,
+ * so callers can shed or defer that owner's further work instead of
+ * letting it block others.
+ *
+ * NOTE: A C++ thread cannot be cancelled; the watchdog only observes.
+ * NOTE: This class is not copyable or movable ( owns a thread ).
+ */
+class Watchdog
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Information about one overrun.
+     */
+    struct Overrun {
+        std::string label;        ///< What was running ( e.g. event type )
+        std::uint64_t owner;      ///< Who ran it ( e.g. connection id )
+        clock::duration elapsed;  ///< Time spent so far / in total
+        clock::duration budget;   ///< Deadline the handler was given
+        bool finished;            ///< false: still running, true: done
+    };
+
+    using report_type = std::function<void(const Overrun &)>;
+
+    /**
+     * @brief RAII handle for one watched invocation.
+     *
+     * Releasing ( destroying ) the ticket marks the invocation as done.
+     */
+    class Ticket
+    {
+    public:
+        Ticket() = default;
+        ~Ticket() { release(); }
+
+        Ticket(Ticket &&other) noexcept : wd_(other.wd_), id_(other.id_)
+        {
+            other.wd_ = nullptr;
+        }
+        Ticket &operator=(Ticket &&other) noexcept
+        {
+            if (this != &other) {
+                release();
+                wd_ = other.wd_;
+                id_ = other.id_;
+                other.wd_ = nullptr;
+            }
+            return *this;
+        }
+
+        Ticket(const Ticket &) = delete;
+        Ticket &operator=(const Ticket &) = delete;
+
+        /// @brief Disarm early; safe to call more than once.
+        void release();
+
+    private:
+        friend class Watchdog;
+        Ticket(Watchdog *wd, std::uint64_t id) : wd_(wd), id_(id) {}
+
+        Watchdog *wd_{nullptr};
+        std::uint64_t id_{0};
+    };
+
+    // -- constructor and destructor -- //
+
+    /**
+     * @brief Start the monitor thread.
+     *
+     * @param on_overrun Called from the monitor thread ( while running ) or
+     * the releasing thread ( when finished ). Exceptions are swallowed.
+     * @param tick How often armed tickets are scanned.
+     * @param cooldown How long an owner stays throttled after an overrun.
+     */
+    explicit Watchdog(report_type on_overrun,
+                      clock::duration tick = std::chrono::milliseconds(10),
+                      clock::duration cooldown = std::chrono::seconds(1));
+
+    /**
+     * @brief Stop and join the monitor thread.
+     *
+     * NOTE: All tickets must be released before destruction.
+     */
+    ~Watchdog();
+
+    // -- copy and move trait -- //
+
+    Watchdog(const Watchdog &) = delete;
+    Watchdog &operator=(const Watchdog &) = delete;
+    Watchdog(Watchdog &&) = delete;
+    Watchdog &operator=(Watchdog &&) = delete;
+
+    // -- watch -- //
+
+    /**
+     * @brief Arm a deadline for one invocation.
+     *
+     * @param label Reported on overrun.
+     * @param owner Throttled on overrun.
+     * @param budget Time allowed before the invocation counts as overrun.
+     * @return Ticket that must live as long as the invocation.
+     */
+    Ticket watch(const std::string &label,
+                 std::uint64_t owner,
+                 clock::duration budget);
+
+    /**
+     * @brief Whether @p owner is currently overrunning or cooling down.
+     *
+     * NOTE: Thread-safe; one mutex acquisition and one hash lookup.
+     */
+    bool is_throttled(std::uint64_t owner) const;
+
+    /// @brief Number of armed tickets.
+    std::size_t active() const;
+
+private:
+    struct Entry {
+        std::string label;
+        std::uint64_t owner;
+        clock::time_point start;
+        clock::time_point deadline;
+        bool reported;
+    };
+
+    void _disarm(std::uint64_t id);
+    void _monitor();
+    void _report(const Overrun &overrun) const;
+
+    report_type on_overrun_;    ///< User supplied report function
+    clock::duration tick_;      ///< Scan period
+    clock::duration cooldown_;  ///< Throttle time after an overrun
+
+    mutable std::mutex mtx_;      ///< Protects everything below
+    std::condition_variable cv_;  ///< Wakes the monitor on shutdown
+    bool stop_{false};            ///< Monitor exit flag
+    std::uint64_t next_id_{1};    ///< Ticket id generator
+    std::unordered_map<std::uint64_t, Entry> armed_;  ///< ticket id -> entry
+    mutable std::unordered_map<std::uint64_t, clock::time_point>
+        throttled_;  ///< owner -> throttled until
+    std::unordered_map<std::uint64_t, std::size_t>
+        overrunning_;  ///< owner -> reported tickets still armed
+
+    std::thread monitor_;  ///< Runs _monitor()
+};
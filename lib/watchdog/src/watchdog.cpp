@@ -0,0 +1,134 @@
+// impl for watchdog.hpp
+
+#include "watchdog.hpp"
+
+#include <vector>
+
+// Ticket
+
+void Watchdog::Ticket::release()
+{
+    if (wd_) {
+        wd_->_disarm(id_);
+        wd_ = nullptr;
+    }
+}
+
+// Watchdog
+
+Watchdog::Watchdog(report_type on_overrun,
+                   clock::duration tick,
+                   clock::duration cooldown)
+    : on_overrun_(std::move(on_overrun)), tick_(tick), cooldown_(cooldown)
+{
+    monitor_ = std::thread([this] { _monitor(); });
+}
+
+Watchdog::~Watchdog()
+{
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (monitor_.joinable())
+        monitor_.join();
+}
+
+Watchdog::Ticket Watchdog::watch(const std::string &label,
+                                 std::uint64_t owner,
+                                 clock::duration budget)
+{
+    const auto now = clock::now();
+    std::lock_guard<std::mutex> lk(mtx_);
+    const std::uint64_t id = next_id_++;
+    armed_.emplace(id, Entry{label, owner, now, now + budget, false});
+    return Ticket(this, id);
+}
+
+bool Watchdog::is_throttled(std::uint64_t owner) const
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto it = throttled_.find(owner);
+    if (it == throttled_.end())
+        return false;
+    if (clock::now() < it->second)
+        return true;
+    throttled_.erase(it);  // cool-down expired
+    return false;
+}
+
+std::size_t Watchdog::active() const
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    return armed_.size();
+}
+
+void Watchdog::_disarm(std::uint64_t id)
+{
+    const auto now = clock::now();
+    Overrun overrun;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        auto it = armed_.find(id);
+        if (it == armed_.end())
+            return;
+        const Entry &e = it->second;
+        // late but not yet seen by the monitor still counts
+        if (!e.reported && now <= e.deadline) {
+            armed_.erase(it);
+            return;
+        }
+        overrun = Overrun{e.label, e.owner, now - e.start, e.deadline - e.start,
+                          true};
+        auto running = overrunning_.find(e.owner);
+        if (e.reported && --running->second == 0)
+            overrunning_.erase(running);
+        // the cool-down starts once no ticket of the owner is overrunning
+        if (overrunning_.count(e.owner) == 0)
+            throttled_[e.owner] = now + cooldown_;
+        armed_.erase(it);
+    }
+    _report(overrun);
+}
+
+void Watchdog::_monitor()
+{
+    std::unique_lock<std::mutex> lk(mtx_);
+    while (!stop_) {
+        cv_.wait_for(lk, tick_, [this] { return stop_; });
+        if (stop_)
+            break;
+
+        const auto now = clock::now();
+        std::vector<Overrun> late;
+        for (auto &it : armed_) {
+            Entry &e = it.second;
+            if (e.reported || now <= e.deadline)
+                continue;
+            e.reported = true;
+            ++overrunning_[e.owner];
+            throttled_[e.owner] = clock::time_point::max();  // until released
+            late.push_back(Overrun{e.label, e.owner, now - e.start,
+                                   e.deadline - e.start, false});
+        }
+
+        if (late.empty())
+            continue;
+        lk.unlock();  // never call user code with the lock held
+        for (const auto &o : late)
+            _report(o);
+        lk.lock();
+    }
+}
+
+void Watchdog::_report(const Overrun &overrun) const
+{
+    if (!on_overrun_)
+        return;
+    try {
+        on_overrun_(overrun);
+    } catch (...) {
+        // a failing reporter must not take the monitor thread down
+    }
+}
@@ -1,27 +1,208 @@
+#pragma once
+
+#include <shared_mutex>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "account_table.hpp"     // AccountTable
+#include "credential_cache.hpp"  // CredentialCache
+#include "crypto.hpp"            // PasswordHash
+#include "event_registry.hpp"    // EventRegistry, EventEntry
+#include "friend_graph.hpp"      // FriendGraph
+#include "roaring_set.hpp"       // RoaringSet
+#include "room_registry.hpp"     // RoomRegistry
+#include "state_journal.hpp"     // StateJournal::Encoder
+#include "suggestion_index.hpp"  // SuggestionIndex
+#include "user_ids.hpp"          // UserIds
+
+/**
+ * @enum EventType
+ * @brief Events known at compile time; values index the dispatch table.
+ *
+ * NOTE: Keep in enum order with EventDispatcher below.
+ */
+enum class EventType {
+    Login,
+    Chat,
+    AddFriend,
+    Room
+};
+
+/**
+ * @brief Map the "type" field of an incoming message to an EventType.
+ * @param name Event name on the wire ( e.g. "login" ).
+ * @param[out] out Parsed event type.
+ * @return true if @p name is a built-in event.
+ */
+bool parse_event_type(const std::string &name, EventType &out);
 
+/**
+ * @brief Interface for runtime plugins ( slow path ).
+ *
+ * Built-in handlers do not derive from this class; they are bound at
+ * compile time through EventDispatcher.
+ */
 class BaseEventHandler
 {
 public:
-    virtual void handle(const std::string &json) = 0;
+    virtual bool handle(const std::string &json) = 0;
     virtual ~BaseEventHandler() = default;
 };
 
-class AddFriendEventHandler : public BaseEventHandler
+/**
+ * @brief Friendships: { "from", "to" } adds one, with "action": "remove"
+ * ends it.
+ *
+ * Names are interned once; the graph itself works on dense integer ids
+ * ( see FriendGraph ).
+ *
+ * NOTE: MT-safe; queries share a lock, mutations take it exclusively.
+ */
+class AddFriendEventHandler
+{
+public:
+    /// @return true if the friendship changed.
+    bool handle(const std::string &json);
+
+    /// @brief Whether @p a and @p b are friends.
+    bool are_friends(const std::string &a, const std::string &b) const;
+
+    /// @brief Friends of @p user, ascending by interned id.
+    std::vector<std::string> friends_of(const std::string &user) const;
+
+    /**
+     * @brief "People you may know": non-friends of @p user with the most
+     * mutual friends, best first, as ( name, mutual count ).
+     *
+     * NOTE: Served from an index updated on every friendship change.
+     */
+    std::vector<std::pair<std::string, std::uint32_t>> suggest_friends(
+        const std::string &user);
+
+    /**
+     * @brief Copy the friendships for a snapshot, under the shared lock:
+     * names are encoded, the graph arrays copied. The returned encoder
+     * writes the image ( see restore() ) and may run on any thread.
+     */
+    StateJournal::Encoder snapshot() const;
+
+    /**
+     * @brief Replace every friendship with an image from snapshot().
+     * Suggestions are recomputed user by user, on their next query.
+     * @return false, changing nothing, if the image is malformed.
+     */
+    bool restore(std::string_view image);
+
+private:
+    mutable std::shared_mutex mtx_;  ///< Protects everything below
+    UserIds ids_;                    ///< name <-> dense id
+    FriendGraph graph_;              ///< CSR + delta adjacency
+    SuggestionIndex suggestions_;    ///< Top-K friends of friends
+};
+
+/**
+ * @brief Group rooms: { "action": "join" | "leave", "room", "user" }.
+ *
+ * Trusts "user": Server only dispatches events whose "user" is logged in
+ * on the connection that sent them.
+ *
+ * Also tracks who is online ( Server calls set_online() as users come and
+ * go ), so a room message is fanned out by intersecting the room with the
+ * online set instead of probing every member.
+ *
+ * NOTE: MT-safe; fan-out lookups share a lock, changes take it exclusively.
+ */
+class RoomEventHandler
 {
 public:
-    void handle(const std::string &json) override;
+    /// @return true if the membership changed.
+    bool handle(const std::string &json);
+
+    /// @brief Mark @p user as reachable or not.
+    void set_online(const std::string &user, bool online);
+
+    /**
+     * @brief Online members of @p room, except @p from.
+     * @return Empty if the room does not exist or @p from is not a member.
+     */
+    std::vector<std::string> recipients(const std::string &room,
+                                        const std::string &from) const;
+
+    /// @brief Whether @p user is in @p room ( may read its history ).
+    bool is_member(const std::string &room, const std::string &user) const;
+
+    /**
+     * @brief Copy the rooms for a snapshot, under the shared lock ( names
+     * and member ids are encoded right away ). Who is online is not kept.
+     */
+    StateJournal::Encoder snapshot() const;
+
+    /**
+     * @brief Replace every room with an image from snapshot(); nobody is
+     * online afterwards.
+     * @return false, changing nothing, if the image is malformed.
+     */
+    bool restore(std::string_view image);
+
+private:
+    mutable std::shared_mutex mtx_;  ///< Protects everything below
+    UserIds ids_;                    ///< name <-> dense id
+    RoomRegistry rooms_;             ///< room -> members
+    RoaringSet online_{0};           ///< Online users, one bit each
 };
 
-class ChatEventHandler : public BaseEventHandler
+/**
+ * @brief Chat messages: { "from", "to" } for one user, { "from", "room" }
+ * for a group room.
+ *
+ * An optional "id" is the client's idempotency key: Server confirms again,
+ * instead of storing, a chat whose ( "from", "id" ) it stored in the last
+ * minutes, so a retry after a timeout is not stored or delivered twice.
+ *
+ * NOTE: Runs on the chat strands: calls for one conversation are serialized,
+ * calls for different conversations may run concurrently.
+ */
+class ChatEventHandler
 {
 public:
-    void handle(const std::string &json) override;
+    bool handle(const std::string &json);
 };
 
+/**
+ * @brief Login: checks { "username", "password" } against the account table.
+ *
+ * A full check runs PBKDF2 ( tens of ms ), so Server runs this handler on its
+ * own bounded login pool, never on the chat path. A user who logged in
+ * successfully within the cache TTL skips the KDF.
+ *
+ * Accounts live in a memory-mapped AccountTable ( "accounts" ), so they
+ * survive restarts without being loaded, and lookups take no lock.
+ *
+ * NOTE: MT-safe; may run on several login workers at once.
+ */
 // ! need singleton
-class LoginEventHandler : public BaseEventHandler
+class LoginEventHandler
 {
 public:
-    void handle(const std::string &json) override;
+    bool handle(const std::string &json);
+
+    /**
+     * @brief Create or replace an account ( hashes the password ).
+     */
+    void add_account(const std::string &username, const std::string &password);
+
+private:
+    AccountTable accounts_{"accounts"};  ///< username -> password hash
+    CredentialCache cache_;              ///< Recently verified logins
 };
+
+/// Compile-time handler table used by Server.
+using EventDispatcher =
+    EventRegistry<EventType,
+                  EventEntry<EventType::Login, LoginEventHandler>,
+                  EventEntry<EventType::Chat, ChatEventHandler>,
+                  EventEntry<EventType::AddFriend, AddFriendEventHandler>,
+                  EventEntry<EventType::Room, RoomEventHandler>>;
@@ -10,13 +10,16 @@
 #ifdef _WIN32
 
 #include <atomic>
+#include <chrono>  // for handler deadline
 #include <condition_variable>
-#include <functional>  // for callback function
-#include <memory>      // for std::shared_ptr, std::unique_ptr
+#include <cstdint>
+#include <memory>  // for std::shared_ptr, std::unique_ptr
 #include <mutex>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <thread>
+#include <unordered_map>  // live connections by id
 #include <vector>
 
 // windows 的技術債
@@ -29,6 +32,25 @@
 #include <winsock2.h>
 #include <ws2tcpip.h>
 
+#include "Event_handeler.hpp"     // EventDispatcher, BaseEventHandler
+#include "ack_window.hpp"         // AckWindow
+#include "dedup_filter.hpp"       // DedupFilter
+#include "history_compactor.hpp"  // HistoryCompactor
+#include "history_engine.hpp"     // HistoryEngine
+#include "history_store.hpp"      // HistoryStore
+#include "history_writer.hpp"     // HistoryWriter
+#include "offline_inbox.hpp"      // OfflineInbox
+#include "recent_cache.hpp"       // RecentCache
+#include "search_index.hpp"       // SearchIndex
+#include "session_store.hpp"      // SessionStore
+#include "session_token.hpp"      // SessionTokenIssuer
+#include "state_journal.hpp"      // StateJournal
+#include "strand.hpp"             // StrandExecutor
+#include "thread_pool.hpp"        // ThreadPool
+#include "watchdog.hpp"           // Watchdog
+
+class Server;
+
 /**
  * @class ServerSocket
  * @brief Manages communication with a single connected client socket.
@@ -52,16 +74,17 @@ public:
      * @param connect_socket Underlying SOCKET returned by accept().
      * @param cv Shared condition variable to notify the Server when this client
      * disconnects.
-     * @param callback_function The callback receives a JSON message, and
-     * returns true if the message was successfully handled. ( apply from class
-     * Server )
+     * @param server Owning Server; incoming JSON messages are handed to
+     * Server::_callback directly ( no type-erased callback ).
+     * @param id Connection id assigned by the Server ( watchdog owner ).
      * @param message_buffer_len Maximum buffer length for send/recv operations
      * (default 1024).
      * @throws std::invalid_argument if parameters are invalid.
      */
     ServerSocket(SOCKET connect_socket,
                  std::shared_ptr<std::condition_variable> cv,
-                 std::function<bool(const std::string &)> callback_function,
+                 Server &server,
+                 std::uint64_t id,
                  int message_buffer_len = 1024);
 
     /**
@@ -77,10 +100,25 @@ public:
      */
     void send_message(const std::string &message) const;
 
+    /**
+     * @brief Send several messages with a single flush.
+     *
+     * NOTE: Sends are serialized per socket, so replies from worker threads
+     * never interleave with frames written by the receive thread.
+     *
+     * Every message is encoded as its own fixed-size frame; all frames are
+     * written from one contiguous buffer.
+     *
+     * @param messages Payloads in send order.
+     * @throws std::runtime_error if send fails or a message is too large.
+     */
+    void send_messages(const std::vector<std::string> &messages) const;
+
     /// @name Accessors
     ///@{
     const std::string &get_username() const { return username_; }
     State get_state() const { return state.load(); }
+    std::uint64_t get_id() const { return id_; }
     ///@}
 
     // -- disable copy trait -- //
@@ -104,13 +142,16 @@ private:
     std::shared_ptr<std::condition_variable>
         cv_;  ///< Notify Server when disconnect occurs
 
-    std::function<bool(const std::string &)>
-        callback_;  ///< function provided by class Server
+    Server &server_;    ///< Owner, receives events via _callback()
+    std::uint64_t id_;  ///< Connection id, unique per Server
+
+    mutable std::mutex send_mtx_;  ///< One writer at a time
 
     /**
      * @brief Internal receive loop running in a separate thread.
      * Blocks on recv(), handles incoming data and disconnect events.
-     * TODO: handle incoming events and dispatch callbacks here.
+     * Every complete frame of one recv() is dispatched as one batch through
+     * Server::_callback(), which answers the batch with one send.
      */
     void _recv_func_async();
 
@@ -122,6 +163,19 @@ private:
 };  // end of ServerSocket
 
 
+/**
+ * @brief How Server recognizes a retried chat ( see DedupFilter ).
+ */
+struct DedupOptions {
+    std::size_t memory_bytes = 8 << 20;  ///< Budget of the filter
+    /// Keys are remembered at least this long
+    std::chrono::steady_clock::duration window = std::chrono::minutes(10);
+    /// A filter hit is confirmed among this many newest chats of the
+    /// conversation: a retry sent after more than that many newer chats is
+    /// stored a second time.
+    std::size_t scan = 200;
+};
+
 /**
  * @class Server
  * @brief Listens for incoming connections and dispatches them to a pool of
@@ -137,11 +191,17 @@ public:
      * @param max_connections Maximum concurrent clients (default 3).
      * @param message_buffer_len Buffer size for client messaging (default
      * 1024).
+     * @param history Where chats are stored; null for a HistoryStore in
+     * "history" ( a MemoryHistory for load tests ). Compaction and the
+     * tier stats only run on a HistoryStore.
+     * @param dedup Memory and time window for recognizing retried chats.
      */
     Server(const std::string &server_ip,
            const std::string &server_port,
            int max_connections = 3,
-           int message_buffer_len = 1024);
+           int message_buffer_len = 1024,
+           std::unique_ptr<HistoryEngine> history = nullptr,
+           DedupOptions dedup = DedupOptions());
 
     /**
      * @brief Clean up server, shutdown threads and sockets.
@@ -170,6 +230,42 @@ public:
      */
     const ServerSocket &get_server_sock(size_t i) const;
 
+    /**
+     * @brief Hit rate and memory of the cache of recent history ( also sent
+     * to clients as { "type": "stats" } ).
+     */
+    RecentCacheStats history_cache_stats() const { return recent_.stats(); }
+
+    // -- plugin -- //
+
+    /**
+     * @brief Register a runtime handler for an event name that is not part
+     * of EventType.
+     *
+     * Built-in events always go through the compile-time dispatch table;
+     * plugins are looked up by name and are therefore the slow path.
+     *
+     * @param event_name Value of the "type" field to match.
+     * @param handler Plugin instance, shared with the dispatcher.
+     */
+    void register_plugin(const std::string &event_name,
+                         std::shared_ptr<BaseEventHandler> handler);
+
+    // -- handler deadline -- //
+
+    /**
+     * @brief Set the time one event handler may run before the watchdog
+     * reports it and throttles its connection.
+     *
+     * The same budget bounds how long an event waits for the handler lock;
+     * an event that cannot get it in time is shed instead of queueing
+     * behind a stuck handler.
+     */
+    void set_handler_budget(std::chrono::milliseconds budget)
+    {
+        handler_budget_.store(budget);
+    }
+
     // -- disable copy trait -- //
     Server(const Server &) = delete;
     Server &operator=(const Server &) = delete;
@@ -178,6 +274,8 @@ public:
     Server(Server &&) = delete;
     Server &operator=(Server &&) = delete;
 
+    friend class ServerSocket;
+
 private:
     std::atomic<bool> stop_{false};  ///< Flag to stop the accept loop (MT-safe)
 
@@ -190,7 +288,7 @@ private:
     std::shared_ptr<std::condition_variable> cv_{
         std::make_shared<std::condition_variable>()};
     std::mutex accept_mtu_;          ///< Mutex for condition_variable waits
-    std::mutex callback_mtu_;        ///< Mutex for lock callback function
+    std::timed_mutex callback_mtu_;  ///< Mutex for lock callback function
     bool is_run_called{false};       ///< Prevent multiple run() calls
     bool is_shutdown_called{false};  ///< Prevent multiple shutdown calls
 
@@ -199,6 +297,99 @@ private:
     std::vector<std::unique_ptr<ServerSocket>>
         ConnectSockets_;  ///< Active client handlers
 
+    EventDispatcher dispatcher_;  ///< Compile-time event handler table
+
+    std::uint64_t next_conn_id_{1};  ///< Id for the next accepted client
+    std::atomic<std::chrono::milliseconds> handler_budget_{
+        std::chrono::milliseconds(200)};  ///< Deadline per handler call
+    Watchdog watchdog_;  ///< Reports overrunning handlers
+
+    ThreadPool pool_;  ///< Shared workers for chat events
+    StrandExecutor<std::string>
+        chat_strands_;  ///< Serializes chat events per conversation
+
+    ThreadPool login_pool_{2, 256};  ///< KDF workers, bounded admission
+
+    /// Key of tokens_, kept so that tokens outlive a restart.
+    static constexpr const char *kKeyFile = "session.key";
+    SessionTokenIssuer tokens_{_token_key()};  ///< Signs and checks tokens
+    SessionStore sessions_;  ///< Session state kept across reconnects
+    /// Orders each change of sessions_ with its record in journal_.
+    std::mutex session_log_mtx_;
+
+    /// Chats a connection may have in flight without acking.
+    static constexpr std::size_t kAckWindow = 128;
+
+    /// The socket of a connection as senders hold it: copied under
+    /// conns_mtx_, used outside it. _forget() clears sock under mtx, so it
+    /// waits for a send in progress and no later send reaches the socket.
+    struct Link {
+        std::mutex mtx;
+        ServerSocket *sock;
+    };
+
+    /// A live connection and the session attached to it ( 0 = none ).
+    struct Conn {
+        std::shared_ptr<Link> link;
+        std::uint64_t session;
+        std::string user;               ///< Set once logged in
+        AckWindow unacked{kAckWindow};  ///< Sent, not acked yet
+        bool backlogged{false};         ///< Chats wait in the inbox
+    };
+    std::mutex conns_mtx_;  ///< Protects conns_ and online_
+    std::unordered_map<std::uint64_t, Conn>
+        conns_;  ///< conn id -> live connection
+    std::unordered_map<std::string, std::uint64_t>
+        online_;  ///< user -> conn id receiving their chats
+
+    /// Messages per flush when an inbox is replayed.
+    static constexpr std::size_t kReplayBatch = 64;
+    /// Chats for offline users; flushed to disk at shutdown
+    OfflineInbox inboxes_{"inbox"};
+
+    std::mutex seq_mtx_;  ///< Protects next_seq_
+    std::unordered_map<std::string, std::uint64_t>
+        next_seq_;  ///< conversation -> last sequence number, seeded from
+                    ///< history_ so numbers go on across restarts
+
+    std::unique_ptr<HistoryEngine>
+        history_;  ///< Every accepted chat, stamped
+    HistoryWriter history_writer_{*history_};  ///< Group-commits history_
+    /// Age past which sealed history is compressed into the cold tier.
+    static constexpr std::chrono::hours kColdHistory{24 * 21};
+    std::unique_ptr<HistoryCompactor>
+        history_compactor_;  ///< Drops deleted chats ( HistoryStore only )
+
+    /// Most messages one history or search page may ask for.
+    static constexpr std::size_t kHistoryPage = 50;
+
+    /// Newest kHistoryPage chats of active conversations, kept by deliver.
+    RecentCache recent_{64 << 20, kHistoryPage};
+
+    SearchIndex search_;  ///< Text of stored chats
+    /// search_ as of the last shutdown; a start indexes only the chats
+    /// stored since.
+    static constexpr const char *kSearchFile = "search.idx";
+
+    /// Chat idempotency keys ( "from" + "id" ) stored within the dedup
+    /// window; a hit is confirmed against history_ before a chat is
+    /// dropped.
+    DedupFilter dedup_;
+    std::size_t dedup_scan_;  ///< Records searched to confirm a hit
+
+    /// Chats accepted but not stored yet, by idempotency key: the
+    /// connections waiting for their "sent" ( a retry joins the first ).
+    std::mutex sending_mtx_;
+    std::unordered_map<std::string, std::vector<std::uint64_t>> sending_;
+
+    /// Tags of the records in journal_: the add_friend or room event as
+    /// received, or a session change made by _change_session().
+    static constexpr char kFriendRecord = 'F';
+    static constexpr char kRoomRecord = 'R';
+    static constexpr char kSessionRecord = 'S';
+    /// Friendships, rooms and sessions: snapshot + log tail
+    StateJournal journal_{"state"};
+
     /**
      * @brief Accept loop for incoming connections and manage client slots.
      * Blocks when max_connections_ reached until a client disconnects.
@@ -215,9 +406,410 @@ private:
      * @brief Callback function to be called by the ServerSocket.
      *
      * This function is used to handle events that the ServerSocket
-     * cannot process by itself.
+     * cannot process by itself. Built-in events are routed through
+     * dispatcher_'s static table, unknown ones fall back to plugins.
+     *
+     * Every handler runs under a watchdog deadline. Events from a connection
+     * whose handler overran recently are shed, and so are events that
+     * cannot take the handler lock within the deadline; a shed is logged
+     * and answered with { "ok": false, "reason": "busy", "shed": n }.
+     *
+     * Chat events skip the handler lock: they are posted to the strand of
+     * their conversation and run on pool_, in order per conversation and in
+     * parallel across conversations.
+     *
+     * Login events run on login_pool_ so a login storm ( slow KDF ) never
+     * occupies the chat workers; when its queue is full they are shed.
+     * A successful login opens a session and replies with a resume token.
+     *
+     * Resume events ( { "type": "resume", "token": ... } ) are answered
+     * inline: one HMAC check, no account lookup, no KDF.
+     *
+     * A chat the handler accepts gets the next sequence number of its
+     * conversation and is appended to history_ through history_writer_.
+     * Once it is on disk it is sent to its recipient if they are online,
+     * and queued in their offline inbox otherwise; the inbox is replayed
+     * after their next login or resume. A chat with an "id" is then
+     * confirmed to its sender ( { "type": "sent", "id", "conversation",
+     * "seq", "ok" }, ok false if it could not be stored ). A retry of the
+     * same "id" is not stored again: it gets the same confirmation, once
+     * the first copy is stored. A chat is refused ( see _refusal() ) unless
+     * its "from" is the user logged in on the connection and, for a room,
+     * a member of it; it is refused as too large if it would not fit a
+     * frame with "conversation" and "seq" added. An add_friend event whose
+     * "from", or a room event whose "user", is not that user is refused
+     * the same way ( { "type": "add_friend" | "room", "ok": false,
+     * "reason": "forbidden" } ) before it reaches the handler.
+     * Clients ack cumulatively per conversation
+     * ( { "type": "ack", "conversation": ..., "seq": ... } ); at most
+     * kAckWindow chats are in flight per connection, the rest wait in the
+     * inbox.
+     *
+     * Acks and the resume, history, search, stats, suggest and delete
+     * requests are answered inline, each under its own watchdog deadline;
+     * their replies go out with one send per batch.
+     *
+     * Events arrive in batches ( all frames of one recv() ): the batch takes
+     * the handler lock once and posts once per conversation.
+     *
+     * @param conn_id Id of the ServerSocket the events came from.
+     * @param events Raw event payloads in arrival order.
+     * @return Number of events handled ( or queued, for chat ); the rest were
+     * rejected or shed.
+     */
+    std::size_t _callback(std::uint64_t conn_id,
+                          const std::vector<std::string> &events);
+
+    /**
+     * @brief Open a session for a freshly logged-in connection and send it
+     * { "type": "login", "ok": true, "token": ... }.
+     * @return false if no session could be opened.
+     */
+    bool _open_session(std::uint64_t conn_id, const std::string &username);
+
+    /**
+     * @brief Verify a resume token and re-attach its session to @p conn_id.
+     *
+     * Replies { "type": "resume", "ok": true, "subscriptions": {
+     * conversation: seq } } or { "type": "resume", "ok": false }, in which
+     * case the client has to log in again. subscriptions are the
+     * conversations the session acked chats of and the rooms it joined,
+     * each with the highest seq acked in it ( 0 if none ), as sequence
+     * numbers are counted per conversation. A connection still holding the
+     * session loses it, so its close does not detach the new one.
+     *
+     * @return true if the session was resumed.
+     */
+    bool _resume(std::uint64_t conn_id,
+                 const std::string &token,
+                 std::vector<std::string> &replies);
+
+    /**
+     * @brief Answer { "type": "history", "with": user | "room": room,
+     * "before": cursor, "limit": n } from a logged-in connection.
+     *
+     * With "at": ms since the Unix epoch instead of "before", the page is
+     * the conversation's last messages sent by then ( jump to a date, see
+     * HistoryStore::fetch_at() ); its next pages back as usual.
+     *
+     * Replies { "type": "history", "conversation": ..., "messages": [...],
+     * "next": cursor } with up to @p limit ( at most kHistoryPage ) stamped
+     * chats, newest first. The page is cut to fit one frame, so it can hold
+     * fewer; next is the cursor of the page before, 0 at the first message.
+     * Only the page is read from history_, never the whole conversation,
+     * and pages inside recent_ are not read from it at all ( the first
+     * page of a conversation admits it ).
+     *
+     * @return false if the connection is not logged in, is not part of the
+     * conversation or @p before is not one of its messages.
+     */
+    bool _history(std::uint64_t conn_id,
+                  const std::string &peer,
+                  bool room,
+                  MessageId before,
+                  std::uint64_t at,
+                  std::size_t limit,
+                  std::vector<std::string> &replies);
+
+    /**
+     * @brief Answer { "type": "search", "query": text, "with": user |
+     * "room": room, "before": cursor, "limit": n } from a logged-in
+     * connection.
+     *
+     * Without "with" or "room" every direct conversation of the user is
+     * searched. Replies { "type": "search", "query": ..., "messages": [...],
+     * "next": cursor } with up to @p limit ( at most kHistoryPage ) stored
+     * chats containing every term of the query, newest first, cut to fit one
+     * frame; next is 0 once there is nothing older. Cursors last until the
+     * server restarts.
+     *
+     * @return false if the connection is not logged in or is not part of
+     * the conversation.
+     */
+    bool _search(std::uint64_t conn_id,
+                 const std::string &query,
+                 const std::string &peer,
+                 bool room,
+                 std::uint64_t before,
+                 std::size_t limit,
+                 std::vector<std::string> &replies);
+
+    /**
+     * @brief Add stored chat @p id to search_: every string field but the
+     * routing ones ( type, from, to, room, id, conversation ).
+     */
+    void _index(const std::string &conversation,
+                MessageId id,
+                std::string_view stored);
+
+    /**
+     * @brief Rebuild friendships, rooms and sessions from journal_: the
+     * newest snapshot, then the changes logged after it. Sessions come back
+     * detached. Runs once, before the server accepts connections.
+     * @throws std::runtime_error if the journal is corrupt.
+     */
+    void _restore_state();
+
+    /**
+     * @brief Log a state change that @p json ( a built-in @p type event )
+     * just made, under callback_mtu_. Only friendships and rooms are kept.
+     */
+    void _journal(EventType type, const std::string &json);
+
+    /**
+     * @brief Apply @p op to sessions_ and log it in journal_, in the same
+     * order for every thread.
+     * @param op "open" ( @p arg is the user; @p session is ignored ),
+     * "close", "subscribe" or "unsubscribe" ( @p arg is the conversation ).
+     * Delivery progress is not logged: it is only as recent as the last
+     * snapshot, so a resume after a restart may resend a few chats.
+     * @return The session opened or changed; 0 if nothing changed.
+     */
+    std::uint64_t _change_session(const std::string &op,
+                                  std::uint64_t session,
+                                  const std::string &arg = std::string());
+
+    /**
+     * @brief Append @p record to journal_ and take a snapshot once one is
+     * due. A failure is logged; the change stays in memory only.
+     */
+    void _log_state(const std::string &record);
+
+    /**
+     * @brief Copy friendships, rooms and sessions for a snapshot. Changes
+     * go on meanwhile: one that is copied and also logged after the
+     * snapshot is replayed again, which every record allows.
+     */
+    StateJournal::Encoder _capture_state();
+
+    /// @brief Key of tokens_: read from kKeyFile, made there if missing.
+    static std::string _token_key();
+
+    /**
+     * @brief Load search_ as saved at the last shutdown and index the
+     * chats of history_ stamped since, oldest first ( all of them if there
+     * is no saved index, or it is not of this history ). Runs once, before
+     * the server accepts connections.
+     */
+    void _index_history();
+
+    /**
+     * @brief Append the stored chats @p records to @p reply, comma
+     * separated, as long as the reply stays a frame ( with room for a
+     * closing suffix ). A chat too large for any frame is replaced by
+     * { "type": "chat", "message_id": id, "too_large": true }.
+     * @return Records used up; the rest go on the next page.
+     */
+    std::size_t _splice(std::string &reply,
+                        const std::vector<RecordView> &records) const;
+
+    /**
+     * @brief Answer { "type": "delete", "message_id": id } from a logged-in
+     * connection: erase a stored chat the connection's user sent.
+     *
+     * Replies { "type": "delete", "message_id", "ok" }. The chat leaves
+     * history at once and the disk at the next compaction.
+     *
+     * @return false if the connection is not logged in.
+     */
+    bool _delete(std::uint64_t conn_id,
+                 MessageId id,
+                 std::vector<std::string> &replies);
+
+    /**
+     * @brief Answer { "type": "stats" } from a logged-in connection with
+     * { "type": "stats", "history_cache": { "hits", "misses", "hit_rate",
+     * "evictions", "conversations", "bytes", "budget" }, "history_tiers":
+     * { "hot_segments", "hot_bytes", "cold_segments", "cold_bytes",
+     * "cold_saved_bytes", "cold_blocks_read" } } ( history_tiers only on
+     * a HistoryStore ).
+     * @return false if the connection is not logged in.
+     */
+    bool _stats(std::uint64_t conn_id, std::vector<std::string> &replies);
+
+    /**
+     * @brief Answer { "type": "suggest" } from a logged-in connection with
+     * { "type": "suggest", "friends": [ names ], "suggestions": [ { "user",
+     * "mutual" } ] }: the user's friends, and the people they may know
+     * best first ( see AddFriendEventHandler::suggest_friends() ).
+     * @return false if the connection is not logged in.
+     */
+    bool _suggest(std::uint64_t conn_id, std::vector<std::string> &replies);
+
+    /// @brief Compaction of history_, with kColdHistory as cold_after.
+    static CompactionOptions _history_compaction();
+
+    /**
+     * @brief Tell the sender a chat is stored: { "type": "sent", "id",
+     * "conversation", "seq", "ok", "message_id" }. message_id ( for
+     * "delete" ) is only there if @p stored is not 0.
+     */
+    void _confirm(std::uint64_t conn_id,
+                  const std::string &id,
+                  const std::string &conversation,
+                  std::uint64_t seq,
+                  MessageId stored);
+
+    /**
+     * @brief Reply refusing a chat: { "type": "sent", "id", "ok": false,
+     * "reason" } ( id only if @p id is not empty ). @p reason is
+     * "forbidden" for a chat its connection may not send, "too_large" for
+     * one that would not fit a frame once stamped.
+     */
+    static std::string _refusal(const std::string &id,
+                                const std::string &reason = "forbidden");
+
+    /**
+     * @brief Find the stored copy of chat @p id from @p from among the
+     * newest dedup_scan_ records of @p conversation.
+     * @return false if it is not there ( a false hit of dedup_ ).
+     */
+    bool _find_sent(const std::string &conversation,
+                    const std::string &from,
+                    const std::string &id,
+                    std::uint64_t &seq,
+                    MessageId &stored);
+
+    /**
+     * @brief Send @p message to connection @p conn_id if it is still alive.
+     */
+    void _reply(std::uint64_t conn_id, const std::string &message);
+
+    /**
+     * @brief Send @p replies to connection @p conn_id with one flush if it
+     * is still alive, and clear them.
+     */
+    void _flush(std::uint64_t conn_id, std::vector<std::string> &replies);
+
+    /**
+     * @brief Send several chats to @p conn_id with one flush and track them
+     * for acks.
+     * @return false if the connection is gone, its ack window has no room
+     * for the whole batch or the send failed; the chats are then left to
+     * the caller's inbox and untracked ( should the connection be gone by
+     * then, _forget() has queued them too: the client drops the copy ).
+     * Once tracked, a chat goes back to the inbox with the rest of the
+     * window if the connection ends unacked ( see _forget() ).
+     */
+    bool _reply_batch(std::uint64_t conn_id,
+                      const std::vector<std::string> &messages);
+
+    /**
+     * @brief Give a chat the next sequence number of @p conversation.
+     * @param[out] seq The number assigned.
+     * @return The event with "conversation" and "seq" added.
+     *
+     * NOTE: Call on the conversation's strand, so numbers follow delivery
+     * order.
+     */
+    std::string _stamp(const std::string &conversation,
+                       const std::string &event,
+                       std::uint64_t &seq);
+
+    /**
+     * @brief Sequence number of the newest chat of @p conversation in
+     * history_, 0 if there is none.
+     */
+    std::uint64_t _stored_seq(const std::string &conversation);
+
+    /**
+     * @brief Track a stamped chat in the ack window of @p c; the caller
+     * sends it on c.link once conns_mtx_ is released.
+     * @return false if @p c is backlogged or its window is full; it is then
+     * marked backlogged and the caller queues the chat in the inbox.
+     *
+     * NOTE: Call with conns_mtx_ held.
+     */
+    bool _send_tracked(Conn &c,
+                       const std::string &conversation,
+                       std::uint64_t seq,
+                       const std::string &message);
+
+    /**
+     * @brief Send @p messages with one flush on @p link, unless its
+     * connection was forgotten.
+     * @return false if nothing was sent.
+     *
+     * NOTE: Call without conns_mtx_: a send may block on a slow client.
+     */
+    static bool _send(Link &link, const std::vector<std::string> &messages);
+
+    /**
+     * @brief Hand a chat to @p to: directly if online and within the ack
+     * window, else to the inbox.
+     */
+    void _deliver(const std::string &to,
+                  const std::string &conversation,
+                  std::uint64_t seq,
+                  const std::string &message);
+
+    /**
+     * @brief Send a room message to the room's online members but @p from.
+     *
+     * Recipients come from RoomEventHandler ( room and online set
+     * intersected ), so the cost follows who is online, not the room size.
+     * Members whose ack window is full get it through their inbox.
+     */
+    void _fan_out(const std::string &room,
+                  const std::string &from,
+                  std::uint64_t seq,
+                  const std::string &message);
+
+    /**
+     * @brief Tell the sender of add_friend event @p json whether it changed
+     * the friendship ( { "type": "add_friend", "from", "to", "action",
+     * "ok" }, into @p replies ), and the other user too if it did and they
+     * are online.
+     */
+    void _answer_friend(const std::string &json,
+                        bool ok,
+                        std::vector<std::string> &replies);
+
+    /**
+     * @brief Follow or stop following a room in the session of the user a
+     * Room event joined to or removed from it ( if they are online ).
+     */
+    void _follow_room(const std::string &json);
+
+    /**
+     * @brief Cumulative ack from @p conn_id: @p conversation up to @p seq.
+     * Recorded in its session ( followed, last delivered ); resumes a
+     * backlogged connection once its window has room.
+     */
+    void _ack(std::uint64_t conn_id,
+              const std::string &conversation,
+              std::uint64_t seq);
+
+    /**
+     * @brief Route @p user's chats to @p conn_id and stream their offline
+     * backlog there first.
+     */
+    void _replay_inbox(std::uint64_t conn_id, const std::string &user);
+
+    /**
+     * @brief Stream the inbox of a backlogged connection while its ack
+     * window has room.
+     *
+     * The backlog goes out up to kReplayBatch frames per flush. Sends block
+     * while the client's receive window is full, and the replay pauses when
+     * the ack window is; the next ack resumes it. Once the inbox is empty,
+     * chats go straight to the connection again.
+     */
+    void _drain(std::uint64_t conn_id, const std::string &user);
+
+    /**
+     * @brief Make connection @p conn_id reachable by _reply().
+     * Called by ServerSocket before its receive thread starts.
+     */
+    void _track(std::uint64_t conn_id, ServerSocket *sock);
+
+    /**
+     * @brief Forget a closing connection and detach its session.
+     * Its unacked chats go back to the inbox, so the next login or resume
+     * resends only that gap.
+     * Called by ServerSocket before its socket goes away.
      */
-    bool _callback(const std::string &json);
+    void _forget(std::uint64_t conn_id);
 };  // end of Server
 
 #endif  // _WIN32
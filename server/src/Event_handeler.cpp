@@ -0,0 +1,278 @@
+// impl for Event_handeler.hpp
+#include "Event_handeler.hpp"
+
+#include <algorithm>
+#include <mutex>
+
+#include <nlohmann/json.hpp>
+
+namespace
+{
+
+/// AccountTable value: u32 iterations | digest | salt.
+std::string encode_hash(const PasswordHash &h)
+{
+    std::string out(4, '\0');
+    for (int i = 0; i < 4; ++i)
+        out[i] = static_cast<char>(h.iterations >> (8 * i));
+    out.append(reinterpret_cast<const char *>(h.digest.data()),
+               h.digest.size());
+    out += h.salt;
+    return out;
+}
+
+bool decode_hash(std::string_view in, PasswordHash &out)
+{
+    if (in.size() < 4 + out.digest.size())
+        return false;
+    out.iterations = 0;
+    for (int i = 0; i < 4; ++i)
+        out.iterations |= std::uint32_t{static_cast<unsigned char>(in[i])}
+                          << (8 * i);
+    std::copy(in.begin() + 4, in.begin() + 4 + out.digest.size(),
+              out.digest.begin());
+    out.salt.assign(in.substr(4 + out.digest.size()));
+    return true;
+}
+
+}  // namespace
+
+bool parse_event_type(const std::string &name, EventType &out)
+{
+    if (name == "login") {
+        out = EventType::Login;
+        return true;
+    }
+    if (name == "chat") {
+        out = EventType::Chat;
+        return true;
+    }
+    if (name == "add_friend") {
+        out = EventType::AddFriend;
+        return true;
+    }
+    if (name == "room") {
+        out = EventType::Room;
+        return true;
+    }
+    return false;
+}
+
+bool AddFriendEventHandler::handle(const std::string &json)
+{
+    auto event = nlohmann::json::parse(json, nullptr, false);
+    if (event.is_discarded() || !event.contains("from") ||
+        !event.contains("to") || !event["from"].is_string() ||
+        !event["to"].is_string())
+        return false;
+    const bool remove = event.value("action", std::string()) == "remove";
+    const auto &from = event["from"].get_ref<const std::string &>();
+    const auto &to = event["to"].get_ref<const std::string &>();
+
+    // the result goes to both users from Server::_answer_friend()
+    std::unique_lock<std::shared_mutex> lk(mtx_);
+    if (remove) {
+        UserId a, b;
+        if (!ids_.find(from, a) || !ids_.find(to, b) || !graph_.remove(a, b))
+            return false;
+        suggestions_.on_removed(graph_, a, b);
+        return true;
+    }
+    const UserId a = ids_.intern(from), b = ids_.intern(to);
+    if (!graph_.add(a, b))
+        return false;
+    suggestions_.on_added(graph_, a, b);
+    return true;
+}
+
+bool AddFriendEventHandler::are_friends(const std::string &a,
+                                        const std::string &b) const
+{
+    std::shared_lock<std::shared_mutex> lk(mtx_);
+    UserId x, y;
+    return ids_.find(a, x) && ids_.find(b, y) && graph_.are_friends(x, y);
+}
+
+std::vector<std::pair<std::string, std::uint32_t>>
+AddFriendEventHandler::suggest_friends(const std::string &user)
+{
+    std::vector<std::pair<std::string, std::uint32_t>> out;
+    // exclusive: a dirty entry is rebuilt in place
+    std::unique_lock<std::shared_mutex> lk(mtx_);
+    UserId id;
+    if (!ids_.find(user, id))
+        return out;
+    std::vector<Suggestion> top;
+    suggestions_.suggest(graph_, id, top);
+    out.reserve(top.size());
+    for (const auto &s : top)
+        out.emplace_back(ids_.name(s.user), s.mutual);
+    return out;
+}
+
+std::vector<std::string> AddFriendEventHandler::friends_of(
+    const std::string &user) const
+{
+    std::vector<std::string> out;
+    std::shared_lock<std::shared_mutex> lk(mtx_);
+    UserId id;
+    if (!ids_.find(user, id))
+        return out;
+    std::vector<UserId> scratch;
+    const FriendSpan row = graph_.friends(id, scratch);
+    out.reserve(row.size);
+    for (UserId f : row)
+        out.push_back(ids_.name(f));
+    return out;
+}
+
+StateJournal::Encoder AddFriendEventHandler::snapshot() const
+{
+    std::string names;
+    std::shared_lock<std::shared_mutex> lk(mtx_);
+    ids_.save(names);
+    return [names = std::move(names), graph = graph_](std::string &image) {
+        image += names;
+        graph.save(image);
+    };
+}
+
+bool AddFriendEventHandler::restore(std::string_view image)
+{
+    UserIds ids;
+    FriendGraph graph;
+    if (!ids.load(image) || !graph.load(image) || !image.empty() ||
+        graph.rows() > ids.size())
+        return false;
+    std::unique_lock<std::shared_mutex> lk(mtx_);
+    ids_ = std::move(ids);
+    graph_ = std::move(graph);
+    suggestions_.reset(ids_.size());
+    return true;
+}
+
+bool ChatEventHandler::handle(const std::string &json)
+{
+    // storing and delivery are done by Server; only well-formed chats are
+    // accepted
+    auto event = nlohmann::json::parse(json, nullptr, false);
+    if (event.is_discarded() || !event.contains("from") ||
+        !event["from"].is_string())
+        return false;
+    return (event.contains("to") && event["to"].is_string()) ||
+           (event.contains("room") && event["room"].is_string());
+}
+
+bool RoomEventHandler::handle(const std::string &json)
+{
+    auto event = nlohmann::json::parse(json, nullptr, false);
+    if (event.is_discarded() || !event.contains("room") ||
+        !event.contains("user") || !event["room"].is_string() ||
+        !event["user"].is_string())
+        return false;
+    const std::string action = event.value("action", std::string("join"));
+    const auto &room = event["room"].get_ref<const std::string &>();
+    const auto &user = event["user"].get_ref<const std::string &>();
+
+    std::unique_lock<std::shared_mutex> lk(mtx_);
+    if (action == "leave") {
+        UserId id;
+        return ids_.find(user, id) && rooms_.leave(room, id);
+    }
+    if (action != "join")
+        return false;
+    return rooms_.join(room, ids_.intern(user));
+}
+
+void RoomEventHandler::set_online(const std::string &user, bool online)
+{
+    std::unique_lock<std::shared_mutex> lk(mtx_);
+    if (online) {
+        online_.add(ids_.intern(user));
+        return;
+    }
+    UserId id;
+    if (ids_.find(user, id))
+        online_.remove(id);
+}
+
+std::vector<std::string> RoomEventHandler::recipients(
+    const std::string &room,
+    const std::string &from) const
+{
+    std::vector<std::string> out;
+    std::vector<UserId> ids;
+    std::shared_lock<std::shared_mutex> lk(mtx_);
+    UserId sender;
+    if (!ids_.find(from, sender) || !rooms_.is_member(room, sender) ||
+        !rooms_.online_members(room, online_, ids))
+        return out;
+    out.reserve(ids.size());
+    for (UserId id : ids) {
+        if (id != sender)
+            out.push_back(ids_.name(id));
+    }
+    return out;
+}
+
+bool RoomEventHandler::is_member(const std::string &room,
+                                 const std::string &user) const
+{
+    std::shared_lock<std::shared_mutex> lk(mtx_);
+    UserId id;
+    return ids_.find(user, id) && rooms_.is_member(room, id);
+}
+
+StateJournal::Encoder RoomEventHandler::snapshot() const
+{
+    std::string image;
+    std::shared_lock<std::shared_mutex> lk(mtx_);
+    ids_.save(image);
+    rooms_.save(image);
+    return [image = std::move(image)](std::string &out) { out += image; };
+}
+
+bool RoomEventHandler::restore(std::string_view image)
+{
+    UserIds ids;
+    RoomRegistry rooms;
+    if (!ids.load(image) || !rooms.load(image, ids.size()) || !image.empty())
+        return false;
+    std::unique_lock<std::shared_mutex> lk(mtx_);
+    ids_ = std::move(ids);
+    rooms_ = std::move(rooms);
+    online_ = RoaringSet(0);
+    return true;
+}
+
+bool LoginEventHandler::handle(const std::string &json)
+{
+    auto event = nlohmann::json::parse(json, nullptr, false);
+    if (event.is_discarded() || !event.contains("username") ||
+        !event.contains("password") || !event["username"].is_string() ||
+        !event["password"].is_string())
+        return false;
+    const auto &username = event["username"].get_ref<const std::string &>();
+    const auto &password = event["password"].get_ref<const std::string &>();
+
+    // fast path: verified moments ago ( reconnect )
+    if (cache_.check(username, password))
+        return true;
+
+    std::string_view value;
+    PasswordHash stored;
+    if (!accounts_.find(username, value) || !decode_hash(value, stored))
+        return false;
+    if (!verify_password(password, stored))  // slow: runs the KDF
+        return false;
+    cache_.put(username, password);
+    return true;
+}
+
+void LoginEventHandler::add_account(const std::string &username,
+                                    const std::string &password)
+{
+    const PasswordHash h = hash_password(password);  // slow
+    accounts_.put(username, encode_hash(h));
+    cache_.invalidate(username);  // after: no login re-caches the old one
+}
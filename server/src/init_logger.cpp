@@ -26,5 +26,8 @@ void init_logger()
         return;
     called = true;
 
-    // TODO: init logger here
+    // server logger, also used by the handler watchdog
+    auto logger = LoggerRegistry::instance().get_logger("server");
+    logger->addSink(TerminalSink::get());
+    SET_LOG_LEVEL(logger);
 }
@@ -1,9 +1,18 @@
 // impl for client.hpp
 #include "server.hpp"
 
+#include <algorithm>
 #include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
 #include <sstream>
 
+#include <nlohmann/json.hpp>
+
+#include "frame_buffer.hpp"
+#include "logger.hpp"
+
 #ifdef _WIN32
 
 //------------------------------------------------------------------------------
@@ -13,11 +22,13 @@
 ServerSocket::ServerSocket(
     SOCKET connect_socket,
     std::shared_ptr<std::condition_variable> cv,
-    std::function<bool(const std::string &)> callback_function,
+    Server &server,
+    std::uint64_t id,
     int message_buffer_len)
     : ConnectSocket_(connect_socket),
       cv_(std::move(cv)),
-      callback_(callback_function),
+      server_(server),
+      id_(id),
       message_buffer_len_(message_buffer_len)
 {
     if (message_buffer_len_ > 10240) {
@@ -30,6 +41,7 @@ ServerSocket::ServerSocket(
         throw std::invalid_argument("Condition variable pointer is null");
 
     state.store(State::Connection);
+    server_._track(id_, this);
 
     // Launch receive thread immediately
     recv_thread_ = std::thread([this] { this->_recv_func_async(); });
@@ -37,6 +49,9 @@ ServerSocket::ServerSocket(
 
 ServerSocket::~ServerSocket()
 {
+    if (ConnectSocket_ != INVALID_SOCKET)
+        shutdown(ConnectSocket_, SD_BOTH);  // a stalled send returns
+    server_._forget(id_);  // no reply may reach a dying socket
     _shutdown();  // Ensure thread and socket are closed on destruction
 }
 
@@ -52,6 +67,7 @@ void ServerSocket::send_message(const std::string &message) const
     std::vector<char> buffer(message_buffer_len_, 0);
     std::memcpy(buffer.data(), message.data(), message.size());
 
+    std::lock_guard<std::mutex> lk(send_mtx_);
     int iResult = send(ConnectSocket_, buffer.data(), message_buffer_len_, 0);
     if (iResult == SOCKET_ERROR) {
         std::stringstream oss;
@@ -61,6 +77,34 @@ void ServerSocket::send_message(const std::string &message) const
     }
 }
 
+void ServerSocket::send_messages(
+    const std::vector<std::string> &messages) const
+{
+    if (state.load() != State::Connection || messages.empty())
+        return;
+
+    // coalesce every frame into one buffer -> one flush
+    std::string wire;
+    wire.reserve(messages.size() * message_buffer_len_);
+    for (const auto &message : messages)
+        FrameBuffer::encode(wire, message, message_buffer_len_);
+
+    std::lock_guard<std::mutex> lk(send_mtx_);
+    const char *p = wire.data();
+    int left = static_cast<int>(wire.size());
+    while (left > 0) {
+        int iResult = send(ConnectSocket_, p, left, 0);
+        if (iResult == SOCKET_ERROR) {
+            std::stringstream oss;
+            oss << "[Error] send failed with error: " << WSAGetLastError();
+            // TODO: logging here
+            throw std::runtime_error(oss.str());
+        }
+        p += iResult;
+        left -= iResult;
+    }
+}
+
 void ServerSocket::_shutdown()
 {
     if (state.load() == State::DisConnection)
@@ -77,14 +121,19 @@ void ServerSocket::_shutdown()
 
 void ServerSocket::_recv_func_async()
 {
+    FrameBuffer frames(message_buffer_len_);
+    std::vector<std::string> batch;
     while (state.load() == State::Connection) {
-        std::vector<char> buffer(message_buffer_len_);
-        int iResult =
-            recv(ConnectSocket_, buffer.data(), message_buffer_len_, 0);
+        int iResult = recv(ConnectSocket_, frames.write_ptr(),
+                           static_cast<int>(frames.writable()), 0);
 
         if (iResult > 0) {
-            // TODO: handle incoming event here
-            send_message(buffer.data());  // * dummy behavior for test
+            frames.commit(iResult);
+            // drain every complete frame, wait for more on a partial one
+            if (frames.drain(batch) == 0)
+                continue;
+            server_._callback(id_, batch);
+            batch.clear();
         } else if (iResult == 0) {
             // Connection closed by client
             // TODO: handle graceful disconnect here
@@ -102,6 +151,9 @@ void ServerSocket::_recv_func_async()
     // Clean-up after loop exit
     // 教授提供意見: 讓 thread 自己 stop 順便 dispose 會不會好處理一點?
     state.store(State::DisConnection);
+    if (ConnectSocket_ != INVALID_SOCKET)
+        shutdown(ConnectSocket_, SD_BOTH);  // a stalled send returns
+    server_._forget(id_);  // session waits for a resume from here on
     if (ConnectSocket_ != INVALID_SOCKET) {
         closesocket(ConnectSocket_);
         ConnectSocket_ = INVALID_SOCKET;  // Prevent misuse
@@ -114,15 +166,156 @@ void ServerSocket::_recv_func_async()
 // Server Implementation
 //------------------------------------------------------------------------------
 
+namespace
+{
+
+/**
+ * @brief Report a handler that missed its deadline.
+ */
+void _report_overrun(const Watchdog::Overrun &o)
+{
+    using std::chrono::duration_cast;
+    using std::chrono::milliseconds;
+    std::stringstream oss;
+    oss << "[Watchdog] handler '" << o.label << "' of connection " << o.owner
+        << (o.finished ? " finished after " : " still running after ")
+        << duration_cast<milliseconds>(o.elapsed).count() << " ms (budget "
+        << duration_cast<milliseconds>(o.budget).count() << " ms)";
+    LoggerRegistry::instance().get_logger("server")->warning(oss.str());
+}
+
+/// Report @p what to the "server" logger as a warning.
+void _warn(const std::string &what)
+{
+    LoggerRegistry::instance().get_logger("server")->warning(what);
+}
+
+/// Reply refusing a @p type event sent on behalf of another user.
+std::string _forbidden(const std::string &type)
+{
+    nlohmann::json reply;
+    reply["type"] = type;
+    reply["ok"] = false;
+    reply["reason"] = "forbidden";
+    return reply.dump();
+}
+
+/// Reply to a batch shed unhandled: @p shed events were not looked at.
+std::string _busy(std::size_t shed)
+{
+    return R"({"ok":false,"reason":"busy","shed":)" + std::to_string(shed) +
+           '}';
+}
+
+/**
+ * @brief Strand key of a chat event.
+ *
+ * A one-to-one conversation is keyed by both user names in sorted order so
+ * that "a -> b" and "b -> a" share one strand. A room is keyed by its name
+ * behind a '#'; should that collide with a user pair, the two merely share
+ * a strand.
+ *
+ * @return false if the event names no conversation.
+ */
+bool _conversation_key(const nlohmann::json &event, std::string &out)
+{
+    auto from = event.find("from");
+    if (from == event.end() || !from->is_string())
+        return false;
+    auto room = event.find("room");
+    if (room != event.end() && room->is_string()) {
+        out = '#' + room->get<std::string>();
+        return true;
+    }
+    auto to = event.find("to");
+    if (to == event.end() || !to->is_string())
+        return false;
+    const auto &a = from->get_ref<const std::string &>();
+    const auto &b = to->get_ref<const std::string &>();
+    out = a < b ? a + '\n' + b : b + '\n' + a;
+    return true;
+}
+
+/// Wall clock for history records, ms since the Unix epoch.
+std::uint64_t _now_ms()
+{
+    using namespace std::chrono;
+    return static_cast<std::uint64_t>(
+        duration_cast<milliseconds>(system_clock::now().time_since_epoch())
+            .count());
+}
+
+/**
+ * @brief Conversation and sequence number of a chat stamped by
+ * Server::_stamp().
+ * @return false for anything else.
+ */
+bool _stamp_of(const std::string &message,
+               std::string &conversation,
+               std::uint64_t &seq)
+{
+    auto event = nlohmann::json::parse(message, nullptr, false);
+    if (event.is_discarded() || !event.contains("conversation") ||
+        !event.contains("seq") || !event["conversation"].is_string() ||
+        !event["seq"].is_number_unsigned())
+        return false;
+    conversation = event["conversation"].get<std::string>();
+    seq = event["seq"].get<std::uint64_t>();
+    return true;
+}
+
+/// Leads a snapshot of journal_ with friendships, rooms and sessions; an
+/// image without it holds the friendships alone ( an older server's ).
+constexpr std::string_view kStateMagic = "CHATST02";
+
+/// Append @p section to @p image behind its length ( 8 bytes LE ).
+void _put_section(std::string &image, const std::string &section)
+{
+    for (int i = 0; i < 8; ++i)
+        image += static_cast<char>(section.size() >> (8 * i) & 0xFF);
+    image += section;
+}
+
+/// Take a section put by _put_section() from the front of @p in.
+bool _take_section(std::string_view &in, std::string_view &section)
+{
+    if (in.size() < 8)
+        return false;
+    std::uint64_t len = 0;
+    for (int i = 0; i < 8; ++i)
+        len |= std::uint64_t(static_cast<unsigned char>(in[i])) << (8 * i);
+    in.remove_prefix(8);
+    if (len > in.size())
+        return false;
+    section = in.substr(0, len);
+    in.remove_prefix(len);
+    return true;
+}
+
+}  // namespace
+
 Server::Server(const std::string &server_ip,
                const std::string &server_port,
                int max_connections,
-               int message_buffer_len)
+               int message_buffer_len,
+               std::unique_ptr<HistoryEngine> history,
+               DedupOptions dedup)
     : server_ip_(server_ip),
       server_port_(server_port),
       max_connections_(max_connections),
-      message_buffer_len_(message_buffer_len)
+      message_buffer_len_(message_buffer_len),
+      watchdog_(_report_overrun),
+      chat_strands_(pool_),
+      history_(history ? std::move(history)
+                       : std::make_unique<HistoryStore>("history")),
+      dedup_(dedup.memory_bytes, dedup.window),
+      dedup_scan_(dedup.scan)
 {
+    if (auto *store = dynamic_cast<HistoryStore *>(history_.get()))
+        history_compactor_ = std::make_unique<HistoryCompactor>(
+            *store, _history_compaction());
+    _restore_state();
+    _index_history();
     if (_init()) {
         throw std::runtime_error("Initialization failed");
     }
@@ -169,6 +362,31 @@ void Server::shutdown()
         accept_thread_.join();
     }
 
+    // logins in progress finish ( their sessions are journaled below );
+    // queued ones are dropped with their closed connections
+    login_pool_.shutdown();
+
+    // accepted chats reach the writer, the writer the disk, and their
+    // deliveries ( now to inboxes ) run before the workers stop
+    chat_strands_.wait_idle();
+    history_writer_.shutdown();
+    chat_strands_.wait_idle();
+    pool_.shutdown();  // no chat task may outlive the handlers
+    // chats still in memory for offline users go to disk with the rest
+    try {
+        inboxes_.flush();
+    } catch (const std::exception &e) {
+        _warn(std::string("[Inbox] chats lost at shutdown: ") + e.what());
+    }
+    // every stored chat is indexed now: the next start reads this back
+    if (!search_.save(kSearchFile, _now_ms()))
+        LoggerRegistry::instance().get_logger("server")->warning(
+            "cannot save the search index; the next start rebuilds it");
+    if (history_compactor_)
+        history_compactor_->stop();
+    journal_.sync();
+    journal_.wait();  // a snapshot in flight is finished, not torn
+
     WSACleanup();
 }
 
@@ -180,6 +398,17 @@ const ServerSocket &Server::get_server_sock(size_t i) const
     return *ConnectSockets_[i];
 }
 
+void Server::register_plugin(const std::string &event_name,
+                             std::shared_ptr<BaseEventHandler> handler)
+{
+    if (!handler)
+        throw std::invalid_argument("plugin handler is null");
+    dispatcher_.register_plugin(event_name,
+                                [handler](const std::string &json) {
+                                    return handler->handle(json);
+                                });
+}
+
 void Server::_accept()
 {
     std::unique_lock<std::mutex> lock(accept_mtu_);
@@ -209,9 +438,7 @@ void Server::_accept()
         }
 
         auto server_sock = std::make_unique<ServerSocket>(
-            ClientSocket, cv_,
-            [this](const std::string &msg) { return _callback(msg); },
-            message_buffer_len_);
+            ClientSocket, cv_, *this, next_conn_id_++, message_buffer_len_);
 
         bool reused = false;
         for (auto &ptr : ConnectSockets_) {
@@ -281,11 +508,1261 @@ bool Server::_init()
     return false;
 }
 
-bool Server::_callback(const std::string &json)
+std::size_t Server::_callback(std::uint64_t conn_id,
+                              const std::vector<std::string> &events)
+{
+    // shed: this connection recently stalled a handler
+    if (watchdog_.is_throttled(conn_id)) {
+        _warn("[Shed] " + std::to_string(events.size()) +
+              " events of throttled connection " + std::to_string(conn_id));
+        _reply(conn_id, _busy(events.size()));
+        return 0;
+    }
+
+    struct Locked {
+        bool builtin;
+        EventType type;
+        std::string name;
+        const std::string *json;
+    };
+    // events that need the handler lock
+    std::vector<Locked> locked;
+    // events for the login pool
+    std::vector<const std::string *> logins;
+    struct Delivery {
+        std::string from;
+        std::string to;  ///< User, or room name if room is set
+        bool room;
+        std::string event;
+        std::string id;  ///< Idempotency key, may be empty
+    };
+    std::vector<std::pair<std::string, std::vector<Delivery>>>
+        chats;  // conversation -> chat events, arrival order
+
+    const auto budget = handler_budget_.load();
+    std::size_t handled = 0;
+    std::vector<std::string> replies;  // to this connection, one flush
+
+    std::string user;  // logged in as, empty until a login or resume
+    {
+        std::lock_guard<std::mutex> lk(conns_mtx_);
+        auto it = conns_.find(conn_id);
+        if (it != conns_.end())
+            user = it->second.user;
+    }
+
+    for (const auto &json : events) {
+        auto event = nlohmann::json::parse(json, nullptr, false);
+        if (event.is_discarded() || !event.contains("type") ||
+            !event["type"].is_string()) {
+            // TODO: logging here
+            continue;
+        }
+        const std::string &name = event["type"].get_ref<const std::string &>();
+        // requests answered here run under a deadline like any handler
+        if (name == "ack") {
+            auto ticket = watchdog_.watch(name, conn_id, budget);
+            auto conversation = event.find("conversation");
+            auto seq = event.find("seq");
+            if (conversation != event.end() && conversation->is_string() &&
+                seq != event.end() && seq->is_number_unsigned()) {
+                _ack(conn_id, conversation->get_ref<const std::string &>(),
+                     seq->get<std::uint64_t>());
+                ++handled;
+            }
+            continue;
+        }
+        if (name == "resume") {
+            auto ticket = watchdog_.watch(name, conn_id, budget);
+            auto token = event.find("token");
+            if (token != event.end() && token->is_string() &&
+                _resume(conn_id, token->get_ref<const std::string &>(),
+                        replies))
+                ++handled;
+            continue;
+        }
+        if (name == "history") {
+            auto ticket = watchdog_.watch(name, conn_id, budget);
+            auto room = event.find("room");
+            const bool is_room = room != event.end() && room->is_string();
+            auto peer = is_room ? room : event.find("with");
+            auto before = event.find("before");
+            auto at = event.find("at");
+            auto limit = event.find("limit");
+            const bool numbers =
+                (before == event.end() || before->is_number_unsigned()) &&
+                (at == event.end() || at->is_number_unsigned()) &&
+                (limit == event.end() || limit->is_number_unsigned());
+            if (peer != event.end() && peer->is_string() && numbers &&
+                _history(conn_id, peer->get_ref<const std::string &>(),
+                         is_room,
+                         before == event.end() ? 0
+                                               : before->get<MessageId>(),
+                         at == event.end() ? 0 : at->get<std::uint64_t>(),
+                         limit == event.end() ? kHistoryPage
+                                              : limit->get<std::size_t>(),
+                         replies))
+                ++handled;
+            continue;
+        }
+        if (name == "search") {
+            auto ticket = watchdog_.watch(name, conn_id, budget);
+            auto query = event.find("query");
+            auto room = event.find("room");
+            const bool is_room = room != event.end() && room->is_string();
+            auto peer = is_room ? room : event.find("with");
+            auto before = event.find("before");
+            auto limit = event.find("limit");
+            const bool valid =
+                query != event.end() && query->is_string() &&
+                (peer == event.end() || peer->is_string()) &&
+                (before == event.end() || before->is_number_unsigned()) &&
+                (limit == event.end() || limit->is_number_unsigned());
+            if (valid &&
+                _search(conn_id, query->get_ref<const std::string &>(),
+                        peer == event.end() ? std::string()
+                                            : peer->get<std::string>(),
+                        is_room,
+                        before == event.end() ? 0
+                                              : before->get<std::uint64_t>(),
+                        limit == event.end() ? kHistoryPage
+                                             : limit->get<std::size_t>(),
+                        replies))
+                ++handled;
+            continue;
+        }
+        if (name == "stats") {
+            auto ticket = watchdog_.watch(name, conn_id, budget);
+            if (_stats(conn_id, replies))
+                ++handled;
+            continue;
+        }
+        if (name == "suggest") {
+            auto ticket = watchdog_.watch(name, conn_id, budget);
+            if (_suggest(conn_id, replies))
+                ++handled;
+            continue;
+        }
+        if (name == "delete") {
+            auto ticket = watchdog_.watch(name, conn_id, budget);
+            auto id = event.find("message_id");
+            if (id != event.end() && id->is_number_unsigned() &&
+                _delete(conn_id, id->get<MessageId>(), replies))
+                ++handled;
+            continue;
+        }
+        EventType type = EventType::Login;
+        const bool builtin = parse_event_type(name, type);
+
+        if (builtin && type == EventType::Chat) {
+            std::string conversation;
+            if (!_conversation_key(event, conversation))
+                continue;
+            // client retries are recognized on the strand ( see below )
+            auto id = event.find("id");
+            const bool has_id = id != event.end() && id->is_string();
+            // a chat speaks for the connection's own user only
+            if (user.empty() || event["from"] != user) {
+                replies.push_back(
+                    _refusal(has_id ? id->get<std::string>() : ""));
+                continue;
+            }
+            // it must still fit a frame once _stamp() has added to it
+            event["conversation"] = conversation;
+            event["seq"] = std::numeric_limits<std::uint64_t>::max();
+            if (event.dump().size() >
+                static_cast<std::size_t>(message_buffer_len_)) {
+                replies.push_back(_refusal(
+                    has_id ? id->get<std::string>() : "", "too_large"));
+                continue;
+            }
+            // batches are small: a linear scan beats a map here
+            auto it = std::find_if(
+                chats.begin(), chats.end(),
+                [&](const auto &c) { return c.first == conversation; });
+            if (it == chats.end())
+                it = chats.emplace(chats.end(), std::move(conversation),
+                                   std::vector<Delivery>{});
+            const bool room = event.contains("room");
+            it->second.push_back(Delivery{
+                event["from"].get<std::string>(),
+                event[room ? "room" : "to"].get<std::string>(), room, json,
+                has_id ? id->get<std::string>() : std::string()});
+        } else if (builtin && type == EventType::Login) {
+            logins.push_back(&json);
+        } else if (builtin && type == EventType::AddFriend &&
+                   (user.empty() || event["from"] != user)) {
+            // a friendship is changed by one of its own users only
+            replies.push_back(_forbidden(name));
+        } else if (builtin && type == EventType::Room &&
+                   (user.empty() || event["user"] != user)) {
+            // users join and leave rooms themselves: membership grants
+            // the room's history
+            replies.push_back(_forbidden(name));
+        } else {
+            locked.push_back(Locked{builtin, type, name, &json});
+        }
+    }
+
+    _flush(conn_id, replies);
+
+    // chat: one strand post per conversation, ordered, no global lock
+    for (auto &chat : chats) {
+        handled += chat.second.size();
+        chat_strands_.post(
+            chat.first,
+            [this, conn_id, budget, conversation = chat.first,
+             batch = std::move(chat.second)] {
+                for (const auto &d : batch) {
+                    auto ticket = watchdog_.watch("chat", conn_id, budget);
+                    // a retry: confirm the copy in flight or stored. Every
+                    // copy of a key runs on this strand, so no two race
+                    const std::string key =
+                        d.id.empty() ? std::string() : d.from + '\n' + d.id;
+                    if (!key.empty()) {
+                        std::uint64_t seq = 0;
+                        MessageId stored = 0;
+                        {
+                            std::lock_guard<std::mutex> lk(sending_mtx_);
+                            auto it = sending_.find(key);
+                            if (it != sending_.end()) {
+                                it->second.push_back(conn_id);
+                                continue;
+                            }
+                        }
+                        if (dedup_.contains(key) &&
+                            _find_sent(conversation, d.from, d.id, seq,
+                                       stored)) {
+                            _confirm(conn_id, d.id, conversation, seq,
+                                     stored);
+                            continue;
+                        }
+                    }
+                    // membership is checked here, in order with the
+                    // room's other events
+                    if (d.room && !dispatcher_.get<EventType::Room>()
+                                       .is_member(d.to, d.from)) {
+                        _reply(conn_id, _refusal(d.id));
+                        continue;
+                    }
+                    if (!dispatcher_.dispatch(EventType::Chat, d.event))
+                        continue;
+                    if (!key.empty()) {
+                        std::lock_guard<std::mutex> lk(sending_mtx_);
+                        sending_[key].push_back(conn_id);
+                    }
+                    std::uint64_t seq;
+                    const auto message = _stamp(conversation, d.event, seq);
+                    const std::uint64_t now = _now_ms();
+                    auto deliver = [this, conversation, d, key, seq, message,
+                                    now](MessageId stored) {
+                        if (stored == 0)
+                            _warn("[History] chat from " + d.from +
+                                  " not stored, delivered anyway");
+                        if (stored != 0) {
+                            recent_.on_append(conversation, stored, now,
+                                              message);
+                            _index(conversation, stored, message);
+                        }
+                        if (d.room)
+                            _fan_out(d.to, d.from, seq, message);
+                        else
+                            _deliver(d.to, conversation, seq, message);
+                        if (key.empty())
+                            return;
+                        // only a stored chat counts as seen: a failed one
+                        // may be sent again
+                        if (stored != 0)
+                            dedup_.insert(key);
+                        std::vector<std::uint64_t> waiting;
+                        {
+                            std::lock_guard<std::mutex> lk(sending_mtx_);
+                            auto it = sending_.find(key);
+                            if (it != sending_.end()) {
+                                waiting = std::move(it->second);
+                                sending_.erase(it);
+                            }
+                        }
+                        for (const auto waiter : waiting)
+                            _confirm(waiter, d.id, conversation, seq, stored);
+                    };
+                    // delivered once durable, back on the strand: the
+                    // writer thread only commits
+                    history_writer_.append(
+                        conversation, message, now,
+                        [this, conversation,
+                         deliver = std::move(deliver)](MessageId stored) {
+                            chat_strands_.post(conversation,
+                                               [deliver, stored] {
+                                                   deliver(stored);
+                                               });
+                        });
+                }
+            });
+    }
+
+    // login: bounded KDF pool, shed when its queue is full
+    for (const auto *json : logins) {
+        const bool admitted =
+            login_pool_.try_submit([this, conn_id, budget, json = *json] {
+                auto ticket = watchdog_.watch("login", conn_id, budget);
+                if (!dispatcher_.dispatch(EventType::Login, json)) {
+                    _reply(conn_id, R"({"type":"login","ok":false})");
+                    return;
+                }
+                // the handler validated the event, "username" is a string
+                auto event = nlohmann::json::parse(json, nullptr, false);
+                const auto user = event["username"].get<std::string>();
+                if (_open_session(conn_id, user))
+                    _replay_inbox(conn_id, user);
+            });
+        if (admitted)
+            ++handled;
+        else
+            _reply(conn_id,
+                   R"({"type":"login","ok":false,"reason":"busy"})");
+    }
+    if (locked.empty())
+        return handled;
+
+    // one lock acquisition for the rest of the batch; shed it if another
+    // handler holds the lock past its deadline
+    std::unique_lock<std::timed_mutex> lock(callback_mtu_, budget);
+    if (!lock.owns_lock()) {
+        _warn("[Shed] " + std::to_string(locked.size()) +
+              " events of connection " + std::to_string(conn_id) +
+              ": handler lock busy past the deadline");
+        _reply(conn_id, _busy(locked.size()));
+        return handled;
+    }
+    for (const auto &e : locked) {
+        auto ticket = watchdog_.watch(e.name, conn_id, budget);
+        // fast path for built-in events, plugin slow path otherwise
+        const bool ok = e.builtin ? dispatcher_.dispatch(e.type, *e.json)
+                                  : dispatcher_.dispatch(e.name, *e.json);
+        if (ok && e.builtin)
+            _journal(e.type, *e.json);
+        if (ok && e.builtin && e.type == EventType::Room)
+            _follow_room(*e.json);
+        if (e.builtin && e.type == EventType::AddFriend)
+            _answer_friend(*e.json, ok, replies);
+        handled += ok ? 1 : 0;
+    }
+    _flush(conn_id, replies);
+    return handled;
+}
+
+bool Server::_open_session(std::uint64_t conn_id, const std::string &username)
+{
+    const std::uint64_t session = _change_session("open", 0, username);
+    if (session == 0) {
+        _reply(conn_id, R"({"type":"login","ok":false,"reason":"busy"})");
+        return false;
+    }
+    std::uint64_t previous = 0;
+    {
+        std::lock_guard<std::mutex> lk(conns_mtx_);
+        auto it = conns_.find(conn_id);
+        if (it == conns_.end()) {  // gone while the KDF ran
+            sessions_.detach(session);
+            return false;
+        }
+        previous = it->second.session;
+        it->second.session = session;
+    }
+    if (previous != 0)
+        _change_session("close", previous);  // logged in twice
+
+    nlohmann::json reply;
+    reply["type"] = "login";
+    reply["ok"] = true;
+    reply["token"] = tokens_.issue(username, session);
+    _reply(conn_id, reply.dump());
+    return true;
+}
+
+bool Server::_resume(std::uint64_t conn_id,
+                     const std::string &token,
+                     std::vector<std::string> &replies)
+{
+    SessionClaims claims;
+    SessionState state;
+    if (!tokens_.verify(token, claims) ||
+        !sessions_.attach(claims.session_id, claims.user, state)) {
+        replies.push_back(R"({"type":"resume","ok":false})");
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lk(conns_mtx_);
+        auto it = conns_.find(conn_id);
+        if (it != conns_.end())
+            it->second.session = claims.session_id;
+        // taken over: the old connection must not detach it when it goes
+        for (auto &other : conns_) {
+            if (other.first != conn_id &&
+                other.second.session == claims.session_id)
+                other.second.session = 0;
+        }
+    }
+
+    nlohmann::json reply;
+    reply["type"] = "resume";
+    reply["ok"] = true;
+    reply["subscriptions"] = state.subscriptions;
+    replies.push_back(reply.dump());
+    _flush(conn_id, replies);  // the reply goes ahead of the inbox
+    _replay_inbox(conn_id, claims.user);
+    return true;
+}
+
+bool Server::_history(std::uint64_t conn_id,
+                      const std::string &peer,
+                      bool room,
+                      MessageId before,
+                      std::uint64_t at,
+                      std::size_t limit,
+                      std::vector<std::string> &replies)
 {
-    std::lock_guard<std::mutex> lock(callback_mtu_);
-    // TODO: handel Event here
+    std::string user;
+    {
+        std::lock_guard<std::mutex> lk(conns_mtx_);
+        auto it = conns_.find(conn_id);
+        if (it == conns_.end() || it->second.user.empty())
+            return false;
+        user = it->second.user;
+    }
+    std::string conversation;
+    if (room) {
+        if (!dispatcher_.get<EventType::Room>().is_member(peer, user))
+            return false;
+        conversation = '#' + peer;
+    } else {
+        conversation = user < peer ? user + '\n' + peer : peer + '\n' + user;
+    }
+
+    // a cached page is copied out of recent_; the rest are read in place
+    limit = std::min(limit, kHistoryPage);
+    std::vector<HistoryRecord> cached;
+    HistoryPage page;
+    if (at != 0) {
+        // a jump to a date: the time index finds it, the cache cannot
+        history_->fetch_at(conversation, at, limit, page);
+    } else if (recent_.get(conversation, before, limit, cached, page.next)) {
+        page.records.resize(cached.size());
+        for (std::size_t i = 0; i < cached.size(); ++i) {
+            page.records[i].id = cached[i].id;
+            page.records[i].payload = cached[i].payload;
+        }
+    } else if (before == 0) {
+        // opening a chat: admit the conversation with its newest messages
+        const auto ticket = recent_.begin_fill(conversation);
+        if (!history_->fetch(conversation, 0, recent_.per_conversation(),
+                            page))
+            return false;
+        recent_.fill(conversation, ticket, page.records, page.next == 0);
+        if (page.records.size() > limit) {
+            page.next = limit == 0 ? 0 : page.records[limit - 1].id;
+            page.records.resize(limit);
+        }
+    } else if (!history_->fetch(conversation, before, limit, page)) {
+        return false;
+    }
+
+    nlohmann::json head;
+    head["type"] = "history";
+    head["conversation"] = conversation;
+    std::string reply = head.dump();
+    reply.pop_back();  // '}'
+    reply += ",\"messages\":[";
+    const std::size_t n = _splice(reply, page.records);
+    const MessageId next =
+        n < page.records.size() ? page.records[n - 1].id : page.next;
+    reply += "],\"next\":" + std::to_string(next) + '}';
+    replies.push_back(std::move(reply));
+    return true;
+}
+
+bool Server::_search(std::uint64_t conn_id,
+                     const std::string &query,
+                     const std::string &peer,
+                     bool room,
+                     std::uint64_t before,
+                     std::size_t limit,
+                     std::vector<std::string> &replies)
+{
+    std::string user;
+    {
+        std::lock_guard<std::mutex> lk(conns_mtx_);
+        auto it = conns_.find(conn_id);
+        if (it == conns_.end() || it->second.user.empty())
+            return false;
+        user = it->second.user;
+    }
+    std::vector<std::string> scope;
+    if (peer.empty()) {
+        scope = search_.conversations_of(user);
+    } else if (room) {
+        if (!dispatcher_.get<EventType::Room>().is_member(peer, user))
+            return false;
+        scope.push_back('#' + peer);
+    } else {
+        scope.push_back(user < peer ? user + '\n' + peer
+                                    : peer + '\n' + user);
+    }
+
+    limit = std::min(limit, kHistoryPage);
+    std::vector<SearchHit> hits;
+    search_.search(scope, query, before, limit, hits);
+
+    // the index never forgets: erased chats drop out here
+    std::vector<RecordView> records;
+    std::vector<std::uint64_t> docs;
+    RecordView r;
+    for (const auto &hit : hits) {
+        if (history_->view(hit.id, r)) {
+            records.push_back(r);
+            docs.push_back(hit.doc);
+        }
+    }
+
+    nlohmann::json head;
+    head["type"] = "search";
+    head["query"] = query;
+    std::string reply = head.dump();
+    reply.pop_back();  // '}'
+    reply += ",\"messages\":[";
+    const std::size_t n = _splice(reply, records);
+    std::uint64_t next = 0;
+    if (n < records.size())
+        next = docs[n - 1];
+    else if (hits.size() == limit && limit != 0)
+        next = hits.back().doc;
+    reply += "],\"next\":" + std::to_string(next) + '}';
+    replies.push_back(std::move(reply));
+    return true;
+}
+
+void Server::_index(const std::string &conversation,
+                    MessageId id,
+                    std::string_view stored)
+{
+    const auto chat =
+        nlohmann::json::parse(stored.begin(), stored.end(), nullptr, false);
+    if (!chat.is_object())
+        return;
+    std::string text;
+    for (const auto &field : chat.items()) {
+        const auto &key = field.key();
+        if (!field.value().is_string() || key == "type" || key == "from" ||
+            key == "to" || key == "room" || key == "id" ||
+            key == "conversation")
+            continue;
+        text += field.value().get_ref<const std::string &>();
+        text += '\n';
+    }
+    search_.add(conversation, id, text);
+}
+
+void Server::_restore_state()
+{
+    auto &friends = dispatcher_.get<EventType::AddFriend>();
+    auto &rooms = dispatcher_.get<EventType::Room>();
+    journal_.recover(
+        [&](std::string_view image) {
+            if (image.substr(0, kStateMagic.size()) != kStateMagic)
+                return friends.restore(image);
+            image.remove_prefix(kStateMagic.size());
+            std::string_view f, r;
+            return _take_section(image, f) && _take_section(image, r) &&
+                   friends.restore(f) && rooms.restore(r) &&
+                   sessions_.load(image) && image.empty();
+        },
+        [&](std::string_view record) {
+            // one tag byte, then the event as it was received or the
+            // session change
+            if (record.empty())
+                return;
+            const std::string body(record.substr(1));
+            if (record[0] == kFriendRecord)
+                friends.handle(body);
+            else if (record[0] == kRoomRecord)
+                rooms.handle(body);
+            if (record[0] != kSessionRecord)
+                return;
+            const auto change = nlohmann::json::parse(body, nullptr, false);
+            if (change.is_discarded())
+                return;
+            const auto op = change.value("op", std::string());
+            const auto id = change.value("session", std::uint64_t(0));
+            const auto arg = change.value("arg", std::string());
+            if (op == "open")
+                sessions_.adopt(id, arg);
+            else if (op == "close")
+                sessions_.close(id);
+            else if (op == "subscribe")
+                sessions_.subscribe(id, arg);
+            else if (op == "unsubscribe")
+                sessions_.unsubscribe(id, arg);
+        });
+}
+
+void Server::_journal(EventType type, const std::string &json)
+{
+    if (type == EventType::AddFriend)
+        _log_state(kFriendRecord + json);
+    else if (type == EventType::Room)
+        _log_state(kRoomRecord + json);
+}
+
+std::uint64_t Server::_change_session(const std::string &op,
+                                      std::uint64_t session,
+                                      const std::string &arg)
+{
+    std::lock_guard<std::mutex> lk(session_log_mtx_);
+    bool changed = true;
+    if (op == "open")
+        session = sessions_.open(arg);
+    else if (op == "close")
+        sessions_.close(session);
+    else if (op == "subscribe")
+        changed = sessions_.subscribe(session, arg);
+    else
+        changed = sessions_.unsubscribe(session, arg);
+    if (session == 0 || !changed)
+        return 0;
+
+    nlohmann::json record;
+    record["op"] = op;
+    record["session"] = session;
+    if (!arg.empty())
+        record["arg"] = arg;
+    _log_state(kSessionRecord + record.dump());
+    return session;
+}
+
+void Server::_log_state(const std::string &record)
+{
+    try {
+        journal_.append(record);
+        if (journal_.snapshot_due())
+            journal_.snapshot([this] { return _capture_state(); });
+    } catch (const std::exception &e) {
+        LoggerRegistry::instance().get_logger("server")->error(
+            std::string("[Journal] change kept in memory only: ") + e.what());
+    }
+}
+
+StateJournal::Encoder Server::_capture_state()
+{
+    auto friends = dispatcher_.get<EventType::AddFriend>().snapshot();
+    auto rooms = dispatcher_.get<EventType::Room>().snapshot();
+    std::string sessions;
+    sessions_.save(sessions);
+    return [friends = std::move(friends), rooms = std::move(rooms),
+            sessions = std::move(sessions)](std::string &image) {
+        std::string section;
+        image += kStateMagic;
+        friends(section);
+        _put_section(image, section);
+        section.clear();
+        rooms(section);
+        _put_section(image, section);
+        image += sessions;
+    };
+}
+
+std::string Server::_token_key()
+{
+    {
+        std::ifstream in(kKeyFile, std::ios::binary);
+        std::string key{std::istreambuf_iterator<char>(in),
+                        std::istreambuf_iterator<char>()};
+        if (key.size() == 32)
+            return key;
+    }
+    // a key that cannot be kept only costs the tokens at the next restart
+    std::string key = random_bytes(32);
+    std::ofstream out(kKeyFile, std::ios::binary | std::ios::trunc);
+    out.write(key.data(), static_cast<std::streamsize>(key.size()));
+    return key;
+}
+
+void Server::_index_history()
+{
+    // the index saved at the last shutdown, if it belongs to this history:
+    // one of its newest chats is still there
+    std::uint64_t mark = 0;
+    bool loaded = false;
+    if (search_.load(kSearchFile, mark)) {
+        RecordView r;
+        const std::uint64_t docs = search_.documents();
+        for (std::uint64_t doc = docs; doc > 0 && doc + 16 > docs; --doc)
+            loaded = loaded || history_->view(search_.id_of(doc), r);
+        if (!loaded)
+            search_.clear();
+    }
+
+    // the rest, oldest first, so newer chats get higher document numbers
+    std::vector<std::pair<std::uint64_t, MessageId>> order;
+    history_->scan_since(loaded ? mark + 1 : 0, [&](const RecordView &r) {
+        order.emplace_back(r.timestamp, r.id);
+    });
+    std::sort(order.begin(), order.end());
+    RecordView r;
+    for (const auto &o : order) {
+        if (history_->view(o.second, r))
+            _index(std::string(r.conversation), r.id, r.payload);
+    }
+}
+
+std::size_t Server::_splice(std::string &reply,
+                            const std::vector<RecordView> &records) const
+{
+    // stored chats are JSON already: splice them in, no re-parse. Room is
+    // left for ],"next":<20 digits>}
+    const std::size_t cap = static_cast<std::size_t>(message_buffer_len_) - 32;
+    const std::size_t head = std::min(reply.size(), cap);
+    std::size_t n = 0;
+    std::string placeholder;
+    for (std::size_t i = 0; i < records.size(); ++i) {
+        std::string_view payload = records[i].payload;
+        if (payload.size() + 1 > cap - head) {
+            // would never fit a frame: say it is there, by id
+            placeholder = R"({"type":"chat","message_id":)" +
+                          std::to_string(records[i].id) +
+                          R"(,"too_large":true})";
+            payload = placeholder;
+        }
+        if (reply.size() + payload.size() + 1 > cap) {
+            if (n != 0)
+                return i;  // the rest goes on the next page
+            continue;      // not even the placeholder fits
+        }
+        if (n != 0)
+            reply += ',';
+        reply.append(payload.data(), payload.size());
+        ++n;
+    }
+    return records.size();
+}
+
+bool Server::_delete(std::uint64_t conn_id,
+                     MessageId id,
+                     std::vector<std::string> &replies)
+{
+    std::string user;
+    {
+        std::lock_guard<std::mutex> lk(conns_mtx_);
+        auto it = conns_.find(conn_id);
+        if (it == conns_.end() || it->second.user.empty())
+            return false;
+        user = it->second.user;
+    }
+
+    // only the sender may delete: stored chats carry their "from"
+    bool ok = false;
+    HistoryRecord record;
+    if (history_->read(id, record)) {
+        const auto chat =
+            nlohmann::json::parse(record.payload, nullptr, false);
+        auto from = chat.find("from");
+        ok = chat.is_object() && from != chat.end() && from->is_string() &&
+             from->get_ref<const std::string &>() == user &&
+             history_->erase(id);
+        if (ok)
+            recent_.invalidate(record.conversation);  // refilled on a miss
+    }
+
+    nlohmann::json reply;
+    reply["type"] = "delete";
+    reply["message_id"] = id;
+    reply["ok"] = ok;
+    replies.push_back(reply.dump());
+    return true;
+}
+
+CompactionOptions Server::_history_compaction()
+{
+    CompactionOptions options;
+    options.cold_after = kColdHistory;
+    return options;
+}
+
+bool Server::_stats(std::uint64_t conn_id, std::vector<std::string> &replies)
+{
+    {
+        std::lock_guard<std::mutex> lk(conns_mtx_);
+        auto it = conns_.find(conn_id);
+        if (it == conns_.end() || it->second.user.empty())
+            return false;
+    }
+    const RecentCacheStats cache = recent_.stats();
+    const std::uint64_t lookups = cache.hits + cache.misses;
+
+    nlohmann::json reply;
+    reply["type"] = "stats";
+    auto &h = reply["history_cache"];
+    h["hits"] = cache.hits;
+    h["misses"] = cache.misses;
+    h["hit_rate"] = lookups == 0 ? 0.0 : 1.0 * cache.hits / lookups;
+    h["evictions"] = cache.evictions;
+    h["conversations"] = cache.conversations;
+    h["bytes"] = cache.bytes;
+    h["budget"] = cache.budget;
+
+    if (auto *store = dynamic_cast<const HistoryStore *>(history_.get())) {
+        const TierStats tiers = store->tiers();
+        auto &t = reply["history_tiers"];
+        t["hot_segments"] = tiers.hot_segments;
+        t["hot_bytes"] = tiers.hot_records;
+        t["cold_segments"] = tiers.cold_segments;
+        t["cold_bytes"] = tiers.cold_bytes;
+        t["cold_saved_bytes"] = tiers.cold_records > tiers.cold_bytes
+                                    ? tiers.cold_records - tiers.cold_bytes
+                                    : 0;
+        t["cold_blocks_read"] = tiers.cold_blocks_read;
+    }
+    replies.push_back(reply.dump());
+    return true;
+}
+
+bool Server::_suggest(std::uint64_t conn_id,
+                      std::vector<std::string> &replies)
+{
+    std::string user;
+    {
+        std::lock_guard<std::mutex> lk(conns_mtx_);
+        auto it = conns_.find(conn_id);
+        if (it == conns_.end() || it->second.user.empty())
+            return false;
+        user = it->second.user;
+    }
+    auto &friends = dispatcher_.get<EventType::AddFriend>();
+
+    nlohmann::json reply;
+    reply["type"] = "suggest";
+    reply["friends"] = friends.friends_of(user);
+    auto &suggestions = reply["suggestions"] = nlohmann::json::array();
+    for (const auto &s : friends.suggest_friends(user))
+        suggestions.push_back({{"user", s.first}, {"mutual", s.second}});
+    replies.push_back(reply.dump());
+    return true;
+}
+
+void Server::_confirm(std::uint64_t conn_id,
+                      const std::string &id,
+                      const std::string &conversation,
+                      std::uint64_t seq,
+                      MessageId stored)
+{
+    nlohmann::json reply;
+    reply["type"] = "sent";
+    reply["id"] = id;
+    reply["conversation"] = conversation;
+    reply["seq"] = seq;
+    reply["ok"] = stored != 0;
+    if (stored != 0)
+        reply["message_id"] = stored;
+    _reply(conn_id, reply.dump());
+}
+
+std::string Server::_refusal(const std::string &id,
+                             const std::string &reason)
+{
+    nlohmann::json reply;
+    reply["type"] = "sent";
+    if (!id.empty())
+        reply["id"] = id;
+    reply["ok"] = false;
+    reply["reason"] = reason;
+    return reply.dump();
+}
+
+bool Server::_find_sent(const std::string &conversation,
+                        const std::string &from,
+                        const std::string &id,
+                        std::uint64_t &seq,
+                        MessageId &stored)
+{
+    HistoryPage page;
+    MessageId cursor = 0;
+    std::size_t searched = 0;
+    do {
+        if (!history_->fetch(conversation, cursor, kHistoryPage, page))
+            return false;
+        for (const auto &r : page.records) {
+            auto chat = nlohmann::json::parse(r.payload, nullptr, false);
+            if (chat.is_discarded() || chat.value("from", "") != from ||
+                chat.value("id", "") != id)
+                continue;
+            seq = chat.value("seq", std::uint64_t{0});
+            stored = r.id;
+            return true;
+        }
+        searched += page.records.size();
+        cursor = page.next;
+    } while (cursor != 0 && searched < dedup_scan_);
     return false;
 }
 
+void Server::_reply(std::uint64_t conn_id, const std::string &message)
+{
+    std::vector<std::string> replies{message};
+    _flush(conn_id, replies);
+}
+
+void Server::_flush(std::uint64_t conn_id, std::vector<std::string> &replies)
+{
+    if (replies.empty())
+        return;
+    std::shared_ptr<Link> link;
+    {
+        std::lock_guard<std::mutex> lk(conns_mtx_);
+        auto it = conns_.find(conn_id);
+        if (it != conns_.end())
+            link = it->second.link;
+    }
+    if (link)
+        _send(*link, replies);
+    replies.clear();
+}
+
+bool Server::_reply_batch(std::uint64_t conn_id,
+                          const std::vector<std::string> &messages)
+{
+    std::shared_ptr<Link> link;
+    {
+        std::lock_guard<std::mutex> lk(conns_mtx_);
+        auto it = conns_.find(conn_id);
+        if (it == conns_.end() || it->second.unacked.room() < messages.size())
+            return false;
+        std::string conversation;
+        std::uint64_t seq;
+        for (const auto &m : messages) {
+            if (_stamp_of(m, conversation, seq))
+                it->second.unacked.push(conversation, seq, m);
+        }
+        link = it->second.link;
+    }
+    if (_send(*link, messages))
+        return true;
+
+    // the inbox keeps its copies: untrack them, or they would be resent
+    // from the window as well
+    std::lock_guard<std::mutex> lk(conns_mtx_);
+    auto it = conns_.find(conn_id);
+    if (it == conns_.end())
+        return false;
+    std::string conversation;
+    std::uint64_t seq;
+    for (const auto &m : messages) {
+        if (_stamp_of(m, conversation, seq))
+            it->second.unacked.drop(conversation, seq);
+    }
+    return false;
+}
+
+bool Server::_send(Link &link, const std::vector<std::string> &messages)
+{
+    std::lock_guard<std::mutex> lk(link.mtx);
+    if (link.sock == nullptr)
+        return false;
+    try {
+        link.sock->send_messages(messages);
+    } catch (const std::exception &e) {
+        // the receive thread notices the broken link
+        _warn(std::string("[Send] ") + e.what());
+        return false;
+    }
+    return true;
+}
+
+std::string Server::_stamp(const std::string &conversation,
+                           const std::string &event,
+                           std::uint64_t &seq)
+{
+    bool known;
+    {
+        std::lock_guard<std::mutex> lk(seq_mtx_);
+        auto it = next_seq_.find(conversation);
+        known = it != next_seq_.end();
+        if (known)
+            seq = ++it->second;
+    }
+    if (!known) {
+        // first chat since start: go on from the newest one stored. Only
+        // this strand adds the conversation, so no other stamp races us
+        seq = _stored_seq(conversation) + 1;
+        std::lock_guard<std::mutex> lk(seq_mtx_);
+        next_seq_[conversation] = seq;
+    }
+    auto stamped = nlohmann::json::parse(event);  // validated by the handler
+    stamped["conversation"] = conversation;
+    stamped["seq"] = seq;
+    return stamped.dump();
+}
+
+std::uint64_t Server::_stored_seq(const std::string &conversation)
+{
+    HistoryPage page;
+    if (!history_->fetch(conversation, 0, 1, page) || page.records.empty())
+        return 0;
+    const auto chat =
+        nlohmann::json::parse(page.records.front().payload, nullptr, false);
+    auto seq = chat.is_object() ? chat.find("seq") : chat.end();
+    return seq != chat.end() && seq->is_number_unsigned()
+               ? seq->get<std::uint64_t>()
+               : 0;
+}
+
+bool Server::_send_tracked(Conn &c,
+                           const std::string &conversation,
+                           std::uint64_t seq,
+                           const std::string &message)
+{
+    // once one chat waits in the inbox, later ones queue behind it
+    if (c.backlogged || !c.unacked.push(conversation, seq, message)) {
+        c.backlogged = true;
+        return false;
+    }
+    return true;  // should the send fail, _forget hands it to the inbox
+}
+
+void Server::_deliver(const std::string &to,
+                      const std::string &conversation,
+                      std::uint64_t seq,
+                      const std::string &message)
+{
+    std::shared_ptr<Link> link;
+    {
+        std::lock_guard<std::mutex> lk(conns_mtx_);
+        auto user = online_.find(to);
+        if (user != online_.end()) {
+            Conn &c = conns_.find(user->second)->second;
+            if (_send_tracked(c, conversation, seq, message))
+                link = c.link;
+        }
+    }
+    if (link) {
+        _send(*link, {message});
+        return;
+    }
+    try {
+        inboxes_.push(to, message);
+    } catch (const std::exception &e) {
+        _warn("[Inbox] chat for " + to + " lost: " + e.what());
+    }
+}
+
+void Server::_fan_out(const std::string &room,
+                      const std::string &from,
+                      std::uint64_t seq,
+                      const std::string &message)
+{
+    // online members only: offline ones catch up from the room history
+    const auto to = dispatcher_.get<EventType::Room>().recipients(room, from);
+    const std::string conversation = '#' + room;
+    std::vector<const std::string *> backlogged;
+    std::vector<std::shared_ptr<Link>> links;
+    {
+        std::lock_guard<std::mutex> lk(conns_mtx_);
+        for (const auto &user : to) {
+            auto online = online_.find(user);
+            if (online == online_.end())
+                continue;  // left since the lookup
+            Conn &c = conns_.find(online->second)->second;
+            if (_send_tracked(c, conversation, seq, message))
+                links.push_back(c.link);
+            else
+                backlogged.push_back(&user);
+        }
+    }
+    const std::vector<std::string> one{message};
+    for (const auto &link : links)
+        _send(*link, one);
+    for (const auto *user : backlogged) {
+        try {
+            inboxes_.push(*user, message);
+        } catch (const std::exception &e) {
+            _warn("[Inbox] chat for " + *user + " lost: " + e.what());
+        }
+    }
+}
+
+void Server::_answer_friend(const std::string &json,
+                            bool ok,
+                            std::vector<std::string> &replies)
+{
+    // "from" was checked against the connection's user before dispatch
+    auto event = nlohmann::json::parse(json, nullptr, false);
+    nlohmann::json reply;
+    reply["type"] = "add_friend";
+    reply["from"] = event["from"];
+    reply["to"] = event["to"];
+    reply["action"] = event["action"].is_string() ? event["action"] : "add";
+    reply["ok"] = ok;
+    replies.push_back(reply.dump());
+    if (!ok || !reply["to"].is_string())
+        return;
+
+    std::uint64_t peer = 0;
+    {
+        std::lock_guard<std::mutex> lk(conns_mtx_);
+        auto online = online_.find(reply["to"].get<std::string>());
+        if (online != online_.end())
+            peer = online->second;
+    }
+    if (peer != 0)
+        _reply(peer, replies.back());
+}
+
+void Server::_follow_room(const std::string &json)
+{
+    // the handler validated the event, and _callback() that "user" is the
+    // connection's own
+    const auto event = nlohmann::json::parse(json, nullptr, false);
+    const auto user = event.value("user", std::string());
+    const std::string conversation = '#' + event.value("room", std::string());
+    const bool join = event.value("action", std::string()) == "join";
+
+    std::uint64_t session = 0;
+    {
+        std::lock_guard<std::mutex> lk(conns_mtx_);
+        auto online = online_.find(user);
+        if (online == online_.end())
+            return;
+        session = conns_.find(online->second)->second.session;
+    }
+    if (session != 0)
+        _change_session(join ? "subscribe" : "unsubscribe", session,
+                        conversation);
+}
+
+void Server::_ack(std::uint64_t conn_id,
+                  const std::string &conversation,
+                  std::uint64_t seq)
+{
+    std::string user;
+    std::uint64_t session = 0;
+    bool drain = false;
+    {
+        std::lock_guard<std::mutex> lk(conns_mtx_);
+        auto it = conns_.find(conn_id);
+        if (it == conns_.end())
+            return;
+        Conn &c = it->second;
+        const std::size_t acked = c.unacked.ack(conversation, seq);
+        session = c.session;
+        drain = acked != 0 && c.backlogged;
+        user = c.user;
+    }
+    // progress is the client's own claim, kept per conversation; the
+    // first ack of one follows it ( and is journaled )
+    if (session != 0 && !sessions_.set_delivered(session, conversation, seq)) {
+        _change_session("subscribe", session, conversation);
+        sessions_.set_delivered(session, conversation, seq);
+    }
+    if (drain)
+        _drain(conn_id, user);  // room was made: resume the backlog
+}
+
+void Server::_replay_inbox(std::uint64_t conn_id, const std::string &user)
+{
+    {
+        std::lock_guard<std::mutex> lk(conns_mtx_);
+        auto it = conns_.find(conn_id);
+        if (it == conns_.end())
+            return;
+        it->second.user = user;
+        it->second.backlogged = true;  // new chats queue behind the backlog
+        online_[user] = conn_id;
+    }
+    dispatcher_.get<EventType::Room>().set_online(user, true);
+    _drain(conn_id, user);
+}
+
+void Server::_drain(std::uint64_t conn_id, const std::string &user)
+{
+    auto sink = [this, conn_id](const std::vector<std::string> &batch) {
+        return _reply_batch(conn_id, batch);
+    };
+    for (bool stragglers = false;;) {
+        std::size_t batch;
+        {
+            std::lock_guard<std::mutex> lk(conns_mtx_);
+            auto it = conns_.find(conn_id);
+            if (it == conns_.end())
+                return;
+            batch = std::min(kReplayBatch, it->second.unacked.room());
+        }
+        // 0 if the window is full or another drain runs: either one ends
+        // with the inbox empty or an ack calls us again
+        const std::size_t sent =
+            batch == 0 ? 0 : inboxes_.replay(user, batch, sink);
+
+        std::lock_guard<std::mutex> lk(conns_mtx_);
+        auto it = conns_.find(conn_id);
+        if (it == conns_.end())
+            return;
+        if (inboxes_.pending(user) > 0) {
+            it->second.backlogged = true;
+            if (sent == 0)
+                return;
+            continue;
+        }
+        if (stragglers)
+            return;
+        // empty: chats go straight out again; one more pass picks up any
+        // pushed while the flag was still set
+        it->second.backlogged = false;
+        stragglers = true;
+    }
+}
+
+void Server::_track(std::uint64_t conn_id, ServerSocket *sock)
+{
+    auto link = std::make_shared<Link>();
+    link->sock = sock;
+    std::lock_guard<std::mutex> lk(conns_mtx_);
+    conns_[conn_id] = Conn{std::move(link), 0, {}};
+}
+
+void Server::_forget(std::uint64_t conn_id)
+{
+    std::string user;
+    std::vector<AckWindow::Entry> gap;
+    std::shared_ptr<Link> link;
+    {
+        std::lock_guard<std::mutex> lk(conns_mtx_);
+        auto it = conns_.find(conn_id);
+        if (it == conns_.end())
+            return;
+        link = std::move(it->second.link);
+        if (it->second.session != 0)
+            sessions_.detach(it->second.session);
+        auto online = online_.find(it->second.user);
+        if (online != online_.end() && online->second == conn_id) {
+            online_.erase(online);  // from now on their chats go to the inbox
+            dispatcher_.get<EventType::Room>().set_online(it->second.user,
+                                                          false);
+        }
+        user = std::move(it->second.user);
+        gap = it->second.unacked.take_unacked();
+        conns_.erase(it);
+    }
+    {
+        std::lock_guard<std::mutex> lk(link->mtx);  // a send in progress ends
+        link->sock = nullptr;
+    }
+    // resent on the next login or resume; the client drops what it had
+    // already received by ( conversation, seq )
+    for (const auto &e : gap) {
+        try {
+            inboxes_.push(user, e.message);
+        } catch (const std::exception &e) {
+            _warn("[Inbox] unacked chat for " + user + " lost: " + e.what());
+        }
+    }
+}
+
 #endif  // _WIN32
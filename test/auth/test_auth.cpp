@@ -0,0 +1,342 @@
+// test auth
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+// -- headers for thread -- //
+#include <chrono>
+#include <thread>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// -- credentials -- //
+#include "account_table.hpp"
+#include "credential_cache.hpp"
+#include "crypto.hpp"
+#include "session_store.hpp"
+#include "session_token.hpp"
+
+using namespace std::chrono_literals;
+namespace fs = std::filesystem;
+
+namespace
+{
+
+/// Fresh table directory per test case.
+struct TempDir {
+    fs::path path;
+    TempDir()
+        : path(fs::temp_directory_path() /
+               ("auth_test_" + std::to_string(std::rand())))
+    {
+        fs::remove_all(path);
+    }
+    ~TempDir() { fs::remove_all(path); }
+};
+
+std::string hex(const std::uint8_t *p, std::size_t n)
+{
+    std::string out;
+    char buf[3];
+    for (std::size_t i = 0; i < n; ++i) {
+        std::snprintf(buf, sizeof(buf), "%02x", p[i]);
+        out += buf;
+    }
+    return out;
+}
+
+std::string hex(const Digest &d)
+{
+    return hex(d.data(), d.size());
+}
+
+}  // namespace
+
+TEST_CASE("SHA-256 known answers")
+{
+    REQUIRE(hex(sha256("")) ==
+            "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    REQUIRE(hex(sha256("abc")) ==
+            "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    const std::string two_blocks =
+        "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    REQUIRE(hex(sha256(two_blocks)) ==
+            "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+
+    // incremental update must match one-shot
+    Sha256 h;
+    const std::string msg(1000, 'x');
+    for (std::size_t i = 0; i < msg.size(); i += 7)
+        h.update(msg.data() + i, std::min<std::size_t>(7, msg.size() - i));
+    REQUIRE(h.finish() == sha256(msg));
+}
+
+TEST_CASE("HMAC-SHA256 known answers ( RFC 4231 )")
+{
+    const std::string key(20, '\x0b');
+    REQUIRE(hex(HmacSha256(key).mac("Hi There")) ==
+            "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7");
+    REQUIRE(hex(HmacSha256("Jefe").mac("what do ya want for nothing?")) ==
+            "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843");
+}
+
+TEST_CASE("PBKDF2-HMAC-SHA256 known answers")
+{
+    std::uint8_t out[32];
+    pbkdf2_sha256("password", "salt", 1, out, sizeof(out));
+    REQUIRE(hex(out, sizeof(out)) ==
+            "120fb6cffcf8b32c43e7225256c4f837a86548c92ccc35480805987cb70be17b");
+    pbkdf2_sha256("password", "salt", 4096, out, sizeof(out));
+    REQUIRE(hex(out, sizeof(out)) ==
+            "c5e478d59288c841aa530db6845c4c8d962893a001ce4e11a4963873aa98134a");
+}
+
+TEST_CASE("Password hash round trip")
+{
+    const PasswordHash stored = hash_password("hunter2", 1000);
+    REQUIRE(stored.salt.size() == 16);
+    REQUIRE(verify_password("hunter2", stored));
+    REQUIRE_FALSE(verify_password("hunter3", stored));
+
+    // same password, different salt
+    REQUIRE(hash_password("hunter2", 1000).digest != stored.digest);
+}
+
+TEST_CASE("CredentialCache")
+{
+    CredentialCache cache(50ms, 2);
+
+    REQUIRE_FALSE(cache.check("alice", "pw"));
+    cache.put("alice", "pw");
+    REQUIRE(cache.check("alice", "pw"));
+    REQUIRE_FALSE(cache.check("alice", "wrong"));
+    REQUIRE_FALSE(cache.check("bob", "pw"));
+
+    SUBCASE("entries expire")
+    {
+        std::this_thread::sleep_for(80ms);
+        REQUIRE_FALSE(cache.check("alice", "pw"));
+    }
+
+    SUBCASE("invalidate")
+    {
+        cache.invalidate("alice");
+        REQUIRE_FALSE(cache.check("alice", "pw"));
+    }
+
+    SUBCASE("capacity is enforced")
+    {
+        cache.put("bob", "pw");
+        cache.put("carol", "pw");  // full of live entries: dropped
+        REQUIRE(cache.size() == 2);
+        REQUIRE_FALSE(cache.check("carol", "pw"));
+
+        std::this_thread::sleep_for(80ms);
+        cache.put("carol", "pw");  // expired entries are swept
+        REQUIRE(cache.check("carol", "pw"));
+        REQUIRE(cache.size() == 1);
+    }
+}
+
+TEST_CASE("Session tokens")
+{
+    using namespace std::chrono;
+    const auto now = SessionTokenIssuer::clock::now();
+    SessionTokenIssuer issuer("server key", hours(1));
+
+    const std::string token = issuer.issue("alicia", 42, now);
+    REQUIRE(token.size() % 4 != 0);  // exercises the trailing bits
+    SessionClaims claims;
+    REQUIRE(issuer.verify(token, claims, now));
+    REQUIRE(claims.user == "alicia");
+    REQUIRE(claims.session_id == 42);
+
+    SUBCASE("url-safe, no padding")
+    {
+        REQUIRE(token.find_first_of("+/=") == std::string::npos);
+    }
+
+    SUBCASE("expired")
+    {
+        REQUIRE_FALSE(issuer.verify(token, claims, now + hours(2)));
+    }
+
+    SUBCASE("other key")
+    {
+        SessionTokenIssuer other("another key", hours(1));
+        REQUIRE_FALSE(other.verify(token, claims, now));
+    }
+
+    SUBCASE("tampered or malformed")
+    {
+        for (std::size_t i = 0; i < token.size(); ++i) {
+            std::string bad = token;
+            bad[i] = bad[i] == 'A' ? 'B' : 'A';
+            REQUIRE_FALSE(issuer.verify(bad, claims, now));
+        }
+        REQUIRE_FALSE(issuer.verify("", claims, now));
+        REQUIRE_FALSE(issuer.verify("not a token!", claims, now));
+        REQUIRE_FALSE(issuer.verify(token.substr(0, 20), claims, now));
+    }
+}
+
+TEST_CASE("SessionStore")
+{
+    SessionStore store(50ms, 2);
+
+    const auto id = store.open("alice");
+    REQUIRE(id != 0);
+    store.subscribe(id, "alice\nbob");
+    store.subscribe(id, "alice\nbob");
+    REQUIRE(store.subscribe(id, "#lobby"));
+    REQUIRE(store.unsubscribe(id, "#lobby"));
+    REQUIRE_FALSE(store.unsubscribe(id, "#lobby"));
+    REQUIRE(store.subscribe(id, "#lobby"));
+    REQUIRE(store.set_delivered(id, "alice\nbob", 7));
+    REQUIRE(store.set_delivered(id, "alice\nbob", 5));  // stale: kept at 7
+    REQUIRE(store.set_delivered(id, "#lobby", 2));  // counted on its own
+    REQUIRE_FALSE(store.set_delivered(id, "#other", 9));  // not followed
+    const std::map<std::string, std::uint64_t> acked{{"#lobby", 2},
+                                                     {"alice\nbob", 7}};
+
+    SessionState state;
+    REQUIRE_FALSE(store.attach(id, "mallory", state));
+    REQUIRE_FALSE(store.attach(id + 1000, "alice", state));
+
+    SUBCASE("resume within the grace period")
+    {
+        store.detach(id);
+        REQUIRE(store.attach(id, "alice", state));
+        REQUIRE(state.user == "alice");
+        REQUIRE(state.subscriptions == acked);
+    }
+
+    SUBCASE("saved and loaded, sessions come back detached")
+    {
+        std::string image;
+        store.save(image);
+        SessionStore back(50ms, 2);
+        std::string_view in = image;
+        REQUIRE(back.load(in));
+        REQUIRE(in.empty());
+        REQUIRE(back.attach(id, "alice", state));
+        REQUIRE(state.subscriptions == acked);
+        REQUIRE(back.open("bob") != id);
+
+        // replayed from a journal: created once, detached
+        back.adopt(id + 1, "carol");
+        back.adopt(id + 1, "mallory");
+        REQUIRE(back.attach(id + 1, "carol", state));
+        std::string_view cut(image.data(), image.size() - 1);
+        REQUIRE_FALSE(back.load(cut));
+        REQUIRE(back.size() == 3);
+    }
+
+    SUBCASE("detached sessions expire")
+    {
+        store.detach(id);
+        std::this_thread::sleep_for(80ms);
+        REQUIRE_FALSE(store.attach(id, "alice", state));
+        REQUIRE(store.size() == 0);
+    }
+
+    SUBCASE("close")
+    {
+        store.close(id);
+        REQUIRE_FALSE(store.attach(id, "alice", state));
+    }
+
+    SUBCASE("capacity is enforced")
+    {
+        REQUIRE(store.open("bob") != 0);
+        REQUIRE(store.open("carol") == 0);  // full of live sessions
+
+        store.detach(id);
+        std::this_thread::sleep_for(80ms);
+        REQUIRE(store.open("carol") != 0);  // expired session swept
+    }
+}
+
+TEST_CASE("AccountTable stores and replaces values in place")
+{
+    TempDir dir;
+    std::string_view value;
+    {
+        AccountTable table(dir.path.string(), 8);
+        REQUIRE_FALSE(table.find("alice", value));
+        table.put("alice", "hash-1");
+        table.put("bob", std::string(100, 'b'));
+        REQUIRE(table.find("alice", value));
+        REQUIRE(value == "hash-1");
+        table.put("alice", "hash-2");  // a password change
+        REQUIRE(table.find("alice", value));
+        REQUIRE(value == "hash-2");
+        REQUIRE(table.size() == 2);
+        table.sync();
+    }
+    // reopened: mapped, nothing rebuilt
+    AccountTable table(dir.path.string());
+    REQUIRE(table.size() == 2);
+    REQUIRE(table.find("alice", value));
+    REQUIRE(value == "hash-2");
+    REQUIRE(table.find("bob", value));
+    REQUIRE(value == std::string(100, 'b'));
+    REQUIRE_FALSE(table.find("carol", value));
+}
+
+TEST_CASE("AccountTable grows and keeps every entry")
+{
+    TempDir dir;
+    {
+        AccountTable table(dir.path.string(), 8);
+        for (int i = 0; i < 5000; ++i)
+            table.put("user" + std::to_string(i), std::to_string(i * 7));
+        REQUIRE(table.size() == 5000);
+        REQUIRE(table.capacity() >= 5000 * 4 / 3);
+    }
+    std::size_t files = 0;
+    for (const auto &entry : fs::directory_iterator(dir.path))
+        files += entry.path().extension() == ".tbl";
+    REQUIRE(files == 1);  // older generations are removed
+
+    AccountTable table(dir.path.string());
+    std::string_view value;
+    for (int i = 0; i < 5000; ++i) {
+        REQUIRE(table.find("user" + std::to_string(i), value));
+        REQUIRE(value == std::to_string(i * 7));
+    }
+}
+
+TEST_CASE("AccountTable readers run alongside the writer")
+{
+    TempDir dir;
+    AccountTable table(dir.path.string(), 8);
+    table.put("root", "0");
+    std::atomic<bool> done{false};
+    std::atomic<int> errors{0};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 4; ++r) {
+        readers.emplace_back([&] {
+            std::string_view value;
+            while (!done.load()) {
+                if (!table.find("root", value) || value != "0")
+                    ++errors;
+            }
+        });
+    }
+    for (int i = 0; i < 20000; ++i)  // several growths
+        table.put("user" + std::to_string(i), "x");
+    done.store(true);
+    for (auto &t : readers)
+        t.join();
+    REQUIRE(errors.load() == 0);
+    REQUIRE(table.size() == 20001);
+}
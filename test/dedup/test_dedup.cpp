@@ -0,0 +1,83 @@
+// test dedup
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+
+// -- dedup filter -- //
+#include "dedup_filter.hpp"
+
+using namespace std::chrono_literals;
+
+namespace
+{
+
+const DedupFilter::clock_type::time_point t0{std::chrono::hours(1000)};
+
+std::string key(int i)
+{
+    return "alice\n" + std::to_string(i);
+}
+
+}  // namespace
+
+TEST_CASE("DedupFilter reports repeats")
+{
+    DedupFilter f(64 * 1024, 60s, 4);
+    REQUIRE(f.memory() <= 64 * 1024);
+    REQUIRE(f.memory() >= 60 * 1024);
+
+    REQUIRE_FALSE(f.seen("alice\nm1", t0));
+    REQUIRE(f.seen("alice\nm1", t0 + 1s));
+    REQUIRE_FALSE(f.seen("bob\nm1", t0 + 1s));  // scoped by sender
+    REQUIRE(f.seen("bob\nm1", t0 + 2s));
+}
+
+TEST_CASE("DedupFilter tests and inserts apart")
+{
+    DedupFilter f(64 * 1024, 60s, 4);
+    REQUIRE_FALSE(f.contains("alice\nm1", t0));
+    REQUIRE_FALSE(f.contains("alice\nm1", t0));  // a test remembers nothing
+    f.insert("alice\nm1", t0 + 1s);
+    REQUIRE(f.contains("alice\nm1", t0 + 2s));
+    REQUIRE(f.seen("alice\nm1", t0 + 2s));
+    REQUIRE_FALSE(f.contains("alice\nm1", t0 + 2min));
+}
+
+TEST_CASE("DedupFilter false positives stay rare at capacity")
+{
+    DedupFilter f(256 * 1024, 60s, 4);
+    const int n = static_cast<int>(f.capacity());
+    int false_hits = 0;
+    for (int i = 0; i < n; ++i)
+        false_hits += f.seen(key(i), t0) ? 1 : 0;
+    REQUIRE(false_hits <= n / 1000);
+    for (int i = 0; i < n; ++i)
+        REQUIRE(f.seen(key(i), t0));  // no false negatives
+}
+
+TEST_CASE("DedupFilter forgets after the window")
+{
+    DedupFilter f(64 * 1024, 30s, 4);  // spans of 10 s
+    REQUIRE_FALSE(f.seen("k", t0));
+    REQUIRE(f.seen("k", t0 + 29s));  // always kept for the window
+    REQUIRE_FALSE(f.seen("late", t0 + 35s));
+
+    // 40 s later at most, both are gone
+    REQUIRE_FALSE(f.seen("k", t0 + 41s));
+    REQUIRE(f.seen("late", t0 + 50s));
+    REQUIRE_FALSE(f.seen("late", t0 + 100s));
+}
+
+TEST_CASE("DedupFilter checks its arguments")
+{
+    REQUIRE_THROWS_AS(DedupFilter(1024, 60s, 1), std::invalid_argument);
+    REQUIRE_THROWS_AS(DedupFilter(1024, 0s, 4), std::invalid_argument);
+    DedupFilter tiny(0, 1s, 2);  // still one block per slice
+    REQUIRE(tiny.memory() == 2 * 64);
+    REQUIRE_FALSE(tiny.seen("x", t0));
+    REQUIRE(tiny.seen("x", t0));
+}
@@ -0,0 +1,88 @@
+// test dispatch
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <string>
+
+// -- compile-time event registry -- //
+#include "event_registry.hpp"
+
+namespace
+{
+
+enum class TestEvent {
+    Ping,
+    Echo,
+    Fail
+};
+
+struct PingHandler {
+    int calls = 0;
+    bool handle(const std::string &) { return ++calls > 0; }
+};
+
+struct EchoHandler {
+    std::string last;
+    bool handle(const std::string &json)
+    {
+        last = json;
+        return true;
+    }
+};
+
+struct FailHandler {
+    bool handle(const std::string &) { return false; }
+};
+
+using TestRegistry = EventRegistry<TestEvent,
+                                   EventEntry<TestEvent::Ping, PingHandler>,
+                                   EventEntry<TestEvent::Echo, EchoHandler>,
+                                   EventEntry<TestEvent::Fail, FailHandler>>;
+
+}  // namespace
+
+TEST_CASE("EventRegistry static dispatch")
+{
+    TestRegistry registry;
+    REQUIRE(TestRegistry::size == 3);
+
+    SUBCASE("routes to the handler bound to the key")
+    {
+        REQUIRE(registry.dispatch(TestEvent::Ping, "{}"));
+        REQUIRE(registry.dispatch(TestEvent::Ping, "{}"));
+        REQUIRE(registry.dispatch(TestEvent::Echo, "hello"));
+        REQUIRE(registry.get<TestEvent::Ping>().calls == 2);
+        REQUIRE(registry.get<TestEvent::Echo>().last == "hello");
+    }
+
+    SUBCASE("handler result is forwarded")
+    {
+        REQUIRE_FALSE(registry.dispatch(TestEvent::Fail, "{}"));
+    }
+
+    SUBCASE("out of range value is rejected")
+    {
+        REQUIRE_FALSE(registry.dispatch(static_cast<TestEvent>(42), "{}"));
+        REQUIRE(registry.get<TestEvent::Ping>().calls == 0);
+    }
+}
+
+TEST_CASE("EventRegistry plugin slow path")
+{
+    TestRegistry registry;
+    std::string seen;
+
+    REQUIRE_FALSE(registry.dispatch(std::string("typing"), "{}"));
+
+    registry.register_plugin("typing", [&seen](const std::string &json) {
+        seen = json;
+        return true;
+    });
+    REQUIRE(registry.dispatch(std::string("typing"), "payload"));
+    REQUIRE(seen == "payload");
+
+    REQUIRE(registry.unregister_plugin("typing"));
+    REQUIRE_FALSE(registry.unregister_plugin("typing"));
+    REQUIRE_FALSE(registry.dispatch(std::string("typing"), "{}"));
+}
@@ -0,0 +1,184 @@
+// test executor
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+// -- headers for thread -- //
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// -- thread pool and strands -- //
+#include "strand.hpp"
+#include "thread_pool.hpp"
+
+using namespace std::chrono_literals;
+
+namespace
+{
+
+// wait until @p done reaches @p n ( or give up after a while )
+bool wait_for_count(std::atomic<int> &done, int n)
+{
+    for (int i = 0; i < 2000 && done.load() < n; ++i)
+        std::this_thread::sleep_for(1ms);
+    return done.load() >= n;
+}
+
+}  // namespace
+
+TEST_CASE("ThreadPool runs submitted tasks")
+{
+    ThreadPool pool(4);
+    REQUIRE(pool.size() == 4);
+
+    std::atomic<int> done{0};
+    for (int i = 0; i < 100; ++i)
+        pool.submit([&done] { done.fetch_add(1); });
+    pool.submit([] { throw std::runtime_error("ignored"); });
+    for (int i = 0; i < 100; ++i)
+        pool.submit([&done] { done.fetch_add(1); });
+
+    REQUIRE(wait_for_count(done, 200));
+}
+
+TEST_CASE("ThreadPool admission limit")
+{
+    ThreadPool pool(1, 2);
+
+    // park the only worker so that later tasks stay queued
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool release = false;
+    std::atomic<int> done{0};
+    REQUIRE(pool.try_submit([&] {
+        std::unique_lock<std::mutex> lk(mtx);
+        cv.wait(lk, [&] { return release; });
+        done.fetch_add(1);
+    }));
+    for (int i = 0; i < 200 && pool.pending() != 0; ++i)
+        std::this_thread::sleep_for(1ms);
+
+    REQUIRE(pool.try_submit([&] { done.fetch_add(1); }));
+    REQUIRE(pool.try_submit([&] { done.fetch_add(1); }));
+    REQUIRE_FALSE(pool.try_submit([&] { done.fetch_add(1); }));
+    REQUIRE(pool.pending() == 2);
+
+    {
+        std::lock_guard<std::mutex> lk(mtx);
+        release = true;
+    }
+    cv.notify_all();
+    REQUIRE(wait_for_count(done, 3));
+    REQUIRE(pool.pending() == 0);
+}
+
+TEST_CASE("StrandExecutor keeps per-key order")
+{
+    ThreadPool pool(4);
+    StrandExecutor<std::string> strands(pool, 8, 4);
+
+    std::mutex mtx;
+    std::map<std::string, std::vector<int>> seen;
+    std::atomic<int> done{0};
+
+    const std::vector<std::string> keys = {"a:b", "a:c", "b:c", "room-1"};
+    for (int i = 0; i < 200; ++i) {
+        for (const auto &key : keys) {
+            strands.post(key, [&, key, i] {
+                {
+                    std::lock_guard<std::mutex> lk(mtx);
+                    seen[key].push_back(i);
+                }
+                done.fetch_add(1);
+            });
+        }
+    }
+
+    REQUIRE(wait_for_count(done, 800));
+    for (const auto &key : keys) {
+        REQUIRE(seen[key].size() == 200);
+        for (int i = 0; i < 200; ++i)
+            REQUIRE(seen[key][i] == i);
+    }
+    pool.shutdown();
+    REQUIRE(strands.active_strands() == 0);
+}
+
+TEST_CASE("StrandExecutor never overlaps one key")
+{
+    ThreadPool pool(4);
+    StrandExecutor<int> strands(pool, 2, 1);
+
+    std::atomic<int> inside{0};
+    std::atomic<bool> overlapped{false};
+    std::atomic<int> done{0};
+
+    for (int i = 0; i < 50; ++i) {
+        strands.post(1, [&] {
+            if (inside.fetch_add(1) != 0)
+                overlapped.store(true);
+            std::this_thread::sleep_for(100us);
+            inside.fetch_sub(1);
+            done.fetch_add(1);
+        });
+    }
+
+    REQUIRE(wait_for_count(done, 50));
+    REQUIRE_FALSE(overlapped.load());
+}
+
+TEST_CASE("StrandExecutor runs different keys in parallel")
+{
+    ThreadPool pool(2);
+    StrandExecutor<int> strands(pool);
+
+    // key 1 blocks until key 2 has run: only possible if they overlap
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool second_ran = false;
+    std::atomic<int> done{0};
+
+    strands.post(1, [&] {
+        std::unique_lock<std::mutex> lk(mtx);
+        cv.wait_for(lk, 2s, [&] { return second_ran; });
+        done.fetch_add(second_ran ? 1 : 0);
+    });
+    strands.post(2, [&] {
+        {
+            std::lock_guard<std::mutex> lk(mtx);
+            second_ran = true;
+        }
+        cv.notify_all();
+        done.fetch_add(1);
+    });
+
+    REQUIRE(wait_for_count(done, 2));
+}
+
+TEST_CASE("StrandExecutor waits until every strand is idle")
+{
+    ThreadPool pool(2);
+    StrandExecutor<int> strands(pool, 4, 2);
+
+    // tasks that post more work are waited for too
+    std::atomic<int> done{0};
+    for (int key = 0; key < 8; ++key) {
+        strands.post(key, [&, key] {
+            std::this_thread::sleep_for(1ms);
+            strands.post(key + 100, [&] { done.fetch_add(1); });
+            done.fetch_add(1);
+        });
+    }
+    strands.wait_idle();
+    REQUIRE(done.load() == 16);
+    REQUIRE(strands.active_strands() == 0);
+    strands.wait_idle();  // returns at once when idle
+}
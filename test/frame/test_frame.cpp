@@ -0,0 +1,60 @@
+// test frame
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// -- fixed-size frame decoder -- //
+#include "frame_buffer.hpp"
+
+TEST_CASE("FrameBuffer drains every complete frame")
+{
+    FrameBuffer fb(8, 4);
+    std::string wire;
+    FrameBuffer::encode(wire, "hi", 8);
+    FrameBuffer::encode(wire, "12345678", 8);  // exactly one frame, no NUL
+    FrameBuffer::encode(wire, "", 8);
+    REQUIRE(wire.size() == 24);
+
+    fb.append(wire.data(), wire.size());
+    std::vector<std::string> out;
+    REQUIRE(fb.drain(out) == 3);
+    REQUIRE(out == std::vector<std::string>{"hi", "12345678", ""});
+    REQUIRE(fb.pending() == 0);
+    REQUIRE(fb.drain(out) == 0);
+}
+
+TEST_CASE("FrameBuffer keeps a partial frame for the next recv")
+{
+    FrameBuffer fb(8, 4);
+    std::string wire;
+    FrameBuffer::encode(wire, "first", 8);
+    FrameBuffer::encode(wire, "second", 8);
+
+    // 11 bytes: one frame plus the start of the next
+    std::memcpy(fb.write_ptr(), wire.data(), 11);
+    fb.commit(11);
+
+    std::vector<std::string> out;
+    REQUIRE(fb.drain(out) == 1);
+    REQUIRE(fb.pending() == 3);
+
+    fb.append(wire.data() + 11, wire.size() - 11);
+    REQUIRE(fb.drain(out) == 1);
+    REQUIRE(out == std::vector<std::string>{"first", "second"});
+}
+
+TEST_CASE("FrameBuffer rejects bad sizes")
+{
+    FrameBuffer fb(4, 1);
+    REQUIRE_THROWS_AS(fb.commit(5), std::out_of_range);
+    REQUIRE_THROWS_AS(fb.append("123456", 6), std::out_of_range);
+
+    std::string wire;
+    REQUIRE_THROWS(FrameBuffer::encode(wire, "too long", 4));
+    REQUIRE_THROWS_AS(FrameBuffer(0), std::invalid_argument);
+}
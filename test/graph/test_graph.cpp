@@ -0,0 +1,260 @@
+// test graph
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// -- friend graph -- //
+#include "friend_graph.hpp"
+#include "suggestion_index.hpp"
+#include "user_ids.hpp"
+
+TEST_CASE("UserIds interns names densely")
+{
+    UserIds ids;
+    REQUIRE(ids.intern("alice") == 0);
+    REQUIRE(ids.intern("bob") == 1);
+    REQUIRE(ids.intern("alice") == 0);
+    REQUIRE(ids.size() == 2);
+    REQUIRE(ids.name(1) == "bob");
+
+    UserId id = 99;
+    REQUIRE(ids.find("bob", id));
+    REQUIRE(id == 1);
+    REQUIRE_FALSE(ids.find("carol", id));
+}
+
+TEST_CASE("FriendGraph basic operations")
+{
+    FriendGraph g;
+    std::vector<UserId> scratch;
+
+    REQUIRE(g.add(0, 3));
+    REQUIRE_FALSE(g.add(3, 0));  // undirected
+    REQUIRE_FALSE(g.add(2, 2));  // no self loops
+    REQUIRE(g.add(0, 1));
+    REQUIRE(g.are_friends(3, 0));
+    REQUIRE_FALSE(g.are_friends(1, 3));
+    REQUIRE_FALSE(g.are_friends(100, 3));  // unknown id
+    REQUIRE(g.edges() == 2);
+
+    SUBCASE("before merge")
+    {
+        auto row = g.friends(0, scratch);
+        REQUIRE(std::vector<UserId>(row.begin(), row.end()) ==
+                std::vector<UserId>{1, 3});
+    }
+
+    SUBCASE("after merge: rows come straight from the CSR")
+    {
+        g.merge();
+        REQUIRE(g.pending() == 0);
+        auto row = g.friends(0, scratch);
+        REQUIRE(row.data != scratch.data());
+        REQUIRE(std::vector<UserId>(row.begin(), row.end()) ==
+                std::vector<UserId>{1, 3});
+        REQUIRE(g.degree(3) == 1);
+        REQUIRE(g.friends(2, scratch).empty());
+    }
+
+    SUBCASE("remove and re-add around a merge")
+    {
+        g.merge();
+        REQUIRE(g.remove(3, 0));
+        REQUIRE_FALSE(g.remove(3, 0));
+        REQUIRE_FALSE(g.are_friends(0, 3));
+        REQUIRE(g.degree(0) == 1);
+        REQUIRE(g.add(0, 3));  // cancels the pending removal
+        REQUIRE(g.pending() == 0);
+        REQUIRE(g.are_friends(0, 3));
+    }
+}
+
+TEST_CASE("FriendGraph matches a reference set under random churn")
+{
+    constexpr UserId kUsers = 200;
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<UserId> pick(0, kUsers - 1);
+
+    for (std::size_t threshold : {std::size_t{0}, std::size_t{16}}) {
+        FriendGraph g(threshold);
+        std::set<std::pair<UserId, UserId>> ref;
+        std::vector<UserId> scratch;
+
+        for (int step = 0; step < 20000; ++step) {
+            UserId a = pick(rng), b = pick(rng);
+            const auto key = std::minmax(a, b);
+            if (rng() % 3 == 0)
+                REQUIRE(g.remove(a, b) == (ref.erase(key) == 1));
+            else
+                REQUIRE(g.add(a, b) == (a != b && ref.insert(key).second));
+        }
+        REQUIRE(g.edges() == ref.size());
+
+        for (UserId u = 0; u < kUsers; ++u) {
+            std::vector<UserId> expect;
+            for (const auto &e : ref) {
+                if (e.first == u)
+                    expect.push_back(e.second);
+                else if (e.second == u)
+                    expect.push_back(e.first);
+            }
+            std::sort(expect.begin(), expect.end());
+            auto row = g.friends(u, scratch);
+            REQUIRE(std::vector<UserId>(row.begin(), row.end()) == expect);
+            REQUIRE(g.degree(u) == expect.size());
+            for (UserId v = 0; v < kUsers; ++v)
+                REQUIRE(g.are_friends(u, v) ==
+                        std::binary_search(expect.begin(), expect.end(), v));
+        }
+    }
+}
+
+TEST_CASE("FriendGraph and UserIds round-trip through an image")
+{
+    UserIds ids;
+    FriendGraph g(1 << 20);  // keep everything in the delta
+    std::mt19937 rng(11);
+    for (int i = 0; i < 3000; ++i) {
+        const UserId a = ids.intern("u" + std::to_string(rng() % 300));
+        const UserId b = ids.intern("u" + std::to_string(rng() % 300));
+        if (rng() % 4 == 0)
+            g.remove(a, b);
+        else
+            g.add(a, b);
+    }
+    REQUIRE(g.pending() > 0);
+
+    std::string image;
+    ids.save(image);
+    g.save(image);
+
+    UserIds ids2;
+    FriendGraph g2;
+    std::string_view in = image;
+    REQUIRE(ids2.load(in));
+    REQUIRE(g2.load(in));
+    REQUIRE(in.empty());
+    REQUIRE(ids2.size() == ids.size());
+    REQUIRE(g2.edges() == g.edges());
+    REQUIRE(g2.pending() == 0);
+    std::vector<UserId> s1, s2;
+    for (UserId u = 0; u < ids.size(); ++u) {
+        UserId id;
+        REQUIRE(ids2.find(ids.name(u), id));
+        REQUIRE(id == u);
+        auto r1 = g.friends(u, s1);
+        auto r2 = g2.friends(u, s2);
+        REQUIRE(std::vector<UserId>(r1.begin(), r1.end()) ==
+                std::vector<UserId>(r2.begin(), r2.end()));
+    }
+
+    // a cut image is rejected and changes nothing
+    std::string_view cut(image.data(), image.size() - 1);
+    REQUIRE(ids2.load(cut));
+    REQUIRE_FALSE(g2.load(cut));
+    REQUIRE(g2.edges() == g.edges());
+}
+
+TEST_CASE("FriendGraph mutual friends")
+{
+    FriendGraph g;
+    g.add(0, 1);
+    g.add(0, 2);
+    g.add(3, 1);
+    g.add(3, 2);
+    g.add(3, 4);
+    REQUIRE(g.mutual_friends(0, 3) == 2);
+    g.merge();
+    g.remove(2, 3);
+    REQUIRE(g.mutual_friends(0, 3) == 1);
+    REQUIRE(g.mutual_friends(0, 9) == 0);
+}
+
+TEST_CASE("SuggestionIndex ranks friends of friends")
+{
+    // 0 - {1, 2} - 3, 0 - 1 - 4
+    FriendGraph g;
+    SuggestionIndex idx(2);
+    auto link = [&](UserId a, UserId b) {
+        g.add(a, b);
+        idx.on_added(g, a, b);
+    };
+    link(0, 1);
+    link(0, 2);
+    link(1, 3);
+    link(2, 3);
+    link(1, 4);
+
+    std::vector<Suggestion> out;
+    idx.suggest(g, 0, out);
+    REQUIRE(out.size() == 2);
+    REQUIRE(out[0].user == 3);
+    REQUIRE(out[0].mutual == 2);
+    REQUIRE(out[1].user == 4);
+    REQUIRE(out[1].mutual == 1);
+
+    link(0, 3);  // friends are never suggested
+    idx.suggest(g, 0, out);
+    REQUIRE(out.size() == 1);
+    REQUIRE(out[0].user == 4);
+}
+
+TEST_CASE("SuggestionIndex matches brute force under random churn")
+{
+    constexpr UserId kUsers = 60;
+    constexpr std::size_t kTop = 4;
+    std::mt19937 rng(11);
+    std::uniform_int_distribution<UserId> pick(0, kUsers - 1);
+
+    FriendGraph g(32);
+    SuggestionIndex idx(kTop);
+    std::vector<Suggestion> out;
+
+    for (int round = 0; round < 40; ++round) {
+        for (int step = 0; step < 100; ++step) {
+            UserId a = pick(rng), b = pick(rng);
+            if (rng() % 3 == 0) {
+                if (g.remove(a, b))
+                    idx.on_removed(g, a, b);
+            } else if (g.add(a, b)) {
+                idx.on_added(g, a, b);
+            }
+        }
+
+        for (UserId u = 0; u < kUsers; ++u) {
+            std::vector<std::uint32_t> expect;
+            for (UserId w = 0; w < kUsers; ++w) {
+                if (w == u || g.are_friends(u, w))
+                    continue;
+                const auto m =
+                    static_cast<std::uint32_t>(g.mutual_friends(u, w));
+                if (m > 0)
+                    expect.push_back(m);
+            }
+            std::sort(expect.rbegin(), expect.rend());
+            if (expect.size() > kTop)
+                expect.resize(kTop);
+
+            idx.suggest(g, u, out);
+            std::vector<std::uint32_t> got;
+            for (const auto &s : out) {
+                REQUIRE_FALSE(g.are_friends(u, s.user));
+                REQUIRE(s.user != u);
+                REQUIRE(s.mutual == g.mutual_friends(u, s.user));
+                got.push_back(s.mutual);
+            }
+            REQUIRE(got == expect);
+        }
+    }
+    // the bound keeps most changes incremental, but the dirty path ran
+    REQUIRE(idx.recomputes() > 0);
+    REQUIRE(idx.recomputes() < 40u * kUsers);
+}
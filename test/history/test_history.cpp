@@ -0,0 +1,1017 @@
+// test history
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// -- history store -- //
+#include "crc32c.hpp"
+#include "history_compactor.hpp"
+#include "history_store.hpp"
+#include "history_writer.hpp"
+#include "lz_block.hpp"
+#include "memory_history.hpp"
+#include "recent_cache.hpp"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+/// Fresh store directory per test case.
+struct TempDir {
+    fs::path path;
+    TempDir()
+        : path(fs::temp_directory_path() /
+               ("history_test_" + std::to_string(std::rand())))
+    {
+        fs::remove_all(path);
+    }
+    ~TempDir() { fs::remove_all(path); }
+};
+
+/// Small segments and a short stride, so tests cross both often.
+HistoryOptions small()
+{
+    HistoryOptions o;
+    o.shards = 4;
+    o.segment_bytes = 4096;
+    o.index_every = 8;
+    return o;
+}
+
+std::string conv(int i)
+{
+    return "user" + std::to_string(i % 7) + "\nuser9";
+}
+
+std::string body(int i)
+{
+    return "message " + std::to_string(i) + std::string(i % 50, 'x');
+}
+
+/// Flip a bit of the first copy of @p text in @p file.
+void damage(const fs::path &file, const std::string &text)
+{
+    std::string bytes(static_cast<std::size_t>(fs::file_size(file)), '\0');
+    std::fstream f(file, std::ios::binary | std::ios::in | std::ios::out);
+    f.read(&bytes[0], static_cast<std::streamsize>(bytes.size()));
+    const auto at = bytes.find(text);
+    REQUIRE(at != std::string::npos);
+    f.seekp(static_cast<std::streamoff>(at));
+    f.put(static_cast<char>(bytes[at] ^ 1));
+}
+
+}  // namespace
+
+TEST_CASE("HistoryStore reads back every record")
+{
+    TempDir dir;
+    HistoryStore store(dir.path.string(), small());
+    std::vector<MessageId> ids;
+    for (int i = 0; i < 2000; ++i)
+        ids.push_back(store.append(conv(i), body(i), 1000 + i));
+    REQUIRE(store.count() == 2000);
+
+    HistoryRecord r;
+    for (int i = 0; i < 2000; ++i) {
+        REQUIRE(store.read(ids[i], r));
+        REQUIRE(r.id == ids[i]);
+        REQUIRE(r.conversation == conv(i));
+        REQUIRE(r.payload == body(i));
+        REQUIRE(r.timestamp == 1000u + i);
+    }
+    // one conversation always lands on one shard
+    const MessageId shard = ids[0] >> 48;
+    REQUIRE(shard == store.shard_of(conv(0)));
+    REQUIRE((ids[7] >> 48) == shard);
+
+    // segments are fixed-size files
+    std::size_t segments = 0;
+    for (const auto &f : fs::recursive_directory_iterator(dir.path)) {
+        if (f.path().extension() == ".seg") {
+            ++segments;
+            REQUIRE(fs::file_size(f.path()) == 4096);
+        }
+    }
+    REQUIRE(segments * 4096 >= store.bytes());
+}
+
+TEST_CASE("HistoryStore views records in place")
+{
+    TempDir dir;
+    HistoryStore store(dir.path.string(), small());
+    std::vector<MessageId> ids;
+    for (int i = 0; i < 300; ++i)
+        ids.push_back(store.append(conv(i), body(i), i));
+
+    RecordView a, b;
+    REQUIRE(store.view(ids[42], a));
+    REQUIRE(a.payload == body(42));
+    REQUIRE(a.conversation == conv(42));
+    REQUIRE(store.view(ids[42], b));
+    REQUIRE(a.payload.data() == b.payload.data());  // no copy
+
+    // appends after the mapping was made are visible, old views stay valid
+    const MessageId late = store.append(conv(42), "late", 1);
+    REQUIRE(store.view(late, b));
+    REQUIRE(b.payload == "late");
+    REQUIRE(a.payload == body(42));
+
+    // hints at the start of a shard and across segments are harmless
+    for (MessageId id : {ids[0], ids[150], late})
+        store.prefetch_before(id, 1 << 20);
+    store.prefetch_before(0);
+    REQUIRE_FALSE(store.view(late + 1, b));
+}
+
+TEST_CASE("HistoryStore pages a conversation backwards")
+{
+    TempDir dir;
+    std::vector<MessageId> mine;  // conv(3), oldest first
+    {
+        HistoryStore store(dir.path.string(), small());
+        for (int i = 0; i < 700; ++i) {
+            const MessageId id = store.append(conv(i), body(i), i);
+            if (i % 7 == 3)
+                mine.push_back(id);
+        }
+    }
+    // the conversation chains survive a reopen
+    HistoryStore store(dir.path.string(), small());
+    mine.push_back(store.append(conv(3), "newest", 700));
+
+    HistoryPage page;
+    std::vector<MessageId> got;
+    MessageId cursor = 0;
+    do {
+        REQUIRE(store.fetch(conv(3), cursor, 9, page));
+        REQUIRE(page.records.size() <= 9);
+        for (const auto &r : page.records) {
+            REQUIRE(r.conversation == conv(3));
+            got.push_back(r.id);
+        }
+        cursor = page.next;
+    } while (cursor != 0);
+    REQUIRE(got.size() == mine.size());
+    for (std::size_t i = 0; i < got.size(); ++i)
+        REQUIRE(got[i] == mine[mine.size() - 1 - i]);
+
+    // any message works as a cursor, however old
+    REQUIRE(store.fetch(conv(3), mine[5], 100, page));
+    REQUIRE(page.records.size() == 5);
+    REQUIRE(page.records[0].payload == body(4 * 7 + 3));
+    REQUIRE(page.next == 0);
+
+    // a cursor from another conversation, or none at all
+    REQUIRE_FALSE(store.fetch(conv(3), mine[5] + 1, 10, page));
+    REQUIRE(store.fetch("nobody\nelse", 0, 10, page));
+    REQUIRE(page.records.empty());
+    REQUIRE(page.next == 0);
+}
+
+TEST_CASE("HistoryStore jumps to a date")
+{
+    TempDir dir;
+    HistoryOptions one = small();
+    one.shards = 1;
+    const auto go = [](std::uint64_t) { return true; };
+    // a clock running 10 a message, every third sender 25 behind, and a
+    // conversation that is quiet most of the time
+    const auto stamp = [](int i) { return 100 + i * 10 - (i % 3 ? 0 : 25); };
+    const auto who = [](int i) {
+        return i % 97 == 5 ? std::string("quiet\nuser9") : conv(i);
+    };
+    std::vector<MessageId> ids;
+    auto store = std::make_unique<HistoryStore>(dir.path.string(), one);
+    for (int i = 0; i < 1500; ++i)
+        ids.push_back(store->append(who(i), body(i), stamp(i)));
+
+    // the page starts at the conversation's last message before the first
+    // one stamped later than the date
+    const auto expect = [&](const std::string &c, std::uint64_t t) {
+        int passed = 1500;
+        for (int i = 0, clock = 0; i < 1500 && passed == 1500; ++i)
+            if ((clock = std::max(clock, stamp(i))) > static_cast<int>(t))
+                passed = i;
+        for (int i = passed - 1; i >= 0; --i)
+            if (who(i) == c)
+                return i;
+        return -1;
+    };
+    const auto check = [&] {
+        HistoryPage page;
+        for (const std::string &c : {conv(3), std::string("quiet\nuser9")})
+            for (std::uint64_t t : {0, 80, 99, 100, 105, 4321, 9000, 14100,
+                                    16000, 99999}) {
+                store->fetch_at(c, t, 3, page);
+                const int i = expect(c, t);
+                if (i < 0) {
+                    REQUIRE(page.records.empty());
+                    continue;
+                }
+                REQUIRE(!page.records.empty());
+                REQUIRE(page.records[0].id == ids[i]);
+                REQUIRE(page.records[0].timestamp <= t);
+                for (const auto &r : page.records)
+                    REQUIRE(r.conversation == c);
+                if (page.next != 0) {  // and fetch() goes on from there
+                    HistoryPage more;
+                    REQUIRE(store->fetch(c, page.next, 1, more));
+                    REQUIRE(more.records[0].id < page.records.back().id);
+                }
+            }
+    };
+    check();
+    HistoryPage none;
+    store->fetch_at("nobody\nelse", 5000, 10, none);
+    REQUIRE(none.records.empty());
+
+    // the time index is rebuilt by compaction and by a reopen, and
+    // survives the cold tier
+    for (int i = 0; i < 1500; i += 2)
+        if (who(i) != conv(3) && i % 97 != 5)
+            store->erase(ids[i]);
+    CompactionResult r;
+    while (store->compact(0, 0.1, go, r))
+        ;
+    check();
+    while (store->freeze(0, ~std::uint64_t{0}, go, r))
+        ;
+    check();
+    store.reset();
+    store = std::make_unique<HistoryStore>(dir.path.string(), one);
+    check();
+}
+
+TEST_CASE("HistoryStore scans every message")
+{
+    TempDir dir;
+    HistoryStore store(dir.path.string(), small());
+    std::vector<MessageId> ids;
+    for (int i = 0; i < 300; ++i)
+        ids.push_back(store.append(conv(i), body(i), i));
+    store.erase(ids[7]);
+
+    std::vector<bool> seen(300, false);
+    MessageId last = 0;
+    store.scan([&](const RecordView &v) {
+        REQUIRE((v.id >> 48 != last >> 48 || v.id > last));  // id order
+        last = v.id;
+        const auto i = static_cast<std::size_t>(v.timestamp);
+        REQUIRE(v.payload == body(static_cast<int>(i)));
+        REQUIRE_FALSE(seen[i]);
+        seen[i] = true;
+    });
+    for (int i = 0; i < 300; ++i)
+        REQUIRE(seen[i] == (i != 7));
+}
+
+TEST_CASE("HistoryStore rejects unknown ids and oversized records")
+{
+    TempDir dir;
+    HistoryStore store(dir.path.string(), small());
+    HistoryRecord r;
+    REQUIRE_FALSE(store.read(0, r));
+    const MessageId id = store.append("a\nb", "hi", 1);
+    REQUIRE(store.read(id, r));
+    REQUIRE_FALSE(store.read(id + 1, r));
+    REQUIRE_FALSE(store.read(MessageId{99} << 48 | 1, r));
+    REQUIRE_THROWS_AS(store.append("a\nb", std::string(5000, 'x'), 2),
+                      std::invalid_argument);
+
+    HistoryOptions bad = small();
+    bad.index_every = 0;
+    REQUIRE_THROWS_AS(HistoryStore((dir.path / "x").string(), bad),
+                      std::invalid_argument);
+}
+
+TEST_CASE("HistoryStore reopens where it left off")
+{
+    TempDir dir;
+    std::vector<MessageId> ids;
+    {
+        HistoryStore store(dir.path.string(), small());
+        for (int i = 0; i < 500; ++i)
+            ids.push_back(store.append(conv(i), body(i), i));
+    }
+    HistoryStore store(dir.path.string(), small());
+    REQUIRE(store.count() == 500);
+    HistoryRecord r;
+    REQUIRE(store.read(ids[123], r));
+    REQUIRE(r.payload == body(123));
+
+    // ids continue, nothing is overwritten
+    const MessageId next = store.append(conv(0), "after", 0);
+    REQUIRE(next == ids[497] + 1);  // conv(497) == conv(0)
+    REQUIRE(store.read(ids[497], r));
+    REQUIRE(r.payload == body(497));
+    REQUIRE(store.read(next, r));
+    REQUIRE(r.payload == "after");
+}
+
+TEST_CASE("HistoryStore cuts a torn append")
+{
+    TempDir dir;
+    HistoryOptions one = small();
+    one.shards = 1;
+    MessageId last;
+    {
+        HistoryStore store(dir.path.string(), one);
+        for (int i = 0; i < 3; ++i)
+            last = store.append("a\nb", body(i), i);
+        store.flush();
+    }
+    // a crash in the middle of the next append: only the size made it
+    fs::path seg;
+    for (const auto &f : fs::recursive_directory_iterator(dir.path))
+        if (f.path().extension() == ".seg")
+            seg = f.path();
+    const auto used = 3 * 36 + 3 * 3 + body(0).size() + body(1).size() +
+                      body(2).size();
+    {
+        std::fstream f(seg, std::ios::binary | std::ios::in | std::ios::out);
+        f.seekp(static_cast<std::streamoff>(used));
+        f.write("\x40\0\0\0", 4);
+    }
+
+    HistoryStore store(dir.path.string(), one);
+    REQUIRE(store.count() == 3);
+    const MessageId next = store.append("a\nb", "again", 9);
+    REQUIRE(next == last + 1);
+    HistoryRecord r;
+    REQUIRE(store.read(next, r));
+    REQUIRE(r.payload == "again");
+}
+
+TEST_CASE("HistoryStore checks record checksums")
+{
+    TempDir dir;
+    HistoryOptions one = small();
+    one.shards = 1;
+    std::vector<MessageId> ids;
+    std::vector<fs::path> segs;
+    {
+        HistoryStore store(dir.path.string(), one);
+        for (int i = 0; i < 100; ++i)
+            ids.push_back(store.append("a\nb", body(i), i));
+        store.flush();
+        for (const auto &f : fs::recursive_directory_iterator(dir.path))
+            if (f.path().extension() == ".seg")
+                segs.push_back(f.path());
+        std::sort(segs.begin(), segs.end());
+        REQUIRE(segs.size() > 1);
+
+        // a scan skips what went bad under it
+        damage(segs.back(), "message 98");
+        std::size_t seen = 0;
+        REQUIRE(store.scan([&](const RecordView &) { ++seen; }) == 1);
+        REQUIRE(seen == 99);
+    }
+
+    // in the open segment, a bad record is a torn append
+    {
+        HistoryStore store(dir.path.string(), one);
+        REQUIRE(store.count() == 98);
+        REQUIRE(store.append("a\nb", "again", 0) == ids[98]);
+    }
+
+    // in a sealed one, it is damage
+    damage(segs.front(), "message 5");
+    REQUIRE_THROWS_AS(HistoryStore(dir.path.string(), one),
+                      std::runtime_error);
+}
+
+TEST_CASE("crc32c matches the reference and chains")
+{
+    const std::string check = "123456789";
+    REQUIRE(crc32c(check.data(), check.size()) == 0xE3069283);
+    REQUIRE(crc32c_portable(check.data(), check.size()) == 0xE3069283);
+    const std::string zeros(32, '\0');  // RFC 3720 B.4
+    REQUIRE(crc32c(zeros.data(), zeros.size()) == 0x8A9136AA);
+    REQUIRE(crc32c(nullptr, 0) == 0);
+
+    // every short length at every alignment, split in two or not
+    std::string data;
+    for (int i = 0; i < 256; ++i)
+        data.push_back(static_cast<char>(i * 131 + 7));
+    for (std::size_t off = 0; off < 8; ++off) {
+        for (std::size_t n = 0; off + n <= data.size(); ++n) {
+            const char *p = data.data() + off;
+            const std::uint32_t whole = crc32c_portable(p, n);
+            REQUIRE(crc32c(p, n) == whole);
+            REQUIRE(crc32c(p + n / 2, n - n / 2, crc32c(p, n / 2)) == whole);
+        }
+    }
+
+    // long enough for the interleaved streams
+    std::string big;
+    for (int i = 0; i < 40000; ++i)
+        big.push_back(static_cast<char>(i * 2654435761u >> 11));
+    for (std::size_t n : {12287, 12288, 12289, 30000, 40000})
+        REQUIRE(crc32c(big.data(), n) == crc32c_portable(big.data(), n));
+}
+
+TEST_CASE("HistoryStore erases messages")
+{
+    TempDir dir;
+    std::vector<MessageId> ids;
+    {
+        HistoryStore store(dir.path.string(), small());
+        for (int i = 0; i < 70; ++i)
+            ids.push_back(store.append(conv(3), body(i), i));
+        REQUIRE(store.erase(ids[69]));  // the newest
+        REQUIRE(store.erase(ids[10]));
+        REQUIRE_FALSE(store.erase(ids[10]));  // already gone
+        REQUIRE(store.garbage() == body(69).size() + body(10).size());
+    }
+    // tombstones are replayed on open
+    HistoryStore store(dir.path.string(), small());
+    REQUIRE(store.garbage() == body(69).size() + body(10).size());
+    RecordView v;
+    REQUIRE_FALSE(store.view(ids[10], v));
+    REQUIRE(store.view(ids[11], v));
+
+    HistoryPage page;
+    REQUIRE(store.fetch(conv(3), 0, 60, page));
+    REQUIRE(page.records.size() == 60);
+    REQUIRE(page.records[0].id == ids[68]);
+    REQUIRE(page.records.back().id == ids[8]);  // 10 skipped
+    REQUIRE(store.fetch(conv(3), ids[10], 60, page));  // still a cursor
+    REQUIRE(page.records.size() == 10);
+}
+
+TEST_CASE("HistoryStore compacts erased messages away")
+{
+    TempDir dir;
+    HistoryOptions one = small();
+    one.shards = 1;
+    const auto big = [](int i) { return body(i) + std::string(200, 'p'); };
+    const auto go = [](std::uint64_t) { return true; };
+    std::vector<MessageId> ids;
+    RecordView pinned;
+    {
+        HistoryStore store(dir.path.string(), one);
+        for (int i = 0; i < 400; ++i)
+            ids.push_back(store.append(conv(i), big(i), i));
+        for (int i = 0; i < 400; ++i)
+            if (i % 4 != 1)
+                store.erase(ids[i]);
+        REQUIRE(store.view(ids[1], pinned));
+
+        const auto before = store.bytes();
+        std::size_t merged = 0;
+        CompactionResult r;
+        while (store.compact(0, 0.1, go, r)) {
+            REQUIRE(r.bytes_written <= r.bytes_read);
+            merged = std::max(merged, r.segments);
+        }
+        REQUIRE(merged > 1);  // shrunk segments were merged too
+        REQUIRE(store.bytes() < before / 2);
+        REQUIRE(pinned.payload == big(1));  // its file is gone
+    }
+    REQUIRE(pinned.payload == big(1));  // and so is the store
+
+    // ids, contents and chains survive the merges and a reopen
+    HistoryStore store(dir.path.string(), one);
+    REQUIRE(store.count() == 700);
+    HistoryRecord rec;
+    for (int i = 0; i < 400; ++i) {
+        REQUIRE(store.read(ids[i], rec) == (i % 4 == 1));
+        if (i % 4 == 1)
+            REQUIRE(rec.payload == big(i));
+    }
+    HistoryPage page;
+    std::size_t seen = 0;
+    MessageId cursor = 0;
+    do {
+        REQUIRE(store.fetch(conv(1), cursor, 4, page));
+        for (const auto &r : page.records)
+            REQUIRE(r.conversation == conv(1));
+        seen += page.records.size();
+        cursor = page.next;
+    } while (cursor != 0);
+    REQUIRE(seen == 15);  // i % 28 == 1
+    REQUIRE(store.append(conv(0), "after", 0) == ids.back() + 301);
+}
+
+TEST_CASE("HistoryStore abandons a compaction its pace refuses")
+{
+    TempDir dir;
+    HistoryOptions one = small();
+    one.shards = 1;
+    HistoryStore store(dir.path.string(), one);
+    std::vector<MessageId> ids;
+    for (int i = 0; i < 200; ++i)
+        ids.push_back(store.append(conv(i), body(i), i));
+    for (int i = 0; i < 200; i += 2)
+        store.erase(ids[i]);
+    const auto garbage = store.garbage();
+
+    CompactionResult r;
+    REQUIRE_FALSE(
+        store.compact(0, 0.25, [](std::uint64_t) { return false; }, r));
+    REQUIRE(store.garbage() == garbage);
+    for (const auto &f : fs::recursive_directory_iterator(dir.path))
+        if (f.is_regular_file())
+            REQUIRE(f.path().extension() == ".seg");  // no leftovers
+    HistoryRecord rec;
+    REQUIRE(store.read(ids[1], rec));
+    REQUIRE(rec.payload == body(1));
+}
+
+TEST_CASE("lz_block round-trips and refuses bad input")
+{
+    std::string chat;
+    for (int i = 0; i < 500; ++i)
+        chat += "{\"type\":\"chat\",\"from\":\"user" + std::to_string(i % 9) +
+                "\",\"text\":\"" + body(i) + "\"}";
+    std::string noise;
+    for (int i = 0; i < 5000; ++i)
+        noise.push_back(static_cast<char>(i * 2654435761u >> 13));
+    const std::string inputs[] = {"", "a", "abcd", std::string(100000, 'z'),
+                                  chat, noise};
+    for (const auto &in : inputs) {
+        std::string packed;
+        lz_compress(in.data(), in.size(), packed);
+        std::string out(in.size(), '\0');
+        REQUIRE(lz_decompress(packed.data(), packed.size(), &out[0],
+                              out.size()));
+        REQUIRE(out == in);
+        if (in.size() > 4) {
+            REQUIRE_FALSE(lz_decompress(packed.data(), packed.size() - 1,
+                                        &out[0], out.size()));
+            REQUIRE_FALSE(lz_decompress(packed.data(), packed.size(),
+                                        &out[0], out.size() - 1));
+        }
+    }
+    std::string packed;
+    lz_compress(chat.data(), chat.size(), packed);
+    REQUIRE(packed.size() < chat.size() / 2);
+    const char bad[] = {0x00, 0x05, 0x00};  // a match before the start
+    char out[8];
+    REQUIRE_FALSE(lz_decompress(bad, sizeof(bad), out, sizeof(out)));
+}
+
+TEST_CASE("HistoryStore moves old segments to the cold tier")
+{
+    TempDir dir;
+    HistoryOptions one = small();
+    one.shards = 1;
+    one.cold_block = 1024;
+    const auto go = [](std::uint64_t) { return true; };
+    std::vector<MessageId> ids;
+    RecordView pinned;
+    {
+        HistoryStore store(dir.path.string(), one);
+        for (int i = 0; i < 400; ++i)
+            ids.push_back(store.append(conv(i), body(i), i));
+        REQUIRE(store.erase(ids[5]));
+
+        // only segments wholly before the cut
+        CompactionResult r;
+        std::size_t frozen = 0;
+        while (store.freeze(0, 200, go, r)) {
+            REQUIRE(r.bytes_written < r.bytes_read);
+            ++frozen;
+        }
+        const TierStats t = store.tiers();
+        REQUIRE(frozen > 1);
+        REQUIRE(t.cold_segments == frozen);
+        REQUIRE(t.hot_segments > 1);
+        REQUIRE(t.cold_bytes < t.cold_records);
+        REQUIRE(t.cold_records + t.hot_records == store.bytes());
+        REQUIRE(store.view(ids[10], pinned));
+    }
+    REQUIRE(pinned.payload == body(10));  // the block outlives the store
+
+    HistoryStore store(dir.path.string(), one);
+    REQUIRE(store.tiers().cold_segments > 1);
+    REQUIRE(store.count() == 401);
+
+    // a random read decompresses one block at most
+    const auto before = store.tiers().cold_blocks_read;
+    HistoryRecord rec;
+    REQUIRE(store.read(ids[150], rec));
+    REQUIRE(rec.payload == body(150));
+    REQUIRE(store.tiers().cold_blocks_read - before <= 1);
+
+    // pages run through cold and hot segments alike
+    for (int i = 0; i < 400; ++i) {
+        REQUIRE(store.read(ids[i], rec) == (i != 5));
+        if (i != 5)
+            REQUIRE(rec.payload == body(i));
+    }
+    HistoryPage page;
+    std::size_t seen = 0;
+    MessageId cursor = 0;
+    do {
+        REQUIRE(store.fetch(conv(3), cursor, 7, page));
+        seen += page.records.size();
+        cursor = page.next;
+    } while (cursor != 0);
+    REQUIRE(seen == 57);  // i % 7 == 3
+    std::size_t scanned = 0;
+    REQUIRE(store.scan([&](const RecordView &) { ++scanned; }) == 0);
+    REQUIRE(scanned == 399);
+
+    // compaction takes cold segments back in
+    CompactionResult r;
+    REQUIRE(store.compact(0, 0.0, go, r));
+    REQUIRE_FALSE(store.read(ids[5], rec));
+    REQUIRE(store.read(ids[6], rec));
+    REQUIRE(rec.payload == body(6));
+}
+
+TEST_CASE("HistoryStore keeps a segment hot when compression does not pay")
+{
+    TempDir dir;
+    HistoryOptions one = small();
+    one.shards = 1;
+    one.cold_block = 1024;
+    const auto go = [](std::uint64_t) { return true; };
+    HistoryStore store(dir.path.string(), one);
+    std::uint64_t x = 88172645463325252ULL;  // xorshift: incompressible
+    std::vector<MessageId> ids;
+    for (int i = 0; i < 20; ++i) {
+        std::string noise(1993, '\0');  // 2 fill a segment
+        for (auto &c : noise) {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            c = static_cast<char>(x);
+        }
+        ids.push_back(store.append(conv(0), noise, i));
+    }
+
+    CompactionResult r;
+    REQUIRE(store.freeze(0, 1000, go, r));
+    REQUIRE(r.segments == 0);
+    REQUIRE(r.bytes_written == 0);
+    while (store.freeze(0, 1000, go, r))
+        REQUIRE(r.segments == 0);  // each once, then none qualifies
+    REQUIRE(store.tiers().cold_segments == 0);
+    HistoryRecord rec;
+    REQUIRE(store.read(ids[0], rec));
+    REQUIRE(rec.payload.size() == 1993);
+}
+
+TEST_CASE("HistoryEngine backends answer alike")
+{
+    TempDir dir;
+    HistoryOptions one = small();
+    one.shards = 1;  // one log, one clock, as in memory
+    HistoryStore disk(dir.path.string(), one);
+    MemoryHistory memory(512);  // records often cross into a new chunk
+    HistoryEngine *engines[] = {&disk, &memory};
+
+    std::vector<MessageId> ids[2];
+    for (int e = 0; e < 2; ++e) {
+        HistoryEngine &h = *engines[e];
+        for (int i = 0; i < 300; ++i)
+            ids[e].push_back(h.append(conv(i), body(i), 10 * i - i % 4));
+        std::vector<HistoryAppend> batch;
+        for (int i = 300; i < 600; ++i)
+            batch.push_back(HistoryAppend{conv(i), body(i), 10u * i});
+        batch.insert(batch.begin() + 5,
+                     HistoryAppend{std::string(0x10000, 'c'), "too long", 0});
+        std::vector<MessageId> got;
+        h.write(batch, got);
+        REQUIRE(got.size() == 301);
+        REQUIRE(got[5] == 0);  // fails alone
+        got.erase(got.begin() + 5);
+        for (MessageId id : got)
+            REQUIRE(id != 0);
+        ids[e].insert(ids[e].end(), got.begin(), got.end());
+        for (int i = 0; i < 600; i += 5)
+            REQUIRE(h.erase(ids[e][i]));
+        REQUIRE_FALSE(h.erase(ids[e][0]));
+        REQUIRE_THROWS_AS(h.append(std::string(0x10000, 'c'), "x", 0),
+                          std::invalid_argument);
+        h.sync();
+    }
+
+    // what a caller sees: payloads, in order
+    const auto payloads = [](const HistoryPage &page) {
+        std::vector<std::string> p;
+        for (const auto &r : page.records)
+            p.emplace_back(r.payload);
+        return p;
+    };
+    const auto pages = [&](HistoryEngine &h, const std::string &c) {
+        std::vector<std::string> all;
+        HistoryPage page;
+        MessageId cursor = 0;
+        do {
+            REQUIRE(h.fetch(c, cursor, 7, page));
+            for (auto &p : payloads(page))
+                all.push_back(p);
+            cursor = page.next;
+        } while (cursor != 0);
+        return all;
+    };
+    std::vector<std::string> scanned[2];
+    for (int e = 0; e < 2; ++e)
+        engines[e]->scan([&](const RecordView &r) {
+            scanned[e].emplace_back(r.payload);
+        });
+    REQUIRE(scanned[0] == scanned[1]);
+    REQUIRE(scanned[0].size() == 480);
+
+    // the tail from a mark: stamps 4000 and later ( i >= 400 )
+    for (int e = 0; e < 2; ++e) {
+        scanned[e].clear();
+        engines[e]->scan_since(4000, [&](const RecordView &r) {
+            REQUIRE(r.timestamp >= 4000);
+            scanned[e].emplace_back(r.payload);
+        });
+    }
+    REQUIRE(scanned[0] == scanned[1]);
+    REQUIRE(scanned[0].size() == 160);
+
+    HistoryPage a, b;
+    for (int c = 0; c < 7; ++c) {
+        REQUIRE(pages(disk, conv(c)) == pages(memory, conv(c)));
+        for (std::uint64_t t : {0, 5, 1234, 2990, 3001, 5555, 99999}) {
+            disk.fetch_at(conv(c), t, 9, a);
+            memory.fetch_at(conv(c), t, 9, b);
+            REQUIRE(payloads(a) == payloads(b));
+            REQUIRE((a.next == 0) == (b.next == 0));
+        }
+    }
+    HistoryRecord ra, rb;
+    for (std::size_t i = 0; i < 600; ++i) {
+        REQUIRE(disk.read(ids[0][i], ra) == memory.read(ids[1][i], rb));
+        if (i % 5 != 0)
+            REQUIRE((ra.payload == rb.payload &&
+                     ra.conversation == rb.conversation &&
+                     ra.timestamp == rb.timestamp));
+    }
+    RecordView v;
+    REQUIRE_FALSE(memory.view(0, v));
+    REQUIRE_FALSE(memory.fetch(conv(3), ids[1][4], 5, b));  // conv(4)'s
+    REQUIRE(memory.count() == 600);
+}
+
+TEST_CASE("HistoryWriter commits appends in groups")
+{
+    TempDir dir;
+    HistoryStore store(dir.path.string(), small());
+    std::vector<MessageId> ids(400, 0);
+    std::atomic<int> done{0};
+    {
+        CommitOptions options;
+        options.window = std::chrono::milliseconds(2);
+        HistoryWriter writer(store, options);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&, t] {
+                for (int i = t; i < 400; i += 4)
+                    writer.append(conv(i), body(i), i, [&, i](MessageId id) {
+                        ids[i] = id;
+                        ++done;
+                    });
+            });
+        }
+        for (auto &t : threads)
+            t.join();
+        writer.shutdown();  // commits what is still queued
+        REQUIRE(done == 400);
+        REQUIRE(writer.appends() == 400);
+        REQUIRE(writer.batches() < 400);
+
+        // too late: fails at once, on the caller
+        MessageId late = 1;
+        writer.append("a\nb", "late", 0, [&](MessageId id) { late = id; });
+        REQUIRE(late == 0);
+    }
+
+    HistoryRecord r;
+    for (int i = 0; i < 400; ++i) {
+        REQUIRE(ids[i] != 0);
+        REQUIRE(store.read(ids[i], r));
+        REQUIRE(r.payload == body(i));
+    }
+}
+
+TEST_CASE("HistoryWriter fails only the record that does not fit")
+{
+    TempDir dir;
+    HistoryStore store(dir.path.string(), small());
+    MessageId big = 1, ok = 0;
+    {
+        HistoryWriter writer(store);
+        writer.append("a\nb", std::string(5000, 'x'), 0,
+                      [&](MessageId id) { big = id; });
+        writer.append("a\nb", "fits", 1, [&](MessageId id) { ok = id; });
+    }
+    REQUIRE(big == 0);
+    REQUIRE(ok != 0);
+    store.sync();  // nothing left to write: harmless
+    HistoryRecord r;
+    REQUIRE(store.read(ok, r));
+    REQUIRE(r.payload == "fits");
+}
+
+TEST_CASE("HistoryCompactor reclaims in the background")
+{
+    TempDir dir;
+    HistoryStore store(dir.path.string(), small());
+    std::vector<MessageId> ids;
+    for (int i = 0; i < 1000; ++i)
+        ids.push_back(store.append(conv(i), body(i), i));
+    for (int i = 0; i < 1000; i += 3)
+        store.erase(ids[i]);
+
+    CompactionOptions options;
+    options.io_bytes_per_sec = 0;
+    options.min_garbage = 0.1;
+    options.interval = std::chrono::milliseconds(1);
+    HistoryCompactor compactor(store, options);
+    for (int i = 0; i < 500 && compactor.progress().passes < 2; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    compactor.stop();
+
+    const CompactionProgress p = compactor.progress();
+    REQUIRE(p.passes >= 2);
+    REQUIRE(p.runs > 0);
+    REQUIRE(p.shards == 4);
+    REQUIRE(p.bytes_reclaimed > 0);
+    REQUIRE(p.bytes_written < p.bytes_read);
+    HistoryRecord r;
+    REQUIRE(store.read(ids[1], r));
+    REQUIRE(r.payload == body(1));
+    REQUIRE_FALSE(store.read(ids[3], r));
+}
+
+TEST_CASE("HistoryCompactor freezes segments past cold_after")
+{
+    TempDir dir;
+    HistoryStore store(dir.path.string(), small());
+    const std::uint64_t now = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count());
+    const std::uint64_t month = 30ull * 24 * 3600 * 1000;
+    std::vector<MessageId> ids;
+    for (int i = 0; i < 1000; ++i)
+        ids.push_back(store.append(conv(i), body(i), now - month + i));
+
+    CompactionOptions options;
+    options.io_bytes_per_sec = 0;
+    options.cold_after = std::chrono::hours(24 * 21);
+    HistoryCompactor compactor(store, options, false);
+    REQUIRE(compactor.run_pass() > 0);
+    const CompactionProgress p = compactor.progress();
+    REQUIRE(p.frozen == store.tiers().cold_segments);
+    REQUIRE(p.frozen > 0);
+    REQUIRE(p.runs == 0);
+    REQUIRE(p.bytes_reclaimed > 0);
+    HistoryRecord r;
+    REQUIRE(store.read(ids[1], r));
+    REQUIRE(r.payload == body(1));
+
+    // newer than the cut: stays hot
+    options.cold_after = std::chrono::hours(24 * 60);
+    HistoryCompactor late(store, options, false);
+    REQUIRE(late.run_pass() == 0);
+}
+
+TEST_CASE("HistoryCompactor stays within its I/O budget")
+{
+    TempDir dir;
+    HistoryOptions one = small();
+    one.shards = 1;
+    HistoryStore store(dir.path.string(), one);
+    for (int i = 0; i < 200; ++i) {
+        const MessageId id = store.append(conv(i), body(i), i);
+        if (i % 2 == 0)
+            store.erase(id);
+    }
+
+    CompactionOptions options;
+    options.io_bytes_per_sec = 64 * 1024;
+    options.min_garbage = 0.1;
+    HistoryCompactor compactor(store, options, false);
+    const auto start = std::chrono::steady_clock::now();
+    REQUIRE(compactor.run_pass() > 0);
+    const auto took = std::chrono::steady_clock::now() - start;
+    const CompactionProgress p = compactor.progress();
+    REQUIRE(p.passes == 1);
+
+    // every chunk but the first waits for the budget
+    const double floor = 1.0 * (p.bytes_read + p.bytes_written) / (64 * 1024);
+    REQUIRE(std::chrono::duration<double>(took).count() >= floor * 0.5);
+}
+
+TEST_CASE("RecentCache serves the newest pages of a conversation")
+{
+    TempDir dir;
+    HistoryStore store(dir.path.string(), small());
+    RecentCache cache(1 << 20, 20, 4);
+    for (int i = 0; i < 100; ++i)
+        store.append(conv(i), body(i), i);
+
+    std::vector<HistoryRecord> got;
+    MessageId next;
+    REQUIRE_FALSE(cache.get(conv(3), 0, 10, got, next));
+
+    // admit: the newest per_conversation() messages from the store
+    HistoryPage page;
+    const auto ticket = cache.begin_fill(conv(3));
+    REQUIRE(store.fetch(conv(3), 0, cache.per_conversation(), page));
+    cache.fill(conv(3), ticket, page.records, page.next == 0);
+
+    REQUIRE(cache.get(conv(3), 0, 10, got, next));
+    REQUIRE(got.size() == 10);
+    REQUIRE(got[0].id == page.records[0].id);
+    REQUIRE(got[0].payload == body(99 - 99 % 7 + 3 - 7 * (99 % 7 < 3)));
+    REQUIRE(next == got.back().id);
+    REQUIRE(cache.get(conv(3), next, 10, got, next));  // the rest
+    REQUIRE(got.size() == 4);
+    REQUIRE(next == 0);  // 14 messages: the first one is cached
+    REQUIRE_FALSE(cache.get(conv(3), 12345, 10, got, next));
+
+    // the write path keeps it current, and the oldest fall off
+    for (int i = 0; i < 10; ++i) {
+        const MessageId id = store.append(conv(3), "new" + std::to_string(i),
+                                          100 + i);
+        cache.on_append(conv(3), id, 100 + i, "new" + std::to_string(i));
+    }
+    REQUIRE(cache.get(conv(3), 0, 20, got, next));
+    REQUIRE(got[0].payload == "new9");
+    REQUIRE(got[0].timestamp == 109);
+    REQUIRE(got[0].conversation == conv(3));
+    REQUIRE(next == got.back().id);
+    REQUIRE(store.fetch(conv(3), 0, 20, page));
+    for (std::size_t i = 0; i < 20; ++i) {
+        REQUIRE(got[i].id == page.records[i].id);
+        REQUIRE(got[i].payload == page.records[i].payload);
+    }
+    REQUIRE_FALSE(cache.get(conv(3), 0, 21, got, next));  // not all cached
+
+    cache.invalidate(conv(3));
+    REQUIRE_FALSE(cache.get(conv(3), 0, 1, got, next));
+    const RecentCacheStats stats = cache.stats();
+    REQUIRE(stats.hits == 3);
+    REQUIRE(stats.misses == 4);
+    REQUIRE(stats.conversations == 0);
+}
+
+TEST_CASE("RecentCache drops a fill that raced an append")
+{
+    RecentCache cache(1 << 20, 8, 1);
+    std::vector<RecordView> page(1);
+    page[0].id = 1;
+    page[0].payload = "old";
+
+    auto ticket = cache.begin_fill("a\nb");
+    cache.on_append("a\nb", 2, 0, "newer");  // not in the page read
+    cache.fill("a\nb", ticket, page, true);
+    std::vector<HistoryRecord> got;
+    MessageId next;
+    REQUIRE_FALSE(cache.get("a\nb", 0, 1, got, next));
+
+    ticket = cache.begin_fill("a\nb");
+    cache.fill("a\nb", ticket, page, true);
+    cache.on_append("a\nb", 1, 0, "old");  // the fill had it already
+    REQUIRE(cache.get("a\nb", 0, 5, got, next));
+    REQUIRE(got.size() == 1);
+    REQUIRE(next == 0);
+}
+
+TEST_CASE("RecentCache evicts with CLOCK under its budget")
+{
+    RecentCache cache(16 * 1024, 4, 1);
+    std::vector<HistoryRecord> got;
+    MessageId next;
+    const std::string payload(200, 'p');
+    std::vector<RecordView> page(1);
+    page[0].payload = payload;
+    auto admit = [&](const std::string &c) {
+        page[0].id = 1;
+        cache.fill(c, cache.begin_fill(c), page, false);
+    };
+
+    admit("hot");
+    for (int i = 0; i < 200; ++i) {
+        admit("c" + std::to_string(i));
+        REQUIRE(cache.get("hot", 0, 1, got, next));  // keeps it referenced
+        REQUIRE(cache.stats().bytes <= 16 * 1024);
+    }
+    const RecentCacheStats stats = cache.stats();
+    REQUIRE(stats.evictions > 100);
+    REQUIRE(stats.conversations < 100);
+    REQUIRE_FALSE(cache.get("c0", 0, 1, got, next));
+}
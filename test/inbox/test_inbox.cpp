@@ -0,0 +1,223 @@
+// test inbox
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// -- offline inbox -- //
+#include "ack_window.hpp"
+#include "offline_inbox.hpp"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+/// Fresh spill directory per test case.
+struct TempDir {
+    fs::path path;
+    TempDir()
+        : path(fs::temp_directory_path() /
+               ("inbox_test_" + std::to_string(std::rand())))
+    {
+        fs::remove_all(path);
+    }
+    ~TempDir() { fs::remove_all(path); }
+};
+
+/// Collect everything, remember the batch sizes.
+struct Collector {
+    std::vector<std::string> got;
+    std::vector<std::size_t> batches;
+    OfflineInbox::sink_type sink()
+    {
+        return [this](const std::vector<std::string> &batch) {
+            got.insert(got.end(), batch.begin(), batch.end());
+            batches.push_back(batch.size());
+            return true;
+        };
+    }
+};
+
+std::string msg(std::uint64_t i)
+{
+    return "message " + std::to_string(i);
+}
+
+}  // namespace
+
+TEST_CASE("OfflineInbox keeps order across memory and disk")
+{
+    TempDir dir;
+    OfflineInbox inbox(dir.path.string(), 4, 1024);
+
+    for (int i = 0; i < 10; ++i)
+        inbox.push("bob", msg(i));
+    REQUIRE(inbox.pending("bob") == 10);
+    REQUIRE(inbox.memory_bytes() == 4 * msg(0).size());  // capped
+    REQUIRE(inbox.pending("alice") == 0);
+
+    Collector c;
+    REQUIRE(inbox.replay("bob", 3, c.sink()) == 10);
+    REQUIRE(c.batches == std::vector<std::size_t>{3, 1, 3, 3});
+    for (int i = 0; i < 10; ++i)
+        REQUIRE(c.got[i] == msg(i));
+
+    REQUIRE(inbox.pending("bob") == 0);
+    REQUIRE(inbox.memory_bytes() == 0);
+    REQUIRE(fs::is_empty(dir.path));  // drained spill file is removed
+}
+
+TEST_CASE("OfflineInbox byte cap")
+{
+    TempDir dir;
+    OfflineInbox inbox(dir.path.string(), 100, 10);
+    inbox.push("bob", "12345");
+    inbox.push("bob", "12345");
+    inbox.push("bob", "x");  // over 10 bytes: spilled
+    REQUIRE(inbox.memory_bytes() == 10);
+    REQUIRE(inbox.pending("bob") == 3);
+}
+
+TEST_CASE("OfflineInbox stops when the sink refuses")
+{
+    TempDir dir;
+    OfflineInbox inbox(dir.path.string(), 2, 1024);
+    for (int i = 0; i < 6; ++i)
+        inbox.push("bob", msg(i));
+
+    int calls = 0;
+    auto flaky = [&](const std::vector<std::string> &) {
+        return ++calls < 3;  // connection drops on the third batch
+    };
+    REQUIRE(inbox.replay("bob", 2, flaky) == 4);
+    REQUIRE(inbox.pending("bob") == 2);
+
+    // messages pushed meanwhile queue behind the backlog
+    inbox.push("bob", msg(6));
+
+    Collector c;
+    REQUIRE(inbox.replay("bob", 10, c.sink()) == 3);
+    REQUIRE(c.got == std::vector<std::string>{msg(4), msg(5), msg(6)});
+}
+
+TEST_CASE("OfflineInbox recovers spill files after a restart")
+{
+    TempDir dir;
+    {
+        OfflineInbox inbox(dir.path.string(), 1, 1024);
+        for (int i = 0; i < 4; ++i)
+            inbox.push("bob", msg(i));
+    }
+    // the in-memory head is lost, the spilled tail is not
+
+    // simulate a crash in the middle of an append
+    for (const auto &f : fs::directory_iterator(dir.path)) {
+        std::ofstream out(f.path(), std::ios::binary | std::ios::app);
+        out.write("\x40\0\0\0abc", 7);
+    }
+
+    OfflineInbox inbox(dir.path.string(), 1, 1024);
+    REQUIRE(inbox.pending("bob") == 3);
+    inbox.push("bob", msg(4));  // lands after the torn tail was cut
+
+    Collector c;
+    REQUIRE(inbox.replay("bob", 8, c.sink()) == 4);
+    REQUIRE(c.got ==
+            std::vector<std::string>{msg(1), msg(2), msg(3), msg(4)});
+}
+
+TEST_CASE("OfflineInbox flushes its memory head before a restart")
+{
+    TempDir dir;
+    {
+        OfflineInbox inbox(dir.path.string(), 2, 1024);
+        for (int i = 0; i < 5; ++i)
+            inbox.push("bob", msg(i));  // 0, 1 in memory, the rest spilled
+        inbox.push("carol", msg(10));   // memory only, no spill file yet
+        inbox.flush();
+        REQUIRE(inbox.memory_bytes() == 0);
+        REQUIRE(inbox.pending("bob") == 5);
+
+        inbox.push("carol", msg(11));  // behind the flushed head
+    }
+
+    OfflineInbox inbox(dir.path.string(), 2, 1024);
+    Collector bob, carol;
+    REQUIRE(inbox.replay("bob", 8, bob.sink()) == 5);
+    REQUIRE(bob.got == std::vector<std::string>{msg(0), msg(1), msg(2),
+                                                msg(3), msg(4)});
+    REQUIRE(inbox.replay("carol", 8, carol.sink()) == 2);
+    REQUIRE(carol.got == std::vector<std::string>{msg(10), msg(11)});
+}
+
+TEST_CASE("AckWindow releases on cumulative acks")
+{
+    AckWindow w(8);
+    for (std::uint64_t seq = 1; seq <= 3; ++seq) {
+        REQUIRE(w.push("a\nb", seq, msg(seq)));
+        REQUIRE(w.push("#room", seq, msg(10 + seq)));
+    }
+    REQUIRE(w.size() == 6);
+    REQUIRE(w.room() == 2);
+
+    // acks for the room wait behind the unacked head
+    REQUIRE(w.ack("#room", 3) == 0);
+    REQUIRE(w.ack("a\nb", 1) == 2);  // a\nb 1, #room 1
+    REQUIRE(w.size() == 4);
+
+    auto gap = w.take_unacked();
+    REQUIRE(gap.size() == 2);
+    REQUIRE(gap[0].conversation == "a\nb");
+    REQUIRE(gap[0].seq == 2);
+    REQUIRE(gap[1].message == msg(3));
+    REQUIRE(w.size() == 0);
+}
+
+TEST_CASE("AckWindow drops a message whose send failed")
+{
+    AckWindow w(4);
+    for (std::uint64_t seq = 1; seq <= 3; ++seq)
+        REQUIRE(w.push("c", seq, msg(seq)));
+
+    REQUIRE(w.drop("c", 2) == 0);  // behind the unacked head
+    REQUIRE(w.drop("c", 9) == 0);  // not there
+    REQUIRE(w.ack("c", 1) == 2);
+    REQUIRE(w.drop("c", 3) == 1);
+    REQUIRE(w.size() == 0);
+
+    REQUIRE(w.push("c", 4, msg(4)));
+    REQUIRE(w.push("c", 5, msg(5)));
+    REQUIRE(w.drop("c", 4) == 1);
+    auto gap = w.take_unacked();
+    REQUIRE(gap.size() == 1);
+    REQUIRE(gap[0].seq == 5);
+}
+
+TEST_CASE("AckWindow refuses when full")
+{
+    AckWindow w(3);
+    for (std::uint64_t seq = 1; seq <= 3; ++seq)
+        REQUIRE(w.push("c", seq, msg(seq)));
+    REQUIRE_FALSE(w.push("c", 4, msg(4)));
+    REQUIRE(w.room() == 0);
+
+    REQUIRE(w.ack("c", 2) == 2);
+    REQUIRE(w.room() == 2);
+
+    // the ring wraps around cleanly
+    REQUIRE(w.push("c", 4, msg(4)));
+    REQUIRE(w.push("c", 5, msg(5)));
+    REQUIRE_FALSE(w.push("c", 6, msg(6)));
+    REQUIRE(w.ack("c", 4) == 2);
+    auto gap = w.take_unacked();
+    REQUIRE(gap.size() == 1);
+    REQUIRE(gap[0].seq == 5);
+    REQUIRE(gap[0].message == msg(5));
+}
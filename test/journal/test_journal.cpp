@@ -0,0 +1,203 @@
+// test journal
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// -- state journal -- //
+#include "state_journal.hpp"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+/// Fresh journal directory per test case.
+struct TempDir {
+    fs::path path;
+    TempDir()
+        : path(fs::temp_directory_path() /
+               ("journal_test_" + std::to_string(std::rand())))
+    {
+        fs::remove_all(path);
+    }
+    ~TempDir() { fs::remove_all(path); }
+};
+
+/// Toy state: "key=value" records set a key.
+struct KeyValues {
+    std::map<std::string, std::string> map;
+
+    void apply(std::string_view record)
+    {
+        const auto eq = record.find('=');
+        map[std::string(record.substr(0, eq))] =
+            std::string(record.substr(eq + 1));
+    }
+
+    void save(std::string &out) const
+    {
+        for (const auto &kv : map)
+            out += kv.first + '=' + kv.second + '\n';
+    }
+
+    bool load(std::string_view image)
+    {
+        map.clear();
+        while (!image.empty()) {
+            const auto nl = image.find('\n');
+            if (nl == std::string_view::npos)
+                return false;
+            apply(image.substr(0, nl));
+            image.remove_prefix(nl + 1);
+        }
+        return true;
+    }
+};
+
+JournalRecovery reopen(StateJournal &journal, KeyValues &state)
+{
+    return journal.recover(
+        [&](std::string_view image) { return state.load(image); },
+        [&](std::string_view record) { state.apply(record); });
+}
+
+std::size_t files(const fs::path &dir, const char *ext)
+{
+    std::size_t n = 0;
+    for (const auto &entry : fs::directory_iterator(dir))
+        n += entry.path().extension() == ext;
+    return n;
+}
+
+}  // namespace
+
+TEST_CASE("StateJournal replays its log")
+{
+    TempDir dir;
+    {
+        StateJournal journal(dir.path.string());
+        KeyValues state;
+        const JournalRecovery r = reopen(journal, state);
+        REQUIRE(r.snapshot_lsn == 0);
+        REQUIRE(r.replayed == 0);
+        REQUIRE(journal.append("a=1") == 1);
+        REQUIRE(journal.append("b=2") == 2);
+        REQUIRE(journal.append("a=3") == 3);
+        journal.sync();
+    }
+    StateJournal journal(dir.path.string());
+    KeyValues state;
+    const JournalRecovery r = reopen(journal, state);
+    REQUIRE(r.replayed == 3);
+    REQUIRE(state.map == std::map<std::string, std::string>{{"a", "3"},
+                                                            {"b", "2"}});
+    REQUIRE(journal.append("c=4") == 4);  // numbering goes on
+    REQUIRE_THROWS_AS(StateJournal(dir.path.string()).append("x=0"),
+                      std::logic_error);
+}
+
+TEST_CASE("StateJournal boots from a snapshot and the log tail")
+{
+    TempDir dir;
+    JournalOptions options;
+    options.snapshot_bytes = 64;
+    {
+        StateJournal journal(dir.path.string(), options);
+        KeyValues state;
+        reopen(journal, state);
+        for (int i = 0; i < 10; ++i) {
+            const std::string record =
+                "k" + std::to_string(i % 4) + '=' + std::to_string(i);
+            journal.append(record);
+            state.apply(record);
+        }
+        REQUIRE(journal.snapshot_due());
+        REQUIRE(journal.snapshot([&] {
+            // copied while changes are held off, encoded in the background
+            return StateJournal::Encoder(
+                [copy = state](std::string &image) { copy.save(image); });
+        }));
+        REQUIRE_FALSE(journal.snapshot_due());
+        journal.append("k0=tail");
+        journal.wait();
+        const JournalStats stats = journal.stats();
+        REQUIRE(stats.snapshot_lsn == 10);
+        REQUIRE(stats.snapshots == 1);
+        REQUIRE(stats.lsn == 11);
+    }
+    // the snapshot replaced every log it covers
+    REQUIRE(files(dir.path, ".snap") == 1);
+    REQUIRE(files(dir.path, ".log") == 1);
+
+    StateJournal journal(dir.path.string(), options);
+    KeyValues state;
+    const JournalRecovery r = reopen(journal, state);
+    REQUIRE(r.snapshot_lsn == 10);
+    REQUIRE(r.replayed == 1);
+    REQUIRE(state.map.size() == 4);
+    REQUIRE(state.map["k0"] == "tail");
+    REQUIRE(state.map["k1"] == "9");
+}
+
+TEST_CASE("StateJournal drops a torn append")
+{
+    TempDir dir;
+    {
+        StateJournal journal(dir.path.string());
+        KeyValues state;
+        reopen(journal, state);
+        journal.append("a=1");
+        journal.append("b=2");
+    }
+    // a crash in the middle of the second record
+    fs::path log;
+    for (const auto &entry : fs::directory_iterator(dir.path))
+        log = entry.path();
+    fs::resize_file(log, fs::file_size(log) - 2);
+
+    {
+        StateJournal journal(dir.path.string());
+        KeyValues state;
+        REQUIRE(reopen(journal, state).replayed == 1);
+        REQUIRE(journal.append("c=3") == 2);  // takes the torn one's place
+    }
+    StateJournal journal(dir.path.string());
+    KeyValues state;
+    REQUIRE(reopen(journal, state).replayed == 2);
+    REQUIRE(state.map == std::map<std::string, std::string>{{"a", "1"},
+                                                            {"c", "3"}});
+}
+
+TEST_CASE("StateJournal refuses a corrupt snapshot")
+{
+    TempDir dir;
+    {
+        StateJournal journal(dir.path.string());
+        KeyValues state;
+        reopen(journal, state);
+        journal.append("a=1");
+        state.apply("a=1");
+        journal.snapshot([&] {
+            return StateJournal::Encoder(
+                [copy = state](std::string &image) { copy.save(image); });
+        });
+        journal.wait();
+    }
+    for (const auto &entry : fs::directory_iterator(dir.path)) {
+        if (entry.path().extension() == ".snap") {
+            std::ofstream out(entry.path(), std::ios::binary | std::ios::app);
+            out << "junk";  // size no longer matches the header
+        }
+    }
+    StateJournal journal(dir.path.string());
+    KeyValues state;
+    REQUIRE_THROWS_AS(reopen(journal, state), std::runtime_error);
+}
@@ -12,6 +12,7 @@
 
 #include <array>
 #include <iostream>
+#include <vector>
 
 // -- Queue for MT-safe -- //
 #include "thread_safe_queue.hpp"
@@ -57,4 +58,21 @@ TEST_CASE("Basic Queue")
             REQUIRE(false);
         }
     }
+
+    SUBCASE("test push_batch [FIFO]")
+    {
+        std::vector<int> batch(arr.begin(), arr.end());
+        q.push(0);
+        q.push_batch(batch);
+        REQUIRE(batch.empty());
+
+        int pop_item;
+        REQUIRE(q.try_pop(pop_item));
+        REQUIRE(pop_item == 0);
+        for (size_t i = 0; i < 3; ++i) {
+            REQUIRE(q.try_pop(pop_item));
+            REQUIRE(pop_item == arr[i]);
+        }
+        REQUIRE_FALSE(q.try_pop(pop_item));
+    }
 }
\ No newline at end of file
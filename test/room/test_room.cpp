@@ -0,0 +1,194 @@
+// test room
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <random>
+#include <set>
+#include <vector>
+
+// -- rooms -- //
+#include "roaring_set.hpp"
+#include "room_registry.hpp"
+
+namespace
+{
+
+std::vector<std::uint32_t> items(const RoaringSet &s)
+{
+    std::vector<std::uint32_t> out;
+    s.for_each([&out](std::uint32_t x) { out.push_back(x); });
+    return out;
+}
+
+std::vector<std::uint32_t> common(const RoaringSet &a, const RoaringSet &b)
+{
+    std::vector<std::uint32_t> out;
+    a.for_each_common(b, [&out](std::uint32_t x) { out.push_back(x); });
+    return out;
+}
+
+}  // namespace
+
+TEST_CASE("RoaringSet basics")
+{
+    RoaringSet s;
+    REQUIRE(s.empty());
+    REQUIRE(s.add(7));
+    REQUIRE_FALSE(s.add(7));
+    REQUIRE(s.add(0xFFFFFFFFu));
+    REQUIRE(s.add(1u << 16));
+    REQUIRE(s.size() == 3);
+    REQUIRE(s.contains(7));
+    REQUIRE_FALSE(s.contains(8));
+    REQUIRE(items(s) == std::vector<std::uint32_t>{7, 1u << 16, 0xFFFFFFFFu});
+
+    REQUIRE(s.remove(7));
+    REQUIRE_FALSE(s.remove(7));
+    REQUIRE(s.size() == 2);
+}
+
+TEST_CASE("RoaringSet converts between array and bitmap")
+{
+    RoaringSet s;
+    for (std::uint32_t i = 0; i < 4096; ++i)
+        s.add(i * 2);
+    const std::size_t as_array = s.memory();
+    s.add(1);  // 4097 ids: bitmap
+    REQUIRE(s.size() == 4097);
+    REQUIRE(s.memory() <= as_array + 64);
+    REQUIRE(s.contains(1));
+    REQUIRE(s.contains(8190));
+    REQUIRE_FALSE(s.contains(8191));
+
+    s.remove(1);  // back to an array
+    REQUIRE(s.size() == 4096);
+    auto v = items(s);
+    REQUIRE(v.size() == 4096);
+    REQUIRE(std::is_sorted(v.begin(), v.end()));
+    REQUIRE(v.back() == 8190);
+
+    for (std::uint32_t i = 0; i < 4096; ++i)
+        s.remove(i * 2);
+    REQUIRE(s.empty());
+    REQUIRE(s.memory() < as_array);
+}
+
+TEST_CASE("RoaringSet with bitmaps only")
+{
+    RoaringSet s(0);
+    s.add(5);
+    REQUIRE(s.memory() >= 8192);
+    s.add(70000);
+    REQUIRE(s.contains(5));
+    REQUIRE(s.contains(70000));
+    REQUIRE(items(s) == std::vector<std::uint32_t>{5, 70000});
+    s.remove(5);
+    REQUIRE(items(s) == std::vector<std::uint32_t>{70000});
+    s.remove(70000);
+    REQUIRE(s.empty());
+}
+
+TEST_CASE("RoaringSet matches std::set")
+{
+    std::mt19937 rng(35);
+    // dense and sparse chunks, so every container pair is exercised
+    std::uniform_int_distribution<std::uint32_t> dense(0, 3 * 65536);
+    std::uniform_int_distribution<std::uint32_t> sparse(0, 0xFFFFFFFFu);
+
+    RoaringSet a, b;
+    std::set<std::uint32_t> ra, rb;
+    for (int round = 0; round < 60000; ++round) {
+        const std::uint32_t x = round % 4 ? dense(rng) : sparse(rng);
+        auto &s = round % 2 ? a : b;
+        auto &r = round % 2 ? ra : rb;
+        if (rng() % 5 == 0)
+            REQUIRE(s.remove(x) == (r.erase(x) == 1));
+        else
+            REQUIRE(s.add(x) == r.insert(x).second);
+    }
+    REQUIRE(a.size() == ra.size());
+    REQUIRE(items(a) == std::vector<std::uint32_t>(ra.begin(), ra.end()));
+
+    std::vector<std::uint32_t> want;
+    std::set_intersection(ra.begin(), ra.end(), rb.begin(), rb.end(),
+                          std::back_inserter(want));
+    REQUIRE(!want.empty());
+    REQUIRE(common(a, b) == want);
+    REQUIRE(common(b, a) == want);
+
+    // one side much smaller than the other ( search instead of merge )
+    RoaringSet few;
+    for (std::uint32_t x : ra)
+        if (rng() % 50 == 0)
+            few.add(x + rng() % 2);  // about half of them are in a
+    want.clear();
+    few.for_each([&](std::uint32_t x) {
+        if (ra.count(x))
+            want.push_back(x);
+    });
+    REQUIRE(common(few, a) == want);
+    REQUIRE(common(a, few) == want);
+}
+
+TEST_CASE("RoomRegistry fan-out to online members")
+{
+    RoomRegistry rooms;
+    RoaringSet online(0);
+    for (UserId u = 0; u < 10000; ++u)
+        rooms.join("lobby", u * 7);
+    REQUIRE_FALSE(rooms.join("lobby", 0));
+    REQUIRE(rooms.members("lobby") == 10000);
+    REQUIRE(rooms.is_member("lobby", 70));
+    REQUIRE_FALSE(rooms.is_member("lobby", 71));
+
+    for (UserId u = 0; u < 70000; u += 20)  // every 20th user, members or not
+        online.add(u);
+
+    std::vector<UserId> out;
+    REQUIRE(rooms.online_members("lobby", online, out));
+    REQUIRE(out.size() == 10000 / 20);
+    for (UserId u : out)
+        REQUIRE(u % 140 == 0);
+
+    REQUIRE_FALSE(rooms.online_members("nowhere", online, out));
+    REQUIRE(out.empty());
+
+    rooms.join("small", 1);
+    REQUIRE(rooms.rooms() == 2);
+    REQUIRE(rooms.leave("small", 1));
+    REQUIRE_FALSE(rooms.leave("small", 1));
+    REQUIRE(rooms.rooms() == 1);  // empty rooms are dropped
+}
+
+TEST_CASE("RoomRegistry saves and loads its rooms")
+{
+    RoomRegistry rooms;
+    for (UserId u = 0; u < 5000; ++u)
+        rooms.join("lobby", u * 3);
+    rooms.join("small", 7);
+    std::string image;
+    rooms.save(image);
+    image += "tail";
+
+    RoomRegistry back;
+    back.join("stale", 1);
+    std::string_view in = image;
+    std::string_view unknown = image;
+    REQUIRE_FALSE(back.load(unknown, 4998 * 3));  // an id with no name
+    REQUIRE(back.load(in, 5000 * 3));
+    REQUIRE(in == "tail");  // consumed up to the end of the image
+    REQUIRE(back.rooms() == 2);
+    REQUIRE(back.members("lobby") == 5000);
+    REQUIRE(back.is_member("lobby", 4998 * 3));
+    REQUIRE(back.is_member("small", 7));
+    REQUIRE_FALSE(back.is_member("stale", 1));
+
+    // a cut image changes nothing
+    std::string_view cut(image.data(), image.size() / 2);
+    REQUIRE_FALSE(back.load(cut, 5000 * 3));
+    REQUIRE(back.members("lobby") == 5000);
+}
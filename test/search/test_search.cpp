@@ -0,0 +1,220 @@
+// test search
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// -- search index -- //
+#include "posting_list.hpp"
+#include "search_index.hpp"
+#include "tokenizer.hpp"
+
+namespace
+{
+
+std::vector<std::string> terms(const std::string &text,
+                               TokenMode mode = TokenMode::Index)
+{
+    std::vector<std::string> out;
+    tokenize(text, mode, out);
+    return out;
+}
+
+std::vector<std::uint64_t> ids(const std::vector<SearchHit> &hits)
+{
+    std::vector<std::uint64_t> out;
+    for (const auto &h : hits)
+        out.push_back(h.id);
+    return out;
+}
+
+}  // namespace
+
+TEST_CASE("tokenize splits words and folds case")
+{
+    REQUIRE(terms("Hello, World! it's 2024") ==
+            std::vector<std::string>{"hello", "world", "it", "s", "2024"});
+    REQUIRE(terms("ＡＢＣ１２３") == std::vector<std::string>{"abc123"});
+    REQUIRE(terms("café naïve") ==
+            std::vector<std::string>{"caf\xc3\xa9", "na\xc3\xafve"});
+    REQUIRE(terms("ok\xff\xfeok 👍 ") == std::vector<std::string>{"ok", "ok"});
+    REQUIRE(terms(std::string(65, 'x') + " y") ==
+            std::vector<std::string>{"y"});  // too long to be a word
+    REQUIRE(terms("  ...  ").empty());
+}
+
+TEST_CASE("tokenize cuts CJK runs into bigrams")
+{
+    REQUIRE(terms("你好嗎", TokenMode::Query) ==
+            std::vector<std::string>{"你好", "好嗎"});
+    REQUIRE(terms("你好嗎") ==
+            std::vector<std::string>{"你", "好", "嗎", "你好", "好嗎"});
+    REQUIRE(terms("好", TokenMode::Query) == std::vector<std::string>{"好"});
+
+    // punctuation ends a run, Latin in between is a word of its own
+    REQUIRE(terms("明天，OK嗎？", TokenMode::Query) ==
+            std::vector<std::string>{"明天", "ok", "嗎"});
+    REQUIRE(terms("カタカナ한국", TokenMode::Query) ==
+            std::vector<std::string>{"カタ", "タカ", "カナ", "ナ한", "한국"});
+}
+
+TEST_CASE("PostingList stores gaps and finds members")
+{
+    PostingList list;
+    std::vector<std::uint64_t> docs;
+    for (std::uint64_t d = 3; d < 100000; d += 1 + d % 7)
+        docs.push_back(d);
+    for (auto d : docs)
+        REQUIRE(list.append(d));
+    REQUIRE_FALSE(list.append(docs.back()));  // not ascending
+    REQUIRE(list.size() == docs.size());
+    REQUIRE(list.blocks() ==
+            (docs.size() + PostingList::kBlock - 1) / PostingList::kBlock);
+    REQUIRE(list.bytes() < docs.size() * 2);  // gaps < 128: a byte each
+
+    std::size_t k = 0;
+    for (std::uint64_t d = 0; d <= docs.back() + 10; ++d) {
+        const bool member = k < docs.size() && docs[k] == d;
+        REQUIRE(list.contains(d) == member);
+        if (member)
+            ++k;
+    }
+
+    std::vector<std::uint64_t> block;
+    list.block(1, block);
+    REQUIRE(block.size() == PostingList::kBlock);
+    REQUIRE(block.front() == docs[PostingList::kBlock]);
+    REQUIRE(list.block_of(block.front()) == 1);
+    REQUIRE(list.block_of(block.back() + 1) == 2);
+
+    PostingList big;  // gaps of several bytes
+    REQUIRE(big.append(1));
+    REQUIRE(big.append(std::uint64_t{1} << 40));
+    REQUIRE(big.contains(std::uint64_t{1} << 40));
+    REQUIRE_FALSE(big.contains(2));
+}
+
+TEST_CASE("SearchIndex matches every term, newest first")
+{
+    SearchIndex index;
+    index.add("alice\nbob", 11, "lunch at noon?");
+    index.add("alice\nbob", 12, "Noon works, see you at lunch");
+    index.add("alice\nbob", 13, "我們明天吃午餐");
+    index.add("#team", 14, "lunch meeting moved");
+    index.add("alice\nbob", 15, "明天見");
+
+    std::vector<SearchHit> hits;
+    index.search("alice\nbob", "LUNCH noon", 0, 10, hits);
+    REQUIRE(ids(hits) == std::vector<std::uint64_t>{12, 11});
+    REQUIRE(hits[0].doc > hits[1].doc);
+
+    index.search("alice\nbob", "明天", 0, 10, hits);
+    REQUIRE(ids(hits) == std::vector<std::uint64_t>{15, 13});
+    index.search("alice\nbob", "吃午餐", 0, 10, hits);
+    REQUIRE(ids(hits) == std::vector<std::uint64_t>{13});
+    index.search("alice\nbob", "午", 0, 10, hits);  // one character
+    REQUIRE(ids(hits) == std::vector<std::uint64_t>{13});
+
+    // scoped: the room's lunch is not in the direct conversation
+    index.search("#team", "lunch", 0, 10, hits);
+    REQUIRE(ids(hits) == std::vector<std::uint64_t>{14});
+    index.search(std::vector<std::string>{"alice\nbob", "#team"}, "lunch", 0,
+                 10, hits);
+    REQUIRE(ids(hits) == std::vector<std::uint64_t>{14, 12, 11});
+
+    // nothing to match
+    index.search("alice\nbob", "dinner", 0, 10, hits);
+    REQUIRE(hits.empty());
+    index.search("alice\nbob", "?!", 0, 10, hits);
+    REQUIRE(hits.empty());
+    index.search("carol\ndave", "lunch", 0, 10, hits);
+    REQUIRE(hits.empty());
+
+    REQUIRE(index.documents() == 5);
+    REQUIRE(index.conversations_of("bob") ==
+            std::vector<std::string>{"alice\nbob"});
+    REQUIRE(index.conversations_of("team").empty());
+}
+
+TEST_CASE("SearchIndex pages with the last hit as cursor")
+{
+    SearchIndex index;
+    std::vector<std::uint64_t> expected;  // newest first
+    for (std::uint64_t i = 1; i <= 2000; ++i) {
+        const bool match = i % 3 == 0;
+        index.add(i % 2 ? "a\nb" : "a\nc", i,
+                  match ? "ping 你好" : "pong 你們好");
+        if (match && i % 2)
+            expected.insert(expected.begin(), i);
+    }
+    // repeated terms are one posting
+    index.add("a\nb", 2001, "ping ping ping");
+    expected.insert(expected.begin(), 2001);
+
+    std::vector<std::uint64_t> got;
+    std::vector<SearchHit> hits;
+    std::uint64_t cursor = 0;
+    do {
+        index.search("a\nb", "ping", cursor, 7, hits);
+        REQUIRE(hits.size() <= 7);
+        for (const auto &h : hits)
+            got.push_back(h.id);
+        cursor = hits.empty() ? 0 : hits.back().doc;
+    } while (!hits.empty());
+    REQUIRE(got == expected);
+
+    index.search("a\nb", "你好", 0, 1000, hits);
+    REQUIRE(hits.size() == expected.size() - 1);
+    index.search(std::vector<std::string>{"a\nb", "a\nc"}, "ping", 0, 1000,
+                 hits);
+    REQUIRE(hits.size() == 2000 / 3 + 1);
+    REQUIRE(index.postings() > 2001 * 2);
+    REQUIRE(index.bytes() > 0);
+}
+
+TEST_CASE("SearchIndex saves and loads with its mark")
+{
+    const auto path =
+        (std::filesystem::temp_directory_path() / "test_search.idx").string();
+    SearchIndex index;
+    for (std::uint64_t i = 1; i <= 500; ++i)
+        index.add(i % 2 ? "a\nb" : "#team", 100 + i,
+                  i % 5 ? "lunch at noon" : "午餐 lunch");
+    REQUIRE(index.save(path, 4242));
+
+    SearchIndex back;
+    std::uint64_t mark = 0;
+    REQUIRE(back.load(path, mark));
+    REQUIRE(mark == 4242);
+    REQUIRE(back.documents() == index.documents());
+    REQUIRE(back.postings() == index.postings());
+    REQUIRE(back.id_of(500) == 600);
+    REQUIRE(back.conversations_of("b") == std::vector<std::string>{"a\nb"});
+    std::vector<SearchHit> want, got;
+    index.search("#team", "午餐", 0, 1000, want);
+    back.search("#team", "午餐", 0, 1000, got);
+    REQUIRE(ids(got) == ids(want));
+    REQUIRE(got.size() == 50);
+
+    // new messages go on from the loaded documents
+    REQUIRE(back.add("a\nb", 601, "dinner") == 501);
+
+    // a damaged file changes nothing
+    {
+        std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(20);
+        f.put('\x7f');
+    }
+    REQUIRE_FALSE(back.load(path, mark));
+    REQUIRE(back.documents() == 501);
+    REQUIRE_FALSE(back.load(path + ".missing", mark));
+    back.clear();
+    REQUIRE(back.documents() == 0);
+    REQUIRE(back.add("a\nb", 1, "again") == 1);
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,124 @@
+// test watchdog
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+// -- headers for thread -- //
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include <vector>
+
+// -- deadline watchdog -- //
+#include "watchdog.hpp"
+
+using namespace std::chrono_literals;
+
+namespace
+{
+
+struct Collector {
+    std::mutex mtx;
+    std::vector<Watchdog::Overrun> reports;
+
+    Watchdog::report_type fn()
+    {
+        return [this](const Watchdog::Overrun &o) {
+            std::lock_guard<std::mutex> lk(mtx);
+            reports.push_back(o);
+        };
+    }
+
+    std::size_t size()
+    {
+        std::lock_guard<std::mutex> lk(mtx);
+        return reports.size();
+    }
+};
+
+}  // namespace
+
+TEST_CASE("Watchdog fast handler is not reported")
+{
+    Collector c;
+    Watchdog wd(c.fn(), 1ms, 50ms);
+    {
+        auto ticket = wd.watch("chat", 7, 500ms);
+        REQUIRE(wd.active() == 1);
+    }
+    REQUIRE(wd.active() == 0);
+    std::this_thread::sleep_for(10ms);
+    REQUIRE(c.size() == 0);
+    REQUIRE_FALSE(wd.is_throttled(7));
+}
+
+TEST_CASE("Watchdog reports overrun with label and duration")
+{
+    Collector c;
+    Watchdog wd(c.fn(), 1ms, 50ms);
+
+    auto ticket = wd.watch("login", 3, 5ms);
+    std::this_thread::sleep_for(40ms);
+
+    // reported while still running and owner is throttled
+    REQUIRE(c.size() == 1);
+    REQUIRE(wd.is_throttled(3));
+    REQUIRE_FALSE(wd.is_throttled(4));
+    {
+        std::lock_guard<std::mutex> lk(c.mtx);
+        REQUIRE(c.reports[0].label == "login");
+        REQUIRE(c.reports[0].owner == 3);
+        REQUIRE_FALSE(c.reports[0].finished);
+        REQUIRE(c.reports[0].elapsed >= c.reports[0].budget);
+    }
+
+    // finishing reports the total duration and starts the cool-down
+    ticket.release();
+    REQUIRE(c.size() == 2);
+    {
+        std::lock_guard<std::mutex> lk(c.mtx);
+        REQUIRE(c.reports[1].finished);
+        REQUIRE(c.reports[1].elapsed >= 40ms);
+    }
+    REQUIRE(wd.is_throttled(3));
+    std::this_thread::sleep_for(80ms);
+    REQUIRE_FALSE(wd.is_throttled(3));
+}
+
+TEST_CASE("Watchdog keeps throttling while another ticket overruns")
+{
+    Collector c;
+    Watchdog wd(c.fn(), 1ms, 20ms);
+
+    auto first = wd.watch("history", 5, 5ms);
+    auto second = wd.watch("search", 5, 5ms);
+    std::this_thread::sleep_for(30ms);
+    REQUIRE(c.size() == 2);
+
+    // one done, the other still running: no cool-down yet
+    first.release();
+    std::this_thread::sleep_for(60ms);
+    REQUIRE(wd.is_throttled(5));
+
+    second.release();
+    REQUIRE(wd.is_throttled(5));
+    std::this_thread::sleep_for(60ms);
+    REQUIRE_FALSE(wd.is_throttled(5));
+}
+
+TEST_CASE("Watchdog ticket can be moved")
+{
+    Collector c;
+    Watchdog wd(c.fn(), 1ms, 10ms);
+
+    Watchdog::Ticket outer;
+    {
+        auto inner = wd.watch("add_friend", 1, 1s);
+        outer = std::move(inner);
+    }
+    REQUIRE(wd.active() == 1);
+    outer.release();
+    outer.release();
+    REQUIRE(wd.active() == 0);
+}